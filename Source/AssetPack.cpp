@@ -0,0 +1,522 @@
+#include "BaseUtils.hpp"
+#include "AssetPack.hpp"
+#include "Streams.hpp"
+#include "Settings.hpp"
+#include "Time.hpp"
+#include "ImGuiUtils.hpp"
+#include "LoadProfiler.hpp"
+#include "FrameArena.hpp"
+#include <algorithm>
+#include <chrono>
+
+static UintSetting g_CacheCompactionThresholdPercent(SettingCategory::Startup, "Cache.CompactionThresholdPercent", 50);
+static UintSetting g_CacheMaxSizeMB(SettingCategory::Startup, "Cache.MaxSizeMB", 4096);
+static UintSetting g_CacheWriteQueueMaxSizeMB(SettingCategory::Startup, "Cache.WriteQueueMaxSizeMB", 256);
+
+AssetPack* g_AssetPack;
+
+static uint64_t GetMaxSize()
+{
+    return (uint64_t)g_CacheMaxSizeMB.GetValue() * 1024 * 1024;
+}
+
+AssetPack::~AssetPack()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        // The thread writes remaining queued entries and the index before it exits.
+        m_FlushRequested = true;
+        m_StopRequested = true;
+    }
+    m_WriteCondition.notify_one();
+    if(m_Thread.joinable())
+        m_Thread.join();
+}
+
+void AssetPack::Open(const wstr_view& path)
+{
+    assert(m_Path.empty());
+    path.to_string(m_Path);
+    m_Thread = std::thread([this]()
+    {
+        SetThreadName(GetCurrentThreadId(), "ASSET PACK");
+        ThreadMain();
+    });
+}
+
+bool AssetPack::IsOpen()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    WaitForOpen(lock);
+    return m_File != nullptr;
+}
+
+bool AssetPack::Find(Type type, uint64_t hash, int64_t sourceTime,
+    std::span<const char>& outData, std::shared_ptr<const MappedFile>& outFile)
+{
+    outData = {};
+    outFile.reset();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    WaitForOpen(lock);
+    if(!m_File)
+        return false;
+
+    const AssetPackEntry* const entry = FindAssetPackEntry(m_Index, (uint32_t)type, hash);
+    if(!entry || (sourceTime != ANY_SOURCE_TIME && entry->m_SourceTime != sourceTime))
+    {
+        ++m_MissCount;
+        return false;
+    }
+
+    ++m_HitCount;
+    m_LastAccessTimes[entry - m_Index.data()] = GetCurrentAccessTime();
+    m_LastAccessTimesChanged = true;
+    outData = std::span<const char>(m_File->GetData() + entry->m_Offset, (size_t)entry->m_Size);
+    outFile = m_File;
+    return true;
+}
+
+bool AssetPack::Contains(Type type, uint64_t hash, int64_t sourceTime)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    WaitForOpen(lock);
+    if(!m_File)
+        return false;
+
+    const AssetPackEntry* const entry = FindAssetPackEntry(m_Index, (uint32_t)type, hash);
+    if(!entry || (sourceTime != ANY_SOURCE_TIME && entry->m_SourceTime != sourceTime))
+        return false;
+
+    m_LastAccessTimes[entry - m_Index.data()] = GetCurrentAccessTime();
+    m_LastAccessTimesChanged = true;
+    return true;
+}
+
+void AssetPack::Add(Type type, uint64_t hash, int64_t sourceTime, std::vector<char>&& data)
+{
+    const uint64_t maxQueueSize = (uint64_t)g_CacheWriteQueueMaxSizeMB.GetValue() * 1024 * 1024;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if(m_WriteQueueSize + data.size() > maxQueueSize)
+        {
+            // The entry will be made again next time it is needed.
+            ++m_DropCount;
+            return;
+        }
+        m_WriteQueueSize += data.size();
+        m_WriteQueue.push_back({
+            .m_Type = type,
+            .m_Hash = hash,
+            .m_SourceTime = sourceTime,
+            .m_Data = std::move(data) });
+    }
+    m_WriteCondition.notify_one();
+}
+
+void AssetPack::Flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_FlushRequested = true;
+    }
+    m_WriteCondition.notify_one();
+}
+
+AssetPack::Statistics AssetPack::GetStatistics()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    WaitForOpen(lock);
+    Statistics s;
+    s.m_EntryCount = (uint32_t)m_Index.size();
+    s.m_FileSize = m_File ? m_File->GetSize() : 0;
+    s.m_DeadSize = m_DeadSize;
+    s.m_HitCount = m_HitCount;
+    s.m_MissCount = m_MissCount;
+    s.m_AddCount = m_AddCount;
+    s.m_EvictCount = m_EvictCount;
+    s.m_EvictedSize = m_EvictedSize;
+    s.m_DropCount = m_DropCount;
+    s.m_WriteQueueSize = m_WriteQueueSize;
+    return s;
+}
+
+void AssetPack::ImGui()
+{
+    const Statistics s = GetStatistics();
+    ImGui::Text("Entries: %u, file size: %s, dead space: %s", s.m_EntryCount,
+        FrameSizeToStr(s.m_FileSize),
+        FrameSizeToStr(s.m_DeadSize));
+    ImGui::Text("Budget: %s", FrameSizeToStr(GetMaxSize()));
+    ImGui::Text("Hits: %llu, misses: %llu, added: %llu", s.m_HitCount, s.m_MissCount, s.m_AddCount);
+    ImGui::Text("Evicted: %llu (%s)", s.m_EvictCount,
+        FrameSizeToStr(s.m_EvictedSize));
+    ImGui::Text("Write queue: %s, dropped: %llu",
+        FrameSizeToStr(s.m_WriteQueueSize), s.m_DropCount);
+}
+
+int64_t AssetPack::GetCurrentAccessTime()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void AssetPack::ThreadMain()
+{
+    OpenOnThread();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Opened = true;
+    }
+    m_OpenedCondition.notify_all();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for(;;)
+    {
+        m_WriteCondition.wait(lock, [this]()
+        {
+            return !m_WriteQueue.empty() || m_FlushRequested || m_StopRequested;
+        });
+        // Queued entries go first, so a flush requested after them includes them.
+        if(!m_WriteQueue.empty())
+        {
+            const WriteRequest request = std::move(m_WriteQueue.front());
+            m_WriteQueue.pop_front();
+            lock.unlock();
+            try
+            {
+                WriteOnThread(request);
+            } CATCH_PRINT_ERROR(CloseWriter();)
+            lock.lock();
+            m_WriteQueueSize -= request.m_Data.size();
+        }
+        else if(m_FlushRequested)
+        {
+            m_FlushRequested = false;
+            lock.unlock();
+            try
+            {
+                FlushOnThread();
+            } CATCH_PRINT_ERROR(CloseWriter(); m_PendingEntries.clear();)
+            lock.lock();
+        }
+        else
+            break;
+    }
+}
+
+void AssetPack::OpenOnThread()
+{
+    LogInfoF(L"Opening asset pack \"{}\"...", m_Path);
+
+    try
+    {
+        const std::filesystem::path pathP = StrToPath(m_Path);
+        std::error_code errorCode;
+        std::filesystem::create_directories(pathP.parent_path(), errorCode);
+
+        if(FileExists(pathP))
+        {
+            try
+            {
+                Map();
+            } CATCH_PRINT_ERROR(m_File.reset(); m_Index = {};)
+            if(!m_File)
+            {
+                try
+                {
+                    Recover();
+                } CATCH_PRINT_ERROR(m_File.reset(); m_Index = {};)
+            }
+            if(!m_File)
+                LogWarning(L"Asset pack is invalid. Creating new one.");
+        }
+        if(!m_File)
+        {
+            CreateEmpty();
+            Map();
+        }
+
+        std::vector<AssetPackEntry> entries = GetEntries();
+        const size_t entryCountBefore = entries.size();
+        Evict(entries, GetMaxSize());
+
+        const uint64_t fileSize = m_File->GetSize();
+        if(entries.size() < entryCountBefore ||
+            (m_DeadSize > 0 && m_DeadSize * 100 >= fileSize * g_CacheCompactionThresholdPercent.GetValue()))
+        {
+            Compact(entries);
+        }
+
+        LogInfoF(L"Asset pack: {} entries, size {}, dead space {}.",
+            m_Index.size(), SizeToStr(m_File->GetSize()), SizeToStr(m_DeadSize));
+    }
+    CATCH_PRINT_ERROR(m_File.reset(); m_Index = {}; m_LastAccessTimes.clear();)
+}
+
+void AssetPack::WriteOnThread(const WriteRequest& request)
+{
+    if(!m_File)
+        return;
+
+    ERR_TRY;
+
+    if(!m_Writer)
+    {
+        // Previous index and footer stay in place, so m_Index remains valid until the flush.
+        // They become dead space.
+        OpenWriter();
+    }
+
+    const std::vector<char> zeros(ASSET_PACK_ALIGNMENT);
+    const uint64_t offset = AlignAssetPackOffset(m_WritePosition);
+    m_Writer->Write(zeros.data(), (size_t)(offset - m_WritePosition));
+    m_Writer->Write(request.m_Data);
+    m_WritePosition = offset + request.m_Data.size();
+
+    m_PendingEntries.push_back({
+        .m_Type = (uint32_t)request.m_Type,
+        .m_Reserved = 0,
+        .m_Hash = request.m_Hash,
+        .m_Offset = offset,
+        .m_Size = request.m_Data.size(),
+        .m_SourceTime = request.m_SourceTime,
+        .m_LastAccessTime = GetCurrentAccessTime() });
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_AddCount;
+
+    ERR_CATCH_MSG(std::format(L"Cannot add entry to asset pack \"{}\".", m_Path));
+}
+
+void AssetPack::FlushOnThread()
+{
+    PROFILE_LOAD_SCOPE("AssetPack::Flush");
+    if(!m_File)
+        return;
+
+    ERR_TRY;
+
+    std::vector<AssetPackEntry> knownEntries;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if(m_PendingEntries.empty() && !m_LastAccessTimesChanged)
+            return;
+        knownEntries = GetEntries();
+        m_LastAccessTimesChanged = false;
+    }
+
+    if(!m_Writer)
+        OpenWriter();
+
+    // Another instance could have flushed since m_Index was mapped. Merging into m_Index would drop
+    // the entries it added, and the dead size below would count them as dead.
+    std::vector<AssetPackEntry> currentEntries(m_WriterIndex.begin(), m_WriterIndex.end());
+    MergeAssetPackAccessTimes(knownEntries, currentEntries);
+    std::vector<AssetPackEntry> entries;
+    MergeAssetPackEntries(m_PendingEntries, currentEntries, entries);
+    // Data of evicted entries becomes dead space, removed by compaction on the next Open.
+    Evict(entries, GetMaxSize());
+
+    uint64_t liveSize = 0;
+    for(const AssetPackEntry& entry : entries)
+        liveSize += entry.m_Size;
+    const uint64_t deadSize = m_WritePosition - ASSET_PACK_HEADER_SIZE - liveSize;
+
+    WriteIndex(*m_Writer, m_WritePosition, entries, deadSize);
+    CloseWriter();
+    m_PendingEntries.clear();
+
+    std::span<const AssetPackEntry> index;
+    uint64_t newDeadSize = 0;
+    std::shared_ptr<const MappedFile> file = MapFile(m_Path, index, newDeadSize);
+    std::vector<int64_t> lastAccessTimes(index.size());
+    for(size_t i = 0; i < index.size(); ++i)
+        lastAccessTimes[i] = index[i].m_LastAccessTime;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // Find could update access times while the index was written. Both indices are sorted.
+    size_t oldIndex = 0;
+    for(size_t i = 0; i < index.size(); ++i)
+    {
+        while(oldIndex < m_Index.size() && AssetPackEntryLess(m_Index[oldIndex], index[i]))
+            ++oldIndex;
+        if(oldIndex < m_Index.size() && !AssetPackEntryLess(index[i], m_Index[oldIndex]) &&
+            m_LastAccessTimes[oldIndex] > lastAccessTimes[i])
+        {
+            lastAccessTimes[i] = m_LastAccessTimes[oldIndex];
+            m_LastAccessTimesChanged = true;
+        }
+    }
+    // Textures may still use the old mapping - they keep it alive.
+    m_File = std::move(file);
+    m_Index = index;
+    m_LastAccessTimes = std::move(lastAccessTimes);
+    m_DeadSize = newDeadSize;
+
+    ERR_CATCH_MSG(std::format(L"Cannot flush asset pack \"{}\".", m_Path));
+}
+
+void AssetPack::OpenWriter()
+{
+    // Fails if another instance is appending, so the file doesn't change until CloseWriter.
+    m_Writer = std::make_unique<FileStream>(m_Path, FileStream::Flag_Write | FileStream::Flag_Append);
+    m_WritePosition = m_Writer->GetPosition();
+
+    m_WriterFile = std::make_shared<MappedFile>(m_Path);
+    const std::span<const char> data(m_WriterFile->GetData(), m_WriterFile->GetSize());
+    if(!ValidateAssetPackHeader(data))
+        FAIL(L"Invalid header or unsupported version.");
+    uint64_t deadSize = 0;
+    if(!ParseAssetPackFooter(data, m_WriterIndex, deadSize))
+    {
+        // Another instance was killed while appending, or this one failed to write an entry.
+        // What follows the last footer becomes dead space.
+        const uint64_t validSize = FindLastValidAssetPackEnd(data);
+        if(validSize == 0)
+            FAIL(L"No valid footer found.");
+        ParseAssetPackFooter(data.first((size_t)validSize), m_WriterIndex, deadSize);
+    }
+}
+
+void AssetPack::CloseWriter()
+{
+    m_Writer.reset();
+    m_WriterIndex = {};
+    m_WriterFile.reset();
+}
+
+void AssetPack::WaitForOpen(std::unique_lock<std::mutex>& lock)
+{
+    m_OpenedCondition.wait(lock, [this]() { return m_Opened; });
+}
+
+std::vector<AssetPackEntry> AssetPack::GetEntries() const
+{
+    std::vector<AssetPackEntry> entries(m_Index.begin(), m_Index.end());
+    for(size_t i = 0; i < entries.size(); ++i)
+        entries[i].m_LastAccessTime = m_LastAccessTimes[i];
+    return entries;
+}
+
+void AssetPack::Evict(std::vector<AssetPackEntry>& inoutEntries, uint64_t budget)
+{
+    uint64_t evictedSize = 0;
+    const uint32_t evictCount = EvictAssetPackEntries(inoutEntries, budget, evictedSize);
+    if(evictCount == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_EvictCount += evictCount;
+        m_EvictedSize += evictedSize;
+    }
+
+    LogInfoF(L"Evicted {} entries ({}) from asset pack to fit in budget {}.",
+        evictCount, SizeToStr(evictedSize), SizeToStr(budget));
+}
+
+void AssetPack::CreateEmpty()
+{
+    std::vector<char> bytes;
+    BuildAssetPackHeader(bytes);
+    uint64_t position = bytes.size();
+    BuildAssetPackIndex(position, {}, 0, bytes);
+
+    FileStream stream(m_Path, FileStream::Flag_Write | FileStream::Flag_Sequential);
+    stream.Write(bytes);
+}
+
+std::shared_ptr<const MappedFile> AssetPack::MapFile(const wstr_view& path,
+    std::span<const AssetPackEntry>& outIndex, uint64_t& outDeadSize)
+{
+    auto file = std::make_shared<MappedFile>(path);
+    const std::span<const char> data(file->GetData(), file->GetSize());
+    if(!ValidateAssetPackHeader(data))
+        FAIL(L"Invalid header or unsupported version.");
+    if(!ParseAssetPackFooter(data, outIndex, outDeadSize))
+        FAIL(L"Invalid footer or index.");
+    return file;
+}
+
+void AssetPack::Map()
+{
+    std::span<const AssetPackEntry> index;
+    uint64_t deadSize = 0;
+    m_File = MapFile(m_Path, index, deadSize);
+    m_Index = index;
+    m_LastAccessTimes.resize(m_Index.size());
+    for(size_t i = 0; i < m_Index.size(); ++i)
+        m_LastAccessTimes[i] = m_Index[i].m_LastAccessTime;
+    m_DeadSize = deadSize;
+}
+
+void AssetPack::Recover()
+{
+    uint64_t fileSize = 0;
+    uint64_t validSize = 0;
+    {
+        const MappedFile file(m_Path);
+        const std::span<const char> data(file.GetData(), file.GetSize());
+        if(!ValidateAssetPackHeader(data))
+            FAIL(L"Invalid header or unsupported version.");
+        fileSize = file.GetSize();
+        validSize = FindLastValidAssetPackEnd(data);
+    }
+    if(validSize == 0)
+        FAIL(L"No valid footer found.");
+
+    LogWarningF(L"Asset pack was not flushed completely. Truncating {} after the last index.",
+        SizeToStr(fileSize - validSize));
+    {
+        // Fails if another instance of the program is writing to the file.
+        FileStream stream(m_Path, FileStream::Flag_Write | FileStream::Flag_Append);
+        stream.SetPosition((ptrdiff_t)validSize, BaseStream::MoveMethod::Begin);
+        stream.Truncate();
+    }
+    Map();
+}
+
+void AssetPack::Compact(std::span<const AssetPackEntry> entriesToKeep)
+{
+    LogInfoF(L"Compacting asset pack, dead space {}...", SizeToStr(m_DeadSize));
+    const Time beginTime = Now();
+
+    const wstring tmpPath = m_Path + L".tmp";
+    {
+        std::vector<char> header;
+        BuildAssetPackHeader(header);
+        FileStream stream(tmpPath, FileStream::Flag_Write | FileStream::Flag_Sequential);
+        stream.Write(header);
+        uint64_t position = header.size();
+
+        const std::vector<char> zeros(ASSET_PACK_ALIGNMENT);
+        std::vector<AssetPackEntry> entries(entriesToKeep.begin(), entriesToKeep.end());
+        for(AssetPackEntry& entry : entries)
+        {
+            const uint64_t offset = AlignAssetPackOffset(position);
+            stream.Write(zeros.data(), (size_t)(offset - position));
+            stream.Write(m_File->GetData() + entry.m_Offset, (size_t)entry.m_Size);
+            entry.m_Offset = offset;
+            position = offset + entry.m_Size;
+        }
+        // Only alignment padding remains, which is not worth counting.
+        WriteIndex(stream, position, entries, 0);
+    }
+
+    // Nothing else uses the mapping yet, so the file can be replaced.
+    m_File.reset();
+    m_Index = {};
+    std::filesystem::rename(StrToPath(tmpPath), StrToPath(m_Path));
+    Map();
+
+    LogInfoF(L"Compacted asset pack to {} in {:.1f} ms.",
+        SizeToStr(m_File->GetSize()), TimeToMilliseconds<float>(Now() - beginTime));
+}
+
+void AssetPack::WriteIndex(FileStream& stream, uint64_t& inoutPosition, std::span<const AssetPackEntry> entries,
+    uint64_t deadSize)
+{
+    std::vector<char> bytes;
+    BuildAssetPackIndex(inoutPosition, entries, deadSize, bytes);
+    stream.Write(bytes);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include "AssetPackFormat.hpp"
+
+class MappedFile;
+class FileStream;
+
+/*
+Single file holding cooked assets, e.g. processed textures, so the cache doesn't need
+to open and check one file per asset.
+
+Entries are identified by type and hash. Each entry remembers last write time of its
+source file, so stale entries are not returned.
+
+The file is append-only: new entries are written at the end, then Flush writes a new sorted
+index and a footer after them. The index is used directly from the memory-mapped file.
+Replaced entries and old copies of the index become dead space, removed by compaction in Open
+when there is too much of it. Every footer ends at a multiple of PACK_DATA_ALIGNMENT. If the file
+doesn't end with a valid footer, e.g. the process was killed while appending, Open finds the last
+valid one and truncates what follows, so a partially written entry is never seen.
+
+Another instance of the program can use the same file. Only one can append at a time - opening the file for
+appending fails while another instance has it open, and the entry is not added. Flush merges new entries into
+the index at the end of the file as it was when it was opened for appending, which includes entries flushed by other
+instances, not the index this instance mapped earlier.
+
+The index also records when each entry was last used. If live entries exceed "Cache.MaxSizeMB",
+Open and Flush evict the least recently used ones, so the budget holds also during a long session.
+Data evicted by Flush stays in the file as dead space until compaction in the next Open.
+
+The file format is in AssetPackFormat.hpp.
+
+All file operations happen on a background thread, so loading never waits for writes. Open starts
+the thread. Add and Flush only queue work for it. Queued data is limited by "Cache.WriteQueueMaxSizeMB" -
+entries that don't fit are dropped. Find and GetStatistics wait until opening finishes.
+*/
+class AssetPack
+{
+public:
+    enum class Type : uint32_t
+    {
+        Texture = 1,
+        Mesh = 2,
+        ShaderBytecode = 3,
+        // Maps hash of shader sources and compiler arguments to hash of ShaderBytecode entry.
+        ShaderKey = 4,
+    };
+
+    // Pass to Find when source file doesn't exist, to accept entry of any source time.
+    static const int64_t ANY_SOURCE_TIME = INT64_MIN;
+
+    struct Statistics
+    {
+        uint32_t m_EntryCount = 0;
+        uint64_t m_FileSize = 0;
+        uint64_t m_DeadSize = 0;
+        uint64_t m_HitCount = 0;
+        uint64_t m_MissCount = 0;
+        uint64_t m_AddCount = 0;
+        uint64_t m_EvictCount = 0;
+        uint64_t m_EvictedSize = 0;
+        uint64_t m_DropCount = 0;
+        uint64_t m_WriteQueueSize = 0;
+    };
+
+    // Writes all queued entries and the index.
+    ~AssetPack();
+
+    // Starts opening existing pack file or creating new one. If it fails, the pack stays closed
+    // and works as if empty.
+    void Open(const wstr_view& path);
+    bool IsOpen();
+
+    /*
+    Returns true and data of the entry if it exists and was made from source file with sourceTime.
+    Entries added before the last completed flush are found.
+    outFile keeps memory pointed by outData alive, also after the pack is flushed or destroyed.
+    */
+    bool Find(Type type, uint64_t hash, int64_t sourceTime,
+        std::span<const char>& outData, std::shared_ptr<const MappedFile>& outFile);
+    // Like Find, but only checks if the entry exists, e.g. to not add a duplicate. Doesn't count as a hit
+    // or a miss in statistics. Updates last access time of the entry, as it is going to be used.
+    bool Contains(Type type, uint64_t hash, int64_t sourceTime);
+    // Queues new entry to be appended to the file. It replaces existing entry with same type and hash
+    // after Flush. Doesn't wait.
+    void Add(Type type, uint64_t hash, int64_t sourceTime, std::vector<char>&& data);
+    // Queues writing index of all entries with their last access times and mapping the file again,
+    // so new entries can be found. Doesn't wait.
+    void Flush();
+
+    Statistics GetStatistics();
+    void ImGui();
+
+private:
+    struct WriteRequest
+    {
+        Type m_Type;
+        uint64_t m_Hash;
+        int64_t m_SourceTime;
+        std::vector<char> m_Data;
+    };
+
+    wstring m_Path;
+    std::thread m_Thread;
+
+    // Protects members below. Once opened, m_Thread changes m_File, m_Index, m_DeadSize only while
+    // holding it, so it can read them without locking.
+    std::mutex m_Mutex;
+    // Signaled when m_Opened becomes true.
+    std::condition_variable m_OpenedCondition;
+    // Signaled when there is work for m_Thread.
+    std::condition_variable m_WriteCondition;
+    bool m_Opened = false;
+    std::shared_ptr<const MappedFile> m_File;
+    // Points to m_File.
+    std::span<const AssetPackEntry> m_Index;
+    // Same size as m_Index. Updated by Find, written by Flush.
+    std::vector<int64_t> m_LastAccessTimes;
+    bool m_LastAccessTimesChanged = false;
+    uint64_t m_DeadSize = 0;
+    std::deque<WriteRequest> m_WriteQueue;
+    // Sum of data sizes in m_WriteQueue and the request being written.
+    uint64_t m_WriteQueueSize = 0;
+    bool m_FlushRequested = false;
+    bool m_StopRequested = false;
+    uint64_t m_HitCount = 0;
+    uint64_t m_MissCount = 0;
+    uint64_t m_AddCount = 0;
+    uint64_t m_EvictCount = 0;
+    uint64_t m_EvictedSize = 0;
+    uint64_t m_DropCount = 0;
+
+    // Used only by m_Thread. Not null between writing an entry and flush.
+    unique_ptr<FileStream> m_Writer;
+    // The file as it was when m_Writer was opened and its index, which Flush merges new entries into.
+    std::shared_ptr<const MappedFile> m_WriterFile;
+    std::span<const AssetPackEntry> m_WriterIndex;
+    uint64_t m_WritePosition = 0;
+    std::vector<AssetPackEntry> m_PendingEntries;
+
+    static int64_t GetCurrentAccessTime();
+    // Body of m_Thread: opens the pack, then processes m_WriteQueue and flush requests until stopped.
+    void ThreadMain();
+    void OpenOnThread();
+    void WriteOnThread(const WriteRequest& request);
+    // Opens m_Writer and reads the current index at the end of the file to m_WriterFile, m_WriterIndex.
+    void OpenWriter();
+    void CloseWriter();
+    void FlushOnThread();
+    void WaitForOpen(std::unique_lock<std::mutex>& lock);
+    void CreateEmpty();
+    // Maps path and validates it.
+    static std::shared_ptr<const MappedFile> MapFile(const wstr_view& path,
+        std::span<const AssetPackEntry>& outIndex, uint64_t& outDeadSize);
+    // Maps m_Path, validates it, sets m_File, m_Index, m_LastAccessTimes.
+    void Map();
+    // Truncates the file after the last valid footer and maps it.
+    void Recover();
+    // Returns index entries with updated m_LastAccessTime.
+    std::vector<AssetPackEntry> GetEntries() const;
+    // Removes least recently used entries from the list until their total size fits in budget.
+    // Takes m_Mutex to update statistics.
+    void Evict(std::vector<AssetPackEntry>& inoutEntries, uint64_t budget);
+    // Rewrites the file with only given entries, which must come from the current index.
+    void Compact(std::span<const AssetPackEntry> entries);
+    static void WriteIndex(FileStream& stream, uint64_t& inoutPosition, std::span<const AssetPackEntry> entries,
+        uint64_t deadSize);
+};
+
+extern AssetPack* g_AssetPack;
@@ -0,0 +1,200 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "AssetPackFormat.hpp"
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(AssetPackEntry) == 48);
+
+static const char PACK_FILE_MAGIC[16] = "RegEngineAssets";
+static const uint32_t PACK_FILE_VERSION = 102;
+static const char PACK_FOOTER_MAGIC[8] = "PackEnd";
+
+struct PackFileHeader
+{
+    char m_Magic[16];
+    uint32_t m_Version;
+    uint32_t m_Reserved;
+};
+static_assert(sizeof(PackFileHeader) == ASSET_PACK_HEADER_SIZE);
+
+struct PackFileFooter
+{
+    uint64_t m_IndexOffset;
+    uint64_t m_EntryCount;
+    // Bytes between the header and the index not used by any live entry.
+    uint64_t m_DeadSize;
+    char m_Magic[8];
+};
+static_assert(sizeof(PackFileFooter) == 32);
+
+bool AssetPackEntryLess(const AssetPackEntry& lhs, const AssetPackEntry& rhs)
+{
+    if(lhs.m_Type != rhs.m_Type)
+        return lhs.m_Type < rhs.m_Type;
+    return lhs.m_Hash < rhs.m_Hash;
+}
+
+const AssetPackEntry* FindAssetPackEntry(std::span<const AssetPackEntry> index, uint32_t type, uint64_t hash)
+{
+    AssetPackEntry key = {};
+    key.m_Type = type;
+    key.m_Hash = hash;
+    const auto it = std::lower_bound(index.begin(), index.end(), key, AssetPackEntryLess);
+    if(it == index.end() || it->m_Type != type || it->m_Hash != hash)
+        return nullptr;
+    return &*it;
+}
+
+void BuildAssetPackHeader(std::vector<char>& outBytes)
+{
+    PackFileHeader header = {};
+    header.m_Version = PACK_FILE_VERSION;
+    memcpy(header.m_Magic, PACK_FILE_MAGIC, sizeof(PACK_FILE_MAGIC));
+    const char* const bytes = (const char*)&header;
+    outBytes.insert(outBytes.end(), bytes, bytes + sizeof(header));
+}
+
+bool ValidateAssetPackHeader(std::span<const char> data)
+{
+    if(data.size() < sizeof(PackFileHeader))
+        return false;
+    PackFileHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    return memcmp(header.m_Magic, PACK_FILE_MAGIC, sizeof(PACK_FILE_MAGIC)) == 0 &&
+        header.m_Version == PACK_FILE_VERSION;
+}
+
+void BuildAssetPackIndex(uint64_t& inoutPosition, std::span<const AssetPackEntry> entries, uint64_t deadSize,
+    std::vector<char>& outBytes)
+{
+    const uint64_t indexOffset = AlignAssetPackOffset(inoutPosition);
+    const uint64_t indexEnd = indexOffset + entries.size() * sizeof(AssetPackEntry);
+    const uint64_t fileEnd = AlignAssetPackOffset(indexEnd + sizeof(PackFileFooter));
+
+    // Padding stays zero.
+    const size_t begin = outBytes.size();
+    outBytes.resize(begin + (size_t)(fileEnd - inoutPosition));
+    char* const dst = outBytes.data() + begin;
+    memcpy(dst + (indexOffset - inoutPosition), entries.data(), entries.size() * sizeof(AssetPackEntry));
+
+    PackFileFooter footer = {};
+    footer.m_IndexOffset = indexOffset;
+    footer.m_EntryCount = entries.size();
+    footer.m_DeadSize = deadSize;
+    memcpy(footer.m_Magic, PACK_FOOTER_MAGIC, sizeof(PACK_FOOTER_MAGIC));
+    memcpy(dst + (fileEnd - sizeof(PackFileFooter) - inoutPosition), &footer, sizeof(footer));
+    inoutPosition = fileEnd;
+}
+
+bool ParseAssetPackFooter(std::span<const char> data,
+    std::span<const AssetPackEntry>& outIndex, uint64_t& outDeadSize)
+{
+    const uint64_t fileEnd = data.size();
+    if(fileEnd % ASSET_PACK_ALIGNMENT != 0 || fileEnd < sizeof(PackFileHeader) + sizeof(PackFileFooter))
+        return false;
+    const uint64_t footerOffset = fileEnd - sizeof(PackFileFooter);
+    PackFileFooter footer;
+    memcpy(&footer, data.data() + footerOffset, sizeof(footer));
+    if(memcmp(footer.m_Magic, PACK_FOOTER_MAGIC, sizeof(PACK_FOOTER_MAGIC)) != 0)
+        return false;
+    if(footer.m_IndexOffset % ASSET_PACK_ALIGNMENT != 0 ||
+        footer.m_IndexOffset < sizeof(PackFileHeader) || footer.m_IndexOffset > footerOffset ||
+        footer.m_EntryCount > (footerOffset - footer.m_IndexOffset) / sizeof(AssetPackEntry))
+        return false;
+    // Only padding is allowed between the index and the footer.
+    const uint64_t indexEnd = footer.m_IndexOffset + footer.m_EntryCount * sizeof(AssetPackEntry);
+    if(footerOffset - indexEnd >= ASSET_PACK_ALIGNMENT)
+        return false;
+
+    const AssetPackEntry* const index = (const AssetPackEntry*)(data.data() + footer.m_IndexOffset);
+    for(uint64_t i = 0; i < footer.m_EntryCount; ++i)
+    {
+        if(index[i].m_Offset < sizeof(PackFileHeader) ||
+            index[i].m_Offset > footer.m_IndexOffset ||
+            index[i].m_Size > footer.m_IndexOffset - index[i].m_Offset)
+            return false;
+        if(i > 0 && !AssetPackEntryLess(index[i - 1], index[i]))
+            return false;
+    }
+
+    outIndex = std::span<const AssetPackEntry>(index, (size_t)footer.m_EntryCount);
+    outDeadSize = footer.m_DeadSize;
+    return true;
+}
+
+uint64_t FindLastValidAssetPackEnd(std::span<const char> data)
+{
+    std::span<const AssetPackEntry> index;
+    uint64_t deadSize = 0;
+    for(uint64_t end = data.size() / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT; end > 0; end -= ASSET_PACK_ALIGNMENT)
+    {
+        if(ParseAssetPackFooter(data.first((size_t)end), index, deadSize))
+            return end;
+    }
+    return 0;
+}
+
+void MergeAssetPackEntries(std::span<const AssetPackEntry> newEntries, std::span<const AssetPackEntry> currentEntries,
+    std::vector<AssetPackEntry>& outEntries)
+{
+    // Newer entries go first, so they win in std::unique.
+    outEntries.assign(newEntries.rbegin(), newEntries.rend());
+    outEntries.insert(outEntries.end(), currentEntries.begin(), currentEntries.end());
+    std::stable_sort(outEntries.begin(), outEntries.end(), AssetPackEntryLess);
+    outEntries.erase(std::unique(outEntries.begin(), outEntries.end(),
+        [](const AssetPackEntry& lhs, const AssetPackEntry& rhs)
+    {
+        return lhs.m_Type == rhs.m_Type && lhs.m_Hash == rhs.m_Hash;
+    }), outEntries.end());
+}
+
+void MergeAssetPackAccessTimes(std::span<const AssetPackEntry> srcEntries, std::span<AssetPackEntry> inoutEntries)
+{
+    size_t srcIndex = 0;
+    for(AssetPackEntry& entry : inoutEntries)
+    {
+        while(srcIndex < srcEntries.size() && AssetPackEntryLess(srcEntries[srcIndex], entry))
+            ++srcIndex;
+        if(srcIndex < srcEntries.size() && !AssetPackEntryLess(entry, srcEntries[srcIndex]))
+            entry.m_LastAccessTime = std::max(entry.m_LastAccessTime, srcEntries[srcIndex].m_LastAccessTime);
+    }
+}
+
+uint32_t EvictAssetPackEntries(std::vector<AssetPackEntry>& inoutEntries, uint64_t budget, uint64_t& inoutEvictedSize)
+{
+    uint64_t totalSize = 0;
+    for(const AssetPackEntry& entry : inoutEntries)
+        totalSize += entry.m_Size;
+    if(totalSize <= budget)
+        return 0;
+
+    // Least recently used first.
+    std::vector<size_t> order(inoutEntries.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+    {
+        return inoutEntries[lhs].m_LastAccessTime < inoutEntries[rhs].m_LastAccessTime;
+    });
+
+    std::vector<bool> evicted(inoutEntries.size());
+    uint32_t evictedCount = 0;
+    for(size_t i = 0; i < order.size() && totalSize > budget; ++i)
+    {
+        const AssetPackEntry& entry = inoutEntries[order[i]];
+        totalSize -= entry.m_Size;
+        evicted[order[i]] = true;
+        ++evictedCount;
+        inoutEvictedSize += entry.m_Size;
+    }
+
+    // Keeps the order of the rest, so they stay sorted.
+    size_t dstIndex = 0;
+    for(size_t srcIndex = 0; srcIndex < inoutEntries.size(); ++srcIndex)
+    {
+        if(!evicted[srcIndex])
+            inoutEntries[dstIndex++] = inoutEntries[srcIndex];
+    }
+    inoutEntries.resize(dstIndex);
+    return evictedCount;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+File format of AssetPack: header, entries, sorted index and footer, see AssetPack.hpp.
+Functions here only build and parse bytes and lists of entries - AssetPack does the file I/O on its thread
+and applies settings.
+
+Layout, all numbers little-endian:
+- Header: Magic = "RegEngineAssets", Version, Reserved.
+- Entries, each at an offset aligned to ASSET_PACK_ALIGNMENT.
+- Index at an offset aligned to ASSET_PACK_ALIGNMENT: AssetPackEntry[EntryCount] sorted by AssetPackEntryLess.
+- Footer: IndexOffset, EntryCount, DeadSize, Magic = "PackEnd", ending at a multiple of ASSET_PACK_ALIGNMENT.
+Entries, index and footer can repeat, as the file is append-only. The last footer is the valid one.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Entries and the index start at offsets aligned to this, so data can be used directly
+// from the mapped file, e.g. texture levels keep D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+// Footers end at offsets aligned to this, so the last valid one can be found after a crash.
+static const uint64_t ASSET_PACK_ALIGNMENT = 512;
+// Size of the header at the beginning of the file.
+static const uint64_t ASSET_PACK_HEADER_SIZE = 24;
+
+struct AssetPackEntry
+{
+    uint32_t m_Type;
+    uint32_t m_Reserved;
+    uint64_t m_Hash;
+    uint64_t m_Offset;
+    uint64_t m_Size;
+    int64_t m_SourceTime;
+    // In seconds since epoch.
+    int64_t m_LastAccessTime;
+};
+
+// Order of the index: by type, then by hash.
+bool AssetPackEntryLess(const AssetPackEntry& lhs, const AssetPackEntry& rhs);
+// Returns entry with given type and hash from a sorted index, or null.
+const AssetPackEntry* FindAssetPackEntry(std::span<const AssetPackEntry> index, uint32_t type, uint64_t hash);
+
+inline uint64_t AlignAssetPackOffset(uint64_t offset)
+{
+    return (offset + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+}
+
+// Appends the header that starts a new file, ASSET_PACK_HEADER_SIZE bytes.
+void BuildAssetPackHeader(std::vector<char>& outBytes);
+// Returns false if data doesn't start with a header of the current version.
+bool ValidateAssetPackHeader(std::span<const char> data);
+
+/*
+Appends padding, the index of given entries and a footer, to be written to the file at inoutPosition,
+and moves inoutPosition to the new end of the file.
+entries: sorted by AssetPackEntryLess.
+deadSize: bytes between the header and the index not used by any of the entries.
+*/
+void BuildAssetPackIndex(uint64_t& inoutPosition, std::span<const AssetPackEntry> entries, uint64_t deadSize,
+    std::vector<char>& outBytes);
+
+/*
+Returns true if there is a valid footer at the end of data, pointing to a valid index. outIndex points into data,
+which must be aligned to 8 bytes, like a mapped file.
+*/
+bool ParseAssetPackFooter(std::span<const char> data,
+    std::span<const AssetPackEntry>& outIndex, uint64_t& outDeadSize);
+// Returns size of the beginning of data ending with the last valid footer, or 0 if there is none,
+// e.g. to truncate what a crash left after it.
+uint64_t FindLastValidAssetPackEnd(std::span<const char> data);
+
+/*
+Makes a sorted list of all entries after entries written since the last index were added to it.
+newEntries: in the order they were written, so later ones replace earlier ones with the same type and hash.
+currentEntries: the current index.
+*/
+void MergeAssetPackEntries(std::span<const AssetPackEntry> newEntries, std::span<const AssetPackEntry> currentEntries,
+    std::vector<AssetPackEntry>& outEntries);
+
+/*
+For each entry of inoutEntries with the same type and hash as one of srcEntries, takes the later of their last
+access times. Both sorted by AssetPackEntryLess. Used when the file was flushed by another instance of the program,
+so its index replaces the one this instance read, but access times recorded by this instance are not lost.
+*/
+void MergeAssetPackAccessTimes(std::span<const AssetPackEntry> srcEntries, std::span<AssetPackEntry> inoutEntries);
+
+/*
+Removes least recently used entries until their total size fits in budget. The rest keep their order.
+Returns number of entries removed, adds their size to inoutEvictedSize.
+*/
+uint32_t EvictAssetPackEntries(std::vector<AssetPackEntry>& inoutEntries, uint64_t budget, uint64_t& inoutEvictedSize);
@@ -35,6 +35,7 @@
 #include <span>
 #include <filesystem>
 #include <format>
+#include <memory_resource>
 #include <functional>
 
 #include <cstdio>
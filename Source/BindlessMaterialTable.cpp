@@ -0,0 +1,76 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "BindlessMaterialTable.hpp"
+#include <cassert>
+#include <cstring>
+
+static uint32_t GetAllCopiesMask(uint32_t copyCount)
+{
+    return copyCount == 32 ? UINT32_MAX : (1u << copyCount) - 1;
+}
+
+void BindlessMaterialTable::Init(uint32_t recordSize, uint32_t recordCount, uint32_t copyCount)
+{
+    assert(recordSize > 0);
+    assert(copyCount > 0 && copyCount <= MAX_COPY_COUNT);
+    m_RecordSize = recordSize;
+    m_RecordCount = recordCount;
+    m_CopyCount = copyCount;
+    m_Data.assign((size_t)recordSize * recordCount, 0);
+    m_DirtyMasks.assign(recordCount, GetAllCopiesMask(copyCount));
+    m_DirtyRecordCount = recordCount;
+}
+
+void BindlessMaterialTable::Clear()
+{
+    m_RecordSize = 0;
+    m_RecordCount = 0;
+    m_CopyCount = 0;
+    m_Data.clear();
+    m_DirtyMasks.clear();
+    m_DirtyRecordCount = 0;
+}
+
+const void* BindlessMaterialTable::GetRecord(uint32_t recordIndex) const
+{
+    assert(recordIndex < m_RecordCount);
+    return m_Data.data() + (size_t)recordIndex * m_RecordSize;
+}
+
+bool BindlessMaterialTable::SetRecord(uint32_t recordIndex, const void* data)
+{
+    assert(recordIndex < m_RecordCount);
+    char* const record = m_Data.data() + (size_t)recordIndex * m_RecordSize;
+    if(memcmp(record, data, m_RecordSize) == 0)
+        return false;
+    memcpy(record, data, m_RecordSize);
+    if(m_DirtyMasks[recordIndex] == 0)
+        ++m_DirtyRecordCount;
+    m_DirtyMasks[recordIndex] = GetAllCopiesMask(m_CopyCount);
+    return true;
+}
+
+uint32_t BindlessMaterialTable::TakeDirtyRanges(uint32_t copyIndex, std::vector<Range>& outRanges)
+{
+    assert(copyIndex < m_CopyCount);
+    outRanges.clear();
+    if(m_DirtyRecordCount == 0)
+        return 0;
+
+    const uint32_t copyBit = 1u << copyIndex;
+    uint32_t takenCount = 0;
+    for(uint32_t recordIndex = 0; recordIndex < m_RecordCount; ++recordIndex)
+    {
+        uint32_t& dirtyMask = m_DirtyMasks[recordIndex];
+        if((dirtyMask & copyBit) == 0)
+            continue;
+        dirtyMask &= ~copyBit;
+        if(dirtyMask == 0)
+            --m_DirtyRecordCount;
+        if(!outRanges.empty() && outRanges.back().m_FirstRecord + outRanges.back().m_RecordCount == recordIndex)
+            ++outRanges.back().m_RecordCount;
+        else
+            outRanges.push_back(Range{recordIndex, 1});
+        ++takenCount;
+    }
+    return takenCount;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+CPU side of the table of material records read by shaders in the bindless path of Renderer.
+
+Records are opaque blocks of RecordSize bytes, one per material, indexed by material index. The GPU buffer
+holds one copy of the whole table per frame in flight, as previous frames may still read theirs.
+
+SetRecord compares new contents with the current ones, so setting all records every frame costs only
+a memcmp for those that didn't change. A changed record becomes dirty in every copy. TakeDirtyRanges returns
+what must be written to one copy before the frame that uses it, so in a steady state nothing is written.
+
+Not thread-safe.
+*/
+
+#include <cstdint>
+#include <vector>
+
+class BindlessMaterialTable
+{
+public:
+    static constexpr uint32_t MAX_COPY_COUNT = 32;
+
+    struct Range
+    {
+        uint32_t m_FirstRecord = 0;
+        uint32_t m_RecordCount = 0;
+    };
+
+    // Records start zeroed and dirty in all copies.
+    void Init(uint32_t recordSize, uint32_t recordCount, uint32_t copyCount);
+    void Clear();
+
+    uint32_t GetRecordSize() const { return m_RecordSize; }
+    uint32_t GetRecordCount() const { return m_RecordCount; }
+    // Number of records changed since any copy was last updated.
+    uint32_t GetDirtyRecordCount() const { return m_DirtyRecordCount; }
+    const void* GetRecord(uint32_t recordIndex) const;
+    // Returns true if the contents changed.
+    bool SetRecord(uint32_t recordIndex, const void* data);
+    /*
+    Fills outRanges with records changed since the last call for this copy, ascending, neighbors merged,
+    and marks them clean in this copy. Returns number of records in them.
+    */
+    uint32_t TakeDirtyRanges(uint32_t copyIndex, std::vector<Range>& outRanges);
+
+private:
+    uint32_t m_RecordSize = 0;
+    uint32_t m_RecordCount = 0;
+    uint32_t m_CopyCount = 0;
+    std::vector<char> m_Data;
+    // Indexed by record index. Bit i set = the record changed since copy i was last updated.
+    std::vector<uint32_t> m_DirtyMasks;
+    // Records with any bit set in m_DirtyMasks, so TakeDirtyRanges doesn't scan them in a steady state.
+    uint32_t m_DirtyRecordCount = 0;
+};
@@ -0,0 +1,243 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "BlockCompressor.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include "ParallelFor.hpp"
+
+// Power iterations to find the principal axis of colors of a block. 4 are enough to converge for 16 points.
+static const uint32_t POWER_ITERATION_COUNT = 4;
+
+static uint16_t PackRGB565(const float rgb[3])
+{
+    const uint32_t r = (uint32_t)(std::clamp(rgb[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    const uint32_t g = (uint32_t)(std::clamp(rgb[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+    const uint32_t b = (uint32_t)(std::clamp(rgb[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, int outRGB[3])
+{
+    const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    outRGB[0] = (r << 3) | (r >> 2);
+    outRGB[1] = (g << 2) | (g >> 4);
+    outRGB[2] = (b << 3) | (b >> 2);
+}
+
+static void StoreUint16(uint8_t* dst, uint16_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+}
+
+uint32_t BlockCompressor::GetBlockSize(Format format)
+{
+    return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+}
+
+BlockCompressor::BlockCompressor(Format format, uint32_t sourceChannelCount, uint32_t flags) :
+    m_Format(format),
+    m_SourceChannelCount(sourceChannelCount)
+{
+    assert(sourceChannelCount == 4 || (sourceChannelCount == 1 && format == Format::BC4));
+    if(sourceChannelCount == 4)
+    {
+        const bool BGRA = (flags & FLAG_BGRA) != 0;
+        m_ChannelOffsets[0] = BGRA ? 2 : 0;
+        m_ChannelOffsets[1] = 1;
+        m_ChannelOffsets[2] = BGRA ? 0 : 2;
+        m_ChannelOffsets[3] = 3;
+    }
+}
+
+void BlockCompressor::Compress(const Image& src, uint8_t* dst, size_t dstRowPitch, uint32_t threadCount) const
+{
+    assert(src.m_Pixels && src.m_Width > 0 && src.m_Height > 0 && dst);
+    const uint32_t blockCountX = (src.m_Width + 3) / 4;
+    const uint32_t blockCountY = (src.m_Height + 3) / 4;
+    const uint32_t blockSize = GetBlockSize(m_Format);
+    assert(dstRowPitch >= (size_t)blockCountX * blockSize);
+
+    ParallelFor(blockCountY, threadCount, [&](size_t blockY)
+    {
+        uint8_t* blockPtr = dst + blockY * dstRowPitch;
+        uint8_t pixels[16][4];
+        for(uint32_t blockX = 0; blockX < blockCountX; ++blockX, blockPtr += blockSize)
+        {
+            LoadBlock(src, blockX, (uint32_t)blockY, pixels);
+            switch(m_Format)
+            {
+            case Format::BC1:
+                EncodeColorBlock(pixels, blockPtr);
+                break;
+            case Format::BC3:
+                EncodeSingleChannelBlock(pixels, 3, blockPtr);
+                EncodeColorBlock(pixels, blockPtr + 8);
+                break;
+            case Format::BC4:
+                EncodeSingleChannelBlock(pixels, 0, blockPtr);
+                break;
+            case Format::BC5:
+                EncodeSingleChannelBlock(pixels, 0, blockPtr);
+                EncodeSingleChannelBlock(pixels, 1, blockPtr + 8);
+                break;
+            }
+        }
+    });
+}
+
+void BlockCompressor::LoadBlock(const Image& src, uint32_t blockX, uint32_t blockY, uint8_t outPixels[16][4]) const
+{
+    for(uint32_t y = 0; y < 4; ++y)
+    {
+        const uint32_t srcY = std::min(blockY * 4 + y, src.m_Height - 1);
+        const uint8_t* const row = src.m_Pixels + srcY * src.m_RowPitch;
+        for(uint32_t x = 0; x < 4; ++x)
+        {
+            const uint32_t srcX = std::min(blockX * 4 + x, src.m_Width - 1);
+            const uint8_t* const pixel = row + (size_t)srcX * m_SourceChannelCount;
+            for(uint32_t channel = 0; channel < 4; ++channel)
+                outPixels[y * 4 + x][channel] = pixel[m_ChannelOffsets[channel]];
+        }
+    }
+}
+
+void BlockCompressor::EncodeColorBlock(const uint8_t pixels[16][4], uint8_t* dst)
+{
+    float mean[3] = {};
+    for(uint32_t i = 0; i < 16; ++i)
+        for(uint32_t c = 0; c < 3; ++c)
+            mean[c] += pixels[i][c];
+    for(uint32_t c = 0; c < 3; ++c)
+        mean[c] /= 16.f;
+
+    // Covariance matrix, symmetric: xx, xy, xz, yy, yz, zz.
+    float cov[6] = {};
+    for(uint32_t i = 0; i < 16; ++i)
+    {
+        const float d[3] = {pixels[i][0] - mean[0], pixels[i][1] - mean[1], pixels[i][2] - mean[2]};
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+
+    float axis[3] = {1.f, 1.f, 1.f};
+    for(uint32_t iteration = 0; iteration < POWER_ITERATION_COUNT; ++iteration)
+    {
+        const float v[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+        const float maxComponent = std::max({std::abs(v[0]), std::abs(v[1]), std::abs(v[2])});
+        if(maxComponent == 0.f)
+            break; // All colors equal, any axis works.
+        for(uint32_t c = 0; c < 3; ++c)
+            axis[c] = v[c] / maxComponent;
+    }
+
+    // Endpoints are the colors with the extreme projections on the axis.
+    uint32_t minIndex = 0, maxIndex = 0;
+    float minProj = FLT_MAX, maxProj = -FLT_MAX;
+    for(uint32_t i = 0; i < 16; ++i)
+    {
+        const float proj = pixels[i][0] * axis[0] + pixels[i][1] * axis[1] + pixels[i][2] * axis[2];
+        if(proj < minProj)
+        {
+            minProj = proj;
+            minIndex = i;
+        }
+        if(proj > maxProj)
+        {
+            maxProj = proj;
+            maxIndex = i;
+        }
+    }
+    const float maxColor[3] = {(float)pixels[maxIndex][0], (float)pixels[maxIndex][1], (float)pixels[maxIndex][2]};
+    const float minColor[3] = {(float)pixels[minIndex][0], (float)pixels[minIndex][1], (float)pixels[minIndex][2]};
+    uint16_t color0 = PackRGB565(maxColor);
+    uint16_t color1 = PackRGB565(minColor);
+
+    uint32_t indices = 0;
+    if(color0 != color1)
+    {
+        // color0 > color1 selects the 4-color mode in BC1. BC3 always uses it.
+        if(color0 < color1)
+            std::swap(color0, color1);
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for(uint32_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t bestIndex = 0;
+            int bestDistance = INT_MAX;
+            for(uint32_t paletteIndex = 0; paletteIndex < 4; ++paletteIndex)
+            {
+                int distance = 0;
+                for(uint32_t c = 0; c < 3; ++c)
+                {
+                    const int d = (int)pixels[i][c] - palette[paletteIndex][c];
+                    distance += d * d;
+                }
+                if(distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = paletteIndex;
+                }
+            }
+            indices |= bestIndex << (i * 2);
+        }
+    }
+
+    StoreUint16(dst, color0);
+    StoreUint16(dst + 2, color1);
+    for(uint32_t i = 0; i < 4; ++i)
+        dst[4 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+void BlockCompressor::EncodeSingleChannelBlock(const uint8_t pixels[16][4], uint32_t channel, uint8_t* dst)
+{
+    int minValue = 255, maxValue = 0;
+    for(uint32_t i = 0; i < 16; ++i)
+    {
+        minValue = std::min<int>(minValue, pixels[i][channel]);
+        maxValue = std::max<int>(maxValue, pixels[i][channel]);
+    }
+
+    // value0 > value1 selects the mode with 6 interpolated values.
+    uint64_t indices = 0;
+    if(maxValue > minValue)
+    {
+        int palette[8] = {maxValue, minValue};
+        for(int i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * maxValue + i * minValue) / 7;
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            uint64_t bestIndex = 0;
+            int bestDistance = INT_MAX;
+            for(uint32_t paletteIndex = 0; paletteIndex < 8; ++paletteIndex)
+            {
+                const int distance = std::abs((int)pixels[i][channel] - palette[paletteIndex]);
+                if(distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = paletteIndex;
+                }
+            }
+            indices |= bestIndex << (i * 3);
+        }
+    }
+
+    dst[0] = (uint8_t)maxValue;
+    dst[1] = (uint8_t)minValue;
+    for(uint32_t i = 0; i < 6; ++i)
+        dst[2 + i] = (uint8_t)(indices >> (i * 8));
+}
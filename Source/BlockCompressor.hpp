@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+Encoder of 8-bit images to block-compressed formats BC1, BC3, BC4 and BC5, used by Texture when loading
+from source files. BC7 and other source formats still go through DirectXTex.
+
+Color endpoints are fitted along the principal axis of the 16 colors of a block, found with power iteration,
+single-channel endpoints are the minimum and maximum. Every pixel then takes the nearest palette entry.
+Values are encoded as stored, so sRGB textures are fitted in sRGB space, like DirectXTex does by default.
+
+Blocks reaching beyond the image, in levels smaller than 4x4, repeat its last row and column.
+Rows of blocks are spread across threads with ParallelFor.
+*/
+
+#include <cstdint>
+#include <cstddef>
+
+class BlockCompressor
+{
+public:
+    enum class Format
+    {
+        BC1, // RGB, opaque
+        BC3, // RGBA
+        BC4, // R
+        BC5, // RG
+    };
+    enum FLAGS
+    {
+        // Source pixels have 4 channels in order B, G, R, A instead of R, G, B, A.
+        FLAG_BGRA = 0x1,
+    };
+
+    struct Image
+    {
+        const uint8_t* m_Pixels;
+        uint32_t m_Width;
+        uint32_t m_Height;
+        size_t m_RowPitch;
+    };
+
+    // Size of one 4x4 block, in bytes.
+    static uint32_t GetBlockSize(Format format);
+
+    // sourceChannelCount: 4, or 1 only for BC4.
+    BlockCompressor(Format format, uint32_t sourceChannelCount, uint32_t flags = 0);
+    // dst receives rows of blocks, dstRowPitch bytes apart. threadCount = 0 means all hardware threads.
+    void Compress(const Image& src, uint8_t* dst, size_t dstRowPitch, uint32_t threadCount = 0) const;
+
+private:
+    const Format m_Format;
+    const uint32_t m_SourceChannelCount;
+    // Offsets of R, G, B, A in a source pixel.
+    uint32_t m_ChannelOffsets[4] = {};
+
+    // Gathers block at block coordinates (blockX, blockY) as 16 RGBA pixels.
+    void LoadBlock(const Image& src, uint32_t blockX, uint32_t blockY, uint8_t outPixels[16][4]) const;
+    static void EncodeColorBlock(const uint8_t pixels[16][4], uint8_t* dst);
+    static void EncodeSingleChannelBlock(const uint8_t pixels[16][4], uint32_t channel, uint8_t* dst);
+};
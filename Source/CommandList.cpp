@@ -5,9 +5,22 @@
 #include "Settings.hpp"
 #include "Renderer.hpp"
 #include <pix3.h>
+#include <algorithm>
 
 static BoolSetting g_UsePIXEvents(SettingCategory::Runtime, "UsePIXEvents", true);
 
+static const char* COMMAND_LIST_CALL_NAMES[] = {
+    "PipelineState", "RootSignature", "Viewport", "ScissorRect", "PrimitiveTopology",
+    "RootDescriptorTable", "RootConstants", "RootShaderResourceView", "VertexBuffers", "IndexBuffer",
+};
+static_assert(_countof(COMMAND_LIST_CALL_NAMES) == (size_t)CommandListCall::Count);
+
+const char* GetCommandListCallName(CommandListCall call)
+{
+    assert(call < CommandListCall::Count);
+    return COMMAND_LIST_CALL_NAMES[(size_t)call];
+}
+
 void CommandList::Init(
     ID3D12CommandAllocator* cmdAllocator,
     ID3D12GraphicsCommandList* cmdList)
@@ -31,6 +44,7 @@ void CommandList::Execute(ID3D12CommandQueue* cmdQueue)
 	cmdQueue->ExecuteCommandLists(1, &cmdListBase);
     m_CmdList = nullptr;
     m_State = State{};
+    m_Statistics = CommandListStatistics{};
 }
 
 void CommandList::BeginPIXEvent(const wstr_view& msg)
@@ -45,10 +59,19 @@ void CommandList::EndPIXEvent()
         PIXEndEvent(m_CmdList);
 }
 
+bool CommandList::CountCall(CommandListCall call, bool changed)
+{
+    if(changed)
+        ++m_Statistics.m_IssuedCounts[(size_t)call];
+    else
+        ++m_Statistics.m_FilteredCounts[(size_t)call];
+    return changed;
+}
+
 void CommandList::SetPipelineState(ID3D12PipelineState* pipelineState)
 {
     assert(m_CmdList);
-    if(pipelineState != m_State.m_PipelineState)
+    if(CountCall(CommandListCall::PipelineState, pipelineState != m_State.m_PipelineState))
     {
         m_CmdList->SetPipelineState(pipelineState);
         m_State.m_PipelineState = pipelineState;
@@ -58,17 +81,19 @@ void CommandList::SetPipelineState(ID3D12PipelineState* pipelineState)
 void CommandList::SetRootSignature(ID3D12RootSignature* rootSignature)
 {
     assert(m_CmdList);
-    if(rootSignature != m_State.m_RootSignature)
+    if(CountCall(CommandListCall::RootSignature, rootSignature != m_State.m_RootSignature))
     {
         m_CmdList->SetGraphicsRootSignature(rootSignature);
         m_State.m_RootSignature = rootSignature;
+        std::fill(std::begin(m_State.m_RootArguments), std::end(m_State.m_RootArguments), 0);
+        std::fill(std::begin(m_State.m_RootConstants), std::end(m_State.m_RootConstants), RootConstants{});
     }
 }
 
 void CommandList::SetViewport(const D3D12_VIEWPORT& viewport)
 {
     assert(m_CmdList);
-    if(viewport != m_State.m_Viewport)
+    if(CountCall(CommandListCall::Viewport, viewport != m_State.m_Viewport))
     {
         m_CmdList->RSSetViewports(1, &viewport);
         m_State.m_Viewport = viewport;
@@ -78,10 +103,11 @@ void CommandList::SetViewport(const D3D12_VIEWPORT& viewport)
 void CommandList::SetScissorRect(const D3D12_RECT& scissorRect)
 {
     assert(m_CmdList);
-    if(scissorRect.left != m_State.m_ScissorRect.left ||
+    const bool changed = scissorRect.left != m_State.m_ScissorRect.left ||
         scissorRect.top != m_State.m_ScissorRect.top ||
         scissorRect.right != m_State.m_ScissorRect.right ||
-        scissorRect.bottom != m_State.m_ScissorRect.bottom)
+        scissorRect.bottom != m_State.m_ScissorRect.bottom;
+    if(CountCall(CommandListCall::ScissorRect, changed))
     {
         m_CmdList->RSSetScissorRects(1, &scissorRect);
         m_State.m_ScissorRect = scissorRect;
@@ -91,13 +117,93 @@ void CommandList::SetScissorRect(const D3D12_RECT& scissorRect)
 void CommandList::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology)
 {
     assert(m_CmdList);
-    if(primitiveTopology != m_State.m_PritimitveTopology)
+    if(CountCall(CommandListCall::PrimitiveTopology, primitiveTopology != m_State.m_PritimitveTopology))
     {
         m_CmdList->IASetPrimitiveTopology(primitiveTopology);
         m_State.m_PritimitveTopology = primitiveTopology;
     }
 }
 
+void CommandList::SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    assert(m_CmdList && m_State.m_RootSignature);
+    assert(rootParameterIndex < ROOT_PARAMETER_MAX_COUNT && baseDescriptor.ptr != 0);
+    UINT64& currentDescriptor = m_State.m_RootArguments[rootParameterIndex];
+    if(CountCall(CommandListCall::RootDescriptorTable, baseDescriptor.ptr != currentDescriptor))
+    {
+        m_CmdList->SetGraphicsRootDescriptorTable(rootParameterIndex, baseDescriptor);
+        currentDescriptor = baseDescriptor.ptr;
+    }
+}
+
+void CommandList::SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValuesToSet,
+    const void* srcData, uint32_t destOffsetIn32BitValues)
+{
+    assert(m_CmdList && m_State.m_RootSignature);
+    assert(rootParameterIndex < ROOT_PARAMETER_MAX_COUNT && num32BitValuesToSet > 0 && srcData);
+    bool changed = true;
+    if(destOffsetIn32BitValues + num32BitValuesToSet <= ROOT_CONSTANT_TRACKED_MAX_COUNT)
+    {
+        RootConstants& current = m_State.m_RootConstants[rootParameterIndex];
+        const uint32_t mask = ((1u << num32BitValuesToSet) - 1) << destOffsetIn32BitValues;
+        const size_t size = num32BitValuesToSet * sizeof(uint32_t);
+        changed = (current.m_KnownMask & mask) != mask ||
+            memcmp(current.m_Values + destOffsetIn32BitValues, srcData, size) != 0;
+        if(changed)
+        {
+            memcpy(current.m_Values + destOffsetIn32BitValues, srcData, size);
+            current.m_KnownMask |= mask;
+        }
+    }
+    if(CountCall(CommandListCall::RootConstants, changed))
+    {
+        m_CmdList->SetGraphicsRoot32BitConstants(rootParameterIndex, num32BitValuesToSet,
+            srcData, destOffsetIn32BitValues);
+    }
+}
+
+void CommandList::SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+{
+    assert(m_CmdList && m_State.m_RootSignature);
+    assert(rootParameterIndex < ROOT_PARAMETER_MAX_COUNT && bufferLocation != 0);
+    UINT64& currentLocation = m_State.m_RootArguments[rootParameterIndex];
+    if(CountCall(CommandListCall::RootShaderResourceView, bufferLocation != currentLocation))
+    {
+        m_CmdList->SetGraphicsRootShaderResourceView(rootParameterIndex, bufferLocation);
+        currentLocation = bufferLocation;
+    }
+}
+
+void CommandList::SetVertexBuffers(uint32_t startSlot, uint32_t viewCount, const D3D12_VERTEX_BUFFER_VIEW* views)
+{
+    assert(m_CmdList);
+    assert(viewCount > 0 && startSlot + viewCount <= D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT && views);
+    // The structure has no padding, so it can be compared with memcmp.
+    static_assert(sizeof(D3D12_VERTEX_BUFFER_VIEW) == sizeof(UINT64) + 2 * sizeof(UINT));
+    D3D12_VERTEX_BUFFER_VIEW* const currentViews = m_State.m_VertexBuffers + startSlot;
+    const size_t size = viewCount * sizeof(D3D12_VERTEX_BUFFER_VIEW);
+    if(CountCall(CommandListCall::VertexBuffers, memcmp(views, currentViews, size) != 0))
+    {
+        m_CmdList->IASetVertexBuffers(startSlot, viewCount, views);
+        memcpy(currentViews, views, size);
+    }
+}
+
+void CommandList::SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+{
+    assert(m_CmdList);
+    const D3D12_INDEX_BUFFER_VIEW newView = view ? *view : D3D12_INDEX_BUFFER_VIEW{};
+    const D3D12_INDEX_BUFFER_VIEW& currentView = m_State.m_IndexBuffer;
+    const bool changed = newView.BufferLocation != currentView.BufferLocation ||
+        newView.SizeInBytes != currentView.SizeInBytes ||
+        newView.Format != currentView.Format;
+    if(CountCall(CommandListCall::IndexBuffer, changed))
+    {
+        m_CmdList->IASetIndexBuffer(view);
+        m_State.m_IndexBuffer = newView;
+    }
+}
+
 void CommandList::SetRenderTargets(RenderingResource* depthStencil, std::initializer_list<RenderingResource*> renderTargets)
 {
     DescriptorManager* const RTVDescriptorManager = g_Renderer->GetRTVDescriptorManager();
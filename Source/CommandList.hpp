@@ -5,6 +5,36 @@
 class RenderingResource;
 
 constexpr size_t RENDER_TARGET_MAX_COUNT = 8;
+// Root signature can have at most 64 DWORDs, and a descriptor table takes 1.
+constexpr size_t ROOT_PARAMETER_MAX_COUNT = 64;
+// Root constants are tracked only within first this many 32-bit values of a root parameter.
+constexpr uint32_t ROOT_CONSTANT_TRACKED_MAX_COUNT = 4;
+
+// Calls of CommandList that are dropped when they would set the state that is already set.
+enum class CommandListCall
+{
+    PipelineState,
+    RootSignature,
+    Viewport,
+    ScissorRect,
+    PrimitiveTopology,
+    RootDescriptorTable,
+    RootConstants,
+    RootShaderResourceView,
+    VertexBuffers,
+    IndexBuffer,
+    Count
+};
+const char* GetCommandListCallName(CommandListCall call);
+
+// Counts of calls made through CommandList, recorded for one frame.
+struct CommandListStatistics
+{
+    // Indexed by CommandListCall.
+    uint32_t m_IssuedCounts[(size_t)CommandListCall::Count] = {};
+    // Calls dropped because the same state was already set.
+    uint32_t m_FilteredCounts[(size_t)CommandListCall::Count] = {};
+};
 
 /*
 Represents ID3D12GraphicsCommandList during command recording.
@@ -18,6 +48,7 @@ public:
     void Execute(ID3D12CommandQueue* cmdQueue);
     
     ID3D12GraphicsCommandList* GetCmdList() const { return m_CmdList; }
+    const CommandListStatistics& GetStatistics() const { return m_Statistics; }
 
     // Warning! msg is actually a formatting string, so don't use '%'!
     void BeginPIXEvent(const wstr_view& msg);
@@ -29,6 +60,16 @@ public:
     void SetViewport(const D3D12_VIEWPORT& viewport);
     void SetScissorRect(const D3D12_RECT& scissorRect);
     void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY primitiveTopology);
+    // Root arguments are tracked per root parameter. Setting a different root signature forgets them, as D3D12 does.
+    void SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+    // Calls reaching beyond ROOT_CONSTANT_TRACKED_MAX_COUNT values are never filtered.
+    void SetGraphicsRoot32BitConstants(uint32_t rootParameterIndex, uint32_t num32BitValuesToSet,
+        const void* srcData, uint32_t destOffsetIn32BitValues);
+    void SetGraphicsRootShaderResourceView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation);
+    // Tracked per slot.
+    void SetVertexBuffers(uint32_t startSlot, uint32_t viewCount, const D3D12_VERTEX_BUFFER_VIEW* views);
+    // view can be null.
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view);
     // Any of render-target or depth-stencil pointers can be null.
     void SetRenderTargets(
         RenderingResource* depthStencil,
@@ -38,6 +79,13 @@ public:
         RenderingResource* renderTarget);
 
 private:
+    struct RootConstants
+    {
+        uint32_t m_Values[ROOT_CONSTANT_TRACKED_MAX_COUNT] = {};
+        // Bit i set = m_Values[i] is known.
+        uint32_t m_KnownMask = 0;
+    };
+
     ID3D12GraphicsCommandList* m_CmdList = nullptr;
     struct State
     {
@@ -46,7 +94,18 @@ private:
         D3D12_VIEWPORT m_Viewport = CD3DX12_VIEWPORT(FLT_MIN, FLT_MIN, FLT_MAX, FLT_MAX);
         D3D12_RECT m_ScissorRect = CD3DX12_RECT(LONG_MIN, LONG_MIN, LONG_MAX, LONG_MAX);
         D3D12_PRIMITIVE_TOPOLOGY m_PritimitveTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        // Descriptor table GPU handle or root descriptor GPU address, depending on the root parameter. 0 = not set.
+        UINT64 m_RootArguments[ROOT_PARAMETER_MAX_COUNT] = {};
+        RootConstants m_RootConstants[ROOT_PARAMETER_MAX_COUNT] = {};
+        // All zeros = not set.
+        D3D12_VERTEX_BUFFER_VIEW m_VertexBuffers[D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
+        // UINT64_MAX = not set, all zeros = set to null.
+        D3D12_INDEX_BUFFER_VIEW m_IndexBuffer = {.BufferLocation = UINT64_MAX};
     } m_State;
+    CommandListStatistics m_Statistics;
+
+    // Counts the call as issued if changed or filtered otherwise. Returns changed.
+    bool CountCall(CommandListCall call, bool changed);
 };
 
 class PIXEventScope
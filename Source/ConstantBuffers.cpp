@@ -3,13 +3,26 @@
 #include "Descriptors.hpp"
 #include "Renderer.hpp"
 #include "Settings.hpp"
+#include "ImGuiUtils.hpp"
+#include "FrameArena.hpp"
 
 constexpr uint32_t ALIGNMENT = 256;
+// Space each thread reserves at once from the shared ring buffer. Multiply of ALIGNMENT, so offsets stay aligned.
+constexpr uint32_t THREAD_CHUNK_SIZE = 16 * ALIGNMENT;
+static_assert(THREAD_CHUNK_SIZE % ALIGNMENT == 0);
+// Limits of the ring buffer size per frame when resized automatically.
+constexpr uint64_t MIN_AUTO_SIZE_PER_FRAME = 16 * THREAD_CHUNK_SIZE;
+constexpr uint64_t MAX_AUTO_BUFFER_SIZE = 256llu * 1024 * 1024;
+constexpr uint32_t MIN_OVERFLOW_BUFFER_SIZE = 64 * 1024;
+static_assert(MIN_OVERFLOW_BUFFER_SIZE % ALIGNMENT == 0);
+static_assert(RING_BUFFER_MAX_FRAME_COUNT >= MAX_FRAME_COUNT);
 
 extern UintSetting g_FrameCount;
 
 static UintSetting g_TemporaryConstantBuffereMaxSizePerFrame(SettingCategory::Startup,
     "ConstantBuffers.Temporary.MaxSizePerFrame", 0);
+static BoolSetting g_TemporaryConstantBufferAutoResize(SettingCategory::Startup,
+    "ConstantBuffers.Temporary.AutoResize", true);
 
 void TemporaryConstantBufferManager::Init()
 {
@@ -18,35 +31,100 @@ void TemporaryConstantBufferManager::Init()
     CHECK_BOOL(g_TemporaryConstantBuffereMaxSizePerFrame.GetValue() > 0 &&
         g_TemporaryConstantBuffereMaxSizePerFrame.GetValue() % 32 == 0);
 
-    const uint32_t bufSize = g_TemporaryConstantBuffereMaxSizePerFrame.GetValue() * g_FrameCount.GetValue();
+    m_FrameCount = g_FrameCount.GetValue();
+    // Whole chunks, so the ring buffer doesn't need to round its capacity down.
+    const uint32_t bufSize = AlignUp(
+        g_TemporaryConstantBuffereMaxSizePerFrame.GetValue() * m_FrameCount, THREAD_CHUNK_SIZE);
 
-    m_RingBuffer.Init(bufSize, g_FrameCount.GetValue());
-
-    // Create m_Buffer.
-    {
-        D3D12MA::ALLOCATION_DESC allocDesc = {};
-        allocDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
-        const D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(bufSize);
-        CHECK_HR(g_Renderer->GetMemoryAllocator()->CreateResource(&allocDesc, &resDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr, // pOptimizedClearValue
-            &m_Buffer,
-            IID_NULL, nullptr)); // riidResource, ppvResource
-    }
-
-    // Persistently map m_Buffer.
-    CHECK_HR(m_Buffer->GetResource()->Map(0, D3D12_RANGE_NONE, &m_BufferMappedPtr));
+    m_RingBuffer.Init(bufSize, m_FrameCount, THREAD_CHUNK_SIZE);
+    m_Buffer = CreateUploadBuffer(bufSize, m_BufferMappedPtr);
 }
 
 TemporaryConstantBufferManager::~TemporaryConstantBufferManager()
 {
     if(m_BufferMappedPtr)
         m_Buffer->GetResource()->Unmap(0, D3D12_RANGE_ALL);
+
+    if(m_UsageHistory.GetPeak() > 0)
+    {
+        LogInfoF(L"Temporary constant buffers: peak {} per frame, recommended \"ConstantBuffers.Temporary.MaxSizePerFrame\": {}.",
+            SizeToStr(m_UsageHistory.GetPeak()), GetRecommendedMaxSizePerFrame());
+    }
+}
+
+ComPtr<D3D12MA::Allocation> TemporaryConstantBufferManager::CreateUploadBuffer(uint32_t size, void*& outMappedPtr)
+{
+    ComPtr<D3D12MA::Allocation> buffer;
+    D3D12MA::ALLOCATION_DESC allocDesc = {};
+    allocDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+    const D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    CHECK_HR(g_Renderer->GetMemoryAllocator()->CreateResource(&allocDesc, &resDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr, // pOptimizedClearValue
+        &buffer,
+        IID_NULL, nullptr)); // riidResource, ppvResource
+
+    // Persistently map it. Buffers are released still mapped, which D3D12 allows.
+    CHECK_HR(buffer->GetResource()->Map(0, D3D12_RANGE_NONE, &outMappedPtr));
+    return buffer;
 }
 
 void TemporaryConstantBufferManager::NewFrame()
 {
+    // Doesn't run concurrently with CreateBuffer, so m_OverflowMutex is not needed.
     m_RingBuffer.NewFrame();
+
+    std::vector<ComPtr<D3D12MA::Allocation>>& lastFrameReleases = m_DeferredReleases[m_DeferredReleaseIndex];
+    for(OverflowBuffer& overflowBuf : m_OverflowBuffers)
+        lastFrameReleases.push_back(std::move(overflowBuf.m_Buffer));
+    m_OverflowBuffers.clear();
+
+    const uint64_t lastFrameUsage = m_RingBuffer.GetLastFrameSize() + m_OverflowSize;
+    m_OverflowSize = 0;
+    m_UsageHistory.Push(lastFrameUsage);
+    if(g_TemporaryConstantBufferAutoResize.GetValue())
+        AutoResize(lastFrameUsage);
+
+    // Frame that used these last is finished on the GPU, as it is FrameCount frames ago.
+    m_DeferredReleaseIndex = (m_DeferredReleaseIndex + 1) % m_FrameCount;
+    m_DeferredReleases[m_DeferredReleaseIndex].clear();
+
+    m_LastFrameDescriptorWriteCount = m_DescriptorWriteCount.exchange(0);
+}
+
+void TemporaryConstantBufferManager::AutoResize(uint64_t lastFrameUsage)
+{
+    const uint64_t sizePerFrame = m_RingBuffer.GetCapacity() / m_FrameCount;
+    uint64_t newSizePerFrame = 0;
+    // Grow after overflow, with a margin.
+    if(lastFrameUsage > sizePerFrame)
+        newSizePerFrame = lastFrameUsage + lastFrameUsage / 2;
+    // Shrink when the whole window used less than a quarter. New size of 2x maximum leaves a gap before growing again.
+    else if(m_UsageHistory.GetCount() == FrameUsageHistory::WINDOW_SIZE &&
+        m_UsageHistory.GetRollingMax() * 4 < sizePerFrame)
+    {
+        newSizePerFrame = m_UsageHistory.GetRollingMax() * 2;
+    }
+    if(newSizePerFrame == 0)
+        return;
+
+    newSizePerFrame = std::max(newSizePerFrame, MIN_AUTO_SIZE_PER_FRAME);
+    const uint64_t newBufSize = std::min(AlignUp<uint64_t>(newSizePerFrame * m_FrameCount, THREAD_CHUNK_SIZE),
+        MAX_AUTO_BUFFER_SIZE);
+    if(newBufSize == m_RingBuffer.GetCapacity())
+        return;
+
+    // The old buffer is still used by recent frames.
+    void* newMappedPtr = nullptr;
+    ComPtr<D3D12MA::Allocation> newBuffer = CreateUploadBuffer((uint32_t)newBufSize, newMappedPtr);
+    m_DeferredReleases[m_DeferredReleaseIndex].push_back(std::move(m_Buffer));
+    m_Buffer = std::move(newBuffer);
+    m_BufferMappedPtr = newMappedPtr;
+    m_RingBuffer.Reset((uint32_t)newBufSize);
+    m_UsageHistory.ClearWindow();
+    ++m_ResizeCount;
+
+    LogInfoF(L"Temporary constant buffer resized to {} per frame.", SizeToStr(newBufSize / m_FrameCount));
 }
 
 void TemporaryConstantBufferManager::CreateBuffer(uint32_t size,
@@ -55,7 +133,11 @@ void TemporaryConstantBufferManager::CreateBuffer(uint32_t size,
     const uint32_t alignedSize = AlignUp(size, ALIGNMENT);
 
     uint32_t newBufOffset = 0;
-    CHECK_BOOL(m_RingBuffer.Allocate(alignedSize, newBufOffset));
+    if(!m_RingBuffer.Allocate(alignedSize, newBufOffset))
+    {
+        CreateOverflowBuffer(alignedSize, outMappedPtr, outGPUAddr);
+        return;
+    }
 
     outMappedPtr = (char*)m_BufferMappedPtr + newBufOffset;
     
@@ -63,6 +145,30 @@ void TemporaryConstantBufferManager::CreateBuffer(uint32_t size,
     outGPUAddr = m_Buffer->GetResource()->GetGPUVirtualAddress() + newBufOffset;
 }
 
+void TemporaryConstantBufferManager::CreateOverflowBuffer(uint32_t size,
+    void*& outMappedPtr, D3D12_GPU_VIRTUAL_ADDRESS& outGPUAddr)
+{
+    std::lock_guard<std::mutex> lock(m_OverflowMutex);
+    m_OverflowSize += size;
+
+    if(m_OverflowBuffers.empty() ||
+        m_OverflowBuffers.back().m_Size - m_OverflowBuffers.back().m_UsedSize < size)
+    {
+        // Overflow is expected to repeat in the next frames until resized, so chain big buffers.
+        const uint32_t bufSize = std::max(AlignUp(m_RingBuffer.GetCapacity() / m_FrameCount / 4, ALIGNMENT),
+            std::max(size, MIN_OVERFLOW_BUFFER_SIZE));
+        OverflowBuffer overflowBuf;
+        overflowBuf.m_Buffer = CreateUploadBuffer(bufSize, overflowBuf.m_MappedPtr);
+        overflowBuf.m_Size = bufSize;
+        m_OverflowBuffers.push_back(std::move(overflowBuf));
+    }
+
+    OverflowBuffer& overflowBuf = m_OverflowBuffers.back();
+    outMappedPtr = (char*)overflowBuf.m_MappedPtr + overflowBuf.m_UsedSize;
+    outGPUAddr = overflowBuf.m_Buffer->GetResource()->GetGPUVirtualAddress() + overflowBuf.m_UsedSize;
+    overflowBuf.m_UsedSize += size;
+}
+
 void TemporaryConstantBufferManager::CreateBuffer(uint32_t size,
     void*& outMappedPtr, D3D12_GPU_DESCRIPTOR_HANDLE& outCBVDescriptorHandle)
 {
@@ -80,4 +186,27 @@ void TemporaryConstantBufferManager::CreateBuffer(uint32_t size,
     CBVDesc.SizeInBytes = alignedSize;
     g_Renderer->GetDevice()->CreateConstantBufferView(&CBVDesc, descMgr->GetCPUHandle(descriptor));
     outCBVDescriptorHandle = descMgr->GetGPUHandle(descriptor);
+    ++m_DescriptorWriteCount;
+}
+
+uint32_t TemporaryConstantBufferManager::GetRecommendedMaxSizePerFrame() const
+{
+    // With a margin, in units required by the setting.
+    const uint64_t peak = m_UsageHistory.GetPeak();
+    const uint64_t recommended = AlignUp<uint64_t>(peak + peak / 4, 32);
+    return (uint32_t)std::clamp<uint64_t>(recommended, 32, UINT32_MAX & ~31u);
+}
+
+void TemporaryConstantBufferManager::ImGui()
+{
+    ImGui::Text("Size per frame: %s, resized %u times",
+        FrameSizeToStr(m_RingBuffer.GetCapacity() / m_FrameCount),
+        m_ResizeCount);
+    ImGui::Text("Used per frame: last %s, max of %u frames %s, peak %s",
+        FrameSizeToStr(m_UsageHistory.GetLast()),
+        m_UsageHistory.GetCount(),
+        FrameSizeToStr(m_UsageHistory.GetRollingMax()),
+        FrameSizeToStr(m_UsageHistory.GetPeak()));
+    ImGui::Text("Recommended \"ConstantBuffers.Temporary.MaxSizePerFrame\": %u", GetRecommendedMaxSizePerFrame());
+    ImGui::Text("CBV descriptors last frame: written %u", m_LastFrameDescriptorWriteCount);
 }
@@ -1,10 +1,18 @@
 #pragma once
 
 #include "MultiFrameRingBuffer.hpp"
+#include <mutex>
+#include <atomic>
 
 /*
 Represents a facility for allocation and filling temporary constant buffers
 valid only for recording and execution of the current frame.
+CreateBuffer is thread-safe. NewFrame must not be called concurrently with it.
+
+When a frame needs more than the ring buffer holds, extra upload buffers are chained for that frame
+instead of failing. NewFrame records how much each frame used and, with setting
+"ConstantBuffers.Temporary.AutoResize", replaces the ring buffer with a bigger one after an overflow
+or a smaller one when the rolling maximum stays well below its size.
 */
 class TemporaryConstantBufferManager
 {
@@ -16,7 +24,8 @@ public:
     /*
     - Allocates a new piece of data inside the buffer.
       - Returns mapped pointer to it. The memory is uncached and write-combined!
-    - Returns GPU address of that data, to be used for setting up a CBV descriptor.
+    - Returns GPU address of that data, to be used for setting up a CBV descriptor
+      or as a root descriptor, e.g. of a structured buffer of tightly packed per-draw data.
     */
     void CreateBuffer(uint32_t size,
         void*& outMappedPtr, D3D12_GPU_VIRTUAL_ADDRESS& outGPUAddr);
@@ -30,8 +39,45 @@ public:
     void CreateBuffer(uint32_t size,
         void*& outMappedPtr, D3D12_GPU_DESCRIPTOR_HANDLE& outCBVDescriptorHandle);
 
+    // Value for setting "ConstantBuffers.Temporary.MaxSizePerFrame" that would fit the peak usage so far.
+    uint32_t GetRecommendedMaxSizePerFrame() const;
+    void ImGui();
+
 private:
+    struct OverflowBuffer
+    {
+        ComPtr<D3D12MA::Allocation> m_Buffer;
+        void* m_MappedPtr = nullptr;
+        uint32_t m_Size = 0;
+        uint32_t m_UsedSize = 0;
+    };
+
+    uint32_t m_FrameCount = 0;
     ComPtr<D3D12MA::Allocation> m_Buffer;
     void* m_BufferMappedPtr = nullptr;
-    MultiFrameRingBuffer<uint32_t> m_RingBuffer;
+    ConcurrentMultiFrameRingBuffer<uint32_t> m_RingBuffer;
+    FrameUsageHistory m_UsageHistory;
+    uint32_t m_ResizeCount = 0;
+
+    // In the current frame.
+    std::atomic<uint32_t> m_DescriptorWriteCount = 0;
+    // Of the last frame.
+    uint32_t m_LastFrameDescriptorWriteCount = 0;
+
+    // Protects members below.
+    std::mutex m_OverflowMutex;
+    // Chained in the current frame, when m_RingBuffer was full.
+    std::vector<OverflowBuffer> m_OverflowBuffers;
+    uint64_t m_OverflowSize = 0;
+
+    // Buffers no longer used by new frames, released when the frames that used them are finished.
+    // Indexed by m_DeferredReleaseIndex of the frame that used them last.
+    std::vector<ComPtr<D3D12MA::Allocation>> m_DeferredReleases[MAX_FRAME_COUNT];
+    uint32_t m_DeferredReleaseIndex = 0;
+
+    static ComPtr<D3D12MA::Allocation> CreateUploadBuffer(uint32_t size, void*& outMappedPtr);
+    void CreateOverflowBuffer(uint32_t size,
+        void*& outMappedPtr, D3D12_GPU_VIRTUAL_ADDRESS& outGPUAddr);
+    // Called in NewFrame with usage of the frame that just ended.
+    void AutoResize(uint64_t lastFrameUsage);
 };
@@ -0,0 +1,315 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "DescriptorDefragmentation.hpp"
+#include <map>
+#include <bit>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+struct Page
+{
+    uint64_t m_Index = 0;
+    // Bit set = slot used.
+    uint64_t m_UsedMask = 0;
+    // Contains a single descriptor that is not movable.
+    bool m_Pinned = false;
+    // Indices to DescriptorDefragmentationInput::m_Singles.
+    std::vector<size_t> m_Singles;
+};
+
+// Range or page placed by step 2.
+struct Block
+{
+    uint64_t m_Index = 0;
+    uint64_t m_Size = 0;
+    uint64_t m_Alignment = 1;
+    // Index to DescriptorDefragmentationInput::m_Ranges, SIZE_MAX for a page.
+    size_t m_RangeIndex = SIZE_MAX;
+};
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// occupied: begin -> end of ranges taken, not overlapping.
+uint64_t FindLowestFit(const std::map<uint64_t, uint64_t>& occupied, uint64_t size, uint64_t alignment)
+{
+    uint64_t offset = 0;
+    for(const auto& [begin, end] : occupied)
+    {
+        if(AlignUp(offset, alignment) + size <= begin)
+            break;
+        offset = std::max(offset, end);
+    }
+    return AlignUp(offset, alignment);
+}
+
+} // namespace
+
+DescriptorDefragmentationPlan PlanDescriptorDefragmentation(const DescriptorDefragmentationInput& input)
+{
+    const uint64_t pageSize = input.m_PageSize;
+    assert(pageSize > 0 && pageSize <= 64);
+    const uint64_t fullMask = pageSize == 64 ? UINT64_MAX : (1llu << pageSize) - 1;
+
+    DescriptorDefragmentationPlan plan;
+    plan.m_RangeIndices.resize(input.m_Ranges.size());
+    plan.m_SingleIndices.resize(input.m_Singles.size());
+
+    // Step 1: empty the least used movable pages.
+    std::map<uint64_t, Page> pages;
+    for(size_t singleIndex = 0; singleIndex < input.m_Singles.size(); ++singleIndex)
+    {
+        const DescriptorDefragmentationInput::Single& single = input.m_Singles[singleIndex];
+        assert(single.m_Index < input.m_DescriptorCount);
+        Page& page = pages[single.m_Index / pageSize];
+        page.m_Index = single.m_Index / pageSize;
+        assert((page.m_UsedMask & (1llu << (single.m_Index % pageSize))) == 0 && "Duplicate single descriptor.");
+        page.m_UsedMask |= 1llu << (single.m_Index % pageSize);
+        page.m_Pinned = page.m_Pinned || !single.m_Movable;
+        page.m_Singles.push_back(singleIndex);
+        plan.m_SingleIndices[singleIndex] = single.m_Index;
+    }
+
+    const auto freeSlotCount = [pageSize](const Page& page) {
+        return pageSize - (uint64_t)std::popcount(page.m_UsedMask);
+    };
+    std::vector<Page*> pinnedPages;
+    std::vector<Page*> movablePages;
+    uint64_t pinnedFreeCount = 0;
+    uint64_t movableFreeCount = 0;
+    for(auto& [pageIndex, page] : pages)
+    {
+        if(page.m_Pinned)
+        {
+            pinnedPages.push_back(&page);
+            pinnedFreeCount += freeSlotCount(page);
+        }
+        else
+        {
+            movablePages.push_back(&page);
+            movableFreeCount += freeSlotCount(page);
+        }
+    }
+    // Least used first. Of equally used ones, those at the end of the section first.
+    std::sort(movablePages.begin(), movablePages.end(), [](const Page* lhs, const Page* rhs) {
+        const int lhsCount = std::popcount(lhs->m_UsedMask), rhsCount = std::popcount(rhs->m_UsedMask);
+        return lhsCount != rhsCount ? lhsCount < rhsCount : lhs->m_Index > rhs->m_Index;
+    });
+
+    // Pinned pages receive first, then movable pages from the most used.
+    size_t pinnedReceiverIndex = 0;
+    size_t movableReceiverEnd = movablePages.size();
+    size_t emptiedPageCount = 0;
+    for(; emptiedPageCount < movablePages.size(); ++emptiedPageCount)
+    {
+        Page& donor = *movablePages[emptiedPageCount];
+        // Now counts only the pages after the donor.
+        movableFreeCount -= freeSlotCount(donor);
+        if(pageSize - freeSlotCount(donor) > pinnedFreeCount + movableFreeCount)
+            break;
+        for(size_t singleIndex : donor.m_Singles)
+        {
+            while(pinnedReceiverIndex < pinnedPages.size() && pinnedPages[pinnedReceiverIndex]->m_UsedMask == fullMask)
+                ++pinnedReceiverIndex;
+            Page* receiver;
+            if(pinnedReceiverIndex < pinnedPages.size())
+            {
+                receiver = pinnedPages[pinnedReceiverIndex];
+                --pinnedFreeCount;
+            }
+            else
+            {
+                while(movablePages[movableReceiverEnd - 1]->m_UsedMask == fullMask)
+                    --movableReceiverEnd;
+                assert(movableReceiverEnd - 1 > emptiedPageCount);
+                receiver = movablePages[movableReceiverEnd - 1];
+                --movableFreeCount;
+            }
+            const uint64_t slot = (uint64_t)std::countr_zero(~receiver->m_UsedMask & fullMask);
+            receiver->m_UsedMask |= 1llu << slot;
+            receiver->m_Singles.push_back(singleIndex);
+            plan.m_SingleIndices[singleIndex] = receiver->m_Index * pageSize + slot;
+        }
+        donor.m_UsedMask = 0;
+        donor.m_Singles.clear();
+    }
+
+    // Step 2: lay out the remaining pages and the ranges.
+    std::map<uint64_t, uint64_t> occupied;
+    std::vector<Block> movableBlocks;
+    for(size_t rangeIndex = 0; rangeIndex < input.m_Ranges.size(); ++rangeIndex)
+    {
+        const DescriptorDefragmentationInput::Range& range = input.m_Ranges[rangeIndex];
+        assert(range.m_Size > 0 && range.m_Index + range.m_Size <= input.m_DescriptorCount);
+        plan.m_RangeIndices[rangeIndex] = range.m_Index;
+        if(range.m_Movable)
+            movableBlocks.push_back(Block{range.m_Index, range.m_Size, 1, rangeIndex});
+        else
+            occupied[range.m_Index] = range.m_Index + range.m_Size;
+    }
+    // Old page index -> new page index.
+    std::map<uint64_t, uint64_t> pageRemap;
+    for(const auto& [pageIndex, page] : pages)
+    {
+        if(page.m_UsedMask == 0)
+            continue;
+        if(page.m_Pinned)
+        {
+            occupied[pageIndex * pageSize] = (pageIndex + 1) * pageSize;
+            pageRemap[pageIndex] = pageIndex;
+        }
+        else
+            movableBlocks.push_back(Block{pageIndex * pageSize, pageSize, pageSize, SIZE_MAX});
+    }
+
+    std::sort(movableBlocks.begin(), movableBlocks.end(), [](const Block& lhs, const Block& rhs) {
+        return lhs.m_Index < rhs.m_Index;
+    });
+    for(const Block& block : movableBlocks)
+    {
+        const uint64_t newIndex = FindLowestFit(occupied, block.m_Size, block.m_Alignment);
+        // The block's current place is always free: blocks placed before were there or lower.
+        assert(newIndex <= block.m_Index);
+        occupied[newIndex] = newIndex + block.m_Size;
+        if(block.m_RangeIndex != SIZE_MAX)
+        {
+            plan.m_RangeIndices[block.m_RangeIndex] = newIndex;
+            if(newIndex != block.m_Index)
+                plan.m_Moves.push_back({block.m_Index, newIndex, block.m_Size});
+        }
+        else
+            pageRemap[block.m_Index / pageSize] = newIndex / pageSize;
+    }
+
+    // Final indices of single descriptors, from the pages they are in after step 1.
+    std::vector<DescriptorDefragmentationPlan::Move> singleMoves;
+    for(size_t singleIndex = 0; singleIndex < input.m_Singles.size(); ++singleIndex)
+    {
+        uint64_t& newIndex = plan.m_SingleIndices[singleIndex];
+        newIndex = pageRemap.at(newIndex / pageSize) * pageSize + newIndex % pageSize;
+        const uint64_t oldIndex = input.m_Singles[singleIndex].m_Index;
+        if(newIndex != oldIndex)
+            singleMoves.push_back({oldIndex, newIndex, 1});
+    }
+    std::sort(singleMoves.begin(), singleMoves.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.m_SrcIndex < rhs.m_SrcIndex;
+    });
+    for(const DescriptorDefragmentationPlan::Move& move : singleMoves)
+    {
+        DescriptorDefragmentationPlan::Move* const last = plan.m_Moves.empty() ? nullptr : &plan.m_Moves.back();
+        if(last && last->m_SrcIndex + last->m_Count == move.m_SrcIndex &&
+            last->m_DstIndex + last->m_Count == move.m_DstIndex)
+        {
+            ++last->m_Count;
+        }
+        else
+            plan.m_Moves.push_back(move);
+    }
+
+    for(const auto& [oldPageIndex, newPageIndex] : pageRemap)
+        plan.m_Pages.push_back(newPageIndex);
+    std::sort(plan.m_Pages.begin(), plan.m_Pages.end());
+    plan.m_UsedEnd = occupied.empty() ? 0 : occupied.rbegin()->second;
+    return plan;
+}
+
+bool ValidateDescriptorDefragmentationPlan(const DescriptorDefragmentationInput& input,
+    const DescriptorDefragmentationPlan& plan)
+{
+    const uint64_t descriptorCount = input.m_DescriptorCount;
+    const uint64_t pageSize = input.m_PageSize;
+    if(pageSize == 0 || pageSize > 64 ||
+        plan.m_RangeIndices.size() != input.m_Ranges.size() ||
+        plan.m_SingleIndices.size() != input.m_Singles.size())
+    {
+        return false;
+    }
+
+    // Old index of the descriptor that ends up at each index, UINT64_MAX if it doesn't move there.
+    std::vector<uint64_t> expectedSources(descriptorCount, UINT64_MAX);
+    // begin -> end of ranges and pages after defragmentation.
+    std::vector<std::pair<uint64_t, uint64_t>> blocks;
+
+    for(size_t i = 0; i < plan.m_Pages.size(); ++i)
+    {
+        const uint64_t pageIndex = plan.m_Pages[i];
+        if((i > 0 && pageIndex <= plan.m_Pages[i - 1]) || (pageIndex + 1) * pageSize > descriptorCount)
+            return false;
+        blocks.push_back({pageIndex * pageSize, (pageIndex + 1) * pageSize});
+    }
+    for(size_t rangeIndex = 0; rangeIndex < input.m_Ranges.size(); ++rangeIndex)
+    {
+        const DescriptorDefragmentationInput::Range& range = input.m_Ranges[rangeIndex];
+        const uint64_t newIndex = plan.m_RangeIndices[rangeIndex];
+        if(range.m_Size == 0 || range.m_Index + range.m_Size > descriptorCount ||
+            newIndex + range.m_Size > descriptorCount || (!range.m_Movable && newIndex != range.m_Index))
+        {
+            return false;
+        }
+        blocks.push_back({newIndex, newIndex + range.m_Size});
+        if(newIndex != range.m_Index)
+        {
+            for(uint64_t i = 0; i < range.m_Size; ++i)
+                expectedSources[newIndex + i] = range.m_Index + i;
+        }
+    }
+
+    std::vector<uint64_t> pageSingleCounts(plan.m_Pages.size(), 0);
+    std::vector<bool> singleUsed(descriptorCount, false);
+    for(size_t singleIndex = 0; singleIndex < input.m_Singles.size(); ++singleIndex)
+    {
+        const DescriptorDefragmentationInput::Single& single = input.m_Singles[singleIndex];
+        const uint64_t newIndex = plan.m_SingleIndices[singleIndex];
+        if(single.m_Index >= descriptorCount || newIndex >= descriptorCount || singleUsed[newIndex] ||
+            (!single.m_Movable && newIndex != single.m_Index))
+        {
+            return false;
+        }
+        singleUsed[newIndex] = true;
+        const auto pageIt = std::lower_bound(plan.m_Pages.begin(), plan.m_Pages.end(), newIndex / pageSize);
+        if(pageIt == plan.m_Pages.end() || *pageIt != newIndex / pageSize)
+            return false;
+        ++pageSingleCounts[pageIt - plan.m_Pages.begin()];
+        if(newIndex != single.m_Index)
+            expectedSources[newIndex] = single.m_Index;
+    }
+    if(std::find(pageSingleCounts.begin(), pageSingleCounts.end(), 0) != pageSingleCounts.end())
+        return false;
+
+    std::sort(blocks.begin(), blocks.end());
+    for(size_t i = 1; i < blocks.size(); ++i)
+    {
+        if(blocks[i - 1].second > blocks[i].first)
+            return false;
+    }
+    uint64_t usedEnd = 0;
+    for(const auto& [begin, end] : blocks)
+        usedEnd = std::max(usedEnd, end);
+    if(plan.m_UsedEnd != usedEnd)
+        return false;
+
+    // Every expected destination is written by exactly one move, from the right source, and nothing else is.
+    for(const DescriptorDefragmentationPlan::Move& move : plan.m_Moves)
+    {
+        if(move.m_Count == 0 || move.m_SrcIndex + move.m_Count > descriptorCount ||
+            move.m_DstIndex + move.m_Count > descriptorCount)
+        {
+            return false;
+        }
+        for(uint64_t i = 0; i < move.m_Count; ++i)
+        {
+            uint64_t& expectedSource = expectedSources[move.m_DstIndex + i];
+            if(expectedSource != move.m_SrcIndex + i)
+                return false;
+            // Marked as written, so a second move to the same index fails.
+            expectedSource = UINT64_MAX;
+        }
+    }
+    return std::all_of(expectedSources.begin(), expectedSources.end(), [](uint64_t source) {
+        return source == UINT64_MAX;
+    });
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+Planner of compaction of persistent descriptors, used by DescriptorManager::Defragment.
+
+Input is the layout of the persistent section: ranges of multiple descriptors, and single descriptors
+in pages of PageSize. Descriptors whose owner isn't registered for patching are pinned - they keep
+their index, and so does the whole page of a pinned single descriptor.
+
+The plan is made in two steps:
+
+1. Single descriptors are moved out of the least used movable pages to free slots of other pages,
+   pinned ones first, as long as the emptied pages can be freed.
+2. Remaining pages and ranges are laid out again. Pinned ones stay, movable ones are placed in order
+   of their current index at the lowest free index they fit in, which is never above the current one.
+   This gathers free space at the end of the section.
+
+Moves map old index to new index of every descriptor that changes place. Sources and destinations
+of different moves may overlap, so the caller copies from a snapshot of the old contents.
+
+ValidateDescriptorDefragmentationPlan checks a plan against its input before the caller changes anything.
+*/
+
+#include <cstdint>
+#include <vector>
+
+struct DescriptorDefragmentationInput
+{
+    struct Range
+    {
+        uint64_t m_Index = 0;
+        uint64_t m_Size = 0;
+        bool m_Movable = false;
+    };
+    struct Single
+    {
+        uint64_t m_Index = 0;
+        bool m_Movable = false;
+    };
+
+    // Size of the persistent section.
+    uint64_t m_DescriptorCount = 0;
+    // Size and alignment of pages of single descriptors. At most 64.
+    uint64_t m_PageSize = 64;
+    std::vector<Range> m_Ranges;
+    std::vector<Single> m_Singles;
+};
+
+struct DescriptorDefragmentationPlan
+{
+    struct Move
+    {
+        uint64_t m_SrcIndex = 0;
+        uint64_t m_DstIndex = 0;
+        uint64_t m_Count = 0;
+    };
+
+    // New index of every input range and single descriptor, indexed like in the input.
+    std::vector<uint64_t> m_RangeIndices;
+    std::vector<uint64_t> m_SingleIndices;
+    // Pages that contain single descriptors after defragmentation, as first index / PageSize, ascending.
+    std::vector<uint64_t> m_Pages;
+    // Consecutive descriptors moving together are merged into one move.
+    std::vector<Move> m_Moves;
+    // End of the last range or page after defragmentation.
+    uint64_t m_UsedEnd = 0;
+};
+
+DescriptorDefragmentationPlan PlanDescriptorDefragmentation(const DescriptorDefragmentationInput& input);
+
+/*
+Returns true if the plan is consistent with the input:
+- pinned ranges and single descriptors keep their index, everything stays within DescriptorCount,
+- pages are ascending, each contains a single descriptor, every single descriptor is in one of them
+  and no two share an index,
+- ranges and pages don't overlap, UsedEnd is the end of the last one,
+- moves cover exactly the descriptors that change place, each moved to its new index once.
+*/
+bool ValidateDescriptorDefragmentationPlan(const DescriptorDefragmentationInput& input,
+    const DescriptorDefragmentationPlan& plan);
@@ -0,0 +1,137 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "DescriptorSlotAllocator.hpp"
+#include <bit>
+#include <algorithm>
+#include <cassert>
+
+static constexpr uint64_t FULL_MASK = UINT64_MAX;
+
+void HierarchicalBitset::Init(uint64_t bitCount)
+{
+    m_Levels.clear();
+    uint64_t wordCount = (bitCount + 63) / 64;
+    for(;;)
+    {
+        m_Levels.push_back(std::vector<uint64_t>(std::max<uint64_t>(wordCount, 1), 0));
+        if(wordCount <= 1)
+            break;
+        wordCount = (wordCount + 63) / 64;
+    }
+}
+
+void HierarchicalBitset::Set(uint64_t index)
+{
+    for(std::vector<uint64_t>& level : m_Levels)
+    {
+        const bool wasZero = level[index / 64] == 0;
+        level[index / 64] |= 1llu << (index % 64);
+        if(!wasZero)
+            break;
+        index /= 64;
+    }
+}
+
+void HierarchicalBitset::Reset(uint64_t index)
+{
+    for(std::vector<uint64_t>& level : m_Levels)
+    {
+        level[index / 64] &= ~(1llu << (index % 64));
+        if(level[index / 64] != 0)
+            break;
+        index /= 64;
+    }
+}
+
+uint64_t HierarchicalBitset::FindFirstSet() const
+{
+    if(m_Levels.back()[0] == 0)
+        return UINT64_MAX;
+    uint64_t index = 0;
+    for(size_t levelIndex = m_Levels.size(); levelIndex--; )
+        index = index * 64 + std::countr_zero(m_Levels[levelIndex][index]);
+    return index;
+}
+
+void DescriptorSlotAllocator::Init(uint64_t descriptorCount)
+{
+    const uint64_t pageCount = descriptorCount / PAGE_SIZE;
+    m_FreeMasks.assign(pageCount, 0);
+    m_PagesAdded.assign(pageCount, false);
+    m_PagesWithFreeSlots.Init(pageCount);
+    m_PageCount = 0;
+    m_PagesWithFreeSlotsCount = 0;
+    m_AllocationCount = 0;
+}
+
+bool DescriptorSlotAllocator::Allocate(uint64_t& outIndex)
+{
+    const uint64_t pageIndex = m_PagesWithFreeSlots.FindFirstSet();
+    if(pageIndex == UINT64_MAX)
+        return false;
+    uint64_t& freeMask = m_FreeMasks[pageIndex];
+    assert(freeMask != 0);
+    const uint64_t slotIndex = std::countr_zero(freeMask);
+    freeMask &= ~(1llu << slotIndex);
+    if(freeMask == 0)
+    {
+        m_PagesWithFreeSlots.Reset(pageIndex);
+        --m_PagesWithFreeSlotsCount;
+    }
+    ++m_AllocationCount;
+    outIndex = pageIndex * PAGE_SIZE + slotIndex;
+    return true;
+}
+
+bool DescriptorSlotAllocator::Free(uint64_t index, uint64_t& outPageIndex)
+{
+    const uint64_t pageIndex = index / PAGE_SIZE;
+    const uint64_t slotBit = 1llu << (index % PAGE_SIZE);
+    assert(pageIndex < m_FreeMasks.size() && m_PagesAdded[pageIndex]);
+    uint64_t& freeMask = m_FreeMasks[pageIndex];
+    assert((freeMask & slotBit) == 0 && "Descriptor freed twice.");
+    if(freeMask == 0)
+    {
+        m_PagesWithFreeSlots.Set(pageIndex);
+        ++m_PagesWithFreeSlotsCount;
+    }
+    freeMask |= slotBit;
+    --m_AllocationCount;
+
+    if(freeMask != FULL_MASK || m_PagesWithFreeSlotsCount == 1)
+        return false;
+    m_PagesWithFreeSlots.Reset(pageIndex);
+    --m_PagesWithFreeSlotsCount;
+    m_PagesAdded[pageIndex] = false;
+    m_FreeMasks[pageIndex] = 0;
+    --m_PageCount;
+    outPageIndex = pageIndex;
+    return true;
+}
+
+void DescriptorSlotAllocator::AddPage(uint64_t pageIndex, uint64_t allocatedMask)
+{
+    assert(pageIndex < m_FreeMasks.size() && !m_PagesAdded[pageIndex]);
+    m_PagesAdded[pageIndex] = true;
+    m_FreeMasks[pageIndex] = ~allocatedMask;
+    if(allocatedMask != FULL_MASK)
+    {
+        m_PagesWithFreeSlots.Set(pageIndex);
+        ++m_PagesWithFreeSlotsCount;
+    }
+    ++m_PageCount;
+    m_AllocationCount += (uint64_t)std::popcount(allocatedMask);
+}
+
+uint64_t DescriptorSlotAllocator::GetAllocatedMask(uint64_t pageIndex) const
+{
+    assert(pageIndex < m_FreeMasks.size());
+    return m_PagesAdded[pageIndex] ? ~m_FreeMasks[pageIndex] : 0;
+}
+
+DescriptorSlotAllocator::Statistics DescriptorSlotAllocator::GetStatistics() const
+{
+    return Statistics{
+        .m_PageCount = m_PageCount,
+        .m_AllocationCount = m_AllocationCount,
+        .m_FreeSlotCount = m_PageCount * PAGE_SIZE - m_AllocationCount};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+Allocator of single descriptors used by DescriptorManager for persistent descriptors.
+
+Descriptors are allocated in pages of PAGE_SIZE. The owner allocates space for a page with its general
+allocator, aligned to PAGE_SIZE, and gives it with AddPage. Each page has a mask of free slots,
+and pages with any free slot are found with a hierarchical bitset, so Allocate and Free are O(1):
+a few bit scans of 64-bit words, one per level, and no search.
+
+Not thread-safe.
+*/
+
+#include <cstdint>
+#include <vector>
+
+// Set of bits with O(log64 N) search for any set bit.
+class HierarchicalBitset
+{
+public:
+    void Init(uint64_t bitCount);
+    void Set(uint64_t index);
+    void Reset(uint64_t index);
+    bool Get(uint64_t index) const { return (m_Levels[0][index / 64] & (1llu << (index % 64))) != 0; }
+    // Returns UINT64_MAX if no bit is set.
+    uint64_t FindFirstSet() const;
+
+private:
+    // m_Levels[0] holds the bits, bit i of m_Levels[L + 1] is set if word i of m_Levels[L] is not zero.
+    // The last level is a single word.
+    std::vector<std::vector<uint64_t>> m_Levels;
+};
+
+class DescriptorSlotAllocator
+{
+public:
+    static constexpr uint64_t PAGE_SIZE = 64;
+
+    struct Statistics
+    {
+        uint64_t m_PageCount = 0;
+        uint64_t m_AllocationCount = 0;
+        // Free slots in pages added, not usable for ranges of descriptors.
+        uint64_t m_FreeSlotCount = 0;
+    };
+
+    // descriptorCount: size of the whole index space. Only full pages in it can be added.
+    void Init(uint64_t descriptorCount);
+
+    // Returns false if all pages are full - then add a page and try again.
+    bool Allocate(uint64_t& outIndex);
+    /*
+    Returns true if the page that contained index became empty and was removed, so the owner should free it.
+    A page is kept if it is the only one with free slots, so freeing and allocating a single descriptor
+    doesn't add and remove the same page each time.
+    */
+    bool Free(uint64_t index, uint64_t& outPageIndex);
+    // pageIndex: first descriptor index of the page / PAGE_SIZE.
+    // allocatedMask: slots to mark as allocated already, bit i for slot i - used when rebuilding after defragmentation.
+    void AddPage(uint64_t pageIndex, uint64_t allocatedMask = 0);
+    // Bit i set = slot i of the page is allocated. 0 for pages not added.
+    uint64_t GetAllocatedMask(uint64_t pageIndex) const;
+
+    Statistics GetStatistics() const;
+
+private:
+    // Indexed by page index. Bit set = slot free. Meaningful only for pages added.
+    std::vector<uint64_t> m_FreeMasks;
+    // Page index is set if the page was added and has any free slot.
+    HierarchicalBitset m_PagesWithFreeSlots;
+    std::vector<bool> m_PagesAdded;
+    uint64_t m_PageCount = 0;
+    uint64_t m_PagesWithFreeSlotsCount = 0;
+    uint64_t m_AllocationCount = 0;
+};
@@ -2,6 +2,9 @@
 #include "Descriptors.hpp"
 #include "Renderer.hpp"
 #include "Settings.hpp"
+#include "ImGuiUtils.hpp"
+#include <bit>
+#include <algorithm>
 
 extern UintSetting g_FrameCount;
 
@@ -10,6 +13,16 @@ static const wchar_t* DESCRIPTOR_HEAP_TYPE_NAMES[] = {
 };
 static_assert(_countof(DESCRIPTOR_HEAP_TYPE_NAMES) == (size_t)D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES);
 
+// Temporary descriptors each thread reserves at once from the shared ring buffer.
+static const uint64_t TEMPORARY_DESCRIPTOR_THREAD_CHUNK_SIZE = 16;
+
+// freeCount: all free descriptors, largestFreeRange: the largest range of them that can be allocated at once.
+static float CalculateFragmentation(uint64_t freeCount, uint64_t largestFreeRange)
+{
+    // 0 when all free space is one range, close to 1 when it is scattered into small ones.
+    return freeCount ? 1.f - (float)largestFreeRange / (float)freeCount : 0.f;
+}
+
 void DescriptorManager::Init(
     D3D12_DESCRIPTOR_HEAP_TYPE type,
     uint32_t persistentDescriptorMaxCount,
@@ -21,12 +34,15 @@ void DescriptorManager::Init(
     m_Type = type;
     m_PersistentDescriptorMaxCount = persistentDescriptorMaxCount;
     m_TemporaryDescriptorMaxCountPerFrame = temporaryDescriptorMaxCountPerFrame;
+    m_FrameCount = g_FrameCount.GetValue();
     
     if(temporaryDescriptorMaxCountPerFrame)
     {
+        const uint64_t temporaryDescriptorMaxCount = temporaryDescriptorMaxCountPerFrame * g_FrameCount.GetValue();
         m_TemporaryDescriptorRingBuffer.Init(
-            temporaryDescriptorMaxCountPerFrame * g_FrameCount.GetValue(),
-            g_FrameCount.GetValue());
+            temporaryDescriptorMaxCount,
+            g_FrameCount.GetValue(),
+            std::min(TEMPORARY_DESCRIPTOR_THREAD_CHUNK_SIZE, temporaryDescriptorMaxCount));
     }
 
     // Create m_DescriptorHeap.
@@ -52,13 +68,49 @@ void DescriptorManager::Init(
         D3D12MA::VIRTUAL_BLOCK_DESC desc = {};
         desc.Size = persistentDescriptorMaxCount;
         CHECK_HR(D3D12MA::CreateVirtualBlock(&desc, &m_VirtualBlock));
+
+        m_SlotAllocator.Init(persistentDescriptorMaxCount);
+        m_SlotPageAllocs.resize(persistentDescriptorMaxCount / DescriptorSlotAllocator::PAGE_SIZE, {0});
+        m_SlotOwners.resize(persistentDescriptorMaxCount, nullptr);
+    }
+
+    // Create m_ShadowHeap.
+    if(persistentDescriptorMaxCount &&
+        (type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER))
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+        desc.Type = type;
+        desc.NumDescriptors = persistentDescriptorMaxCount;
+        CHECK_HR(g_Renderer->GetDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_ShadowHeap)));
+        SetD3D12ObjectName(m_ShadowHeap, std::format(L"{} shadow descriptor heap",
+            DESCRIPTOR_HEAP_TYPE_NAMES[(uint32_t)type]));
+        m_ShadowCPUHandleForHeapStart = m_ShadowHeap->GetCPUDescriptorHandleForHeapStart();
     }
 }
 
 DescriptorManager::~DescriptorManager()
 {
+    if(m_TemporaryUsageHistory.GetPeak() > 0)
+    {
+        LogInfoF(L"{} temporary descriptors: peak {} per frame, recommended MaxCountPerFrame: {}.",
+            DESCRIPTOR_HEAP_TYPE_NAMES[(uint32_t)m_Type], m_TemporaryUsageHistory.GetPeak(),
+            GetRecommendedTemporaryMaxCountPerFrame());
+    }
+
     if(m_VirtualBlock)
     {
+        for(std::vector<Descriptor>& descriptors : m_DeferredFrees)
+            FreeDeferred(descriptors);
+
+        assert(m_SlotAllocator.GetStatistics().m_AllocationCount == 0 &&
+            "Unfreed persistent descriptors. Inspect m_Type to check their type.");
+        // Pages kept empty.
+        for(D3D12MA::VirtualAllocation& pageAlloc : m_SlotPageAllocs)
+        {
+            if(pageAlloc.AllocHandle)
+                m_VirtualBlock->FreeAllocation(pageAlloc);
+        }
+
         D3D12MA::Statistics stats = {};
         m_VirtualBlock->GetStatistics(&stats);
         assert(stats.AllocationCount == 0 && "Unfreed persistent descriptors. Inspect m_Type to check their type.");
@@ -67,26 +119,146 @@ DescriptorManager::~DescriptorManager()
 
 void DescriptorManager::NewFrame()
 {
-    if(m_TemporaryDescriptorMaxCountPerFrame > 0)
-        m_TemporaryDescriptorRingBuffer.NewFrame();
+    // Doesn't run concurrently with AllocateTemporary, but AllocatePersistent may use m_VirtualBlock.
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+
+    FlushPendingWrites();
+    if(m_TemporaryDescriptorMaxCountPerFrame == 0)
+        return;
+
+    m_TemporaryDescriptorRingBuffer.NewFrame();
+    m_TemporaryUsageHistory.Push(m_TemporaryDescriptorRingBuffer.GetLastFrameSize() + m_TemporaryOverflowCount);
+    m_TemporaryOverflowCount = 0;
+
+    // Frame that used these is finished on the GPU, as it is FrameCount frames ago.
+    m_DeferredFreeIndex = (m_DeferredFreeIndex + 1) % m_FrameCount;
+    FreeDeferred(m_DeferredFrees[m_DeferredFreeIndex]);
 }
 
-Descriptor DescriptorManager::AllocatePersistent(uint32_t descriptorCount)
+void DescriptorManager::FreeDeferred(std::vector<Descriptor>& descriptors)
 {
-    assert(m_PersistentDescriptorMaxCount);
+    for(const Descriptor& desc : descriptors)
+        FreePersistentLocked(desc);
+    descriptors.clear();
+}
+
+void DescriptorManager::FlushPendingWrites()
+{
+    if(m_PendingWrites.empty())
+        return;
+    std::sort(m_PendingWrites.begin(), m_PendingWrites.end());
+    ID3D12Device* const device = g_Renderer->GetDevice();
+    // Copy runs of consecutive indices at once, written e.g. for a range.
+    for(size_t i = 0; i < m_PendingWrites.size(); )
+    {
+        const uint64_t firstIndex = m_PendingWrites[i];
+        uint64_t endIndex = firstIndex + 1;
+        for(++i; i < m_PendingWrites.size() && m_PendingWrites[i] <= endIndex; ++i)
+            endIndex = m_PendingWrites[i] + 1;
+        device->CopyDescriptorsSimple(
+            (UINT)(endIndex - firstIndex),
+            CD3DX12_CPU_DESCRIPTOR_HANDLE(m_CPUHandleForHeapStart, (int32_t)firstIndex, m_DescriptorSize),
+            CD3DX12_CPU_DESCRIPTOR_HANDLE(m_ShadowCPUHandleForHeapStart, (int32_t)firstIndex, m_DescriptorSize),
+            m_Type);
+    }
+    m_PendingWrites.clear();
+}
+
+Descriptor DescriptorManager::AllocatePersistentLocked(uint32_t descriptorCount)
+{
+    Descriptor descriptor;
+    if(descriptorCount == 1)
+    {
+        if(m_SlotAllocator.Allocate(descriptor.m_Index))
+            return descriptor;
+        if(AddSlotPage() && m_SlotAllocator.Allocate(descriptor.m_Index))
+            return descriptor;
+        // No space for a whole page, e.g. fragmented by ranges - allocate it like a range.
+    }
     D3D12MA::VIRTUAL_ALLOCATION_DESC virtualAllocDesc = {};
     virtualAllocDesc.Size = descriptorCount;
-    Descriptor descriptor;
-    CHECK_HR(m_VirtualBlock->Allocate(&virtualAllocDesc, &descriptor.m_VirtualAlloc, &descriptor.m_Index));
+    Range range = {.m_Size = descriptorCount};
+    const HRESULT hr = m_VirtualBlock->Allocate(&virtualAllocDesc, &range.m_Alloc, &descriptor.m_Index);
+    if(FAILED(hr))
+    {
+        // Free space may be enough, only fragmented - compact it at the next frame.
+        m_DefragmentationRequested = true;
+        CHECK_HR(hr);
+    }
+    m_Ranges.emplace(descriptor.m_Index, range);
     return descriptor;
 }
 
+void DescriptorManager::FreePersistentLocked(Descriptor desc)
+{
+    // A range never starts in a page of single descriptors.
+    const auto rangeIt = m_Ranges.find(desc.m_Index);
+    if(rangeIt != m_Ranges.end())
+    {
+        m_VirtualBlock->FreeAllocation(rangeIt->second.m_Alloc);
+        m_Ranges.erase(rangeIt);
+        return;
+    }
+    m_SlotOwners[desc.m_Index] = nullptr;
+    uint64_t pageIndex = 0;
+    if(m_SlotAllocator.Free(desc.m_Index, pageIndex))
+    {
+        m_VirtualBlock->FreeAllocation(m_SlotPageAllocs[pageIndex]);
+        m_SlotPageAllocs[pageIndex] = {0};
+    }
+}
+
+bool DescriptorManager::AddSlotPage()
+{
+    D3D12MA::VIRTUAL_ALLOCATION_DESC virtualAllocDesc = {};
+    virtualAllocDesc.Size = DescriptorSlotAllocator::PAGE_SIZE;
+    virtualAllocDesc.Alignment = DescriptorSlotAllocator::PAGE_SIZE;
+    D3D12MA::VirtualAllocation pageAlloc = {0};
+    uint64_t offset = 0;
+    if(FAILED(m_VirtualBlock->Allocate(&virtualAllocDesc, &pageAlloc, &offset)))
+        return false;
+    const uint64_t pageIndex = offset / DescriptorSlotAllocator::PAGE_SIZE;
+    m_SlotPageAllocs[pageIndex] = pageAlloc;
+    m_SlotAllocator.AddPage(pageIndex);
+    return true;
+}
+
+Descriptor DescriptorManager::AllocatePersistent(uint32_t descriptorCount)
+{
+    assert(m_PersistentDescriptorMaxCount);
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    return AllocatePersistentLocked(descriptorCount);
+}
+
+void DescriptorManager::AllocatePersistentMovable(uint32_t descriptorCount, Descriptor& outDesc)
+{
+    assert(m_PersistentDescriptorMaxCount);
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    outDesc = AllocatePersistentLocked(descriptorCount);
+    outDesc.m_Movable = true;
+    const auto rangeIt = m_Ranges.find(outDesc.m_Index);
+    if(rangeIt != m_Ranges.end())
+        rangeIt->second.m_Owner = &outDesc;
+    else
+        m_SlotOwners[outDesc.m_Index] = &outDesc;
+}
+
 Descriptor DescriptorManager::AllocateTemporary(uint32_t descriptorCount)
 {
     assert(m_TemporaryDescriptorMaxCountPerFrame);
     Descriptor descriptor;
-    CHECK_BOOL(m_TemporaryDescriptorRingBuffer.Allocate(descriptorCount, descriptor.m_Index));
-    descriptor.m_Index += m_PersistentDescriptorMaxCount;
+    if(m_TemporaryDescriptorRingBuffer.Allocate(descriptorCount, descriptor.m_Index))
+    {
+        descriptor.m_Index += m_PersistentDescriptorMaxCount;
+        return descriptor;
+    }
+
+    // Ring buffer is full - overflow to the persistent section.
+    CHECK_BOOL(m_VirtualBlock);
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    descriptor = AllocatePersistentLocked(descriptorCount);
+    m_DeferredFrees[m_DeferredFreeIndex].push_back(descriptor);
+    m_TemporaryOverflowCount += descriptorCount;
     return descriptor;
 }
 
@@ -95,10 +267,251 @@ void DescriptorManager::FreePersistent(Descriptor desc)
     if(!desc.IsNull())
     {
         assert(m_PersistentDescriptorMaxCount);
-        m_VirtualBlock->FreeAllocation(desc.m_VirtualAlloc);
+        std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+        FreePersistentLocked(desc);
     }
 }
 
+void DescriptorManager::FreePersistentDeferred(Descriptor desc)
+{
+    if(desc.IsNull())
+        return;
+    assert(m_PersistentDescriptorMaxCount && m_TemporaryDescriptorMaxCountPerFrame);
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    const auto rangeIt = m_Ranges.find(desc.m_Index);
+    if(rangeIt != m_Ranges.end())
+        rangeIt->second.m_Owner = nullptr;
+    else
+        m_SlotOwners[desc.m_Index] = nullptr;
+    m_DeferredFrees[m_DeferredFreeIndex].push_back(desc);
+}
+
+uint32_t DescriptorManager::GetRecommendedTemporaryMaxCountPerFrame() const
+{
+    // With a margin.
+    const uint64_t peak = m_TemporaryUsageHistory.GetPeak();
+    return (uint32_t)std::min<uint64_t>(peak + peak / 4, UINT32_MAX);
+}
+
+void DescriptorManager::ImGui_PersistentStatistics()
+{
+    if(!m_VirtualBlock)
+        return;
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    const DescriptorSlotAllocator::Statistics slotStats = m_SlotAllocator.GetStatistics();
+    D3D12MA::DetailedStatistics blockStats = {};
+    m_VirtualBlock->CalculateStatistics(&blockStats);
+    const uint64_t rangeCount = blockStats.Stats.AllocationCount - slotStats.m_PageCount;
+    const uint64_t rangeDescriptorCount = blockStats.Stats.AllocationBytes -
+        slotStats.m_PageCount * DescriptorSlotAllocator::PAGE_SIZE;
+    const uint64_t unusedCount = m_PersistentDescriptorMaxCount - blockStats.Stats.AllocationBytes;
+    const uint64_t largestUnusedRange = blockStats.UnusedRangeCount ? blockStats.UnusedRangeSizeMax : 0;
+
+    ImGui::Text("Persistent: %u", m_PersistentDescriptorMaxCount);
+    ImGui::Text("Single: %llu in %llu pages, %llu free slots",
+        slotStats.m_AllocationCount, slotStats.m_PageCount, slotStats.m_FreeSlotCount);
+    ImGui::Text("Ranges: %llu, %llu descriptors", rangeCount, rangeDescriptorCount);
+    ImGui::Text("Unused: %llu in %u ranges, largest %llu, fragmentation %.1f%%",
+        unusedCount, blockStats.UnusedRangeCount, largestUnusedRange,
+        CalculateFragmentation(unusedCount + slotStats.m_FreeSlotCount, largestUnusedRange) * 100.f);
+    if(ImGui::Button("Defragment"))
+        RequestDefragmentation();
+}
+
+float DescriptorManager::CalculateFragmentation()
+{
+    if(!m_VirtualBlock)
+        return 0.f;
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    D3D12MA::DetailedStatistics blockStats = {};
+    m_VirtualBlock->CalculateStatistics(&blockStats);
+    const uint64_t unusedCount = m_PersistentDescriptorMaxCount - blockStats.Stats.AllocationBytes;
+    return ::CalculateFragmentation(
+        unusedCount + m_SlotAllocator.GetStatistics().m_FreeSlotCount,
+        blockStats.UnusedRangeCount ? blockStats.UnusedRangeSizeMax : 0);
+}
+
+void DescriptorManager::Defragment()
+{
+    if(!m_VirtualBlock)
+        return;
+    std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+    m_DefragmentationRequested = false;
+
+    // GPU is idle, so temporary descriptors that overflowed here can be freed now instead of pinning them.
+    for(std::vector<Descriptor>& descriptors : m_DeferredFrees)
+        FreeDeferred(descriptors);
+    FlushPendingWrites();
+
+    constexpr uint64_t PAGE_SIZE = DescriptorSlotAllocator::PAGE_SIZE;
+    DescriptorDefragmentationInput input;
+    input.m_DescriptorCount = m_PersistentDescriptorMaxCount;
+    input.m_PageSize = PAGE_SIZE;
+    for(const auto& [index, range] : m_Ranges)
+        input.m_Ranges.push_back({index, range.m_Size, range.m_Owner != nullptr});
+    const uint64_t oldPageCount = m_SlotAllocator.GetStatistics().m_PageCount;
+    for(uint64_t pageIndex = 0; pageIndex < m_SlotPageAllocs.size(); ++pageIndex)
+    {
+        for(uint64_t mask = m_SlotAllocator.GetAllocatedMask(pageIndex); mask; mask &= mask - 1)
+        {
+            const uint64_t index = pageIndex * PAGE_SIZE + (uint64_t)std::countr_zero(mask);
+            input.m_Singles.push_back({index, m_SlotOwners[index] != nullptr});
+        }
+    }
+
+    const DescriptorDefragmentationPlan plan = PlanDescriptorDefragmentation(input);
+    if(plan.m_Moves.empty() && plan.m_Pages.size() == oldPageCount)
+        return;
+    // Nothing is changed until the plan is checked and all allocations are made at their new indices,
+    // so if anything fails, descriptors stay where they were.
+    if(!ValidateDescriptorDefragmentationPlan(input, plan))
+    {
+        LogWarningF(L"{} descriptors not defragmented: invalid plan.", DESCRIPTOR_HEAP_TYPE_NAMES[(uint32_t)m_Type]);
+        return;
+    }
+
+    /*
+    Create all allocations at their new indices in a new virtual block, which replaces m_VirtualBlock.
+    D3D12MA can't allocate at a given offset, but in an empty block each allocation is placed right after
+    the previous one, so gaps are filled with temporary allocations. This is checked for every allocation.
+    */
+    struct NewAllocation
+    {
+        uint64_t m_Index;
+        uint64_t m_Size;
+        // Index to input.m_Ranges, SIZE_MAX for a page.
+        size_t m_RangeIndex;
+    };
+    std::vector<NewAllocation> newAllocs;
+    for(size_t rangeIndex = 0; rangeIndex < input.m_Ranges.size(); ++rangeIndex)
+        newAllocs.push_back({plan.m_RangeIndices[rangeIndex], input.m_Ranges[rangeIndex].m_Size, rangeIndex});
+    for(uint64_t pageIndex : plan.m_Pages)
+        newAllocs.push_back({pageIndex * PAGE_SIZE, PAGE_SIZE, SIZE_MAX});
+    std::sort(newAllocs.begin(), newAllocs.end(), [](const NewAllocation& lhs, const NewAllocation& rhs) {
+        return lhs.m_Index < rhs.m_Index;
+    });
+
+    ComPtr<D3D12MA::VirtualBlock> newVirtualBlock;
+    D3D12MA::VIRTUAL_BLOCK_DESC blockDesc = {};
+    blockDesc.Size = m_PersistentDescriptorMaxCount;
+    CHECK_HR(D3D12MA::CreateVirtualBlock(&blockDesc, &newVirtualBlock));
+
+    uint64_t endIndex = 0;
+    std::vector<D3D12MA::VirtualAllocation> allocs(newAllocs.size(), D3D12MA::VirtualAllocation{0});
+    std::vector<D3D12MA::VirtualAllocation> fillers;
+    const auto allocateNext = [&](uint64_t size, D3D12MA::VirtualAllocation& outAlloc) {
+        D3D12MA::VIRTUAL_ALLOCATION_DESC virtualAllocDesc = {};
+        virtualAllocDesc.Size = size;
+        uint64_t index = 0;
+        if(FAILED(newVirtualBlock->Allocate(&virtualAllocDesc, &outAlloc, &index)) || index != endIndex)
+            return false;
+        endIndex += size;
+        return true;
+    };
+    for(size_t i = 0; i < newAllocs.size(); ++i)
+    {
+        const bool allocated =
+            (newAllocs[i].m_Index <= endIndex || allocateNext(newAllocs[i].m_Index - endIndex, fillers.emplace_back())) &&
+            allocateNext(newAllocs[i].m_Size, allocs[i]);
+        if(!allocated)
+        {
+            LogWarningF(L"{} descriptors not defragmented: allocation not placed at index {}.",
+                DESCRIPTOR_HEAP_TYPE_NAMES[(uint32_t)m_Type], endIndex);
+            // newVirtualBlock is released with its allocations, m_VirtualBlock is unchanged.
+            newVirtualBlock->Clear();
+            return;
+        }
+    }
+    for(const D3D12MA::VirtualAllocation& filler : fillers)
+        newVirtualBlock->FreeAllocation(filler);
+
+    // From here on, the new layout is applied.
+    MoveDescriptors(plan.m_Moves);
+    m_VirtualBlock->Clear();
+    m_VirtualBlock = std::move(newVirtualBlock);
+    std::fill(m_SlotPageAllocs.begin(), m_SlotPageAllocs.end(), D3D12MA::VirtualAllocation{0});
+    std::vector<Range> oldRanges;
+    for(const auto& [index, range] : m_Ranges)
+        oldRanges.push_back(range);
+    m_Ranges.clear();
+    for(size_t i = 0; i < newAllocs.size(); ++i)
+    {
+        const NewAllocation& newAlloc = newAllocs[i];
+        if(newAlloc.m_RangeIndex != SIZE_MAX)
+        {
+            Range range = oldRanges[newAlloc.m_RangeIndex];
+            range.m_Alloc = allocs[i];
+            if(range.m_Owner)
+                range.m_Owner->m_Index = newAlloc.m_Index;
+            m_Ranges.emplace(newAlloc.m_Index, range);
+        }
+        else
+            m_SlotPageAllocs[newAlloc.m_Index / PAGE_SIZE] = allocs[i];
+    }
+
+    // Rebuild m_SlotAllocator and m_SlotOwners with the new indices of single descriptors.
+    std::vector<uint64_t> allocatedMasks(m_SlotPageAllocs.size(), 0);
+    std::vector<Descriptor*> newSlotOwners(m_SlotOwners.size(), nullptr);
+    for(size_t singleIndex = 0; singleIndex < input.m_Singles.size(); ++singleIndex)
+    {
+        const uint64_t newIndex = plan.m_SingleIndices[singleIndex];
+        allocatedMasks[newIndex / PAGE_SIZE] |= 1llu << (newIndex % PAGE_SIZE);
+        Descriptor* const owner = m_SlotOwners[input.m_Singles[singleIndex].m_Index];
+        if(owner)
+            owner->m_Index = newIndex;
+        newSlotOwners[newIndex] = owner;
+    }
+    m_SlotOwners = std::move(newSlotOwners);
+    m_SlotAllocator.Init(m_PersistentDescriptorMaxCount);
+    for(uint64_t pageIndex : plan.m_Pages)
+        m_SlotAllocator.AddPage(pageIndex, allocatedMasks[pageIndex]);
+
+    LogInfoF(L"{} descriptors defragmented: {} moves, pages {} -> {}, used up to {} of {}.",
+        DESCRIPTOR_HEAP_TYPE_NAMES[(uint32_t)m_Type], plan.m_Moves.size(), oldPageCount, plan.m_Pages.size(),
+        plan.m_UsedEnd, m_PersistentDescriptorMaxCount);
+}
+
+void DescriptorManager::MoveDescriptors(std::span<const DescriptorDefragmentationPlan::Move> moves)
+{
+    ID3D12Device* const device = g_Renderer->GetDevice();
+
+    // Sources of copies must be in a heap that is not shader-visible, and moves may overlap,
+    // so copy from a snapshot of the persistent section.
+    ComPtr<ID3D12DescriptorHeap> snapshotHeap;
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.Type = m_Type;
+    heapDesc.NumDescriptors = m_PersistentDescriptorMaxCount;
+    CHECK_HR(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&snapshotHeap)));
+    const D3D12_CPU_DESCRIPTOR_HANDLE snapshotStart = snapshotHeap->GetCPUDescriptorHandleForHeapStart();
+    // Where movable descriptors are written through CPU handles.
+    const D3D12_CPU_DESCRIPTOR_HANDLE writtenStart = m_ShadowHeap ? m_ShadowCPUHandleForHeapStart : m_CPUHandleForHeapStart;
+    device->CopyDescriptorsSimple(m_PersistentDescriptorMaxCount, snapshotStart, writtenStart, m_Type);
+
+    for(const DescriptorDefragmentationPlan::Move& move : moves)
+    {
+        const CD3DX12_CPU_DESCRIPTOR_HANDLE src(snapshotStart, (int32_t)move.m_SrcIndex, m_DescriptorSize);
+        device->CopyDescriptorsSimple((UINT)move.m_Count,
+            CD3DX12_CPU_DESCRIPTOR_HANDLE(writtenStart, (int32_t)move.m_DstIndex, m_DescriptorSize), src, m_Type);
+        if(m_ShadowHeap)
+        {
+            device->CopyDescriptorsSimple((UINT)move.m_Count,
+                CD3DX12_CPU_DESCRIPTOR_HANDLE(m_CPUHandleForHeapStart, (int32_t)move.m_DstIndex, m_DescriptorSize),
+                src, m_Type);
+        }
+    }
+}
+
+void DescriptorManager::ImGui_TemporaryStatistics()
+{
+    ImGui::Text("Temporary per frame: %u", m_TemporaryDescriptorMaxCountPerFrame);
+    ImGui::Text("Used per frame: last %llu, max of %u frames %llu, peak %llu",
+        m_TemporaryUsageHistory.GetLast(),
+        m_TemporaryUsageHistory.GetCount(),
+        m_TemporaryUsageHistory.GetRollingMax(),
+        m_TemporaryUsageHistory.GetPeak());
+    ImGui::Text("Recommended MaxCountPerFrame: %u", GetRecommendedTemporaryMaxCountPerFrame());
+}
+
 D3D12_GPU_DESCRIPTOR_HANDLE DescriptorManager::GetGPUHandle(Descriptor desc, uint32_t descIndex)
 {
     assert(!desc.IsNull());
@@ -110,6 +523,14 @@ D3D12_GPU_DESCRIPTOR_HANDLE DescriptorManager::GetGPUHandle(Descriptor desc, uin
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorManager::GetCPUHandle(Descriptor desc, uint32_t descIndex)
 {
     assert(!desc.IsNull());
+    if(desc.m_Movable && m_ShadowHeap)
+    {
+        std::lock_guard<std::mutex> lock(m_VirtualBlockMutex);
+        m_PendingWrites.push_back(desc.m_Index + descIndex);
+        return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_ShadowCPUHandleForHeapStart,
+            (int32_t)(desc.m_Index + descIndex), // offsetInDescriptors
+            m_DescriptorSize); // descriptorIncrementSize
+    }
     return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_CPUHandleForHeapStart,
         (int32_t)(desc.m_Index + descIndex), // offsetInDescriptors
         m_DescriptorSize); // descriptorIncrementSize
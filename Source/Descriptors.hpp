@@ -1,6 +1,11 @@
 #pragma once
 
 #include "MultiFrameRingBuffer.hpp"
+#include "DescriptorSlotAllocator.hpp"
+#include "DescriptorDefragmentation.hpp"
+#include <mutex>
+#include <atomic>
+#include <map>
 
 /*
 Represents a single or a sequence of several shader-visible descriptors,
@@ -9,8 +14,9 @@ A lightweight object to be passed by value.
 */
 struct Descriptor
 {
-    D3D12MA::VirtualAllocation m_VirtualAlloc = { 0 };
     uint64_t m_Index = UINT64_MAX;
+    // Allocated with DescriptorManager::AllocatePersistentMovable.
+    bool m_Movable = false;
 
     bool IsNull() const { return m_Index == UINT64_MAX; }
 };
@@ -28,9 +34,23 @@ allocate descriptors of two types:
 Space in m_DescriptorHeap is divided into two sections:
 
 1. (persistentDescriptorMaxCount) for persistent descriptors, managed by
-   D3D12MA::VirtualAllocator.
+   D3D12MA::VirtualAllocator. Single descriptors, which are almost all of them,
+   are allocated from pages of DescriptorSlotAllocator::PAGE_SIZE taken from it,
+   in O(1). Only ranges of multiple descriptors go to the virtual block directly.
 2. (temporaryDescriptorMaxCountPerFrame * g_FrameCount) for temporary
-   descriptors, managed by MultiFrameRingBuffer.
+   descriptors, managed by ConcurrentMultiFrameRingBuffer.
+
+AllocateTemporary is thread-safe. NewFrame must not be called concurrently with it.
+
+Persistent descriptors allocated with AllocatePersistentMovable register the Descriptor object of their
+owner, so Defragment can compact the persistent section and patch the owner. Others are pinned in place.
+CopyDescriptors can't read from shader-visible heaps, so for CBV_SRV_UAV and SAMPLER, CPU handles of
+movable descriptors point to m_ShadowHeap, which is copied to the heap in NewFrame.
+
+When a frame needs more temporary descriptors than the ring buffer holds, the rest is taken from
+the persistent section and freed automatically like temporary ones. The heap itself cannot grow
+without recreating it and all persistent descriptors, so usage per frame is recorded to recommend
+a better "...Temporary.MaxCountPerFrame" setting instead.
 */
 class DescriptorManager
 {
@@ -43,16 +63,53 @@ public:
     void NewFrame();
 
     ID3D12DescriptorHeap* GetHeap() { return m_DescriptorHeap.Get(); }
+    // Start of the persistent section, for tables indexed with Descriptor::m_Index of persistent descriptors.
+    D3D12_GPU_DESCRIPTOR_HANDLE GetPersistentSectionGPUHandle() const { return m_GPUHandleForHeapStart; }
 
     Descriptor AllocatePersistent(uint32_t descriptorCount);
+    /*
+    Like AllocatePersistent, but outDesc is registered as the owner, so Defragment can move the descriptors
+    and update outDesc. outDesc must stay at the same address until it is freed with FreePersistent.
+    */
+    void AllocatePersistentMovable(uint32_t descriptorCount, Descriptor& outDesc);
     Descriptor AllocateTemporary(uint32_t descriptorCount);
     void FreePersistent(Descriptor desc);
+    /*
+    Frees desc in NewFrame g_FrameCount frames later, when frames in flight that may use it are finished.
+    If movable, it is pinned until then, so its owner can take a new descriptor right away.
+    */
+    void FreePersistentDeferred(Descriptor desc);
+
+    // Part of free persistent descriptors, including free slots in pages, outside of the largest free range. 0..1.
+    float CalculateFragmentation();
+    // Set also when allocation of a range fails.
+    void RequestDefragmentation() { m_DefragmentationRequested = true; }
+    bool IsDefragmentationRequested() const { return m_DefragmentationRequested; }
+    /*
+    Compacts persistent descriptors: moves movable ones to lower indices with CopyDescriptorsSimple,
+    updates their owners and frees emptied pages. GPU must be idle, as descriptors of frames in flight move.
+    */
+    void Defragment();
+
+    // Value for setting "...Temporary.MaxCountPerFrame" that would fit the peak usage so far.
+    uint32_t GetRecommendedTemporaryMaxCountPerFrame() const;
+    void ImGui_PersistentStatistics();
+    void ImGui_TemporaryStatistics();
 
     // Pass non-zero descIndex if desc represents a sequence of multiple descriptors you want to index individually.
     D3D12_GPU_DESCRIPTOR_HANDLE GetGPUHandle(Descriptor desc, uint32_t descIndex = 0);
+    // For movable descriptors in shader-visible heaps, what is written there gets to the heap in NewFrame.
     D3D12_CPU_DESCRIPTOR_HANDLE GetCPUHandle(Descriptor desc, uint32_t descIndex = 0);
 
 private:
+    struct Range
+    {
+        D3D12MA::VirtualAllocation m_Alloc = { 0 };
+        uint64_t m_Size = 0;
+        // Null if not movable.
+        Descriptor* m_Owner = nullptr;
+    };
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type = D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
     uint32_t m_PersistentDescriptorMaxCount = UINT32_MAX;
     uint32_t m_TemporaryDescriptorMaxCountPerFrame = UINT32_MAX;
@@ -65,6 +122,40 @@ private:
     // Not null if m_PersistentDescriptorMaxCount > 0.
     // Unit used in this allocator is entire descriptors NOT single bytes.
     ComPtr<D3D12MA::VirtualBlock> m_VirtualBlock;
+    DescriptorSlotAllocator m_SlotAllocator;
+    // Allocations in m_VirtualBlock of pages added to m_SlotAllocator, indexed by page index.
+    std::vector<D3D12MA::VirtualAllocation> m_SlotPageAllocs;
+    std::atomic<bool> m_DefragmentationRequested = false;
     // Initialized if m_TemporaryDescriptorMaxCountPerFrame > 0.
-    MultiFrameRingBuffer<uint64_t> m_TemporaryDescriptorRingBuffer;
+    ConcurrentMultiFrameRingBuffer<uint64_t> m_TemporaryDescriptorRingBuffer;
+    FrameUsageHistory m_TemporaryUsageHistory;
+    uint32_t m_FrameCount = 0;
+
+    // Protects m_VirtualBlock and members below.
+    std::mutex m_VirtualBlockMutex;
+    // Owners of single descriptors registered by AllocatePersistentMovable, indexed by descriptor index.
+    std::vector<Descriptor*> m_SlotOwners;
+    // Descriptors allocated directly from m_VirtualBlock, by first index. Descriptor doesn't keep
+    // its VirtualAllocation, as Defragment recreates them.
+    std::map<uint64_t, Range> m_Ranges;
+    // Created for shader-visible types if m_PersistentDescriptorMaxCount > 0, not shader-visible.
+    // Holds the persistent section, as written through CPU handles of movable descriptors.
+    ComPtr<ID3D12DescriptorHeap> m_ShadowHeap;
+    D3D12_CPU_DESCRIPTOR_HANDLE m_ShadowCPUHandleForHeapStart = { UINT64_MAX };
+    // Indices written in m_ShadowHeap since the last NewFrame, to copy to m_DescriptorHeap.
+    std::vector<uint64_t> m_PendingWrites;
+    // Temporary descriptors taken from m_VirtualBlock in the current frame, when the ring buffer was full.
+    uint64_t m_TemporaryOverflowCount = 0;
+    // Such descriptors, freed when the frame that used them is finished.
+    // Indexed by m_DeferredFreeIndex of that frame.
+    std::vector<Descriptor> m_DeferredFrees[MAX_FRAME_COUNT];
+    uint32_t m_DeferredFreeIndex = 0;
+
+    // Called with m_VirtualBlockMutex locked.
+    Descriptor AllocatePersistentLocked(uint32_t descriptorCount);
+    void FreePersistentLocked(Descriptor desc);
+    bool AddSlotPage();
+    void FreeDeferred(std::vector<Descriptor>& descriptors);
+    void FlushPendingWrites();
+    void MoveDescriptors(std::span<const DescriptorDefragmentationPlan::Move> moves);
 };
@@ -0,0 +1,125 @@
+#include "BaseUtils.hpp"
+#include "FrameArena.hpp"
+#include "Renderer.hpp"
+#include "ImGuiUtils.hpp"
+
+// Limits size of a block after growing, so a single huge frame doesn't keep memory forever.
+constexpr size_t MAX_BLOCK_SIZE = 64llu * 1024 * 1024;
+constexpr size_t MIN_OVERFLOW_SIZE = 64 * 1024;
+// Of every block and overflow, so any type can be allocated.
+constexpr size_t BLOCK_ALIGNMENT = 64;
+
+void FrameArena::Init(size_t blockSize, uint32_t frameCount)
+{
+    assert(m_FrameCount == 0 && frameCount > 0 && frameCount <= MAX_FRAME_COUNT);
+    m_FrameCount = frameCount;
+    for(uint32_t i = 0; i < m_FrameCount; ++i)
+    {
+        m_Blocks[i].m_Data = AllocateFromHeap(blockSize);
+        m_Blocks[i].m_Size = blockSize;
+    }
+}
+
+FrameArena::~FrameArena()
+{
+    for(uint32_t i = 0; i < m_FrameCount; ++i)
+        FreeBlock(m_Blocks[i]);
+}
+
+void FrameArena::NewFrame()
+{
+    m_Blocks[m_FrameIndex].m_NeededSize = m_UsedSize;
+    m_FrameIndex = (m_FrameIndex + 1) % m_FrameCount;
+    m_Offset = 0;
+    m_UsedSize = 0;
+
+    // The frame that used this block last is FrameCount frames ago.
+    Block& block = m_Blocks[m_FrameIndex];
+    if(!block.m_Overflows.empty())
+    {
+        for(char* overflow : block.m_Overflows)
+            _aligned_free(overflow);
+        block.m_Overflows.clear();
+
+        // Grow with a margin, so the next frames fit.
+        const size_t newSize = std::min(block.m_NeededSize + block.m_NeededSize / 2, MAX_BLOCK_SIZE);
+        if(newSize > block.m_Size)
+        {
+            _aligned_free(block.m_Data);
+            block.m_Data = nullptr;
+            block.m_Size = 0;
+            block.m_Data = AllocateFromHeap(newSize);
+            block.m_Size = newSize;
+        }
+    }
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    assert(m_FrameCount > 0 && alignment > 0 && alignment <= BLOCK_ALIGNMENT && (alignment & (alignment - 1)) == 0);
+    m_UsedSize += size;
+    m_PeakUsedSize = std::max(m_PeakUsedSize, m_UsedSize);
+
+    Block& block = m_Blocks[m_FrameIndex];
+    const size_t offset = AlignUp(m_Offset, alignment);
+    if(offset + size <= block.m_Size)
+    {
+        m_Offset = offset + size;
+        return block.m_Data + offset;
+    }
+
+    // Block is full - rare, so each overflow just gets its own allocation.
+    char* const overflow = AllocateFromHeap(std::max(size, MIN_OVERFLOW_SIZE));
+    block.m_Overflows.push_back(overflow);
+    return overflow;
+}
+
+char* FrameArena::AllocateFromHeap(size_t size)
+{
+    char* const ptr = (char*)_aligned_malloc(size, BLOCK_ALIGNMENT);
+    if(!ptr)
+        throw std::bad_alloc{};
+    ++m_BlockAllocationCount;
+    return ptr;
+}
+
+void FrameArena::FreeBlock(Block& block)
+{
+    for(char* overflow : block.m_Overflows)
+        _aligned_free(overflow);
+    block.m_Overflows.clear();
+    _aligned_free(block.m_Data);
+    block.m_Data = nullptr;
+}
+
+void FrameArena::ImGui()
+{
+    ImGui::Text("Block size: %s x %u", FrameSizeToStr(GetBlockSize()), m_FrameCount);
+    ImGui::Text("Used: current %s, peak %s", FrameSizeToStr(m_UsedSize), FrameSizeToStr(m_PeakUsedSize));
+    ImGui::Text("Block allocations: %llu", m_BlockAllocationCount);
+}
+
+std::pmr::memory_resource* FrameAlloc()
+{
+    return g_Renderer->GetFrameArena();
+}
+
+const char* FrameSizeToStr(uint64_t size)
+{
+    // Longer than any size.
+    constexpr size_t MAX_LENGTH = 32;
+    char* const buf = (char*)g_Renderer->GetFrameArena()->Allocate(MAX_LENGTH, 1);
+    char* end;
+    if(size == 0)
+        end = std::format_to_n(buf, MAX_LENGTH - 1, "0 B").out;
+    else if(size < 1024)
+        end = std::format_to_n(buf, MAX_LENGTH - 1, "{} B", size).out;
+    else if(size < 1024 * 1024)
+        end = std::format_to_n(buf, MAX_LENGTH - 1, "{:.2f} KB", (double)size / (1024.)).out;
+    else if(size < 1024 * 1024 * 1024)
+        end = std::format_to_n(buf, MAX_LENGTH - 1, "{:.2f} MB", (double)size / (1024. * 1024.)).out;
+    else
+        end = std::format_to_n(buf, MAX_LENGTH - 1, "{:.2f} GB", (double)size / (1024. * 1024. * 1024.)).out;
+    *end = '\0';
+    return buf;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+Linear allocator for transient CPU data of a frame: temporary containers and strings built on the render path.
+Allocation is a pointer bump, freeing does nothing, and all memory of a frame is released at once in NewFrame.
+
+There is one block per frame, like the frame resources, so data allocated during a frame stays valid
+until NewFrame is called FrameCount times. When a block is full, more memory is taken from the general heap
+for the rest of the frame, and the block is reallocated to fit everything next time it is used.
+So in a steady state the render path doesn't touch the general heap - Renderer checks it with HeapAllocationCounter,
+see setting "Renderer.CheckHeapAllocations".
+
+Use it through std::pmr containers with FrameAlloc. Not thread-safe - use only on the main thread.
+*/
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+    void Init(size_t blockSize, uint32_t frameCount);
+    ~FrameArena();
+    // Makes memory allocated FrameCount frames ago available again.
+    void NewFrame();
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Used by the current frame so far, including overflow to the heap.
+    size_t GetUsedSize() const { return m_UsedSize; }
+    size_t GetPeakUsedSize() const { return m_PeakUsedSize; }
+    size_t GetBlockSize() const { return m_Blocks[m_FrameIndex].m_Size; }
+    // Blocks and overflows this arena allocated since Init. Other heap allocations are counted by HeapAllocationCounter.
+    uint64_t GetBlockAllocationCount() const { return m_BlockAllocationCount; }
+
+    void ImGui();
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override { return Allocate(bytes, alignment); }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override { }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    struct Block
+    {
+        char* m_Data = nullptr;
+        size_t m_Size = 0;
+        // Memory from the heap taken after the block was full. Freed in NewFrame.
+        std::vector<char*> m_Overflows;
+        // Total size needed by the frame that used this block last.
+        size_t m_NeededSize = 0;
+    };
+
+    uint32_t m_FrameCount = 0;
+    uint32_t m_FrameIndex = 0;
+    Block m_Blocks[MAX_FRAME_COUNT];
+    size_t m_Offset = 0;
+    size_t m_UsedSize = 0;
+    size_t m_PeakUsedSize = 0;
+    uint64_t m_BlockAllocationCount = 0;
+
+    char* AllocateFromHeap(size_t size);
+    static void FreeBlock(Block& block);
+};
+
+// Use as an allocator argument of std::pmr containers: std::pmr::vector<T> v(FrameAlloc());
+std::pmr::memory_resource* FrameAlloc();
+
+constexpr size_t FRAME_FORMAT_RESERVE = 64;
+
+using FrameString = std::pmr::string;
+using FrameWString = std::pmr::wstring;
+template<typename T>
+using FrameVector = std::pmr::vector<T>;
+
+// Like std::format, but the result is allocated from the frame arena.
+template<typename... Args>
+FrameWString FrameFormat(const wchar_t* format, const Args&... args)
+{
+    FrameWString result(FrameAlloc());
+    // The arena can't reuse memory of a string that grows, so start with enough for typical messages.
+    result.reserve(FRAME_FORMAT_RESERVE);
+    std::vformat_to(std::back_inserter(result), format, std::make_wformat_args(args...));
+    return result;
+}
+
+// Like SizeToStr, for ImGui. The result is allocated from the frame arena.
+const char* FrameSizeToStr(uint64_t size);
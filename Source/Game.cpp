@@ -7,6 +7,7 @@
 #include "ImGuiUtils.hpp"
 #include "Texture.hpp"
 #include "Mesh.hpp"
+#include "AssetPack.hpp"
 #include "../WorkingDir/Shaders/Include/ShaderConstants.h"
 
 extern VecSetting<glm::uvec2> g_Size;
@@ -325,6 +326,24 @@ void Game::ShowStatisticsWindow()
     if(ImGui::CollapsingHeader("D3D12 Memory Allocator"))
         g_Renderer->ImGui_D3D12MAStatistics();
 
+    if(ImGui::CollapsingHeader("Texture streaming"))
+        g_Renderer->ImGui_TextureStreamingStatistics();
+
+    if(ImGui::CollapsingHeader("Pipeline states"))
+        g_Renderer->ImGui_PipelineStateStatistics();
+
+    if(ImGui::CollapsingHeader("Temporary allocators"))
+        g_Renderer->ImGui_TemporaryAllocatorStatistics();
+
+    if(ImGui::CollapsingHeader("Descriptors"))
+        g_Renderer->ImGui_DescriptorStatistics();
+
+    if(ImGui::CollapsingHeader("Command list"))
+        g_Renderer->ImGui_CommandListStatistics();
+
+    if(ImGui::CollapsingHeader("Asset cache"))
+        g_AssetPack->ImGui();
+
     ImGui::End();
 }
 
@@ -448,6 +467,16 @@ void Game::ShowSceneWindow()
                         const wchar_t* formatStr = DXGIFormatToStr(desc.Format);
                         s += std::format(" Format={} MipLevels={}", ConvertUnicodeToChars(formatStr, CP_UTF8), desc.MipLevels);
                         ImGui::Text("%s", s.c_str());
+                        if(t.m_Texture->IsStreaming())
+                        {
+                            ImGui::Text("Streaming: full size %u x %u, first resident mip %u (max %u)",
+                                t.m_Texture->GetFullSize().x, t.m_Texture->GetFullSize().y,
+                                t.m_Texture->GetFirstResidentMip(), t.m_Texture->GetMaxFirstResidentMip());
+                        }
+                    }
+                    else if(t.m_ArrayIndex != SIZE_MAX)
+                    {
+                        ImGui::Text("Texture array %zu, slice %u", t.m_ArrayIndex, t.m_ArraySlice);
                     }
                     else
                     {
@@ -0,0 +1,79 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "HeapAllocationCounter.hpp"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+static std::atomic<uint64_t> g_HeapAllocationCount = 0;
+// Constant-initialized, so it is safe to use during thread startup and shutdown.
+static thread_local uint64_t g_ThreadHeapAllocationCount = 0;
+
+uint64_t GetHeapAllocationCount()
+{
+    return g_HeapAllocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t GetThreadHeapAllocationCount()
+{
+    return g_ThreadHeapAllocationCount;
+}
+
+static void CountAllocation()
+{
+    g_HeapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    ++g_ThreadHeapAllocationCount;
+}
+
+/*
+Only the basic forms of operator new are replaced. The standard library implements the array and nothrow
+forms by calling them, so all of them are counted. Sized forms of operator delete are replaced too,
+so each pair of new and delete matches.
+*/
+
+void* operator new(size_t size)
+{
+    void* const ptr = malloc(size > 0 ? size : 1);
+    if(!ptr)
+        throw std::bad_alloc{};
+    CountAllocation();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    const size_t align = (size_t)alignment;
+#ifdef _WIN32
+    void* const ptr = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    // aligned_alloc needs size to be a multiple of alignment.
+    void* const ptr = aligned_alloc(align, size > 0 ? (size + align - 1) / align * align : align);
+#endif
+    if(!ptr)
+        throw std::bad_alloc{};
+    CountAllocation();
+    return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
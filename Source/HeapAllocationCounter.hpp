@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+Counts allocations from the general heap made through operator new, by replacing the global operator new
+and delete. Renderer uses it to check that the render path doesn't allocate in a steady state,
+see setting "Renderer.CheckHeapAllocations", on in Debug by default.
+Doesn't see malloc called directly, e.g. by third-party libraries.
+*/
+
+#include <cstdint>
+
+// Allocations made by all threads since the start of the program.
+uint64_t GetHeapAllocationCount();
+// Allocations made by the calling thread since it started.
+uint64_t GetThreadHeapAllocationCount();
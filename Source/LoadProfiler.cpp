@@ -0,0 +1,144 @@
+#include "BaseUtils.hpp"
+#include "LoadProfiler.hpp"
+#include "Settings.hpp"
+#include "Streams.hpp"
+#include <mutex>
+#include <algorithm>
+
+static BoolSetting g_LoadProfilerEnabled(SettingCategory::Load, "LoadProfiler.Enabled", false);
+static StringSetting g_LoadProfilerOutputFilePath(SettingCategory::Load, "LoadProfiler.OutputFilePath", "LoadProfile.json");
+
+std::atomic<bool> g_LoadProfilingActive;
+
+struct LoadProfileEvent
+{
+    const char* m_Name;
+    DWORD m_ThreadId;
+    Time m_BeginTime;
+    Time m_EndTime;
+};
+
+static std::mutex g_LoadProfileMutex;
+static std::vector<LoadProfileEvent> g_LoadProfileEvents;
+static Time g_LoadProfileBeginTime;
+
+void LoadProfileScope::Begin(const char* name)
+{
+    m_Name = name;
+    m_BeginTime = Now();
+}
+
+void LoadProfileScope::End()
+{
+    const Time endTime = Now();
+    std::lock_guard<std::mutex> lock(g_LoadProfileMutex);
+    // Profiling could end while the scope was running.
+    if(g_LoadProfilingActive.load(std::memory_order_relaxed))
+        g_LoadProfileEvents.push_back({m_Name, GetCurrentThreadId(), m_BeginTime, endTime});
+}
+
+void BeginLoadProfiling()
+{
+    if(!g_LoadProfilerEnabled.GetValue())
+        return;
+    std::lock_guard<std::mutex> lock(g_LoadProfileMutex);
+    g_LoadProfileEvents.clear();
+    g_LoadProfileBeginTime = Now();
+    g_LoadProfilingActive.store(true);
+}
+
+static double TimeToMicroseconds(Time t)
+{
+    return TimeToSeconds<double>(t) * 1e6;
+}
+
+static void SaveChromeTrace(const wstr_view& filePath, std::span<const LoadProfileEvent> events)
+{
+    ERR_TRY;
+
+    const DWORD processId = GetCurrentProcessId();
+    string s = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for(size_t i = 0; i < events.size(); ++i)
+    {
+        const LoadProfileEvent& e = events[i];
+        // "X" = complete event, with duration. Names are string literals, so they don't need escaping.
+        s += std::format("{{\"name\":\"{}\",\"cat\":\"load\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{}}}{}\n",
+            e.m_Name,
+            TimeToMicroseconds(e.m_BeginTime - g_LoadProfileBeginTime),
+            TimeToMicroseconds(e.m_EndTime - e.m_BeginTime),
+            processId, e.m_ThreadId,
+            i + 1 < events.size() ? "," : "");
+    }
+    s += "]}\n";
+    SaveFile(filePath, std::span<const char>(s.data(), s.size()));
+
+    ERR_CATCH_MSG(std::format(L"Cannot save load profile to \"{}\".", filePath));
+}
+
+static void PrintSummary(std::span<const LoadProfileEvent> events, Time totalTime)
+{
+    struct Row
+    {
+        const char* m_Name;
+        uint32_t m_Count = 0;
+        Time m_TotalTime;
+        Time m_MaxTime;
+    };
+    std::vector<Row> rows;
+    for(const LoadProfileEvent& e : events)
+    {
+        // Linear search is fine for a few dozen distinct names.
+        auto it = std::find_if(rows.begin(), rows.end(), [&](const Row& r) { return strcmp(r.m_Name, e.m_Name) == 0; });
+        if(it == rows.end())
+        {
+            rows.push_back({e.m_Name});
+            it = rows.end() - 1;
+        }
+        const Time duration = e.m_EndTime - e.m_BeginTime;
+        ++it->m_Count;
+        it->m_TotalTime += duration;
+        it->m_MaxTime = std::max(it->m_MaxTime, duration);
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& lhs, const Row& rhs) { return lhs.m_TotalTime > rhs.m_TotalTime; });
+
+    LogMessageF(L"Load profile: {} events in {:.1f} ms. Times include nested scopes.",
+        events.size(), TimeToMilliseconds<float>(totalTime));
+    LogMessageF(L"{:<40} {:>8} {:>12} {:>12} {:>12}", L"Name", L"Count", L"Total ms", L"Avg ms", L"Max ms");
+    for(const Row& r : rows)
+    {
+        const float totalMs = TimeToMilliseconds<float>(r.m_TotalTime);
+        LogMessageF(L"{:<40} {:>8} {:>12.1f} {:>12.2f} {:>12.2f}",
+            ConvertCharsToUnicode(r.m_Name, CP_UTF8), r.m_Count,
+            totalMs, totalMs / (float)r.m_Count, TimeToMilliseconds<float>(r.m_MaxTime));
+    }
+}
+
+void EndLoadProfiling()
+{
+    std::vector<LoadProfileEvent> events;
+    Time totalTime;
+    {
+        std::lock_guard<std::mutex> lock(g_LoadProfileMutex);
+        if(!g_LoadProfilingActive.load(std::memory_order_relaxed))
+            return;
+        g_LoadProfilingActive.store(false);
+        events.swap(g_LoadProfileEvents);
+        totalTime = Now() - g_LoadProfileBeginTime;
+    }
+    std::sort(events.begin(), events.end(), [](const LoadProfileEvent& lhs, const LoadProfileEvent& rhs)
+    {
+        return lhs.m_BeginTime < rhs.m_BeginTime;
+    });
+
+    PrintSummary(events, totalTime);
+
+    const wstring filePath = ConvertCharsToUnicode(g_LoadProfilerOutputFilePath.GetValue(), CP_UTF8);
+    if(!filePath.empty())
+    {
+        try
+        {
+            SaveChromeTrace(filePath, events);
+            LogMessageF(L"Load profile saved to \"{}\".", filePath);
+        } CATCH_PRINT_ERROR(;)
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Time.hpp"
+#include <atomic>
+
+/*
+Measures time spent in steps of the load path, e.g. LoadModel, texture decoding, shader compilation,
+on any thread.
+
+Put PROFILE_LOAD_SCOPE("Name") at the beginning of a scope. Name must be a string literal.
+Events are recorded only between BeginLoadProfiling and EndLoadProfiling, when setting
+"LoadProfiler.Enabled" is true. Otherwise a scope costs only a check of one global flag.
+
+EndLoadProfiling writes all events to a file in Chrome trace-event JSON format,
+which can be opened in chrome://tracing or Perfetto, and logs a summary table.
+*/
+
+extern std::atomic<bool> g_LoadProfilingActive;
+
+class LoadProfileScope
+{
+public:
+    LoadProfileScope(const char* name)
+    {
+        if(g_LoadProfilingActive.load(std::memory_order_relaxed))
+            Begin(name);
+    }
+    ~LoadProfileScope()
+    {
+        if(m_Name)
+            End();
+    }
+    LoadProfileScope(const LoadProfileScope&) = delete;
+    LoadProfileScope& operator=(const LoadProfileScope&) = delete;
+
+private:
+    const char* m_Name = nullptr;
+    Time m_BeginTime;
+
+    void Begin(const char* name);
+    void End();
+};
+
+// Does nothing if setting "LoadProfiler.Enabled" is false. Discards events of a previous unfinished session.
+void BeginLoadProfiling();
+// Does nothing if profiling was not begun.
+void EndLoadProfiling();
+
+#define PROFILE_LOAD_SCOPE_CONCAT_INNER(a, b) a##b
+#define PROFILE_LOAD_SCOPE_CONCAT(a, b) PROFILE_LOAD_SCOPE_CONCAT_INNER(a, b)
+#define PROFILE_LOAD_SCOPE(name) LoadProfileScope PROFILE_LOAD_SCOPE_CONCAT(loadProfileScope, __LINE__)(name)
@@ -4,6 +4,7 @@
 #include "Renderer.hpp"
 #include "Settings.hpp"
 #include "SmallFileCache.hpp"
+#include "AssetPack.hpp"
 #include "ImGuiUtils.hpp"
 #include "Time.hpp"
 #include <windowsx.h>
@@ -214,6 +215,8 @@ Application::~Application()
     else
         SaveRuntimeSettings();
 
+    delete g_AssetPack;
+    g_AssetPack = nullptr;
     delete g_SmallFileCache;
     g_SmallFileCache = nullptr;
 }
@@ -230,6 +233,8 @@ void Application::Init()
     LoadStartupSettings();
     LoadRuntimeSettings();
     LoadLoadSettings();
+    g_AssetPack = new AssetPack{};
+    g_AssetPack->Open(L"Cache/Assets.pack");
     SelectAdapter();
     assert(m_Adapter);
 
@@ -107,3 +107,13 @@ D3D12_INDEX_BUFFER_VIEW Mesh::GetIndexBufferView() const
         (UINT)(m_IndexCount * sizeof(IndexType)), // SizeInBytes
         s_IndexFormat };
 }
+
+uint64_t Mesh::GetAllocatedSize() const
+{
+    uint64_t size = 0;
+    if(m_VertexBuffer)
+        size += m_VertexBuffer->GetSize();
+    if(m_IndexBuffer)
+        size += m_IndexBuffer->GetSize();
+    return size;
+}
@@ -37,6 +37,8 @@ public:
     ID3D12Resource* GetIndexBuffer() const { return m_IndexBuffer->GetResource(); }
     D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView() const;
     D3D12_INDEX_BUFFER_VIEW GetIndexBufferView() const;
+    // Size of GPU memory allocated for vertex and index buffer.
+    uint64_t GetAllocatedSize() const;
 
 private:
     D3D12_PRIMITIVE_TOPOLOGY_TYPE m_TopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_UNDEFINED;
@@ -0,0 +1,330 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "MipmapGenerator.hpp"
+#include <array>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "ParallelFor.hpp"
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+// Rows are processed in blocks of at least this number of pixels, so smaller levels stay on the current thread.
+static const size_t MIN_PIXELS_PER_BLOCK = 16 * 1024;
+static const uint32_t LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+// Source pixels contributing to one destination pixel along one axis: m_Count of them starting at m_First.
+struct DownsampleTaps
+{
+    uint32_t m_First;
+    uint32_t m_Count;
+    float m_Weights[3];
+};
+
+static float LinearToSRGB(float v)
+{
+    return v <= 0.00313066844250063f ?
+        v * 12.92f :
+        std::pow(v, 0.41666666666666666666666666666667f) * 1.055f - 0.055f;
+}
+
+static float SRGBToLinear(float v)
+{
+    return v <= 0.0404482362771082f ?
+        v * 0.07739938080495356037151702786378f :
+        std::pow((v + 0.055f) * 0.94786729857819905213270142180095f, 2.4f);
+}
+
+static const float* GetSRGBToLinearTable()
+{
+    static const std::array<float, 256> table = []()
+    {
+        std::array<float, 256> t;
+        for(uint32_t i = 0; i < 256; ++i)
+            t[i] = SRGBToLinear((float)i / 255.f);
+        return t;
+    }();
+    return table.data();
+}
+
+static const uint8_t* GetLinearToSRGBTable()
+{
+    static const std::array<uint8_t, LINEAR_TO_SRGB_TABLE_SIZE> table = []()
+    {
+        std::array<uint8_t, LINEAR_TO_SRGB_TABLE_SIZE> t;
+        for(uint32_t i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i)
+            t[i] = (uint8_t)(LinearToSRGB((float)i / (float)(LINEAR_TO_SRGB_TABLE_SIZE - 1)) * 255.f + 0.5f);
+        return t;
+    }();
+    return table.data();
+}
+
+static inline uint8_t UnormToByte(float v)
+{
+    return (uint8_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+// Calls func(beginRow, endRow) for blocks of rows, with ParallelFor.
+template<typename Func>
+static void ParallelForRows(uint32_t rowCount, uint32_t width, const Func& func)
+{
+    if(rowCount == 0)
+        return;
+    const uint32_t rowsPerBlock = (uint32_t)std::clamp<size_t>(
+        (MIN_PIXELS_PER_BLOCK + width - 1) / std::max(width, 1u), 1, rowCount);
+    const uint32_t blockCount = (rowCount + rowsPerBlock - 1) / rowsPerBlock;
+    ParallelFor(blockCount, 0, [&](size_t blockIndex)
+    {
+        const uint32_t beginRow = (uint32_t)blockIndex * rowsPerBlock;
+        func(beginRow, std::min(beginRow + rowsPerBlock, rowCount));
+    });
+}
+
+MipmapGenerator::MipmapGenerator(uint32_t flags, float alphaCutoff) :
+    m_Flags(flags),
+    m_AlphaCutoff(alphaCutoff)
+{
+}
+
+void MipmapGenerator::Generate(std::span<const Level> levels)
+{
+    if(levels.size() < 2)
+        return;
+
+    std::vector<float> srcPixels((size_t)levels[0].m_Width * levels[0].m_Height * 4);
+    std::vector<float> dstPixels;
+    Decode(levels[0], srcPixels.data());
+
+    const bool preserveCoverage = (m_Flags & FLAG_PRESERVE_ALPHA_COVERAGE) != 0;
+    const float desiredCoverage = preserveCoverage ?
+        CalculateAlphaCoverage(srcPixels.data(), srcPixels.size() / 4, 1.f) : 0.f;
+
+    for(size_t levelIndex = 1; levelIndex < levels.size(); ++levelIndex)
+    {
+        const Level& srcLevel = levels[levelIndex - 1];
+        const Level& dstLevel = levels[levelIndex];
+        assert(dstLevel.m_Width == std::max(srcLevel.m_Width / 2, 1u));
+        assert(dstLevel.m_Height == std::max(srcLevel.m_Height / 2, 1u));
+
+        const size_t dstPixelCount = (size_t)dstLevel.m_Width * dstLevel.m_Height;
+        dstPixels.resize(dstPixelCount * 4);
+        Downsample(srcPixels.data(), srcLevel.m_Width, srcLevel.m_Height,
+            dstPixels.data(), dstLevel.m_Width, dstLevel.m_Height);
+        if((m_Flags & FLAG_NORMAL_MAP) != 0)
+            Renormalize(dstPixels.data(), dstPixelCount);
+
+        // Scaled alpha is only written to the level, next level is filtered from the unscaled one.
+        const float alphaScale = preserveCoverage ?
+            FindAlphaScale(dstPixels.data(), dstPixelCount, desiredCoverage) : 1.f;
+        Encode(dstPixels.data(), dstLevel, alphaScale);
+
+        std::swap(srcPixels, dstPixels);
+    }
+}
+
+void MipmapGenerator::Decode(const Level& level, float* dst) const
+{
+    const float* const SRGBToLinear = GetSRGBToLinearTable();
+    const bool sRGB = (m_Flags & FLAG_SRGB) != 0;
+    ParallelForRows(level.m_Height, level.m_Width, [&](uint32_t beginRow, uint32_t endRow)
+    {
+        for(uint32_t y = beginRow; y < endRow; ++y)
+        {
+            const uint8_t* srcRow = level.m_Pixels + y * level.m_RowPitch;
+            float* dstRow = dst + (size_t)y * level.m_Width * 4;
+            for(uint32_t x = 0; x < level.m_Width; ++x, srcRow += 4, dstRow += 4)
+            {
+                if(sRGB)
+                {
+                    dstRow[0] = SRGBToLinear[srcRow[0]];
+                    dstRow[1] = SRGBToLinear[srcRow[1]];
+                    dstRow[2] = SRGBToLinear[srcRow[2]];
+                }
+                else
+                {
+                    dstRow[0] = (float)srcRow[0] * (1.f / 255.f);
+                    dstRow[1] = (float)srcRow[1] * (1.f / 255.f);
+                    dstRow[2] = (float)srcRow[2] * (1.f / 255.f);
+                }
+                dstRow[3] = (float)srcRow[3] * (1.f / 255.f);
+            }
+        }
+    });
+}
+
+void MipmapGenerator::Encode(const float* src, const Level& level, float alphaScale) const
+{
+    const uint8_t* const linearToSRGB = GetLinearToSRGBTable();
+    const bool sRGB = (m_Flags & FLAG_SRGB) != 0;
+    ParallelForRows(level.m_Height, level.m_Width, [&](uint32_t beginRow, uint32_t endRow)
+    {
+        for(uint32_t y = beginRow; y < endRow; ++y)
+        {
+            const float* srcRow = src + (size_t)y * level.m_Width * 4;
+            uint8_t* dstRow = level.m_Pixels + y * level.m_RowPitch;
+            for(uint32_t x = 0; x < level.m_Width; ++x, srcRow += 4, dstRow += 4)
+            {
+                if(sRGB)
+                {
+                    for(uint32_t c = 0; c < 3; ++c)
+                    {
+                        const float v = std::clamp(srcRow[c], 0.f, 1.f);
+                        dstRow[c] = linearToSRGB[(uint32_t)(v * (float)(LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+                    }
+                }
+                else
+                {
+                    dstRow[0] = UnormToByte(srcRow[0]);
+                    dstRow[1] = UnormToByte(srcRow[1]);
+                    dstRow[2] = UnormToByte(srcRow[2]);
+                }
+                dstRow[3] = UnormToByte(srcRow[3] * alphaScale);
+            }
+        }
+    });
+}
+
+/*
+Even size: 2 taps of 1/2, a box filter. Odd size 2n+1 goes to n, so a destination pixel covers 2 + 1/n
+source pixels: 3 taps weighted by how much of each one it covers, (n-x)/(2n+1), n/(2n+1), (x+1)/(2n+1).
+This way the last row/column contributes like the others instead of being dropped. Size 1 stays 1.
+*/
+static void CalculateDownsampleTaps(uint32_t srcSize, uint32_t dstSize, std::vector<DownsampleTaps>& outTaps)
+{
+    assert(dstSize == std::max(srcSize / 2, 1u));
+    outTaps.resize(dstSize);
+    const float oddWeightScale = 1.f / (float)srcSize;
+    for(uint32_t x = 0; x < dstSize; ++x)
+    {
+        if(srcSize == 1)
+            outTaps[x] = {0, 1, {1.f, 0.f, 0.f}};
+        else if(srcSize % 2 == 0)
+            outTaps[x] = {x * 2, 2, {0.5f, 0.5f, 0.f}};
+        else
+        {
+            outTaps[x] = {x * 2, 3, {
+                (float)(dstSize - x) * oddWeightScale,
+                (float)dstSize * oddWeightScale,
+                (float)(x + 1) * oddWeightScale}};
+        }
+    }
+}
+
+void MipmapGenerator::Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight,
+    float* dst, uint32_t dstWidth, uint32_t dstHeight)
+{
+    std::vector<DownsampleTaps> rowTaps, columnTaps;
+    CalculateDownsampleTaps(srcHeight, dstHeight, rowTaps);
+    CalculateDownsampleTaps(srcWidth, dstWidth, columnTaps);
+
+    ParallelForRows(dstHeight, dstWidth, [&](uint32_t beginRow, uint32_t endRow)
+    {
+        for(uint32_t y = beginRow; y < endRow; ++y)
+        {
+            const DownsampleTaps& rowTap = rowTaps[y];
+            const float* const firstSrcRow = src + (size_t)rowTap.m_First * srcWidth * 4;
+            float* dstRow = dst + (size_t)y * dstWidth * 4;
+            uint32_t x = 0;
+#if defined(__AVX2__)
+            // Both sizes even: 2x2 box filter, 2 destination pixels from 4x2 source pixels per iteration.
+            if(rowTap.m_Count == 2 && srcWidth % 2 == 0)
+            {
+                const float* const srcRow0 = firstSrcRow;
+                const float* const srcRow1 = firstSrcRow + (size_t)srcWidth * 4;
+                const __m256 quarter = _mm256_set1_ps(0.25f);
+                for(; x + 1 < dstWidth; x += 2)
+                {
+                    const __m256 sum01 = _mm256_add_ps(_mm256_loadu_ps(srcRow0 + x * 8), _mm256_loadu_ps(srcRow1 + x * 8));
+                    const __m256 sum23 = _mm256_add_ps(_mm256_loadu_ps(srcRow0 + x * 8 + 8), _mm256_loadu_ps(srcRow1 + x * 8 + 8));
+                    // sum01 = [p0 | p1], sum23 = [p2 | p3] -> [p0 + p1 | p2 + p3]
+                    const __m256 even = _mm256_permute2f128_ps(sum01, sum23, 0x20);
+                    const __m256 odd = _mm256_permute2f128_ps(sum01, sum23, 0x31);
+                    _mm256_storeu_ps(dstRow + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), quarter));
+                }
+            }
+#endif
+            for(; x < dstWidth; ++x)
+            {
+                const DownsampleTaps& columnTap = columnTaps[x];
+                float sum[4] = {};
+                for(uint32_t tapY = 0; tapY < rowTap.m_Count; ++tapY)
+                {
+                    const float* const srcRow = firstSrcRow + (size_t)tapY * srcWidth * 4;
+                    for(uint32_t tapX = 0; tapX < columnTap.m_Count; ++tapX)
+                    {
+                        const float weight = rowTap.m_Weights[tapY] * columnTap.m_Weights[tapX];
+                        const float* const srcPixel = srcRow + (size_t)(columnTap.m_First + tapX) * 4;
+                        for(uint32_t c = 0; c < 4; ++c)
+                            sum[c] += srcPixel[c] * weight;
+                    }
+                }
+                for(uint32_t c = 0; c < 4; ++c)
+                    dstRow[x * 4 + c] = sum[c];
+            }
+        }
+    });
+}
+
+void MipmapGenerator::Renormalize(float* pixels, size_t pixelCount)
+{
+    for(size_t i = 0; i < pixelCount; ++i, pixels += 4)
+    {
+        float n[3] = {pixels[0] * 2.f - 1.f, pixels[1] * 2.f - 1.f, pixels[2] * 2.f - 1.f};
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(length > 0.f)
+        {
+            for(uint32_t c = 0; c < 3; ++c)
+                n[c] /= length;
+        }
+        else
+        {
+            n[0] = 0.f;
+            n[1] = 0.f;
+            n[2] = 1.f;
+        }
+        for(uint32_t c = 0; c < 3; ++c)
+            pixels[c] = n[c] * 0.5f + 0.5f;
+    }
+}
+
+float MipmapGenerator::CalculateAlphaCoverage(const float* pixels, size_t pixelCount, float alphaScale) const
+{
+    if(pixelCount == 0)
+        return 0.f;
+    size_t passedCount = 0;
+    for(size_t i = 0; i < pixelCount; ++i)
+    {
+        if(pixels[i * 4 + 3] * alphaScale >= m_AlphaCutoff)
+            ++passedCount;
+    }
+    return (float)passedCount / (float)pixelCount;
+}
+
+float MipmapGenerator::FindAlphaScale(const float* pixels, size_t pixelCount, float desiredCoverage) const
+{
+    // Binary search, as coverage grows with scale.
+    float minScale = 0.f;
+    float maxScale = 4.f;
+    float bestScale = 1.f;
+    float bestError = std::fabs(CalculateAlphaCoverage(pixels, pixelCount, 1.f) - desiredCoverage);
+    for(uint32_t i = 0; i < 10; ++i)
+    {
+        const float scale = (minScale + maxScale) * 0.5f;
+        const float coverage = CalculateAlphaCoverage(pixels, pixelCount, scale);
+        const float error = std::fabs(coverage - desiredCoverage);
+        if(error < bestError)
+        {
+            bestError = error;
+            bestScale = scale;
+        }
+        if(coverage < desiredCoverage)
+            minScale = scale;
+        else if(coverage > desiredCoverage)
+            maxScale = scale;
+        else
+            break;
+    }
+    return bestScale;
+}
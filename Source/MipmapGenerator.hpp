@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+Generates mip levels of a texture on the CPU, using multiple threads and AVX2 when available.
+Works on 8-bit pixels with 4 channels, alpha last, e.g. DXGI_FORMAT_R8G8B8A8_UNORM(_SRGB)
+or DXGI_FORMAT_B8G8R8A8_UNORM(_SRGB).
+
+Each level is calculated from the previous one, kept in floats to avoid accumulating quantization error.
+Along an even dimension, the filter is a 2-tap box. Along an odd one, 3 taps weighted by the area
+each source pixel covers, so the last row or column is not dropped.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+class MipmapGenerator
+{
+public:
+    enum FLAGS
+    {
+        // Color channels are sRGB, filtered in linear space. Alpha is always linear.
+        FLAG_SRGB = 0x1,
+        // RGB contains normals encoded as 0..1. Filtered normals are renormalized.
+        FLAG_NORMAL_MAP = 0x2,
+        // Scales alpha of each level so the fraction of pixels passing alpha test
+        // with alphaCutoff stays the same as in level 0.
+        FLAG_PRESERVE_ALPHA_COVERAGE = 0x4,
+    };
+
+    struct Level
+    {
+        uint8_t* m_Pixels;
+        uint32_t m_Width;
+        uint32_t m_Height;
+        size_t m_RowPitch;
+    };
+
+    MipmapGenerator(uint32_t flags, float alphaCutoff = 0.5f);
+    // levels[0] is the source, read only. levels[1..] are written.
+    // Size of each level must be max(1, size of previous level / 2).
+    void Generate(std::span<const Level> levels);
+
+private:
+    const uint32_t m_Flags;
+    const float m_AlphaCutoff;
+
+    void Decode(const Level& level, float* dst) const;
+    void Encode(const float* src, const Level& level, float alphaScale) const;
+    static void Downsample(const float* src, uint32_t srcWidth, uint32_t srcHeight,
+        float* dst, uint32_t dstWidth, uint32_t dstHeight);
+    static void Renormalize(float* pixels, size_t pixelCount);
+    float CalculateAlphaCoverage(const float* pixels, size_t pixelCount, float alphaScale) const;
+    float FindAlphaScale(const float* pixels, size_t pixelCount, float desiredCoverage) const;
+};
@@ -1,5 +1,18 @@
 #pragma once
 
+/*
+Allocators of per-frame memory in a ring buffer, used by ConstantBufferManager and DescriptorManager.
+*/
+
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+
+// Maximum frameCount of Init. Not less than MAX_FRAME_COUNT of the engine, which is not visible here.
+static constexpr uint32_t RING_BUFFER_MAX_FRAME_COUNT = 10;
+
 /*
 An abstract algorithm that ensures linear allocation of anything of various size
 in a ring-buffer fashion with a twist that calling NewFrame() bulk-frees memory
@@ -11,7 +24,7 @@ class MultiFrameRingBuffer
 public:
     void Init(T capacity, uint32_t frameCount)
     {
-        assert(m_FrameCount == 0 && frameCount > 0);
+        assert(m_FrameCount == 0 && frameCount > 0 && frameCount <= RING_BUFFER_MAX_FRAME_COUNT);
         m_Capacity = capacity;
         m_FrameCount = frameCount;
     }
@@ -113,7 +126,203 @@ private:
     T m_Back = 0;
     T m_Front = 0;
     T m_Size = 0;
-    T m_PerFrameSize[MAX_FRAME_COUNT] = {};
+    T m_PerFrameSize[RING_BUFFER_MAX_FRAME_COUNT] = {};
     uint32_t m_FrameCount = 0;
     uint32_t m_FrameIndex = 0;
 };
+
+/*
+Thread-safe variant of MultiFrameRingBuffer: Allocate can be called from multiple threads at once.
+NewFrame must not run concurrently with Allocate - call it between frames, after all recording threads finished.
+
+Threads reserve space by atomic fetch-add on the shared front, in whole chunks of chunkSize units.
+Each thread keeps the rest of its chunk in a thread-local cache and serves following small allocations
+from it, so most allocations touch no shared cache line. Allocations bigger than a chunk are reserved
+directly, rounded up to whole chunks.
+
+Front, back and frame ends are logical 64-bit offsets that only grow - physical offset is logical
+modulo capacity. Capacity is rounded down to a multiple of chunkSize, so a single chunk never crosses
+the end of the buffer. A multi-chunk reservation that would cross it is wasted and retried.
+Every allocation is contiguous and starts at a multiple of chunkSize plus sizes of previous allocations
+from the same chunk, so if chunkSize and all sizes are multiples of some alignment, offsets are aligned too.
+
+Unused rest of a chunk, e.g. when a thread stops allocating or a new frame starts, is wasted until its
+frame is retired - at most one chunk per thread per frame, so chunkSize should be small relative to capacity.
+*/
+template<typename T>
+class ConcurrentMultiFrameRingBuffer
+{
+public:
+    ConcurrentMultiFrameRingBuffer() :
+        m_InstanceId(++s_LastInstanceId)
+    {
+    }
+
+    void Init(T capacity, uint32_t frameCount, T chunkSize)
+    {
+        assert(m_FrameCount == 0 && frameCount > 0 && frameCount <= RING_BUFFER_MAX_FRAME_COUNT);
+        assert(chunkSize > 0 && capacity >= chunkSize);
+        m_ChunkSize = chunkSize;
+        m_Capacity = capacity - capacity % chunkSize;
+        m_FrameCount = frameCount;
+    }
+
+    void NewFrame()
+    {
+        const uint64_t front = m_Front.load(std::memory_order_relaxed);
+        m_LastFrameSize = front - m_FrameEnds[(m_FrameIndex + m_FrameCount - 1) % m_FrameCount];
+        m_FrameEnds[m_FrameIndex] = front;
+        m_FrameIndex = (m_FrameIndex + 1) % m_FrameCount;
+        // Frees everything allocated during frame (current - FrameCount).
+        m_Back = m_FrameEnds[m_FrameIndex];
+        // Invalidates chunks cached by all threads.
+        ++m_FrameNumber;
+    }
+
+    /*
+    Frees everything and changes capacity, e.g. when the owner replaced the memory behind the buffer.
+    Like NewFrame, must not run concurrently with Allocate. The old memory is the owner's responsibility -
+    it stays in use by the last FrameCount frames.
+    */
+    void Reset(T capacity)
+    {
+        assert(m_FrameCount > 0 && capacity >= m_ChunkSize);
+        m_Capacity = capacity - capacity % m_ChunkSize;
+        m_Front.store(0, std::memory_order_relaxed);
+        m_Back = 0;
+        std::fill(std::begin(m_FrameEnds), std::end(m_FrameEnds), 0);
+        ++m_FrameNumber;
+    }
+
+    T GetCapacity() const { return m_Capacity; }
+    // Space taken during the frame closed by the last NewFrame, including unused rest of chunks.
+    uint64_t GetLastFrameSize() const { return m_LastFrameSize; }
+
+    bool Allocate(T size, T& outOffset)
+    {
+        if(size > m_Capacity)
+            return false;
+
+        ThreadCache& cache = s_ThreadCaches[m_InstanceId % THREAD_CACHE_SLOT_COUNT];
+        if(cache.m_InstanceId != m_InstanceId || cache.m_FrameNumber != m_FrameNumber)
+            cache = ThreadCache{.m_InstanceId = m_InstanceId, .m_FrameNumber = m_FrameNumber};
+
+        // Fast path: the rest of the chunk of this thread.
+        if(size <= cache.m_End - cache.m_Begin)
+        {
+            outOffset = (T)(cache.m_Begin % m_Capacity);
+            cache.m_Begin += size;
+            return true;
+        }
+
+        uint64_t begin = 0;
+        if(size <= m_ChunkSize)
+        {
+            if(!Reserve(m_ChunkSize, begin))
+                return false;
+            cache.m_Begin = begin + size;
+            cache.m_End = begin + m_ChunkSize;
+        }
+        // chunkSize doesn't need to be a power of 2.
+        else if(!Reserve(((uint64_t)size + m_ChunkSize - 1) / m_ChunkSize * m_ChunkSize, begin))
+            return false;
+        outOffset = (T)(begin % m_Capacity);
+        return true;
+    }
+
+private:
+    // Remaining part of the current chunk of one thread in one buffer.
+    struct ThreadCache
+    {
+        uint64_t m_InstanceId = 0;
+        uint64_t m_FrameNumber = 0;
+        // Logical offsets.
+        uint64_t m_Begin = 0;
+        uint64_t m_End = 0;
+    };
+    // Direct-mapped by instance ID. Buffers that collide just evict each other's chunk.
+    static constexpr size_t THREAD_CACHE_SLOT_COUNT = 8;
+    static inline thread_local ThreadCache s_ThreadCaches[THREAD_CACHE_SLOT_COUNT] = {};
+    // Unique for every buffer ever created, so a cache never matches a new buffer at the same address.
+    static inline std::atomic<uint64_t> s_LastInstanceId = 0;
+
+    const uint64_t m_InstanceId;
+    T m_Capacity = 0;
+    T m_ChunkSize = 0;
+    uint32_t m_FrameCount = 0;
+    // Members below, except m_Front, change only in NewFrame.
+    uint32_t m_FrameIndex = 0;
+    uint64_t m_FrameNumber = 0;
+    uint64_t m_Back = 0;
+    uint64_t m_FrameEnds[RING_BUFFER_MAX_FRAME_COUNT] = {};
+    uint64_t m_LastFrameSize = 0;
+    // On its own cache line, as it is the only member written by allocating threads.
+    alignas(64) std::atomic<uint64_t> m_Front = 0;
+
+    // size must be multiply of m_ChunkSize. Returns logical offset of a range that doesn't cross the end of the buffer.
+    bool Reserve(uint64_t size, uint64_t& outBegin)
+    {
+        for(;;)
+        {
+            const uint64_t begin = m_Front.fetch_add(size, std::memory_order_relaxed);
+            const uint64_t end = begin + size;
+            if(end > m_Back + m_Capacity)
+            {
+                /*
+                Out of space. Give the range back unless other threads reserved after it - then it stays
+                wasted until this frame is retired. All reservations after this one fail too, as m_Back
+                doesn't change during the frame, so none of them can be overwritten by the rollback.
+                */
+                uint64_t expected = end;
+                m_Front.compare_exchange_strong(expected, begin, std::memory_order_relaxed);
+                return false;
+            }
+            if(begin / m_Capacity == (end - 1) / m_Capacity)
+            {
+                outBegin = begin;
+                return true;
+            }
+            // Crosses the end of the buffer: the range is wasted, try again after it.
+        }
+    }
+};
+
+/*
+Usage of a per-frame allocator over recent frames, e.g. bytes of temporary constant buffers,
+to size it based on what frames really need instead of a fixed maximum.
+*/
+class FrameUsageHistory
+{
+public:
+    // Number of recent frames the rolling maximum is calculated from.
+    static constexpr uint32_t WINDOW_SIZE = 256;
+
+    void Push(uint64_t usage)
+    {
+        m_Values[m_NextIndex] = usage;
+        m_NextIndex = (m_NextIndex + 1) % WINDOW_SIZE;
+        m_Count = std::min(m_Count + 1, WINDOW_SIZE);
+        m_Peak = std::max(m_Peak, usage);
+    }
+    // Forgets recent frames, e.g. after resizing, but not the peak.
+    void ClearWindow() { m_Count = 0; }
+
+    // Number of frames in the window, up to WINDOW_SIZE.
+    uint32_t GetCount() const { return m_Count; }
+    uint64_t GetLast() const { return m_Count ? m_Values[(m_NextIndex + WINDOW_SIZE - 1) % WINDOW_SIZE] : 0; }
+    uint64_t GetRollingMax() const
+    {
+        uint64_t result = 0;
+        for(uint32_t i = 0; i < m_Count; ++i)
+            result = std::max(result, m_Values[(m_NextIndex + WINDOW_SIZE - 1 - i) % WINDOW_SIZE]);
+        return result;
+    }
+    // Maximum since the start of the application.
+    uint64_t GetPeak() const { return m_Peak; }
+
+private:
+    uint64_t m_Values[WINDOW_SIZE] = {};
+    uint32_t m_NextIndex = 0;
+    uint32_t m_Count = 0;
+    uint64_t m_Peak = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+
+/*
+Calls func(index) for every index in [0, count), using up to threadCount threads, including the
+current one. Threads take indices one by one from a shared counter, so items that take
+different time, e.g. shader permutations, are balanced automatically. Returns when all are done.
+
+func must not throw - catch exceptions inside and store the result per index.
+threadCount = 0 means std::thread::hardware_concurrency().
+*/
+template<typename Func>
+void ParallelFor(size_t count, uint32_t threadCount, const Func& func)
+{
+    if(threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = (uint32_t)std::min<size_t>(threadCount, count);
+    if(threadCount <= 1)
+    {
+        for(size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    std::atomic<size_t> nextIndex = 0;
+    auto threadMain = [&]()
+    {
+        for(size_t i = nextIndex++; i < count; i = nextIndex++)
+            func(i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for(uint32_t i = 0; i < threadCount - 1; ++i)
+        threads.emplace_back(threadMain);
+    threadMain();
+    for(auto& t : threads)
+        t.join();
+}
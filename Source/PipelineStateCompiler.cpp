@@ -0,0 +1,107 @@
+#include "BaseUtils.hpp"
+#include "PipelineStateCompiler.hpp"
+#include "LoadProfiler.hpp"
+#include <algorithm>
+
+PipelineStateCompiler::~PipelineStateCompiler()
+{
+    Stop();
+}
+
+void PipelineStateCompiler::Start(CreateFunc&& createFunc)
+{
+    assert(!IsStarted());
+    m_CreateFunc = std::move(createFunc);
+    m_StopRequested = false;
+    m_Thread = std::thread([this]()
+    {
+        SetThreadName(GetCurrentThreadId(), "PSO COMPILER");
+        ThreadMain();
+    });
+}
+
+void PipelineStateCompiler::Stop()
+{
+    if(!IsStarted())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_StopRequested = true;
+    }
+    m_Condition.notify_one();
+    m_Thread.join();
+
+    m_Queue.clear();
+    m_Completed.clear();
+    m_CreateFunc = nullptr;
+}
+
+void PipelineStateCompiler::Request(uint32_t key)
+{
+    assert(IsStarted());
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if(IsKeyPending(key))
+            return;
+        m_Queue.push_back(key);
+    }
+    m_Condition.notify_one();
+}
+
+void PipelineStateCompiler::TakeCompleted(std::pmr::vector<Result>& outResults)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for(Result& result : m_Completed)
+        outResults.push_back(std::move(result));
+    m_Completed.clear();
+}
+
+PipelineStateCompiler::Statistics PipelineStateCompiler::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return Statistics{
+        .m_PendingCount = (uint32_t)m_Queue.size() + (m_Busy ? 1u : 0u),
+        .m_CompiledCount = m_CompiledCount,
+        .m_FailedCount = m_FailedCount};
+}
+
+bool PipelineStateCompiler::IsKeyPending(uint32_t key) const
+{
+    if(m_Busy && m_CurrentKey == key)
+        return true;
+    if(std::find(m_Queue.begin(), m_Queue.end(), key) != m_Queue.end())
+        return true;
+    return std::find_if(m_Completed.begin(), m_Completed.end(),
+        [key](const Result& result) { return result.first == key; }) != m_Completed.end();
+}
+
+void PipelineStateCompiler::ThreadMain()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for(;;)
+    {
+        m_Condition.wait(lock, [this]() { return !m_Queue.empty() || m_StopRequested; });
+        if(m_StopRequested)
+            break;
+
+        m_CurrentKey = m_Queue.front();
+        m_Queue.pop_front();
+        m_Busy = true;
+        lock.unlock();
+
+        ComPtr<ID3D12PipelineState> pso;
+        try
+        {
+            PROFILE_LOAD_SCOPE("PipelineStateCompiler");
+            pso = m_CreateFunc(m_CurrentKey);
+        } CATCH_PRINT_ERROR(pso.Reset();)
+
+        lock.lock();
+        if(pso)
+            ++m_CompiledCount;
+        else
+            ++m_FailedCount;
+        m_Completed.push_back({m_CurrentKey, std::move(pso)});
+        m_Busy = false;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+/*
+Creates pipeline states on a background thread, so a draw needing a PSO that doesn't exist yet
+doesn't stall the frame. PSOs are identified by a key, e.g. combination of material flags,
+and created by a function given to Start, which must be safe to call from that thread.
+
+Request coalesces duplicates: a key already queued, being created or completed and not taken
+yet is not queued again. The owner takes completed PSOs with TakeCompleted, typically once per frame,
+and uses a fallback PSO or skips the draw until then.
+*/
+class PipelineStateCompiler
+{
+public:
+    // Can throw - the error is printed and the key is completed with null PSO.
+    using CreateFunc = std::function<ComPtr<ID3D12PipelineState>(uint32_t key)>;
+    using Result = std::pair<uint32_t, ComPtr<ID3D12PipelineState>>;
+
+    struct Statistics
+    {
+        // Queued or being created.
+        uint32_t m_PendingCount = 0;
+        uint64_t m_CompiledCount = 0;
+        uint64_t m_FailedCount = 0;
+    };
+
+    ~PipelineStateCompiler();
+
+    void Start(CreateFunc&& createFunc);
+    // Waits for the PSO being created, discards queued requests and completed results.
+    void Stop();
+    bool IsStarted() const { return m_Thread.joinable(); }
+
+    // Doesn't wait.
+    void Request(uint32_t key);
+    // Appends PSOs completed since the last call. Null PSO means creation failed.
+    void TakeCompleted(std::pmr::vector<Result>& outResults);
+
+    Statistics GetStatistics();
+
+private:
+    CreateFunc m_CreateFunc;
+    std::thread m_Thread;
+
+    // Protects members below.
+    std::mutex m_Mutex;
+    // Signaled when there is a request or stop for m_Thread.
+    std::condition_variable m_Condition;
+    std::deque<uint32_t> m_Queue;
+    // Key being created by m_Thread, valid when m_Busy.
+    uint32_t m_CurrentKey = 0;
+    bool m_Busy = false;
+    std::vector<Result> m_Completed;
+    bool m_StopRequested = false;
+    uint64_t m_CompiledCount = 0;
+    uint64_t m_FailedCount = 0;
+
+    void ThreadMain();
+    // Called with m_Mutex locked.
+    bool IsKeyPending(uint32_t key) const;
+};
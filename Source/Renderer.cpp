@@ -3,6 +3,10 @@
 #include "CommandList.hpp"
 #include "RenderingResource.hpp"
 #include "Texture.hpp"
+#include "TextureArrayPacker.hpp"
+#include "AssetPack.hpp"
+#include "LoadProfiler.hpp"
+#include "TextureStreaming.hpp"
 #include "Mesh.hpp"
 #include "ConstantBuffers.hpp"
 #include "Shaders.hpp"
@@ -11,6 +15,10 @@
 #include "AssimpUtils.hpp"
 #include "ImGuiUtils.hpp"
 #include "Streams.hpp"
+#include "ParallelFor.hpp"
+#include "PipelineStateCompiler.hpp"
+#include "FrameArena.hpp"
+#include "HeapAllocationCounter.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -90,8 +98,12 @@ static UintSetting g_RTVPersistentDescriptorMaxCount(SettingCategory::Startup,
     "RTVDescriptors.Persistent.MaxCount", 0);
 static UintSetting g_DSVPersistentDescriptorMaxCount(SettingCategory::Startup,
     "DSVDescriptors.Persistent.MaxCount", 0);
+static UintSetting g_FrameArenaBlockSize(SettingCategory::Startup, "FrameArena.BlockSize", 256 * 1024);
+// 0 = never, 1 = in Debug configuration, 2 = always.
+static UintSetting g_CheckHeapAllocations(SettingCategory::Startup, "Renderer.CheckHeapAllocations", 1);
 // 0 = anisotropic filtering disabled, 1..16 = D3D12_SAMPLER_DESC::MaxAnisotropy.
 static UintSetting g_MaxAnisotropy(SettingCategory::Startup, "MaxAnisotropy", 16);
+static BoolSetting g_BindlessEnabled(SettingCategory::Startup, "Renderer.Bindless.Enabled", false);
 
 static BoolSetting g_AssimpPrintSceneInfo(SettingCategory::Load, "Assimp.PrintSceneInfo", false);
 static UintSetting g_SyncInterval(SettingCategory::Runtime, "SyncInterval", 1);
@@ -103,6 +115,19 @@ static MatSetting<mat4> g_AssimpTransform(SettingCategory::Load, "Assimp.Transfo
 static BoolSetting g_AssimpNegateBitangent(SettingCategory::Load, "Assimp.NegateBitangent", true);
 static BoolSetting g_AssimpUseOptimizingFlags(SettingCategory::Load, "Assimp.UseOptimizingFlags", false);
 static UintSetting g_BackFaceCullingMode(SettingCategory::Load, "BackFaceCullingMode", 0);
+static BoolSetting g_TextureCompressionEnabled(SettingCategory::Load, "Textures.Compression.Enabled", true);
+// Use BC7 instead of BC1/BC3 for color textures. Better quality, much slower to encode.
+static BoolSetting g_TextureCompressionHighQuality(SettingCategory::Load, "Textures.Compression.HighQuality", false);
+static BoolSetting g_TextureStreamingEnabled(SettingCategory::Load, "Textures.Streaming.Enabled", true);
+static BoolSetting g_TextureArraysEnabled(SettingCategory::Load, "Textures.Arrays.Enabled", true);
+static UintSetting g_TextureArraysMaxSize(SettingCategory::Load, "Textures.Arrays.MaxSize", 256);
+static BoolSetting g_ShadersPrecompileEnabled(SettingCategory::Load, "Shaders.Precompile.Enabled", true);
+static BoolSetting g_ShadersPrecompileAllPermutations(SettingCategory::Load, "Shaders.Precompile.AllPermutations", false);
+static UintSetting g_ShadersPrecompileThreadCount(SettingCategory::Load, "Shaders.Precompile.ThreadCount", 0);
+static BoolSetting g_AsyncPipelineStatesEnabled(SettingCategory::Load, "Renderer.AsyncPipelineStates.Enabled", true);
+static BoolSetting g_AsyncPipelineStatesUseFallback(SettingCategory::Load, "Renderer.AsyncPipelineStates.UseFallback", true);
+// Reload defragments persistent descriptors of a heap with fragmentation above this, 0..1. 1 = never.
+static FloatSetting g_DescriptorDefragmentationThreshold(SettingCategory::Load, "Descriptors.DefragmentationThreshold", 0.5f);
 
 static Vec4ColorSetting g_BackgroundColor(SettingCategory::Runtime, "Background.Color", vec4(0.f, 0.f, 0.f, 1.f));
 static VecSetting<vec3> g_DirectionToLight(SettingCategory::Load, "DirectionToLight", vec3(0.f, 1.f, 0.f));
@@ -166,22 +191,53 @@ struct PerFrameConstants
     uint32_t _padding3;
 };
 
+// Set as root constants, see StandardRootSignature.
+struct PerDrawConstants
+{
+    uint32_t m_ObjectIndex;
+    uint32_t m_MaterialIndex;
+};
+static_assert(sizeof(PerDrawConstants) == StandardRootSignature::PER_DRAW_CONSTANT_COUNT * sizeof(uint32_t));
+
+// Element of StructuredBuffer perObjectConstants.
 struct PerObjectConstants
 {
     packed_mat4 m_WorldViewProj;
     packed_mat4 m_WorldView;
 };
 
+// Non-bindless path. Element of StructuredBuffer perMaterialConstants.
 struct PerMaterialConstants
 {
     uint32_t m_Flags;
     float m_AlphaCutoff;
-    uint32_t _padding0[2];
+    uint32_t m_AlbedoTextureSlice;
+    uint32_t m_NormalTextureSlice;
 
     packed_vec3 m_Color;
     uint32_t _padding1;
 };
 
+// Bindless path. Element of StructuredBuffer materialRecords, see BindlessMaterialTable.
+struct MaterialRecord
+{
+    uint32_t m_Flags;
+    float m_AlphaCutoff;
+    uint32_t m_AlbedoTextureSlice;
+    uint32_t m_NormalTextureSlice;
+
+    packed_vec3 m_Color;
+    uint32_t m_AlbedoTextureIndex;
+
+    uint32_t m_NormalTextureIndex;
+    uint32_t m_AlbedoSamplerIndex;
+    uint32_t m_NormalSamplerIndex;
+    uint32_t _padding1;
+};
+// Compared with memcmp, so there must be no implicit padding.
+static_assert(sizeof(MaterialRecord) == 48);
+
+// Element of StructuredBuffer g_Lights.
 struct LightConstants
 {
     packed_vec3 m_Color;
@@ -248,11 +304,13 @@ void AssimpLogStream::write(const char* message)
     LogInfo(ConvertCharsToUnicode(message, CP_ACP));
 }
 
-StandardRootSignature::StandardRootSignature()
+StandardRootSignature::StandardRootSignature(bool bindless)
 {
-    constexpr uint32_t PARAM_COUNT = CBV_COUNT + SRV_COUNT + SAMPLER_COUNT;
-    D3D12_DESCRIPTOR_RANGE descRanges[PARAM_COUNT];
-    D3D12_ROOT_PARAMETER params[PARAM_COUNT];
+    constexpr uint32_t BINDLESS_PARAM_COUNT = 2;
+    constexpr uint32_t PARAM_MAX_COUNT = CBV_COUNT + SRV_COUNT + SAMPLER_COUNT + 1 + PACKED_SRV_COUNT +
+        BINDLESS_PARAM_COUNT;
+    D3D12_DESCRIPTOR_RANGE descRanges[PARAM_MAX_COUNT];
+    D3D12_ROOT_PARAMETER params[PARAM_MAX_COUNT];
     uint32_t paramIndex = 0;
     for(uint32_t CBVIndex = 0; CBVIndex < CBV_COUNT; ++CBVIndex, ++paramIndex)
     {
@@ -293,9 +351,57 @@ StandardRootSignature::StandardRootSignature()
                 .pDescriptorRanges = descRanges + paramIndex},
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL};
     }
+    assert(paramIndex == GetPerDrawConstantsParamIndex());
+    params[paramIndex] = {
+        .ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+        .Constants = {
+            .ShaderRegister = CBV_COUNT,
+            .Num32BitValues = PER_DRAW_CONSTANT_COUNT},
+        .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL};
+    ++paramIndex;
+    for(uint32_t packedSRVIndex = 0; packedSRVIndex < PACKED_SRV_COUNT; ++packedSRVIndex, ++paramIndex)
+    {
+        assert(paramIndex == GetPackedSRVParamIndex(packedSRVIndex));
+        params[paramIndex] = {
+            .ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV,
+            .Descriptor = {
+                .ShaderRegister = packedSRVIndex,
+                .RegisterSpace = 2},
+            .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL};
+    }
+    if(bindless)
+    {
+        assert(paramIndex == GetBindlessSRVParamIndex());
+        descRanges[paramIndex] = {
+            .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+            .NumDescriptors = UINT_MAX, // Unbounded
+            .BaseShaderRegister = 0,
+            .RegisterSpace = 1};
+        params[paramIndex] = {
+            .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+            .DescriptorTable = {
+                .NumDescriptorRanges = 1,
+                .pDescriptorRanges = descRanges + paramIndex},
+            .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL};
+        ++paramIndex;
+
+        assert(paramIndex == GetBindlessSamplerParamIndex());
+        descRanges[paramIndex] = {
+            .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER,
+            .NumDescriptors = (UINT)StandardSamplers::COUNT,
+            .BaseShaderRegister = 0,
+            .RegisterSpace = 1};
+        params[paramIndex] = {
+            .ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
+            .DescriptorTable = {
+                .NumDescriptorRanges = 1,
+                .pDescriptorRanges = descRanges + paramIndex},
+            .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL};
+        ++paramIndex;
+    }
 
 	D3D12_ROOT_SIGNATURE_DESC desc = {
-		.NumParameters = PARAM_COUNT,
+		.NumParameters = paramIndex,
         .pParameters = params,
 		.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
 			D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
@@ -323,6 +429,7 @@ void Renderer::Init()
     ERR_TRY;
 
     LogMessage(L"Initializing renderer...\n");
+    BeginLoadProfiling();
 
     CHECK_BOOL(g_FrameCount.GetValue() >= 2 && g_FrameCount.GetValue() <= MAX_FRAME_COUNT);
     CHECK_BOOL(g_SRVPersistentDescriptorMaxCount.GetValue() > 0);
@@ -331,6 +438,7 @@ void Renderer::Init()
     CHECK_BOOL(g_SamplerTemporaryDescriptorMaxCountPerFrame.GetValue() > 0);
     CHECK_BOOL(g_RTVPersistentDescriptorMaxCount.GetValue() > 0);
     CHECK_BOOL(g_DSVPersistentDescriptorMaxCount.GetValue() > 0);
+    CHECK_BOOL(g_FrameArenaBlockSize.GetValue() > 0);
 
     if(g_EnableExperimentalShaderModels.GetValue())
         D3D12EnableExperimentalFeatures(1, &D3D12ExperimentalShaderModels, nullptr, nullptr);
@@ -338,9 +446,18 @@ void Renderer::Init()
     if(g_D3D12DebugLayer_Enabled.GetValue())
         EnableDebugLayer();
 
+    m_FrameArena = std::make_unique<FrameArena>();
+    m_FrameArena->Init(g_FrameArenaBlockSize.GetValue(), g_FrameCount.GetValue());
+
 	CreateDevice();
     CreateMemoryAllocator();
 	LoadCapabilities();
+    m_BindlessEnabled = g_BindlessEnabled.GetValue();
+    if(m_BindlessEnabled && m_Capabilities.m_ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2)
+    {
+        LogWarning(L"Bindless path requires resource binding tier 2. Disabling it.");
+        m_BindlessEnabled = false;
+    }
     m_SRVDescriptorManager = std::make_unique<DescriptorManager>();
     m_SRVDescriptorManager->Init(
         D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
@@ -366,16 +483,15 @@ void Renderer::Init()
     m_StandardSamplers.Init();
     m_ShaderCompiler= std::make_unique<ShaderCompiler>();
     m_ShaderCompiler->Init();
+    m_TextureStreamer = std::make_unique<TextureStreamer>();
 
     {
-        wstr_view MACRO_NAMES[] = {
-            L"ALPHA_TEST",
-            L"HAS_MATERIAL_COLOR",
-            L"HAS_ALBEDO_TEXTURE",
-            L"HAS_NORMAL_TEXTURE",
-        };
+        // Macros and their order are defined in ShaderCommon.cpp, shared with Tools/ShaderCooker.
         m_GBufferMultiPixelShader = std::make_unique<MultiShader>();
-        m_GBufferMultiPixelShader->Init(ShaderType::Pixel, L"Shaders/GBuffer.hlsl", L"MainPS", MACRO_NAMES);
+        m_GBufferMultiPixelShader->Init(GetStandardShaderDesc(
+            m_BindlessEnabled ? StandardShader::GBufferBindlessPS : StandardShader::GBufferPS));
+        assert(m_GBufferMultiPixelShader->GetPermutationCount() * 2 == GBUFFER_PIPELINE_STATE_COUNT);
+        m_GBufferBackFaceCullingMode = g_BackFaceCullingMode.GetValue();
     }
 
 	CreateCommandQueues();
@@ -387,6 +503,10 @@ void Renderer::Init()
     
     m_AssimpInit = std::make_unique<AssimpInit>();
     LoadModel(false);
+    if(g_ShadersPrecompileEnabled.GetValue())
+        PrecompileGBufferPipelineStates();
+    if(g_AsyncPipelineStatesEnabled.GetValue())
+        StartGBufferPipelineStateCompiler();
     //CreateProceduralModel();
     
     //m_Camera = std::make_unique<OrbitingCamera>();
@@ -394,6 +514,8 @@ void Renderer::Init()
     m_Camera->SetAspectRatio(GetFinalResolutionF().x / GetFinalResolutionF().y);
     //m_Camera->SetDistance(3.f);
 
+    EndLoadProfiling();
+
     ERR_CATCH_MSG(L"Failed to initialize renderer.");
 }
 
@@ -409,26 +531,53 @@ Renderer::~Renderer()
 	    CATCH_PRINT_ERROR(;);
     }
 
+    StopGBufferPipelineStateCompiler();
     ClearModel();
 
     ShutdownImGui();
 
     for(uint32_t i = g_FrameCount.GetValue(); i--; )
+    {
+        m_FrameResources[i].m_RetiredAllocations.clear();
         m_FrameResources[i].m_BackBuffer.reset();
+    }
 }
 
 void Renderer::Reload(bool refreshAll)
 {
+    BeginLoadProfiling();
+
 	m_CmdQueue->Signal(m_Fence.Get(), m_NextFenceValue);
     WaitForFenceOnCPU(m_NextFenceValue++);
     
-    ClearGBufferShaders();
+    StopGBufferPipelineStateCompiler();
+    // Force-refresh recompiles all shaders. Normal refresh only those whose source files changed.
+    if(refreshAll)
+        ClearGBufferShaders();
+    else
+        InvalidateOutdatedGBufferShaders();
     ClearModel();
 
-    CreatePostprocessingPipelineState();
-    CreateLightingPipelineStates();
+    // Descriptors of the model are freed, so compact what is left before loading it again.
+    for(DescriptorManager* descMngr : GetDescriptorManagers())
+    {
+        if(descMngr->CalculateFragmentation() > g_DescriptorDefragmentationThreshold.GetValue())
+            descMngr->RequestDefragmentation();
+    }
+    DefragmentDescriptors();
+
+    if(refreshAll || !m_PostprocessingPipelineState || m_PostprocessingShaderDependencies.IsOutdated())
+        CreatePostprocessingPipelineState();
+    if(refreshAll || !m_AmbientPipelineState || !m_LightingPipelineState || m_LightingShaderDependencies.IsOutdated())
+        CreateLightingPipelineStates();
     LoadModel(refreshAll);
+    if(g_ShadersPrecompileEnabled.GetValue())
+        PrecompileGBufferPipelineStates();
+    if(g_AsyncPipelineStatesEnabled.GetValue())
+        StartGBufferPipelineStateCompiler();
     //CreateProceduralModel();
+
+    EndLoadProfiling();
 }
 
 uvec2 Renderer::GetFinalResolutionU()
@@ -450,6 +599,7 @@ void Renderer::BeginUploadCommandList(CommandList& dstCmdList)
 
 void Renderer::CompleteUploadCommandList(CommandList& cmdList)
 {
+    PROFILE_LOAD_SCOPE("Upload wait");
     cmdList.Execute(m_CmdQueue.Get());
 
 	m_UploadCmdListSubmittedFenceValue = m_NextFenceValue++;
@@ -481,14 +631,14 @@ void Renderer::ImGui_D3D12MAStatistics()
 
             ImGui::Text("Blocks: %u, %s",
                 b[i].Stats.BlockCount,
-                ConvertUnicodeToChars(SizeToStr(b[i].Stats.BlockBytes), CP_UTF8).c_str());
+                FrameSizeToStr(b[i].Stats.BlockBytes));
             ImGui::Text("Allocations: %u, %s (%.1f%%)",
                 b[i].Stats.AllocationCount,
-                ConvertUnicodeToChars(SizeToStr(b[i].Stats.AllocationBytes), CP_UTF8).c_str(),
+                FrameSizeToStr(b[i].Stats.AllocationBytes),
                 allocationBytesPercent);
             ImGui::TextColored(usageColor, "Budget: %s, usage: %s (%.1f%%)",
-                ConvertUnicodeToChars(SizeToStr(b[i].BudgetBytes), CP_UTF8).c_str(),
-                ConvertUnicodeToChars(SizeToStr(b[i].UsageBytes), CP_UTF8).c_str(),
+                FrameSizeToStr(b[i].BudgetBytes),
+                FrameSizeToStr(b[i].UsageBytes),
                 usagePercent);
             ImGui::TreePop();
         }
@@ -498,23 +648,147 @@ void Renderer::ImGui_D3D12MAStatistics()
         SaveD3D12MAJSONDump();
 }
 
+void Renderer::ImGui_TextureStreamingStatistics()
+{
+    m_TextureStreamer->ImGui();
+
+    uint64_t textureSize = 0, textureArraySize = 0, meshSize = 0;
+    for(const Scene::Texture& tex : m_Textures)
+    {
+        if(tex.m_Texture)
+            textureSize += tex.m_Texture->GetAllocatedSize();
+    }
+    for(const unique_ptr<Texture>& tex : m_TextureArrays)
+        textureArraySize += tex->GetAllocatedSize();
+    for(const Scene::Mesh& mesh : m_Meshes)
+    {
+        if(mesh.m_Mesh)
+            meshSize += mesh.m_Mesh->GetAllocatedSize();
+    }
+    ImGui::Text("Scene GPU memory: textures %s, texture arrays %s, meshes %s",
+        FrameSizeToStr(textureSize),
+        FrameSizeToStr(textureArraySize),
+        FrameSizeToStr(meshSize));
+}
+
+void Renderer::ImGui_PipelineStateStatistics()
+{
+    const size_t createdCount = std::count_if(m_GBufferPipelineStates.begin(), m_GBufferPipelineStates.end(),
+        [](const GBufferPipelineState& state) { return state.m_PipelineState != nullptr; });
+    ImGui::Text("G-buffer PSOs: %zu of %u", createdCount, GBUFFER_PIPELINE_STATE_COUNT);
+    if(m_GBufferPipelineStateCompiler && m_GBufferPipelineStateCompiler->IsStarted())
+    {
+        const PipelineStateCompiler::Statistics stats = m_GBufferPipelineStateCompiler->GetStatistics();
+        ImGui::Text("Background compilation: pending %u, compiled %llu, failed %llu",
+            stats.m_PendingCount, stats.m_CompiledCount, stats.m_FailedCount);
+        ImGui::Text("Draws using fallback PSO: %u", m_GBufferFallbackDrawCount);
+    }
+    else
+        ImGui::Text("Background compilation disabled.");
+}
+
+void Renderer::ImGui_TemporaryAllocatorStatistics()
+{
+    if(ImGui::TreeNodeEx("Frame arena", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        m_FrameArena->ImGui();
+        ImGui::Text("Main thread heap allocations: last frame %llu, frames after warm-up that allocated %llu",
+            m_LastFrameHeapAllocationCount, m_SteadyStateHeapAllocationFrameCount);
+        ImGui::TreePop();
+    }
+    if(ImGui::TreeNodeEx("Constant buffers", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        m_TemporaryConstantBufferManager->ImGui();
+        ImGui::TreePop();
+    }
+    if(ImGui::TreeNodeEx("SRVDescriptors", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        m_SRVDescriptorManager->ImGui_TemporaryStatistics();
+        ImGui::TreePop();
+    }
+    if(ImGui::TreeNodeEx("SamplerDescriptors", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        m_SamplerDescriptorManager->ImGui_TemporaryStatistics();
+        ImGui::TreePop();
+    }
+}
+
+void Renderer::ImGui_CommandListStatistics()
+{
+    ImGui::Text("Calls last frame: issued / filtered as already set");
+    uint32_t issuedSum = 0, filteredSum = 0;
+    for(size_t callIndex = 0; callIndex < (size_t)CommandListCall::Count; ++callIndex)
+    {
+        const uint32_t issued = m_LastFrameCommandListStatistics.m_IssuedCounts[callIndex];
+        const uint32_t filtered = m_LastFrameCommandListStatistics.m_FilteredCounts[callIndex];
+        ImGui::Text("%s: %u / %u", GetCommandListCallName((CommandListCall)callIndex), issued, filtered);
+        issuedSum += issued;
+        filteredSum += filtered;
+    }
+    ImGui::Text("Total: %u / %u", issuedSum, filteredSum);
+}
+
+void Renderer::ImGui_DescriptorStatistics()
+{
+    if(m_BindlessEnabled)
+    {
+        ImGui::Text("Bindless material records written last frame: %u of %u, pending in other frames: %u",
+            m_LastFrameMaterialRecordWriteCount, m_MaterialTable.GetRecordCount(),
+            m_MaterialTable.GetDirtyRecordCount());
+    }
+    const std::array<DescriptorManager*, 4> managers = GetDescriptorManagers();
+    const char* const names[] = {"SRVDescriptors", "SamplerDescriptors", "RTVDescriptors", "DSVDescriptors"};
+    for(size_t i = 0; i < managers.size(); ++i)
+    {
+        if(ImGui::TreeNodeEx(names[i], ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            managers[i]->ImGui_PersistentStatistics();
+            ImGui::TreePop();
+        }
+    }
+}
+
+// Counts the entity and its descendants that are visible and have meshes.
+static uint32_t CountVisibleObjects(const Scene::Entity& entity)
+{
+    uint32_t result = entity.m_Meshes.empty() ? 0 : 1;
+    for(const auto& childEntity : entity.m_Children)
+    {
+        if(childEntity->m_Visible)
+            result += CountVisibleObjects(*childEntity);
+    }
+    return result;
+}
+
+// Frames after startup that may allocate from the heap, e.g. while the frame arena grows and PSOs are created.
+constexpr uint64_t HEAP_CHECK_WARMUP_FRAME_COUNT = 256;
+
 void Renderer::Render()
 {
     ERR_TRY
 
+    const uint64_t heapAllocationCountAtStart = GetThreadHeapAllocationCount();
 	m_FrameIndex = m_SwapChain->GetCurrentBackBufferIndex();
 	FrameResources& frameRes = m_FrameResources[m_FrameIndex];
     WaitForFenceOnCPU(frameRes.m_SubmittedFenceValue);
+    m_FrameArena->NewFrame();
+    frameRes.m_RetiredAllocations.clear();
+
+    CommandList cmdList;
+    CHECK_HR(frameRes.m_CmdAllocator->Reset());
+    cmdList.Init(frameRes.m_CmdAllocator.Get(), frameRes.m_CmdList.Get());
+
+    // Before NewFrame of descriptor managers, so new descriptors of streaming textures reach the heap.
+    UpdateTextureStreaming(cmdList);
+    DefragmentDescriptors();
+    TakeCompletedGBufferPipelineStates();
+    m_GBufferFallbackDrawCount = 0;
 
     m_SRVDescriptorManager->NewFrame();
     m_SamplerDescriptorManager->NewFrame();
     m_RTVDescriptorManager->NewFrame();
     m_DSVDescriptorManager->NewFrame();
     m_TemporaryConstantBufferManager->NewFrame();
-
-    CommandList cmdList;
-    CHECK_HR(frameRes.m_CmdAllocator->Reset());
-    cmdList.Init(frameRes.m_CmdAllocator.Get(), frameRes.m_CmdList.Get());
     {
         PIX_EVENT_SCOPE(cmdList, L"FRAME");
 
@@ -582,16 +856,53 @@ void Renderer::Render()
 
 	        cmdList.SetRootSignature(m_StandardRootSignature->GetRootSignature());
 
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetCBVParamIndex(0),
                 perFrameConstants);
 
-            vec3 scaleVec = vec3(g_AssimpScale.GetValue());
-            mat4 globalXform = glm::scale(glm::identity<mat4>(), scaleVec);
-            globalXform *= g_AssimpTransform.GetValue();
-            //globalXform = glm::rotate(globalXform, glm::half_pi<float>(), vec3(1.f, 0.f, 0.f));
-            if(m_RootEntity.m_Visible)
+            // Textures and samplers of all materials are reachable through these, set once for the pass.
+            if(m_BindlessEnabled)
+            {
+                UpdateMaterialRecords();
+                if(!m_MaterialRecordDescriptors.IsNull())
+                {
+                    cmdList.SetGraphicsRootDescriptorTable(
+                        m_StandardRootSignature->GetSRVParamIndex(2),
+                        m_SRVDescriptorManager->GetGPUHandle(m_MaterialRecordDescriptors, m_FrameIndex));
+                }
+                cmdList.SetGraphicsRootDescriptorTable(
+                    m_StandardRootSignature->GetBindlessSRVParamIndex(),
+                    m_SRVDescriptorManager->GetPersistentSectionGPUHandle());
+                cmdList.SetGraphicsRootDescriptorTable(
+                    m_StandardRootSignature->GetBindlessSamplerParamIndex(),
+                    m_StandardSamplers.GetD3D12Table());
+            }
+            else
+                SetPackedMaterialConstants(cmdList);
+
+            // Constants of all objects are tightly packed in one buffer instead of a 256 B aligned buffer
+            // and a CBV descriptor each. Draws select theirs with per-draw constant ObjectIndex.
+            m_PackedObjectConstants = nullptr;
+            m_PackedObjectCount = 0;
+            m_PackedObjectCapacity = m_RootEntity.m_Visible ? CountVisibleObjects(m_RootEntity) : 0;
+            if(m_PackedObjectCapacity > 0)
+            {
+                void* mappedPtr = nullptr;
+                D3D12_GPU_VIRTUAL_ADDRESS GPUAddr = 0;
+                m_TemporaryConstantBufferManager->CreateBuffer(
+                    m_PackedObjectCapacity * (uint32_t)sizeof(PerObjectConstants), mappedPtr, GPUAddr);
+                m_PackedObjectConstants = (PerObjectConstants*)mappedPtr;
+                cmdList.SetGraphicsRootShaderResourceView(
+                    m_StandardRootSignature->GetPackedSRVParamIndex(0), GPUAddr);
+
+                vec3 scaleVec = vec3(g_AssimpScale.GetValue());
+                mat4 globalXform = glm::scale(glm::identity<mat4>(), scaleVec);
+                globalXform *= g_AssimpTransform.GetValue();
+                //globalXform = glm::rotate(globalXform, glm::half_pi<float>(), vec3(1.f, 0.f, 0.f));
                 RenderEntity(cmdList, globalXform, m_RootEntity);
+                assert(m_PackedObjectCount == m_PackedObjectCapacity);
+            }
+            m_PackedObjectConstants = nullptr;
         }
 
         if(m_AmbientPipelineState && m_LightingPipelineState)
@@ -609,15 +920,15 @@ void Renderer::Render()
             cmdList.SetRenderTargets(m_DepthTexture.get(), m_ColorRenderTarget.get());
             cmdList.SetRootSignature(m_StandardRootSignature->GetRootSignature());
             
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetCBVParamIndex(0), perFrameConstants);
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetSRVParamIndex(0), m_DepthTexture->GetD3D12SRV());
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetSRVParamIndex(1), m_GBuffers[(size_t)GBuffer::Albedo]->GetD3D12SRV());
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetSRVParamIndex(2), m_GBuffers[(size_t)GBuffer::Normal]->GetD3D12SRV());
-            cmdList.GetCmdList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            cmdList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
             {
                 PIX_EVENT_SCOPE(cmdList, L"Ambient");
@@ -625,31 +936,43 @@ void Renderer::Render()
                 cmdList.GetCmdList()->DrawInstanced(3, 1, 0, 0);
             }
 
-            if(!m_Lights.empty())
+            const uint32_t enabledLightCount = (uint32_t)std::count_if(m_Lights.begin(), m_Lights.end(),
+                [](const Scene::Light& l) { return l.m_Enabled; });
+            if(enabledLightCount > 0)
             {
                 cmdList.SetPipelineState(m_LightingPipelineState.Get());
 
+                // Constants of all enabled lights are packed in one buffer, selected by per-draw constant ObjectIndex.
+                void* mappedPtr = nullptr;
+                D3D12_GPU_VIRTUAL_ADDRESS GPUAddr = 0;
+                m_TemporaryConstantBufferManager->CreateBuffer(enabledLightCount * (uint32_t)sizeof(LightConstants),
+                    mappedPtr, GPUAddr);
+                LightConstants* const packedLightConstants = (LightConstants*)mappedPtr;
+                cmdList.SetGraphicsRootShaderResourceView(
+                    m_StandardRootSignature->GetPackedSRVParamIndex(0), GPUAddr);
+
+                uint32_t packedLightIndex = 0;
                 for(size_t lightIndex = 0; lightIndex < m_Lights.size(); ++lightIndex)
                 {
                     const Scene::Light& l = m_Lights[lightIndex];
                     if(l.m_Enabled)
                     {
-                        PIX_EVENT_SCOPE(cmdList, std::format(L"Light {} Type={}", lightIndex, l.m_Type));
+                        PIX_EVENT_SCOPE(cmdList, FrameFormat(L"Light {} Type={}", lightIndex, l.m_Type).c_str());
 
                         vec3 dirToLight_View = glm::normalize(TransformNormal(m_Camera->GetView(), l.m_DirectionToLight_Position));
 
-                        LightConstants lc;
+                        LightConstants lc = {};
                         lc.m_Color = l.m_Color;
                         lc.m_Type = l.m_Type;
                         lc.m_DirectionToLight_Position = dirToLight_View;
-                        void* mappedPtr = nullptr;
-                        D3D12_GPU_DESCRIPTOR_HANDLE lcDesc;
-                        m_TemporaryConstantBufferManager->CreateBuffer(sizeof(lc), mappedPtr, lcDesc);
-                        memcpy(mappedPtr, &lc, sizeof(lc));
+                        memcpy(packedLightConstants + packedLightIndex, &lc, sizeof(lc));
 
-                        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-                            m_StandardRootSignature->GetCBVParamIndex(1), lcDesc);
+                        const PerDrawConstants perDrawConstants = {.m_ObjectIndex = packedLightIndex};
+                        cmdList.SetGraphicsRoot32BitConstants(
+                            m_StandardRootSignature->GetPerDrawConstantsParamIndex(),
+                            StandardRootSignature::PER_DRAW_CONSTANT_COUNT, &perDrawConstants, 0);
                         cmdList.GetCmdList()->DrawInstanced(3, 1, 0, 0);
+                        ++packedLightIndex;
                     }
                 }
             }
@@ -662,9 +985,9 @@ void Renderer::Render()
             cmdList.SetRenderTargets(nullptr, frameRes.m_BackBuffer.get());
             cmdList.SetPipelineState(m_PostprocessingPipelineState.Get());
             cmdList.SetRootSignature(m_StandardRootSignature->GetRootSignature());
-            cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
+            cmdList.SetGraphicsRootDescriptorTable(
                 m_StandardRootSignature->GetSRVParamIndex(0), m_ColorRenderTarget->GetD3D12SRV());
-            cmdList.GetCmdList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            cmdList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
             cmdList.GetCmdList()->DrawInstanced(3, 1, 0, 0);
         }
 
@@ -674,6 +997,7 @@ void Renderer::Render()
 
         frameRes.m_BackBuffer->TransitionToStates(cmdList, D3D12_RESOURCE_STATE_PRESENT);
     }
+    m_LastFrameCommandListStatistics = cmdList.GetStatistics();
     cmdList.Execute(m_CmdQueue.Get());
 
 	frameRes.m_SubmittedFenceValue = m_NextFenceValue++;
@@ -681,6 +1005,23 @@ void Renderer::Render()
 
 	CHECK_HR(m_SwapChain->Present(g_SyncInterval.GetValue(), 0));
 
+    // In a steady state the render path takes its transient memory from the frame arena, not from the heap.
+    m_LastFrameHeapAllocationCount = GetThreadHeapAllocationCount() - heapAllocationCountAtStart;
+    if(++m_RenderedFrameCount > HEAP_CHECK_WARMUP_FRAME_COUNT && m_LastFrameHeapAllocationCount > 0)
+    {
+        ++m_SteadyStateHeapAllocationFrameCount;
+#ifdef _DEBUG
+        const bool checkHeapAllocations = g_CheckHeapAllocations.GetValue() >= 1;
+#else
+        const bool checkHeapAllocations = g_CheckHeapAllocations.GetValue() >= 2;
+#endif
+        if(checkHeapAllocations)
+        {
+            FAIL(std::format(L"Frame {} made {} heap allocations on the main thread after warm-up.",
+                m_RenderedFrameCount, m_LastFrameHeapAllocationCount));
+        }
+    }
+
     ERR_CATCH_FUNC
 }
 
@@ -800,6 +1141,9 @@ void Renderer::CreateMemoryAllocator()
 
 void Renderer::LoadCapabilities()
 {
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    CHECK_HR(m_Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+    m_Capabilities.m_ResourceBindingTier = options.ResourceBindingTier;
 }
 
 void Renderer::CreateCommandQueues()
@@ -921,7 +1265,7 @@ void Renderer::CreateResources()
     }
     */
 
-	m_StandardRootSignature = std::make_unique<StandardRootSignature>();
+	m_StandardRootSignature = std::make_unique<StandardRootSignature>(m_BindlessEnabled);
 
     {
         D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Tex2D(
@@ -954,34 +1298,66 @@ void Renderer::CreateResources()
     ERR_CATCH_FUNC;
 }
 
-ID3D12PipelineState* Renderer::GetOrCreateGBufferPipelineState(uint32_t materialFlags)
+/*
+Material flags above FLAG_TWOSIDED have the same order as binary macros ALPHA_TEST, HAS_MATERIAL_COLOR,
+HAS_ALBEDO_TEXTURE, HAS_NORMAL_TEXTURE of m_GBufferMultiPixelShader, so its permutation index is just a shift.
+*/
+static_assert(Scene::Material::FLAG_TWOSIDED == 0x1 && Scene::Material::FLAG_ALPHA_MASK == 0x2 &&
+    Scene::Material::FLAG_HAS_MATERIAL_COLOR == 0x4 && Scene::Material::FLAG_HAS_ALBEDO_TEXTURE == 0x8 &&
+    Scene::Material::FLAG_HAS_NORMAL_TEXTURE == 0x10);
+static uint32_t GetGBufferPixelShaderPermutation(uint32_t flags)
 {
-    assert(m_ColorRenderTarget);
-
-    const auto it = m_GBufferPipelineStates.find(materialFlags);
-    if(it != m_GBufferPipelineStates.end())
-        return it->second.Get();
+    return flags >> 1;
+}
 
-    ComPtr<ID3D12PipelineState>& pso = m_GBufferPipelineStates[materialFlags];
+// Converts Scene::Material::FLAG_* to MATERIAL_FLAG_* of shaders.
+static uint32_t GetMaterialShaderFlags(uint32_t materialFlags)
+{
+    uint32_t result = 0;
+    if((materialFlags & Scene::Material::FLAG_TWOSIDED) != 0)
+        result |= MATERIAL_FLAG_TWOSIDED;
+    if((materialFlags & Scene::Material::FLAG_ALPHA_MASK) != 0)
+        result |= MATERIAL_FLAG_ALPHA_MASK;
+    if((materialFlags & Scene::Material::FLAG_HAS_MATERIAL_COLOR) != 0)
+        result |= MATERIAL_FLAG_HAS_MATERIAL_COLOR;
+    if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
+        result |= MATERIAL_FLAG_HAS_ALBEDO_TEXTURE;
+    if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
+        result |= MATERIAL_FLAG_HAS_NORMAL_TEXTURE;
+    return result;
+}
 
-    ERR_TRY
-    ERR_TRY
+uint32_t Renderer::GetGBufferPipelineFlags(uint32_t materialFlags)
+{
+    if(!g_BackfaceCullingEnabled.GetValue())
+        materialFlags |= Scene::Material::FLAG_TWOSIDED;
+    if(!g_AlbedoTexturesEnabled.GetValue())
+        materialFlags &= ~Scene::Material::FLAG_HAS_ALBEDO_TEXTURE;
+    if(!g_NormalMapsEnabled.GetValue())
+        materialFlags &= ~Scene::Material::FLAG_HAS_NORMAL_TEXTURE;
+    return materialFlags;
+}
 
-    const uint32_t macroValues[] = {
-        (materialFlags & Scene::Material::FLAG_ALPHA_MASK) ? 1u : 0u, // ALPHA_TEST
-        (materialFlags & Scene::Material::FLAG_HAS_MATERIAL_COLOR) ? 1u : 0u, // HAS_MATERIAL_COLOR
-        (materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) ? 1u : 0u, // HAS_ALBEDO_TEXTURE
-        (materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) ? 1u : 0u, // HAS_NORMAL_TEXTURE
-    };
+const Shader& Renderer::GetGBufferVertexShader()
+{
+    if(!m_GBufferVertexShader)
+    {
+        unique_ptr<Shader> vs = std::make_unique<Shader>();
+        vs->Init(GetStandardShaderDesc(StandardShader::GBufferVS));
+        m_GBufferVertexShader = std::move(vs);
+    }
+    return *m_GBufferVertexShader;
+}
 
-    const bool backfaceCullingEnabled = g_BackFaceCullingMode.GetValue() > 0 &&
-        (materialFlags & Scene::Material::FLAG_TWOSIDED) == 0;
+ComPtr<ID3D12PipelineState> Renderer::CreateGBufferPipelineState(uint32_t flags, const Shader& vs, const Shader& ps)
+{
+    assert(m_ColorRenderTarget);
+    PROFILE_LOAD_SCOPE("CreateGBufferPipelineState");
 
-    Shader vs;
-    vs.Init(ShaderType::Vertex, L"Shaders/GBuffer.hlsl", L"MainVS");
+    ERR_TRY
 
-    const Shader* ps = m_GBufferMultiPixelShader->GetShader(macroValues);
-    CHECK_BOOL(ps);
+    const bool backfaceCullingEnabled = g_BackFaceCullingMode.GetValue() > 0 &&
+        (flags & Scene::Material::FLAG_TWOSIDED) == 0;
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {
 	    .pRootSignature = m_StandardRootSignature->GetRootSignature(),
@@ -989,8 +1365,8 @@ ID3D12PipelineState* Renderer::GetOrCreateGBufferPipelineState(uint32_t material
             .pShaderBytecode = vs.GetCode().data(),
             .BytecodeLength = vs.GetCode().size()},
 	    .PS = {
-            .pShaderBytecode = ps->GetCode().data(),
-            .BytecodeLength = ps->GetCode().size()},
+            .pShaderBytecode = ps.GetCode().data(),
+            .BytecodeLength = ps.GetCode().size()},
         .SampleMask = UINT32_MAX,
 	    .InputLayout = {
             .pInputElementDescs = Vertex::GetInputElements(),
@@ -1007,19 +1383,146 @@ ID3D12PipelineState* Renderer::GetOrCreateGBufferPipelineState(uint32_t material
 	FillBlendDesc_NoBlending(desc.BlendState);
     FillDepthStencilDesc_DepthTest(desc.DepthStencilState, D3D12_DEPTH_WRITE_MASK_ALL, D3D12_COMPARISON_FUNC_GREATER);
 	
+    ComPtr<ID3D12PipelineState> pso;
     CHECK_HR(m_Device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso)));
-    SetD3D12ObjectName(pso, std::format(L"G-buffer pipeline state Flags=0x{:X}", materialFlags));
+    SetD3D12ObjectName(pso, std::format(L"G-buffer pipeline state Flags=0x{:X}", flags));
+    return pso;
 
-    return pso.Get();
+    ERR_CATCH_MSG(std::format(L"Cannot create G-buffer pipeline state with Flags=0x{:X}.", flags));
+}
 
-    ERR_CATCH_MSG(std::format(L"Cannot create G-buffer pipeline state with Flags=0x{:X}.", materialFlags));
+ID3D12PipelineState* Renderer::GetOrCreateGBufferPipelineState(uint32_t flags)
+{
+    assert(flags < GBUFFER_PIPELINE_STATE_COUNT);
+    GBufferPipelineState& state = m_GBufferPipelineStates[flags];
+    if(state.m_Created)
+        return state.m_PipelineState.Get();
+
+    if(m_GBufferPipelineStateCompiler && m_GBufferPipelineStateCompiler->IsStarted())
+    {
+        m_GBufferPipelineStateCompiler->Request(flags);
+        if(m_GBufferFallbackPipelineState)
+            ++m_GBufferFallbackDrawCount;
+        return m_GBufferFallbackPipelineState.Get();
+    }
+
+    PROFILE_LOAD_SCOPE("GetOrCreateGBufferPipelineState");
+    state.m_Created = true;
+
+    try
+    {
+        const Shader* ps = m_GBufferMultiPixelShader->GetShader(GetGBufferPixelShaderPermutation(flags));
+        CHECK_BOOL(ps);
+        state.m_PipelineState = CreateGBufferPipelineState(flags, GetGBufferVertexShader(), *ps);
+        return state.m_PipelineState.Get();
     } CATCH_PRINT_ERROR(return nullptr;);
 }
 
+void Renderer::StartGBufferPipelineStateCompiler()
+{
+    if(g_AsyncPipelineStatesUseFallback.GetValue())
+    {
+        // No culling and no textures, so it works with any material, just doesn't look right.
+        m_GBufferFallbackPipelineState = GetOrCreateGBufferPipelineState(Scene::Material::FLAG_TWOSIDED);
+    }
+
+    if(!m_GBufferPipelineStateCompiler)
+        m_GBufferPipelineStateCompiler = std::make_unique<PipelineStateCompiler>();
+    m_GBufferPipelineStateCompiler->Start([this](uint32_t flags) -> ComPtr<ID3D12PipelineState>
+    {
+        const Shader* ps = m_GBufferMultiPixelShader->GetShader(GetGBufferPixelShaderPermutation(flags));
+        CHECK_BOOL(ps);
+        return CreateGBufferPipelineState(flags, GetGBufferVertexShader(), *ps);
+    });
+}
+
+void Renderer::StopGBufferPipelineStateCompiler()
+{
+    if(m_GBufferPipelineStateCompiler)
+        m_GBufferPipelineStateCompiler->Stop();
+    m_GBufferFallbackPipelineState.Reset();
+}
+
+void Renderer::TakeCompletedGBufferPipelineStates()
+{
+    if(!m_GBufferPipelineStateCompiler || !m_GBufferPipelineStateCompiler->IsStarted())
+        return;
+    FrameVector<PipelineStateCompiler::Result> results(FrameAlloc());
+    m_GBufferPipelineStateCompiler->TakeCompleted(results);
+    // Failed ones are remembered as null, like in GetOrCreateGBufferPipelineState.
+    for(PipelineStateCompiler::Result& result : results)
+        m_GBufferPipelineStates[result.first] = {std::move(result.second), true};
+}
+
+void Renderer::PrecompileGBufferPipelineStates()
+{
+    PROFILE_LOAD_SCOPE("PrecompileGBufferPipelineStates");
+
+    std::vector<uint32_t> flagsList;
+    if(g_ShadersPrecompileAllPermutations.GetValue())
+    {
+        for(uint32_t flags = 0; flags < GBUFFER_PIPELINE_STATE_COUNT; ++flags)
+            flagsList.push_back(flags);
+    }
+    else
+    {
+        for(const Scene::Material& mat : m_Materials)
+            flagsList.push_back(GetGBufferPipelineFlags(mat.m_Flags));
+        std::sort(flagsList.begin(), flagsList.end());
+        flagsList.erase(std::unique(flagsList.begin(), flagsList.end()), flagsList.end());
+    }
+    std::erase_if(flagsList, [this](uint32_t flags) { return m_GBufferPipelineStates[flags].m_Created; });
+    if(flagsList.empty())
+        return;
+
+    try
+    {
+        const uint32_t threadCount = g_ShadersPrecompileThreadCount.GetValue();
+        const Time beginTime = Now();
+
+        std::vector<uint32_t> permutations(flagsList.size());
+        std::transform(flagsList.begin(), flagsList.end(), permutations.begin(), GetGBufferPixelShaderPermutation);
+        const uint32_t shaderCount = m_GBufferMultiPixelShader->Precompile(permutations, threadCount);
+        const Shader& vs = GetGBufferVertexShader();
+        const Time shadersEndTime = Now();
+
+        // Already compiled, so GetShader only looks them up.
+        const size_t psoCount = flagsList.size();
+        std::vector<const Shader*> pixelShaders(psoCount);
+        for(size_t i = 0; i < psoCount; ++i)
+            pixelShaders[i] = m_GBufferMultiPixelShader->GetShader(permutations[i]);
+
+        std::vector<ComPtr<ID3D12PipelineState>> psos(psoCount);
+        ParallelFor(psoCount, threadCount, [&](size_t i)
+        {
+            if(!pixelShaders[i])
+                return;
+            try
+            {
+                psos[i] = CreateGBufferPipelineState(flagsList[i], vs, *pixelShaders[i]);
+            } CATCH_PRINT_ERROR(;)
+        });
+        // Failed ones are remembered as null, like in GetOrCreateGBufferPipelineState.
+        for(size_t i = 0; i < psoCount; ++i)
+            m_GBufferPipelineStates[flagsList[i]] = {std::move(psos[i]), true};
+        const Time endTime = Now();
+
+        const float shadersSeconds = TimeToSeconds<float>(shadersEndTime - beginTime);
+        const float psosSeconds = TimeToSeconds<float>(endTime - shadersEndTime);
+        LogMessageF(L"Precompiled {} G-buffer shader permutations in {:.1f} ms ({:.1f} shaders/s) "
+            L"and {} pipeline states in {:.1f} ms ({:.1f} PSOs/s), on {} threads.",
+            shaderCount, shadersSeconds * 1000.f, shadersSeconds > 0.f ? (float)shaderCount / shadersSeconds : 0.f,
+            psoCount, psosSeconds * 1000.f, psosSeconds > 0.f ? (float)psoCount / psosSeconds : 0.f,
+            threadCount ? threadCount : std::max(std::thread::hardware_concurrency(), 1u));
+    } CATCH_PRINT_ERROR(;)
+}
+
 void Renderer::CreateLightingPipelineStates()
 {
+    PROFILE_LOAD_SCOPE("CreateLightingPipelineStates");
     m_LightingPipelineState.Reset();
     m_AmbientPipelineState.Reset();
+    m_LightingShaderDependencies.Clear();
 
     ERR_TRY
     ERR_TRY
@@ -1027,8 +1530,10 @@ void Renderer::CreateLightingPipelineStates()
     // Ambient root signature
     {
         Shader vs, ps;
-        vs.Init(ShaderType::Vertex, L"Shaders/Ambient.hlsl", L"FullScreenQuadVS");
-        ps.Init(ShaderType::Pixel,  L"Shaders/Ambient.hlsl", L"MainPS");
+        vs.Init(GetStandardShaderDesc(StandardShader::AmbientVS));
+        ps.Init(GetStandardShaderDesc(StandardShader::AmbientPS));
+        m_LightingShaderDependencies.Append(vs.GetDependencies());
+        m_LightingShaderDependencies.Append(ps.GetDependencies());
 
 	    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {
             .pRootSignature = m_StandardRootSignature->GetRootSignature(),
@@ -1056,8 +1561,10 @@ void Renderer::CreateLightingPipelineStates()
     // Lighting root signature
     {
         Shader vs, ps;
-        vs.Init(ShaderType::Vertex, L"Shaders/Lighting.hlsl", L"FullScreenQuadVS");
-        ps.Init(ShaderType::Pixel,  L"Shaders/Lighting.hlsl", L"MainPS");
+        vs.Init(GetStandardShaderDesc(StandardShader::LightingVS));
+        ps.Init(GetStandardShaderDesc(StandardShader::LightingPS));
+        m_LightingShaderDependencies.Append(vs.GetDependencies());
+        m_LightingShaderDependencies.Append(ps.GetDependencies());
 
 	    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {
 	        .pRootSignature = m_StandardRootSignature->GetRootSignature(),
@@ -1090,14 +1597,18 @@ void Renderer::CreateLightingPipelineStates()
 
 void Renderer::CreatePostprocessingPipelineState()
 {
+    PROFILE_LOAD_SCOPE("CreatePostprocessingPipelineState");
     m_PostprocessingPipelineState.Reset();
+    m_PostprocessingShaderDependencies.Clear();
 
     ERR_TRY
     ERR_TRY
 
     Shader vs, ps;
-    vs.Init(ShaderType::Vertex, L"Shaders/Postprocessing.hlsl", L"FullScreenQuadVS");
-    ps.Init(ShaderType::Pixel,  L"Shaders/Postprocessing.hlsl", L"MainPS");
+    vs.Init(GetStandardShaderDesc(StandardShader::PostprocessingVS));
+    ps.Init(GetStandardShaderDesc(StandardShader::PostprocessingPS));
+    m_PostprocessingShaderDependencies.Append(vs.GetDependencies());
+    m_PostprocessingShaderDependencies.Append(ps.GetDependencies());
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {
 	    .pRootSignature = m_StandardRootSignature->GetRootSignature(),
@@ -1203,8 +1714,12 @@ void Renderer::ShutdownImGui()
 
 void Renderer::ClearModel()
 {
+    DestroyMaterialRecords();
     m_Lights.clear();
+    if(m_TextureStreamer)
+        m_TextureStreamer->Clear();
     m_Textures.clear();
+    m_TextureArrays.clear();
     m_Materials.clear();
     m_Meshes.clear();
     m_RootEntity = Scene::Entity{};
@@ -1212,10 +1727,40 @@ void Renderer::ClearModel()
 
 void Renderer::ClearGBufferShaders()
 {
-    m_GBufferPipelineStates.clear();
+    m_GBufferPipelineStates.fill({});
+    m_GBufferVertexShader.reset();
     m_GBufferMultiPixelShader->Clear();
 }
 
+void Renderer::InvalidateOutdatedGBufferShaders()
+{
+    const uint32_t removedShaderCount = m_GBufferMultiPixelShader->RemoveOutdated();
+
+    bool allOutdated = g_BackFaceCullingMode.GetValue() != m_GBufferBackFaceCullingMode;
+    m_GBufferBackFaceCullingMode = g_BackFaceCullingMode.GetValue();
+    if(m_GBufferVertexShader && m_GBufferVertexShader->GetDependencies().IsOutdated())
+    {
+        m_GBufferVertexShader.reset();
+        allOutdated = true;
+    }
+
+    uint32_t removedPipelineStateCount = 0;
+    for(uint32_t flags = 0; flags < GBUFFER_PIPELINE_STATE_COUNT; ++flags)
+    {
+        GBufferPipelineState& state = m_GBufferPipelineStates[flags];
+        // Failed ones are removed too, so they are tried again.
+        if(state.m_Created && (allOutdated || !state.m_PipelineState ||
+            !m_GBufferMultiPixelShader->IsCompiled(GetGBufferPixelShaderPermutation(flags))))
+        {
+            state = {};
+            ++removedPipelineStateCount;
+        }
+    }
+
+    LogMessageF(L"Invalidated {} G-buffer shader permutations and {} pipeline states.",
+        removedShaderCount, removedPipelineStateCount);
+}
+
 void Renderer::CreateLights()
 {
     Scene::Light dl = {
@@ -1244,6 +1789,7 @@ void Renderer::CreateLights()
 
 void Renderer::LoadModel(bool refreshAll)
 {
+    PROFILE_LOAD_SCOPE("LoadModel");
     ClearModel();
     CreateLights();
 
@@ -1263,7 +1809,11 @@ void Renderer::LoadModel(bool refreshAll)
 
     {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(filePath.c_str(), GetAssimpFlags());
+        const aiScene* scene = nullptr;
+        {
+            PROFILE_LOAD_SCOPE("Assimp ReadFile");
+            scene = importer.ReadFile(filePath.c_str(), GetAssimpFlags());
+        }
         if(!scene)
             FAIL(ConvertCharsToUnicode(importer.GetErrorString(), CP_ACP));
         
@@ -1282,6 +1832,12 @@ void Renderer::LoadModel(bool refreshAll)
         const std::filesystem::path modelDir = std::filesystem::path(filePath.begin(), filePath.end()).parent_path();
         for(uint32_t i = 0; i < scene->mNumMaterials; ++i)
             LoadMaterial(modelDir, scene, i, scene->mMaterials[i], refreshAll);
+        if(g_TextureArraysEnabled.GetValue())
+            PackTextureArrays();
+        CreateMaterialRecords();
+
+        // Makes textures cooked during this load available to the next one, once written in the background.
+        g_AssetPack->Flush();
     }
 
     ERR_CATCH_MSG(std::format(L"Cannot load model from \"{}\".", filePath));
@@ -1309,6 +1865,7 @@ void Renderer::LoadModelNode(Scene::Entity& outEntity, const aiScene* scene, con
 
 void Renderer::LoadModelMesh(const aiScene* scene, const aiMesh* assimpMesh, bool globalXformIsInverted)
 {
+    PROFILE_LOAD_SCOPE("LoadModelMesh");
     const uint32_t vertexCount = assimpMesh->mNumVertices;
     const uint32_t faceCount = assimpMesh->mNumFaces;
     CHECK_BOOL(vertexCount > 0 && faceCount > 0);
@@ -1359,6 +1916,8 @@ void Renderer::LoadModelMesh(const aiScene* scene, const aiMesh* assimpMesh, boo
     Scene::Mesh mesh;
     mesh.m_Title = ConvertCharsToUnicode(str_view(assimpMesh->mName.data, assimpMesh->mName.length), CP_UTF8);
     mesh.m_MaterialIndex = assimpMesh->mMaterialIndex;
+    ComputeBoundingSphere(mesh.m_BoundingSphereCenter, mesh.m_BoundingSphereRadius, vertices);
+    mesh.m_UVDensity = ComputeUVDensity(vertices, indices);
     mesh.m_Mesh = std::make_unique<Mesh>();
     mesh.m_Mesh->Init(
         L"Mesh",
@@ -1372,6 +1931,7 @@ void Renderer::LoadModelMesh(const aiScene* scene, const aiMesh* assimpMesh, boo
 void Renderer::LoadMaterial(const std::filesystem::path& modelDir, const aiScene* scene, uint32_t materialIndex,
     const aiMaterial* material, bool refreshAll)
 {
+    PROFILE_LOAD_SCOPE("LoadMaterial");
     ERR_TRY;
 
     Scene::Material sceneMat;
@@ -1435,6 +1995,27 @@ void Renderer::LoadMaterial(const std::filesystem::path& modelDir, const aiScene
         GetStringMaterialProperty(albedoPath, material, "$raw.Maya|baseColor|file");
     }
 
+    // Alpha mask. Property found in Sponza scene, as strinrg = "MASK".
+    {
+        string s;
+        if(GetStringMaterialProperty(s, material, "$mat.gltf.alphaMode"))
+        {
+            if(s == "MASK")
+                sceneMat.m_Flags |= Scene::Material::FLAG_ALPHA_MASK;
+            else if(s != "OPAQUE")
+                LogWarningF(L"Unrecognized material property \"$mat.gltf.alphaMode\" value: {}", str_view(s));
+        }
+    }
+
+    // Alpha cutoff.
+    sceneMat.m_AlphaCutoff = 0.5f;
+    if((sceneMat.m_Flags & Scene::Material::FLAG_ALPHA_MASK) != 0)
+    {
+        float v;
+        if(GetFloatMaterialProperty(v, material, "$mat.gltf.alphaCutoff"))
+            sceneMat.m_AlphaCutoff = v;
+    }
+
     wstring albedoPathW;
     std::filesystem::path albedoPathP;
     if(!g_TexturePath.GetValue().empty())
@@ -1453,7 +2034,12 @@ void Renderer::LoadMaterial(const std::filesystem::path& modelDir, const aiScene
         albedoPathP = modelDir / albedoPathP;
     if(!albedoPathP.empty())
     {
-        sceneMat.m_AlbedoTextureIndex = TryLoadTexture(albedoPathW, albedoPathP, true, !refreshAll);
+        uint32_t albedoFlags = Texture::FLAG_SRGB;
+        // Alpha of mipmaps must be adjusted for alpha test to keep the same coverage in the distance.
+        if((sceneMat.m_Flags & Scene::Material::FLAG_ALPHA_MASK) != 0)
+            albedoFlags |= Texture::FLAG_ALPHA_TEST;
+        sceneMat.m_AlbedoTextureIndex = TryLoadTexture(albedoPathW, albedoPathP, albedoFlags, !refreshAll,
+            sceneMat.m_AlphaCutoff);
         sceneMat.m_Flags |= Scene::Material::FLAG_HAS_ALBEDO_TEXTURE;
     }
 
@@ -1474,7 +2060,7 @@ void Renderer::LoadMaterial(const std::filesystem::path& modelDir, const aiScene
         normalPathP = modelDir / normalPathP;
     if(!normalPathP.empty())
     {
-        sceneMat.m_NormalTextureIndex = TryLoadTexture(normalPathW, normalPathP, false, !refreshAll);
+        sceneMat.m_NormalTextureIndex = TryLoadTexture(normalPathW, normalPathP, Texture::FLAG_NORMAL_MAP, !refreshAll);
         sceneMat.m_Flags |= Scene::Material::FLAG_HAS_NORMAL_TEXTURE;
     }
 
@@ -1488,34 +2074,15 @@ void Renderer::LoadMaterial(const std::filesystem::path& modelDir, const aiScene
         }
     }
 
-    // Alpha mask. Property found in Sponza scene, as strinrg = "MASK".
-    {
-        string s;
-        if(GetStringMaterialProperty(s, material, "$mat.gltf.alphaMode"))
-        {
-            if(s == "MASK")
-                sceneMat.m_Flags |= Scene::Material::FLAG_ALPHA_MASK;
-            else if(s != "OPAQUE")
-                LogWarningF(L"Unrecognized material property \"$mat.gltf.alphaMode\" value: {}", str_view(s));
-        }
-    }
-
-    // Alpha cutoff.
-    sceneMat.m_AlphaCutoff = 0.5f;
-    if((sceneMat.m_Flags & Scene::Material::FLAG_ALPHA_MASK) != 0)
-    {
-        float v;
-        if(GetFloatMaterialProperty(v, material, "$mat.gltf.alphaCutoff"))
-            sceneMat.m_AlphaCutoff = v;
-    }
-
     m_Materials.push_back(std::move(sceneMat));
 
     ERR_CATCH_MSG(std::format(L"Cannot load material {}.", materialIndex));
 }
 
-size_t Renderer::TryLoadTexture(const wstr_view& title, const std::filesystem::path& path, bool sRGB, bool allowCache)
+size_t Renderer::TryLoadTexture(const wstr_view& title, const std::filesystem::path& path, uint32_t usageFlags, bool allowCache,
+    float alphaCutoff)
 {
+    PROFILE_LOAD_SCOPE("TryLoadTexture");
     if(path.empty())
         return SIZE_MAX;
 
@@ -1538,18 +2105,246 @@ size_t Renderer::TryLoadTexture(const wstr_view& title, const std::filesystem::p
         tex.m_Title.assign(title.data(), title.length());
         tex.m_ProcessedPath = std::move(processedPath);
         tex.m_Texture = std::make_unique<Texture>();
-        uint32_t flags = Texture::FLAG_GENERATE_MIPMAPS | Texture::FLAG_CACHE_SAVE;
-        if(sRGB)
-            flags |= Texture::FLAG_SRGB;
+        uint32_t flags = usageFlags | Texture::FLAG_GENERATE_MIPMAPS | Texture::FLAG_CACHE_SAVE;
+        if(g_TextureCompressionEnabled.GetValue())
+        {
+            flags |= Texture::FLAG_COMPRESS;
+            if(g_TextureCompressionHighQuality.GetValue())
+                flags |= Texture::FLAG_COMPRESS_HIGH_QUALITY;
+        }
         if(allowCache)
             flags |= Texture::FLAG_CACHE_LOAD;
-        tex.m_Texture->LoadFromFile(flags, path.native());
+        if(g_TextureStreamingEnabled.GetValue())
+            flags |= Texture::FLAG_STREAMING;
+        tex.m_Texture->LoadFromFile(flags, path.native(), alphaCutoff);
         m_Textures.push_back(std::move(tex));
         return m_Textures.size() - 1;
     }
     CATCH_PRINT_ERROR(return SIZE_MAX;)
 }
 
+void Renderer::PackTextureArrays()
+{
+    PROFILE_LOAD_SCOPE("PackTextureArrays");
+
+    std::vector<TextureArrayPacker::Item> items;
+    std::vector<size_t> itemTextureIndices;
+    for(size_t i = 0; i < m_Textures.size(); ++i)
+    {
+        const Texture* const tex = m_Textures[i].m_Texture.get();
+        // Streaming textures change their resident levels independently, so they can't share a resource.
+        if(!tex || tex->IsEmpty() || tex->GetArraySize() != 1 || tex->GetMaxFirstResidentMip() != 0)
+            continue;
+        const D3D12_RESOURCE_DESC& desc = tex->GetDesc();
+        items.push_back({
+            .m_Format = (uint32_t)desc.Format,
+            .m_Width = (uint32_t)desc.Width,
+            .m_Height = desc.Height,
+            .m_MipLevels = desc.MipLevels });
+        itemTextureIndices.push_back(i);
+    }
+
+    std::vector<TextureArrayPacker::Array> arrays;
+    TextureArrayPacker(g_TextureArraysMaxSize.GetValue(), D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION).Pack(
+        items, arrays);
+
+    size_t packedTextureCount = 0;
+    for(const TextureArrayPacker::Array& arr : arrays)
+    {
+        try
+        {
+            std::vector<const Texture*> slices(arr.m_Items.size());
+            for(size_t slice = 0; slice < slices.size(); ++slice)
+                slices[slice] = m_Textures[itemTextureIndices[arr.m_Items[slice]]].m_Texture.get();
+
+            const D3D12_RESOURCE_DESC& desc = slices[0]->GetDesc();
+            auto arrayTexture = std::make_unique<Texture>();
+            arrayTexture->LoadArray(slices, std::format(L"Texture array {}: {} x {} {} [{}]",
+                m_TextureArrays.size(), desc.Width, desc.Height, DXGIFormatToStr(desc.Format), slices.size()));
+
+            for(size_t slice = 0; slice < slices.size(); ++slice)
+            {
+                Scene::Texture& tex = m_Textures[itemTextureIndices[arr.m_Items[slice]]];
+                tex.m_ArrayIndex = m_TextureArrays.size();
+                tex.m_ArraySlice = (uint32_t)slice;
+                tex.m_Texture.reset();
+            }
+            m_TextureArrays.push_back(std::move(arrayTexture));
+            packedTextureCount += slices.size();
+        } CATCH_PRINT_ERROR(;)
+    }
+
+    if(!m_TextureArrays.empty())
+    {
+        LogInfoF(L"Packed {} textures into {} texture arrays.", packedTextureCount, m_TextureArrays.size());
+    }
+}
+
+Descriptor Renderer::GetTextureDescriptor(size_t textureIndex, StandardTexture standardTexture,
+    uint32_t& outArraySlice) const
+{
+    outArraySlice = 0;
+    if(textureIndex != SIZE_MAX)
+    {
+        const Scene::Texture& tex = m_Textures[textureIndex];
+        if(tex.m_ArrayIndex != SIZE_MAX)
+        {
+            outArraySlice = tex.m_ArraySlice;
+            return m_TextureArrays[tex.m_ArrayIndex]->GetDescriptor();
+        }
+        if(tex.m_Texture)
+            return tex.m_Texture->GetDescriptor();
+    }
+    return m_StandardTextures[(size_t)standardTexture]->GetDescriptor();
+}
+
+void Renderer::CreateMaterialRecords()
+{
+    if(!m_BindlessEnabled || m_Materials.empty())
+        return;
+
+    ERR_TRY;
+
+    const uint32_t recordCount = (uint32_t)m_Materials.size();
+    const uint32_t copyCount = g_FrameCount.GetValue();
+    m_MaterialTable.Init(sizeof(MaterialRecord), recordCount, copyCount);
+
+    D3D12MA::ALLOCATION_DESC allocDesc = {};
+    allocDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+    const D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Buffer(
+        (UINT64)sizeof(MaterialRecord) * recordCount * copyCount);
+    CHECK_HR(m_MemoryAllocator->CreateResource(&allocDesc, &resDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr, // pOptimizedClearValue
+        &m_MaterialRecordBuffer,
+        IID_NULL, nullptr)); // riidResource, ppvResource
+    SetD3D12ObjectName(m_MaterialRecordBuffer->GetResource(), L"Material records");
+    CHECK_HR(m_MaterialRecordBuffer->GetResource()->Map(0, D3D12_RANGE_NONE, &m_MaterialRecordBufferMappedPtr));
+
+    m_SRVDescriptorManager->AllocatePersistentMovable(copyCount, m_MaterialRecordDescriptors);
+    for(uint32_t copyIndex = 0; copyIndex < copyCount; ++copyIndex)
+    {
+        const D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {
+            .Format = DXGI_FORMAT_UNKNOWN,
+            .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Buffer = {
+                .FirstElement = (UINT64)copyIndex * recordCount,
+                .NumElements = recordCount,
+                .StructureByteStride = sizeof(MaterialRecord)}};
+        m_Device->CreateShaderResourceView(m_MaterialRecordBuffer->GetResource(), &SRVDesc,
+            m_SRVDescriptorManager->GetCPUHandle(m_MaterialRecordDescriptors, copyIndex));
+    }
+
+    ERR_CATCH_FUNC;
+}
+
+void Renderer::DestroyMaterialRecords()
+{
+    if(!m_MaterialRecordDescriptors.IsNull())
+        m_SRVDescriptorManager->FreePersistent(m_MaterialRecordDescriptors);
+    m_MaterialRecordDescriptors = {};
+    if(m_MaterialRecordBufferMappedPtr)
+        m_MaterialRecordBuffer->GetResource()->Unmap(0, D3D12_RANGE_ALL);
+    m_MaterialRecordBufferMappedPtr = nullptr;
+    m_MaterialRecordBuffer.Reset();
+    m_MaterialTable.Clear();
+    m_LastFrameMaterialRecordWriteCount = 0;
+}
+
+void Renderer::GetMaterialRecord(size_t materialIndex, MaterialRecord& outRecord) const
+{
+    const Scene::Material& mat = m_Materials[materialIndex];
+    const uint32_t materialFlags = GetGBufferPipelineFlags(mat.m_Flags);
+
+    outRecord = {};
+    outRecord.m_Flags = GetMaterialShaderFlags(materialFlags);
+    if((materialFlags & Scene::Material::FLAG_ALPHA_MASK) != 0)
+        outRecord.m_AlphaCutoff = mat.m_AlphaCutoff;
+    if((materialFlags & Scene::Material::FLAG_HAS_MATERIAL_COLOR) != 0)
+        outRecord.m_Color = mat.m_Color;
+    if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
+    {
+        const Descriptor desc = GetTextureDescriptor(
+            mat.m_AlbedoTextureIndex, StandardTexture::Gray, outRecord.m_AlbedoTextureSlice);
+        outRecord.m_AlbedoTextureIndex = (uint32_t)desc.m_Index;
+        outRecord.m_AlbedoSamplerIndex = StandardSamplers::GetIndex(
+            D3D12_FILTER_ANISOTROPIC, mat.m_AlbedoTextureAddressMode);
+    }
+    if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
+    {
+        const Descriptor desc = GetTextureDescriptor(
+            mat.m_NormalTextureIndex, StandardTexture::EmptyNormal, outRecord.m_NormalTextureSlice);
+        outRecord.m_NormalTextureIndex = (uint32_t)desc.m_Index;
+        outRecord.m_NormalSamplerIndex = StandardSamplers::GetIndex(
+            D3D12_FILTER_ANISOTROPIC, mat.m_NormalTextureAddressMode);
+    }
+}
+
+void Renderer::UpdateMaterialRecords()
+{
+    const uint32_t recordCount = m_MaterialTable.GetRecordCount();
+    if(recordCount == 0)
+        return;
+
+    // Unchanged records are only compared, so in a steady state nothing is written to the buffer.
+    for(uint32_t recordIndex = 0; recordIndex < recordCount; ++recordIndex)
+    {
+        MaterialRecord record;
+        GetMaterialRecord(recordIndex, record);
+        m_MaterialTable.SetRecord(recordIndex, &record);
+    }
+
+    m_LastFrameMaterialRecordWriteCount = m_MaterialTable.TakeDirtyRanges(m_FrameIndex, m_MaterialRecordDirtyRanges);
+    char* const copyPtr = (char*)m_MaterialRecordBufferMappedPtr + (size_t)m_FrameIndex * recordCount * sizeof(MaterialRecord);
+    for(const BindlessMaterialTable::Range& range : m_MaterialRecordDirtyRanges)
+    {
+        memcpy(copyPtr + (size_t)range.m_FirstRecord * sizeof(MaterialRecord),
+            m_MaterialTable.GetRecord(range.m_FirstRecord),
+            (size_t)range.m_RecordCount * sizeof(MaterialRecord));
+    }
+}
+
+void Renderer::SetPackedMaterialConstants(CommandList& cmdList)
+{
+    if(m_Materials.empty())
+        return;
+
+    void* mappedPtr = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS GPUAddr = 0;
+    m_TemporaryConstantBufferManager->CreateBuffer((uint32_t)(m_Materials.size() * sizeof(PerMaterialConstants)),
+        mappedPtr, GPUAddr);
+    PerMaterialConstants* const packedMaterialConstants = (PerMaterialConstants*)mappedPtr;
+
+    for(size_t materialIndex = 0; materialIndex < m_Materials.size(); ++materialIndex)
+    {
+        const Scene::Material& mat = m_Materials[materialIndex];
+        const uint32_t materialFlags = GetGBufferPipelineFlags(mat.m_Flags);
+
+        // Textures in arrays are selected by slice index.
+        PerMaterialConstants perMaterialConstants = {};
+        perMaterialConstants.m_Flags = GetMaterialShaderFlags(materialFlags);
+        if((materialFlags & Scene::Material::FLAG_ALPHA_MASK) != 0)
+            perMaterialConstants.m_AlphaCutoff = mat.m_AlphaCutoff;
+        if((materialFlags & Scene::Material::FLAG_HAS_MATERIAL_COLOR) != 0)
+            perMaterialConstants.m_Color = mat.m_Color;
+        if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
+        {
+            GetTextureDescriptor(mat.m_AlbedoTextureIndex, StandardTexture::Gray,
+                perMaterialConstants.m_AlbedoTextureSlice);
+        }
+        if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
+        {
+            GetTextureDescriptor(mat.m_NormalTextureIndex, StandardTexture::EmptyNormal,
+                perMaterialConstants.m_NormalTextureSlice);
+        }
+        memcpy(packedMaterialConstants + materialIndex, &perMaterialConstants, sizeof(perMaterialConstants));
+    }
+
+    cmdList.SetGraphicsRootShaderResourceView(
+        m_StandardRootSignature->GetPackedSRVParamIndex(1), GPUAddr);
+}
+
 void Renderer::CreateProceduralModel()
 {
     ClearModel();
@@ -1557,7 +2352,7 @@ void Renderer::CreateProceduralModel()
 
     wstring normalTexturePath = ConvertCharsToUnicode(g_NormalTexturePath.GetValue(), CP_UTF8);
     Scene::Material mat;
-    mat.m_NormalTextureIndex = TryLoadTexture(normalTexturePath, StrToPath(normalTexturePath), false, true);
+    mat.m_NormalTextureIndex = TryLoadTexture(normalTexturePath, StrToPath(normalTexturePath), Texture::FLAG_NORMAL_MAP, true);
     m_Materials.push_back(mat);
 
     Vertex vertices[] = {
@@ -1600,6 +2395,90 @@ void Renderer::WaitForFenceOnCPU(UINT64 value)
 	}
 }
 
+void Renderer::UpdateTextureStreaming(CommandList& cmdList)
+{
+    // Local memory is where textures live, also the only one on UMA.
+    D3D12MA::Budget localBudget = {};
+    m_MemoryAllocator->GetBudget(&localBudget, nullptr);
+
+    FrameVector<TextureStreamer::Change> changes(FrameAlloc());
+    m_TextureStreamer->CalculateChanges(m_Textures, localBudget.UsageBytes, localBudget.BudgetBytes, changes);
+
+    // Frames in flight keep using the previous textures until this frame finishes on the GPU.
+    std::vector<ComPtr<D3D12MA::Allocation>>& retiredAllocations = m_FrameResources[m_FrameIndex].m_RetiredAllocations;
+    for(const TextureStreamer::Change& change : changes)
+    {
+        try
+        {
+            m_Textures[change.m_TextureIndex].m_Texture->SetFirstResidentMip(change.m_FirstResidentMip,
+                cmdList, retiredAllocations);
+        } CATCH_PRINT_ERROR(;)
+    }
+}
+
+std::array<DescriptorManager*, 4> Renderer::GetDescriptorManagers()
+{
+    return {m_SRVDescriptorManager.get(), m_SamplerDescriptorManager.get(),
+        m_RTVDescriptorManager.get(), m_DSVDescriptorManager.get()};
+}
+
+void Renderer::DefragmentDescriptors()
+{
+    bool requested = false;
+    for(DescriptorManager* descMngr : GetDescriptorManagers())
+        requested = requested || descMngr->IsDefragmentationRequested();
+    if(!requested)
+        return;
+
+    // Descriptors are moved, so no frame in flight can be using them.
+    CHECK_HR(m_CmdQueue->Signal(m_Fence.Get(), m_NextFenceValue));
+    WaitForFenceOnCPU(m_NextFenceValue++);
+
+    for(DescriptorManager* descMngr : GetDescriptorManagers())
+    {
+        if(descMngr->IsDefragmentationRequested())
+            descMngr->Defragment();
+    }
+}
+
+void Renderer::RequestTextureStreaming(const mat4& worldXform, size_t meshIndex)
+{
+    const Scene::Mesh& mesh = m_Meshes[meshIndex];
+    if(mesh.m_UVDensity <= 0.f)
+        return;
+    const Scene::Material& mat = m_Materials[mesh.m_MaterialIndex];
+    if(mat.m_AlbedoTextureIndex == SIZE_MAX && mat.m_NormalTextureIndex == SIZE_MAX)
+        return;
+
+    const float scale = std::max(std::max(
+        glm::length(vec3(worldXform[0])), glm::length(vec3(worldXform[1]))), glm::length(vec3(worldXform[2])));
+    const vec3 center_View = Transform(m_Camera->GetView() * worldXform, mesh.m_BoundingSphereCenter);
+    const float radius = mesh.m_BoundingSphereRadius * scale;
+
+    const float zNear = m_Camera->GetZNear();
+    const float tanHalfFovY = tan(m_Camera->GetFovY() * 0.5f);
+    if(!IsSphereInFrustum(center_View, radius, tanHalfFovY * m_Camera->GetAspectRatio(), tanHalfFovY, zNear))
+        return;
+
+    const float projectionScale = CalculateProjectionScale(m_Camera->GetFovY(), GetFinalResolutionF().y);
+    const float distance = std::max(glm::length(center_View) - radius, zNear);
+    // Radius of the object on screen in pixels.
+    const float priority = radius * projectionScale / distance;
+
+    for(size_t textureIndex : {mat.m_AlbedoTextureIndex, mat.m_NormalTextureIndex})
+    {
+        if(textureIndex == SIZE_MAX)
+            continue;
+        const Texture* const texture = m_Textures[textureIndex].m_Texture.get();
+        if(!texture || !texture->IsStreaming())
+            continue;
+        const uvec2 textureSize = texture->GetFullSize();
+        const float mip = EstimateRequiredMip((float)std::max(textureSize.x, textureSize.y),
+            mesh.m_UVDensity / scale, distance, projectionScale);
+        m_TextureStreamer->RequestMip(textureIndex, mip, priority);
+    }
+}
+
 void Renderer::RenderEntity(CommandList& cmdList, const mat4& parentXform, const Scene::Entity& entity)
 {
     // I thought this is the right way
@@ -1613,17 +2492,15 @@ void Renderer::RenderEntity(CommandList& cmdList, const mat4& parentXform, const
         perObjConstants.m_WorldViewProj = m_Camera->GetViewProjection() * entityXform;
         perObjConstants.m_WorldView = m_Camera->GetView() * entityXform;
 
-        void* perObjectConstantsPtr = nullptr;
-        D3D12_GPU_DESCRIPTOR_HANDLE perObjectConstantsDescriptorHandle;
-        m_TemporaryConstantBufferManager->CreateBuffer(sizeof(perObjConstants), perObjectConstantsPtr, perObjectConstantsDescriptorHandle);
-        memcpy(perObjectConstantsPtr, &perObjConstants, sizeof(perObjConstants));
-
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetCBVParamIndex(1),
-            perObjectConstantsDescriptorHandle);
+        assert(m_PackedObjectCount < m_PackedObjectCapacity);
+        const uint32_t objectIndex = m_PackedObjectCount++;
+        memcpy(m_PackedObjectConstants + objectIndex, &perObjConstants, sizeof(perObjConstants));
 
         for(size_t meshIndex : entity.m_Meshes)
-            RenderEntityMesh(cmdList, entity, meshIndex);
+        {
+            RequestTextureStreaming(entityXform, meshIndex);
+            RenderEntityMesh(cmdList, entity, meshIndex, objectIndex);
+        }
     }
 
     for(const auto& childEntity : entity.m_Children)
@@ -1633,116 +2510,70 @@ void Renderer::RenderEntity(CommandList& cmdList, const mat4& parentXform, const
     }
 }
 
-void Renderer::RenderEntityMesh(CommandList& cmdList, const Scene::Entity& entity, size_t meshIndex)
+void Renderer::RenderEntityMesh(CommandList& cmdList, const Scene::Entity& entity, size_t meshIndex, uint32_t objectIndex)
 {
     const Mesh* const mesh = m_Meshes[meshIndex].m_Mesh.get();
     const size_t materialIndex = m_Meshes[meshIndex].m_MaterialIndex;
     assert(materialIndex < m_Materials.size());
     const Scene::Material& mat = m_Materials[materialIndex];
 
-    uint32_t materialFlags = mat.m_Flags;
-    if(!g_BackfaceCullingEnabled.GetValue())
-        materialFlags |= Scene::Material::FLAG_TWOSIDED;
-    if(!g_AlbedoTexturesEnabled.GetValue())
-        materialFlags &= ~Scene::Material::FLAG_HAS_ALBEDO_TEXTURE;
-    if(!g_NormalMapsEnabled.GetValue())
-        materialFlags &= ~Scene::Material::FLAG_HAS_NORMAL_TEXTURE;
-
+    const uint32_t materialFlags = GetGBufferPipelineFlags(mat.m_Flags);
     ID3D12PipelineState* const pso = GetOrCreateGBufferPipelineState(materialFlags);
 
     if(!pso)
         return;
     cmdList.SetPipelineState(pso);
 
-    // Per material constant buffer
-    {
-        PerMaterialConstants perMaterialConstants = {};
-        perMaterialConstants.m_Flags = 0;
-        if((materialFlags & Scene::Material::FLAG_TWOSIDED) != 0)
-            perMaterialConstants.m_Flags |= MATERIAL_FLAG_TWOSIDED;
-        if((materialFlags & Scene::Material::FLAG_ALPHA_MASK) != 0)
-        {
-            perMaterialConstants.m_Flags |= MATERIAL_FLAG_ALPHA_MASK;
-            perMaterialConstants.m_AlphaCutoff = mat.m_AlphaCutoff;
-        }
-        if((materialFlags & Scene::Material::FLAG_HAS_MATERIAL_COLOR) != 0)
-        {
-            perMaterialConstants.m_Flags |= MATERIAL_FLAG_HAS_MATERIAL_COLOR;
-            perMaterialConstants.m_Color = mat.m_Color;
-        }
-        if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
-            perMaterialConstants.m_Flags |= MATERIAL_FLAG_HAS_ALBEDO_TEXTURE;
-        if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
-            perMaterialConstants.m_Flags |= MATERIAL_FLAG_HAS_NORMAL_TEXTURE;
-
-        void* perMaterialConstantsPtr = nullptr;
-        D3D12_GPU_DESCRIPTOR_HANDLE perMaterialConstantsDescriptorHandle;
-        m_TemporaryConstantBufferManager->CreateBuffer(sizeof(perMaterialConstants), perMaterialConstantsPtr, perMaterialConstantsDescriptorHandle);
-        memcpy(perMaterialConstantsPtr, &perMaterialConstants, sizeof(perMaterialConstants));
+    // Constants of the object and the material are in packed buffers set for the whole pass.
+    const PerDrawConstants perDrawConstants = {
+        .m_ObjectIndex = objectIndex,
+        .m_MaterialIndex = (uint32_t)materialIndex};
+    cmdList.SetGraphicsRoot32BitConstants(
+        m_StandardRootSignature->GetPerDrawConstantsParamIndex(),
+        StandardRootSignature::PER_DRAW_CONSTANT_COUNT, &perDrawConstants, 0);
 
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetCBVParamIndex(2),
-            perMaterialConstantsDescriptorHandle);
-    }
-
-    if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
+    // In the bindless path, textures and samplers are selected by indices in the material record.
+    if(!m_BindlessEnabled)
     {
-        Texture* albedoTexture = (mat.m_AlbedoTextureIndex != SIZE_MAX && g_AlbedoTexturesEnabled.GetValue()) ?
-            m_Textures[mat.m_AlbedoTextureIndex].m_Texture.get() : nullptr;
-        D3D12_GPU_DESCRIPTOR_HANDLE albedoTextureDescriptorHandle;
-        if(albedoTexture)
-        {
-            albedoTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
-                m_Textures[mat.m_AlbedoTextureIndex].m_Texture->GetDescriptor());
-        }
-        else
-        {
-            albedoTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
-                m_StandardTextures[(size_t)StandardTexture::Gray]->GetDescriptor());
-        }
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetSRVParamIndex(0), albedoTextureDescriptorHandle);
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetSamplerParamIndex(0),
-            m_StandardSamplers.GetD3D12(D3D12_FILTER_ANISOTROPIC, mat.m_AlbedoTextureAddressMode));
-    }
+        uint32_t albedoTextureSlice = 0, normalTextureSlice = 0;
+        const D3D12_GPU_DESCRIPTOR_HANDLE albedoTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
+            GetTextureDescriptor(mat.m_AlbedoTextureIndex, StandardTexture::Gray, albedoTextureSlice));
+        const D3D12_GPU_DESCRIPTOR_HANDLE normalTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
+            GetTextureDescriptor(mat.m_NormalTextureIndex, StandardTexture::EmptyNormal, normalTextureSlice));
 
-    if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
-    {
-        Texture* normalTexture = mat.m_NormalTextureIndex != SIZE_MAX ?
-            m_Textures[mat.m_NormalTextureIndex].m_Texture.get() : nullptr;
-        D3D12_GPU_DESCRIPTOR_HANDLE normalTextureDescriptorHandle;
-        if(normalTexture)
+        if((materialFlags & Scene::Material::FLAG_HAS_ALBEDO_TEXTURE) != 0)
         {
-            normalTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
-                m_Textures[mat.m_NormalTextureIndex].m_Texture->GetDescriptor());
+            cmdList.SetGraphicsRootDescriptorTable(
+                m_StandardRootSignature->GetSRVParamIndex(0), albedoTextureDescriptorHandle);
+            cmdList.SetGraphicsRootDescriptorTable(
+                m_StandardRootSignature->GetSamplerParamIndex(0),
+                m_StandardSamplers.GetD3D12(D3D12_FILTER_ANISOTROPIC, mat.m_AlbedoTextureAddressMode));
         }
-        else
+
+        if((materialFlags & Scene::Material::FLAG_HAS_NORMAL_TEXTURE) != 0)
         {
-            normalTextureDescriptorHandle = m_SRVDescriptorManager->GetGPUHandle(
-                m_StandardTextures[(size_t)StandardTexture::EmptyNormal]->GetDescriptor());
+            cmdList.SetGraphicsRootDescriptorTable(
+                m_StandardRootSignature->GetSRVParamIndex(1), normalTextureDescriptorHandle);
+            cmdList.SetGraphicsRootDescriptorTable(
+                m_StandardRootSignature->GetSamplerParamIndex(1),
+                m_StandardSamplers.GetD3D12(D3D12_FILTER_ANISOTROPIC, mat.m_NormalTextureAddressMode));
         }
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetSRVParamIndex(1), normalTextureDescriptorHandle);
-        cmdList.GetCmdList()->SetGraphicsRootDescriptorTable(
-            m_StandardRootSignature->GetSamplerParamIndex(1),
-            m_StandardSamplers.GetD3D12(D3D12_FILTER_ANISOTROPIC, mat.m_NormalTextureAddressMode));
     }
 
     cmdList.SetPrimitiveTopology(mesh->GetTopology());
 
     const D3D12_VERTEX_BUFFER_VIEW vbView = mesh->GetVertexBufferView();
-    cmdList.GetCmdList()->IASetVertexBuffers(0, 1, &vbView);
+    cmdList.SetVertexBuffers(0, 1, &vbView);
 
     if(mesh->HasIndices())
     {
         const D3D12_INDEX_BUFFER_VIEW ibView = mesh->GetIndexBufferView();
-        cmdList.GetCmdList()->IASetIndexBuffer(&ibView);
+        cmdList.SetIndexBuffer(&ibView);
     	cmdList.GetCmdList()->DrawIndexedInstanced(mesh->GetIndexCount(), 1, 0, 0, 0);
     }
     else
     {
-        cmdList.GetCmdList()->IASetIndexBuffer(nullptr);
+        cmdList.SetIndexBuffer(nullptr);
     	cmdList.GetCmdList()->DrawInstanced(mesh->GetVertexCount(), 1, 0, 0);
     }
 }
@@ -1775,7 +2606,7 @@ void StandardSamplers::Init()
 
     assert(g_Renderer && g_Renderer->GetSamplerDescriptorManager());
     DescriptorManager* descMngr = g_Renderer->GetSamplerDescriptorManager();
-    m_Descriptors = descMngr->AllocatePersistent(COUNT);
+    descMngr->AllocatePersistentMovable(COUNT, m_Descriptors);
 
     const uint32_t maxAnisotropy = g_MaxAnisotropy.GetValue();
     CHECK_BOOL(maxAnisotropy <= 16);
@@ -1821,7 +2652,7 @@ StandardSamplers::~StandardSamplers()
     g_Renderer->GetSamplerDescriptorManager()->FreePersistent(m_Descriptors);
 }
 
-Descriptor StandardSamplers::Get(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address) const
+uint32_t StandardSamplers::GetIndex(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address)
 {
     uint32_t index = 0;
     switch(filter)
@@ -1840,9 +2671,13 @@ Descriptor StandardSamplers::Get(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE
     case D3D12_TEXTURE_ADDRESS_MODE_CLAMP: index += 1; break;
     default: assert(0);
     }
+    return index;
+}
 
+Descriptor StandardSamplers::Get(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address) const
+{
     Descriptor result = m_Descriptors;
-    result.m_Index += index;
+    result.m_Index += GetIndex(filter, address);
     return result;
 }
 
@@ -1853,6 +2688,12 @@ D3D12_GPU_DESCRIPTOR_HANDLE StandardSamplers::GetD3D12(D3D12_FILTER filter, D3D1
     return g_Renderer->GetSamplerDescriptorManager()->GetGPUHandle(desc);
 }
 
+D3D12_GPU_DESCRIPTOR_HANDLE StandardSamplers::GetD3D12Table() const
+{
+    assert(g_Renderer && g_Renderer->GetSamplerDescriptorManager());
+    return g_Renderer->GetSamplerDescriptorManager()->GetGPUHandle(m_Descriptors);
+}
+
 #endif // #ifndef _STANDARD_SAMPLERS_IMPL
 
 void AssimpPrint(const wstr_view& filePath)
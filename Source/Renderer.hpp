@@ -1,17 +1,20 @@
 #pragma once
 
 #include "Descriptors.hpp"
+#include "Shaders.hpp"
+#include "CommandList.hpp"
+#include "BindlessMaterialTable.hpp"
 #include <unordered_map>
 
 class AssimpInit;
 
-class CommandList;
 class RenderingResource;
 class Texture;
+class TextureStreamer;
 class Mesh;
 class TemporaryConstantBufferManager;
-class Shader;
-class MultiShader;
+class FrameArena;
+class PipelineStateCompiler;
 class ShaderCompiler;
 class OrbitingCamera;
 class FlyingCamera;
@@ -21,6 +24,9 @@ struct aiNode;
 struct aiMesh;
 struct aiMaterial;
 
+struct PerObjectConstants;
+struct MaterialRecord;
+
 enum class GBuffer
 {
     Albedo,
@@ -35,6 +41,7 @@ enum class StandardTexture
 
 struct RendererCapabilities
 {
+    D3D12_RESOURCE_BINDING_TIER m_ResourceBindingTier = D3D12_RESOURCE_BINDING_TIER_1;
 };
 
 struct D3D12DeviceDeleter
@@ -56,14 +63,19 @@ X
 class StandardSamplers
 {
 public:
+    static constexpr size_t COUNT = 4 * 2;
+
     void Init();
     ~StandardSamplers();
     
+    // Index of the sampler in the table of all COUNT samplers, as used by the bindless path.
+    static uint32_t GetIndex(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address);
     Descriptor Get(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address) const;
     D3D12_GPU_DESCRIPTOR_HANDLE GetD3D12(D3D12_FILTER filter, D3D12_TEXTURE_ADDRESS_MODE address) const;
+    // Table of all COUNT samplers.
+    D3D12_GPU_DESCRIPTOR_HANDLE GetD3D12Table() const;
 
 private:
-    static constexpr size_t COUNT = 4 * 2;
     Descriptor m_Descriptors;
 };
 
@@ -75,8 +87,11 @@ struct Texture
     // Just for display to the user.
     wstring m_Title;
     wstring m_ProcessedPath;
-    // Can be null - use some standard texture then.
+    // Can be null - use some standard texture then, unless the texture was moved to an array.
     unique_ptr<::Texture> m_Texture;
+    // Index into Renderer::m_TextureArrays, or SIZE_MAX if not in an array.
+    size_t m_ArrayIndex = SIZE_MAX;
+    uint32_t m_ArraySlice = 0;
 };
 
 struct Material
@@ -118,6 +133,11 @@ struct Mesh
     wstring m_Title;
     unique_ptr<::Mesh> m_Mesh;
     size_t m_MaterialIndex = SIZE_MAX;
+    // In local space of the mesh.
+    vec3 m_BoundingSphereCenter = vec3(0.f);
+    float m_BoundingSphereRadius = 0.f;
+    // Texture coordinate units per local space unit. See ComputeUVDensity.
+    float m_UVDensity = 0.f;
 };
 
 struct Entity
@@ -136,6 +156,15 @@ It offers:
 - CBV b0..b7, each separate DESCRIPTOR_TABLE, visible to ALL shader stages.
 - SRV t0..t7, each separate DESCRIPTOR_TABLE, visible to PIXEL shader stage.
 - Sampler s0..s3, each separate DESCRIPTOR_TABLE, visible to PIXEL shader stages.
+- CBV b8: PER_DRAW_CONSTANT_COUNT 32-bit root constants, visible to ALL shader stages.
+  Indices changing with every draw, e.g. into buffers below, are passed this way without a constant buffer.
+- SRV t0..t1, space2, each separate root descriptor, visible to ALL shader stages.
+  For structured buffers of tightly packed per-object and per-material data, bound by GPU address once per pass.
+
+When created for the bindless path, also:
+- SRV t0..unbounded, space1, one DESCRIPTOR_TABLE starting at the persistent section of the SRV heap,
+  visible to PIXEL shader stage. Requires resource binding tier 2.
+- Sampler s0..s7, space1, one DESCRIPTOR_TABLE for all StandardSamplers, visible to PIXEL shader stage.
 
 Flags:
 ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
@@ -146,16 +175,24 @@ DENY_GEOMETRY_SHADER_ROOT_ACCESS
 class StandardRootSignature
 {
 public:
-    StandardRootSignature();
+    explicit StandardRootSignature(bool bindless);
     ID3D12RootSignature* GetRootSignature() const { return m_RootSignature.Get(); }
     static uint32_t GetCBVParamIndex(uint32_t CBVIndex) { return CBVIndex; }
     static uint32_t GetSRVParamIndex(uint32_t SRVIndex) { return SRVIndex + CBV_COUNT; }
     static uint32_t GetSamplerParamIndex(uint32_t samplerIndex) { return samplerIndex + CBV_COUNT + SRV_COUNT; }
+    static uint32_t GetPerDrawConstantsParamIndex() { return CBV_COUNT + SRV_COUNT + SAMPLER_COUNT; }
+    static uint32_t GetPackedSRVParamIndex(uint32_t packedSRVIndex) { return packedSRVIndex + CBV_COUNT + SRV_COUNT + SAMPLER_COUNT + 1; }
+    // Valid only if created with bindless = true.
+    static uint32_t GetBindlessSRVParamIndex() { return CBV_COUNT + SRV_COUNT + SAMPLER_COUNT + 1 + PACKED_SRV_COUNT; }
+    static uint32_t GetBindlessSamplerParamIndex() { return CBV_COUNT + SRV_COUNT + SAMPLER_COUNT + 1 + PACKED_SRV_COUNT + 1; }
+
+    static constexpr uint32_t PER_DRAW_CONSTANT_COUNT = 2;
 
 private:
     static constexpr uint32_t CBV_COUNT = 8;
     static constexpr uint32_t SRV_COUNT = 8;
     static constexpr uint32_t SAMPLER_COUNT = 4;
+    static constexpr uint32_t PACKED_SRV_COUNT = 2;
 
     ComPtr<ID3D12RootSignature> m_RootSignature;
 };
@@ -173,6 +210,8 @@ public:
     std::vector<Scene::Mesh> m_Meshes;
     std::vector<Scene::Material> m_Materials;
     std::vector<Scene::Texture> m_Textures;
+    // Small textures merged by PackTextureArrays. Referenced by Scene::Texture::m_ArrayIndex.
+    std::vector<unique_ptr<Texture>> m_TextureArrays;
 
 	Renderer(IDXGIFactory4* dxgiFactory, IDXGIAdapter1* adapter, HWND wnd);
 	void Init();
@@ -188,6 +227,7 @@ public:
     DescriptorManager* GetRTVDescriptorManager() { return m_RTVDescriptorManager.get(); }
     DescriptorManager* GetDSVDescriptorManager() { return m_DSVDescriptorManager.get(); }
     TemporaryConstantBufferManager* GetTemporaryConstantBufferManager() { return m_TemporaryConstantBufferManager.get(); }
+    FrameArena* GetFrameArena() { return m_FrameArena.get(); }
     StandardSamplers* GetStandardSamplers() { return &m_StandardSamplers; }
     ShaderCompiler* GetShaderCompiler() { return m_ShaderCompiler.get(); }
     FlyingCamera* GetCamera() { return m_Camera.get(); }
@@ -200,6 +240,11 @@ public:
     void CompleteUploadCommandList(CommandList& cmdList);
 
     void ImGui_D3D12MAStatistics();
+    void ImGui_TextureStreamingStatistics();
+    void ImGui_PipelineStateStatistics();
+    void ImGui_TemporaryAllocatorStatistics();
+    void ImGui_DescriptorStatistics();
+    void ImGui_CommandListStatistics();
 	void Render();
 
 private:
@@ -209,6 +254,8 @@ private:
 		ComPtr<ID3D12GraphicsCommandList> m_CmdList;
 		unique_ptr<RenderingResource> m_BackBuffer;
 		UINT64 m_SubmittedFenceValue = 0;
+        // Resources replaced while recording this frame, released when it is finished on the GPU.
+        std::vector<ComPtr<D3D12MA::Allocation>> m_RetiredAllocations;
 	};
 
 	IDXGIFactory4* const m_DXGIFactory;
@@ -231,8 +278,11 @@ private:
     unique_ptr<DescriptorManager> m_RTVDescriptorManager;
     unique_ptr<DescriptorManager> m_DSVDescriptorManager;
     unique_ptr<TemporaryConstantBufferManager> m_TemporaryConstantBufferManager;
+    unique_ptr<FrameArena> m_FrameArena;
+    CommandListStatistics m_LastFrameCommandListStatistics;
     StandardSamplers m_StandardSamplers;
     unique_ptr<ShaderCompiler> m_ShaderCompiler;
+    unique_ptr<TextureStreamer> m_TextureStreamer;
 	std::array<FrameResources, MAX_FRAME_COUNT> m_FrameResources;
 	unique_ptr<RenderingResource> m_DepthTexture;
 	UINT m_FrameIndex = UINT32_MAX;
@@ -241,19 +291,60 @@ private:
     unique_ptr<RenderingResource> m_GBuffers[(size_t)GBuffer::Count];
     unique_ptr<RenderingResource> m_ColorRenderTarget;
     unique_ptr<StandardRootSignature> m_StandardRootSignature;
+    unique_ptr<Shader> m_GBufferVertexShader;
     unique_ptr<MultiShader> m_GBufferMultiPixelShader;
     uint32_t m_NextD3D12MAJSONDumpIndex = 0;
 
-    // Key is combination of Scene::Material::FLAG_*.
-    // Value null means the PSO couldn't be created due to error, which has been printed to the log.
-    using GBufferPipelineStateMapType = std::unordered_map<uint32_t, ComPtr<ID3D12PipelineState>>;
-    GBufferPipelineStateMapType m_GBufferPipelineStates;
+    // Setting "Renderer.Bindless.Enabled", if supported by the device.
+    bool m_BindlessEnabled = false;
+    // Bindless path: MaterialRecord of every material. Created by LoadModel, empty when there are no materials.
+    BindlessMaterialTable m_MaterialTable;
+    // Copies of m_MaterialTable, one per frame, indexed by m_FrameIndex. Persistently mapped.
+    ComPtr<D3D12MA::Allocation> m_MaterialRecordBuffer;
+    void* m_MaterialRecordBufferMappedPtr = nullptr;
+    // Structured buffer SRVs of copies in m_MaterialRecordBuffer.
+    Descriptor m_MaterialRecordDescriptors;
+    std::vector<BindlessMaterialTable::Range> m_MaterialRecordDirtyRanges;
+    uint32_t m_LastFrameMaterialRecordWriteCount = 0;
+
+    // PerObjectConstants of objects drawn by the G-buffer pass in the current frame, in a temporary buffer,
+    // indexed by per-draw constant ObjectIndex. Allocated for all visible objects at the start of the pass.
+    PerObjectConstants* m_PackedObjectConstants = nullptr;
+    uint32_t m_PackedObjectCount = 0;
+    uint32_t m_PackedObjectCapacity = 0;
+
+    struct GBufferPipelineState
+    {
+        // Null when not created yet or the PSO couldn't be created due to error, which has been printed to the log.
+        ComPtr<ID3D12PipelineState> m_PipelineState;
+        bool m_Created = false;
+    };
+    // Number of combinations of Scene::Material::FLAG_*.
+    static constexpr uint32_t GBUFFER_PIPELINE_STATE_COUNT = 32;
+    // Indexed by combination of Scene::Material::FLAG_*, which is also
+    // permutation index of m_GBufferMultiPixelShader * 2 + FLAG_TWOSIDED.
+    std::array<GBufferPipelineState, GBUFFER_PIPELINE_STATE_COUNT> m_GBufferPipelineStates;
+    // When started, it is the only user of m_GBufferVertexShader and m_GBufferMultiPixelShader.
+    unique_ptr<PipelineStateCompiler> m_GBufferPipelineStateCompiler;
+    // Used while the right PSO is being created by m_GBufferPipelineStateCompiler. Can be null.
+    ComPtr<ID3D12PipelineState> m_GBufferFallbackPipelineState;
+    uint32_t m_GBufferFallbackDrawCount = 0;
+    uint64_t m_RenderedFrameCount = 0;
+    // Made by the main thread during the last Render, see HeapAllocationCounter.hpp.
+    uint64_t m_LastFrameHeapAllocationCount = 0;
+    // Frames after HEAP_CHECK_WARMUP_FRAME_COUNT that allocated from the heap. Should stay 0.
+    uint64_t m_SteadyStateHeapAllocationFrameCount = 0;
+    // Value of setting "BackFaceCullingMode" used by m_GBufferPipelineStates.
+    uint32_t m_GBufferBackFaceCullingMode = 0;
     
     unique_ptr<AssimpInit> m_AssimpInit;
     unique_ptr<FlyingCamera> m_Camera;
 	ComPtr<ID3D12PipelineState> m_AmbientPipelineState;
 	ComPtr<ID3D12PipelineState> m_LightingPipelineState;
 	ComPtr<ID3D12PipelineState> m_PostprocessingPipelineState;
+    // Used by Reload to recreate only pipeline states whose shaders changed.
+    ShaderDependencies m_LightingShaderDependencies;
+    ShaderDependencies m_PostprocessingShaderDependencies;
     Descriptor m_ImGuiDescriptor;
 
     void EnableDebugLayer();
@@ -265,7 +356,20 @@ private:
 	void CreateSwapChain();
 	void CreateFrameResources();
 	void CreateResources();
-    ID3D12PipelineState* GetOrCreateGBufferPipelineState(uint32_t materialFlags);
+    // Returns material flags with debug settings applied, which select the G-buffer PSO.
+    static uint32_t GetGBufferPipelineFlags(uint32_t materialFlags);
+    // Compiles m_GBufferVertexShader on first use.
+    const Shader& GetGBufferVertexShader();
+    // Thread-safe. Throws on error.
+    ComPtr<ID3D12PipelineState> CreateGBufferPipelineState(uint32_t flags, const Shader& vs, const Shader& ps);
+    // When m_GBufferPipelineStateCompiler is started, returns fallback PSO or null until the right one is created.
+    ID3D12PipelineState* GetOrCreateGBufferPipelineState(uint32_t flags);
+    void StartGBufferPipelineStateCompiler();
+    void StopGBufferPipelineStateCompiler();
+    // Moves PSOs completed by m_GBufferPipelineStateCompiler to m_GBufferPipelineStates.
+    void TakeCompletedGBufferPipelineStates();
+    // Creates G-buffer shader permutations and PSOs used by loaded materials, or all of them, in parallel.
+    void PrecompileGBufferPipelineStates();
     void CreateLightingPipelineStates();
     void CreatePostprocessingPipelineState();
     void CreateStandardTextures();
@@ -273,6 +377,8 @@ private:
     void ShutdownImGui();
     void ClearModel();
     void ClearGBufferShaders();
+    // Removes G-buffer shaders whose source files changed and pipeline states that use them.
+    void InvalidateOutdatedGBufferShaders();
     void CreateLights();
     void LoadModel(bool refreshAll);
     void LoadModelNode(Scene::Entity& outEntity, const aiScene* scene, const aiNode* node);
@@ -281,13 +387,40 @@ private:
     void LoadMaterial(const std::filesystem::path& modelDir, const aiScene* scene, uint32_t materialIndex,
         const aiMaterial* material, bool refreshAll);
     // Returns index of the existing or newly loaded texture in m_Textures, SIZE_MAX if failed.
-    size_t TryLoadTexture(const wstr_view& title, const std::filesystem::path& path, bool sRGB, bool allowCache);
+    // usageFlags: Texture::FLAG_SRGB, Texture::FLAG_NORMAL_MAP.
+    // alphaCutoff: used only with Texture::FLAG_ALPHA_TEST.
+    size_t TryLoadTexture(const wstr_view& title, const std::filesystem::path& path, uint32_t usageFlags, bool allowCache,
+        float alphaCutoff = 0.5f);
+    // Moves small, fully resident textures of m_Textures with the same format and size to m_TextureArrays.
+    void PackTextureArrays();
+    // Returns SRV and array slice to sample texture textureIndex, or standardTexture if it is SIZE_MAX or empty.
+    Descriptor GetTextureDescriptor(size_t textureIndex, StandardTexture standardTexture,
+        uint32_t& outArraySlice) const;
+    // Bindless path. Creates m_MaterialTable and its buffer for materials loaded.
+    void CreateMaterialRecords();
+    void DestroyMaterialRecords();
+    // Indices of textures are taken from their descriptors each time, as defragmentation and streaming move them.
+    void GetMaterialRecord(size_t materialIndex, MaterialRecord& outRecord) const;
+    // Writes records that changed to the copy of the current frame.
+    void UpdateMaterialRecords();
+    // Non-bindless path. Fills PerMaterialConstants of all materials in a temporary buffer, indexed by
+    // per-draw constant MaterialIndex, and sets it as packed SRV 1.
+    void SetPackedMaterialConstants(CommandList& cmdList);
     void CreateProceduralModel();
 
     void WaitForFenceOnCPU(UINT64 value);
 
+    // Applies changes in resident mip levels of streaming textures requested in the previous frame.
+    // Uploads are recorded to cmdList, replaced textures retired with the current frame, so it doesn't wait.
+    void UpdateTextureStreaming(CommandList& cmdList);
+    std::array<DescriptorManager*, 4> GetDescriptorManagers();
+    // Defragments descriptor managers that requested it. If there are any, waits for the GPU to finish all work.
+    void DefragmentDescriptors();
+    // Requests mip levels of textures of the mesh, if visible.
+    void RequestTextureStreaming(const mat4& worldXform, size_t meshIndex);
+
     void RenderEntity(CommandList& cmdList, const mat4& parentXform, const Scene::Entity& entity);
-    void RenderEntityMesh(CommandList& cmdList, const Scene::Entity& entity, size_t meshIndex);
+    void RenderEntityMesh(CommandList& cmdList, const Scene::Entity& entity, size_t meshIndex, uint32_t objectIndex);
     void SaveD3D12MAJSONDump();
 };
 
@@ -120,22 +120,22 @@ void RenderingResource::InitDescriptors()
             FillShaderResourceViewDesc_Texture2D(viewDesc, DXGI_FORMAT_R32_FLOAT);
             viewDescPtr = &viewDesc;
         }
-        m_SRV = SRVManager->AllocatePersistent(1);
+        SRVManager->AllocatePersistentMovable(1, m_SRV);
         dev->CreateShaderResourceView(GetResource(), viewDescPtr, SRVManager->GetCPUHandle(m_SRV));
     }
     if((m_Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) != 0)
     {
-        m_UAV = SRVManager->AllocatePersistent(1);
+        SRVManager->AllocatePersistentMovable(1, m_UAV);
         dev->CreateUnorderedAccessView(GetResource(), nullptr, nullptr, SRVManager->GetCPUHandle(m_UAV));
     }
     if((m_Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET) != 0)
     {
-        m_RTV = RTVManager->AllocatePersistent(1);
+        RTVManager->AllocatePersistentMovable(1, m_RTV);
         dev->CreateRenderTargetView(GetResource(), nullptr, RTVManager->GetCPUHandle(m_RTV));
     }
     if((m_Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) != 0)
     {
-        m_DSV = DSVManager->AllocatePersistent(1);
+        DSVManager->AllocatePersistentMovable(1, m_DSV);
         dev->CreateDepthStencilView(GetResource(), nullptr, DSVManager->GetCPUHandle(m_DSV));
     }
 }
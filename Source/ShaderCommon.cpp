@@ -0,0 +1,314 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "ShaderCommon.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// Increase to invalidate all cached and cooked shaders, e.g. after updating DXC.
+static const uint64_t SHADER_KEY_VERSION = 2;
+// Limits recursion of #include scanning, e.g. when files include each other without include guards.
+static const uint32_t MAX_INCLUDE_DEPTH = 32;
+
+static const char SHADER_PACK_MAGIC[4] = {'R', 'E', 'S', 'P'};
+static const uint32_t SHADER_PACK_VERSION = 1;
+static const uint64_t SHADER_PACK_DATA_ALIGNMENT = 16;
+
+static const wchar_t* const GBUFFER_PS_MACRO_NAMES[] = {
+    L"ALPHA_TEST",
+    L"HAS_MATERIAL_COLOR",
+    L"HAS_ALBEDO_TEXTURE",
+    L"HAS_NORMAL_TEXTURE",
+};
+static const uint32_t GBUFFER_PS_MACRO_VALUE_COUNTS[] = {2, 2, 2, 2};
+
+static const ShaderDesc STANDARD_SHADER_DESCS[] = {
+    {ShaderType::Vertex, L"Shaders/GBuffer.hlsl", L"MainVS"},
+    {ShaderType::Pixel, L"Shaders/GBuffer.hlsl", L"MainPS", GBUFFER_PS_MACRO_NAMES, GBUFFER_PS_MACRO_VALUE_COUNTS},
+    {ShaderType::Pixel, L"Shaders/GBufferBindless.hlsl", L"MainPS", GBUFFER_PS_MACRO_NAMES, GBUFFER_PS_MACRO_VALUE_COUNTS},
+    {ShaderType::Vertex, L"Shaders/Ambient.hlsl", L"FullScreenQuadVS"},
+    {ShaderType::Pixel, L"Shaders/Ambient.hlsl", L"MainPS"},
+    {ShaderType::Vertex, L"Shaders/Lighting.hlsl", L"FullScreenQuadVS"},
+    {ShaderType::Pixel, L"Shaders/Lighting.hlsl", L"MainPS"},
+    {ShaderType::Vertex, L"Shaders/Postprocessing.hlsl", L"FullScreenQuadVS"},
+    {ShaderType::Pixel, L"Shaders/Postprocessing.hlsl", L"MainPS"},
+};
+static_assert(std::size(STANDARD_SHADER_DESCS) == (size_t)StandardShader::Count);
+
+uint32_t ShaderDesc::GetPermutationCount() const
+{
+    uint32_t count = 1;
+    for(uint32_t valueCount : m_MacroValueCounts)
+        count *= valueCount;
+    return count;
+}
+
+uint32_t ShaderDesc::GetPermutationIndex(std::span<const uint32_t> macroValues) const
+{
+    return CalculatePermutationIndex(m_MacroValueCounts, macroValues);
+}
+
+void ShaderDesc::GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const
+{
+    CalculateMacroValues(m_MacroValueCounts, permutationIndex, outMacroValues);
+}
+
+uint32_t CalculatePermutationIndex(std::span<const uint32_t> macroValueCounts, std::span<const uint32_t> macroValues)
+{
+    assert(macroValues.size() == macroValueCounts.size());
+    uint32_t index = 0;
+    for(size_t i = macroValues.size(); i--; )
+    {
+        assert(macroValues[i] < macroValueCounts[i]);
+        index = index * macroValueCounts[i] + macroValues[i];
+    }
+    return index;
+}
+
+void CalculateMacroValues(std::span<const uint32_t> macroValueCounts, uint32_t permutationIndex,
+    std::span<uint32_t> outMacroValues)
+{
+    assert(outMacroValues.size() == macroValueCounts.size());
+    for(size_t i = 0; i < outMacroValues.size(); ++i)
+    {
+        outMacroValues[i] = permutationIndex % macroValueCounts[i];
+        permutationIndex /= macroValueCounts[i];
+    }
+}
+
+const ShaderDesc& GetStandardShaderDesc(StandardShader shader)
+{
+    assert(shader < StandardShader::Count);
+    return STANDARD_SHADER_DESCS[(size_t)shader];
+}
+
+void BuildShaderArguments(ShaderType type, std::wstring_view entryPointName,
+    std::span<const std::wstring> extraParameters, bool embedDebugInformation,
+    std::span<const std::wstring> macroNames, std::span<const uint32_t> macroValues,
+    std::vector<std::wstring>& outArguments)
+{
+    assert(macroNames.size() == macroValues.size());
+    outArguments.clear();
+    switch(type)
+    {
+    case ShaderType::Vertex:  outArguments.push_back(L"-T vs_6_0"); outArguments.push_back(L"-D VERTEX_SHADER=1"); break;
+    case ShaderType::Pixel:   outArguments.push_back(L"-T ps_6_0"); outArguments.push_back(L"-D PIXEL_SHADER=1"); break;
+    case ShaderType::Compute: outArguments.push_back(L"-T cs_6_0"); outArguments.push_back(L"-D COMPUTE_SHADER=1"); break;
+    default: assert(0);
+    }
+    outArguments.push_back(L"-E " + std::wstring(entryPointName));
+    outArguments.insert(outArguments.end(), extraParameters.begin(), extraParameters.end());
+    if(embedDebugInformation)
+    {
+        outArguments.push_back(L"-Zi");
+        outArguments.push_back(L"-Qembed_debug");
+    }
+    for(size_t i = 0; i < macroNames.size(); ++i)
+        outArguments.push_back(L"-D " + macroNames[i] + L"=" + std::to_wstring(macroValues[i]));
+}
+
+// FNV-1a, 64-bit.
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3llu;
+    }
+    return hash;
+}
+
+static uint64_t HashUint64(uint64_t hash, uint64_t value)
+{
+    // Fixed little-endian order, independent of the platform.
+    unsigned char bytes[8];
+    for(size_t i = 0; i < 8; ++i)
+        bytes[i] = (unsigned char)(value >> (i * 8));
+    return HashBytes(hash, bytes, 8);
+}
+
+// Hashes code points, as wchar_t is 2 bytes on Windows and 4 bytes on Linux.
+static uint64_t HashWideString(uint64_t hash, std::wstring_view str)
+{
+    hash = HashUint64(hash, str.length());
+    for(wchar_t ch : str)
+        hash = HashUint64(hash, (uint32_t)ch);
+    return hash;
+}
+
+static uint64_t HashChars(uint64_t hash, std::span<const char> chars)
+{
+    hash = HashUint64(hash, chars.size());
+    return HashBytes(hash, chars.data(), chars.size());
+}
+
+// Like HashChars, but CR LF is hashed as LF, so checkouts of source files with either line endings
+// give the same key. Same as HashChars for text with LF line endings.
+static uint64_t HashText(uint64_t hash, std::span<const char> text)
+{
+    auto isSkipped = [&](size_t i) { return text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n'; };
+    size_t size = 0;
+    for(size_t i = 0; i < text.size(); ++i)
+        size += isSkipped(i) ? 0 : 1;
+    hash = HashUint64(hash, size);
+    // Hashes runs of bytes between skipped CRs.
+    size_t runBegin = 0;
+    for(size_t i = 0; i < text.size(); ++i)
+    {
+        if(isSkipped(i))
+        {
+            hash = HashBytes(hash, text.data() + runBegin, i - runBegin);
+            runBegin = i + 1;
+        }
+    }
+    return HashBytes(hash, text.data() + runBegin, text.size() - runBegin);
+}
+
+static void HashIncludes(uint64_t& inoutHash, std::span<const char> source, const std::filesystem::path& dir,
+    const LoadShaderFileFunc& loadFile, std::vector<std::filesystem::path>& inoutVisited, uint32_t depth)
+{
+    const char* const end = source.data() + source.size();
+    for(const char* p = source.data(); p < end; )
+    {
+        while(p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        const char* lineEnd = std::find(p, end, '\n');
+        if(p < end && *p == '#')
+        {
+            ++p;
+            while(p < lineEnd && (*p == ' ' || *p == '\t'))
+                ++p;
+            static const std::string_view INCLUDE = "include";
+            if(std::string_view(p, lineEnd - p).starts_with(INCLUDE))
+            {
+                p += INCLUDE.length();
+                while(p < lineEnd && (*p == ' ' || *p == '\t'))
+                    ++p;
+                if(p < lineEnd && (*p == '"' || *p == '<'))
+                {
+                    const char closing = *p == '"' ? '"' : '>';
+                    const char* const nameBegin = p + 1;
+                    const char* const nameEnd = std::find(nameBegin, lineEnd, closing);
+                    if(nameEnd < lineEnd)
+                    {
+                        const std::string_view name(nameBegin, nameEnd - nameBegin);
+                        inoutHash = HashChars(inoutHash, name);
+
+                        std::error_code errorCode;
+                        const std::filesystem::path includePath = std::filesystem::canonical(
+                            dir / std::u8string(name.begin(), name.end()), errorCode);
+                        std::vector<char> contents;
+                        if(!errorCode &&
+                            std::find(inoutVisited.begin(), inoutVisited.end(), includePath) == inoutVisited.end() &&
+                            loadFile(includePath, contents))
+                        {
+                            inoutHash = HashText(inoutHash, contents);
+                            inoutVisited.push_back(includePath);
+                            if(depth < MAX_INCLUDE_DEPTH)
+                                HashIncludes(inoutHash, contents, dir, loadFile, inoutVisited, depth + 1);
+                        }
+                    }
+                }
+            }
+        }
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+uint64_t CalculateShaderKey(std::span<const char> source, const std::filesystem::path& dir,
+    std::span<const std::wstring> arguments, const LoadShaderFileFunc& loadFile,
+    std::vector<std::filesystem::path>& outIncludes)
+{
+    uint64_t hash = HashUint64(0xcbf29ce484222325llu, SHADER_KEY_VERSION);
+    hash = HashUint64(hash, arguments.size());
+    for(const std::wstring& arg : arguments)
+        hash = HashWideString(hash, arg);
+    hash = HashText(hash, source);
+    outIncludes.clear();
+    HashIncludes(hash, source, dir, loadFile, outIncludes, 0);
+    return hash;
+}
+
+bool GetShaderPackEntryCount(std::span<const char> pack, uint64_t& outEntryCount)
+{
+    ShaderPackHeader header;
+    if(pack.size() < sizeof(header))
+        return false;
+    memcpy(&header, pack.data(), sizeof(header));
+    if(memcmp(header.m_Magic, SHADER_PACK_MAGIC, sizeof(SHADER_PACK_MAGIC)) != 0 ||
+        header.m_Version != SHADER_PACK_VERSION ||
+        header.m_EntryCount > (pack.size() - sizeof(header)) / sizeof(ShaderPackEntry))
+    {
+        return false;
+    }
+    outEntryCount = header.m_EntryCount;
+    return true;
+}
+
+bool FindInShaderPack(std::span<const char> pack, uint64_t key, std::span<const char>& outCode)
+{
+    uint64_t entryCount = 0;
+    if(!GetShaderPackEntryCount(pack, entryCount))
+        return false;
+
+    // Binary search directly in the data, which may not be aligned for ShaderPackEntry.
+    const char* const entries = pack.data() + sizeof(ShaderPackHeader);
+    size_t begin = 0, end = (size_t)entryCount;
+    while(begin < end)
+    {
+        const size_t mid = (begin + end) / 2;
+        ShaderPackEntry entry;
+        memcpy(&entry, entries + mid * sizeof(ShaderPackEntry), sizeof(entry));
+        if(entry.m_Key < key)
+            begin = mid + 1;
+        else if(entry.m_Key > key)
+            end = mid;
+        else
+        {
+            if(entry.m_Offset > pack.size() || entry.m_Size > pack.size() - entry.m_Offset)
+                return false;
+            outCode = pack.subspan((size_t)entry.m_Offset, (size_t)entry.m_Size);
+            return true;
+        }
+    }
+    return false;
+}
+
+void BuildShaderPack(std::span<const std::pair<uint64_t, std::vector<char>>> entries, std::vector<char>& outPack)
+{
+    std::vector<size_t> order(entries.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return entries[lhs].first < entries[rhs].first; });
+
+    const ShaderPackHeader header = {
+        .m_Magic = {SHADER_PACK_MAGIC[0], SHADER_PACK_MAGIC[1], SHADER_PACK_MAGIC[2], SHADER_PACK_MAGIC[3]},
+        .m_Version = SHADER_PACK_VERSION,
+        .m_EntryCount = entries.size()};
+    outPack.assign(sizeof(header) + entries.size() * sizeof(ShaderPackEntry), 0);
+    memcpy(outPack.data(), &header, sizeof(header));
+
+    // Permutations often compile to identical bytecode, e.g. when a macro isn't used - store it once.
+    std::vector<ShaderPackEntry> packEntries(entries.size());
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        const std::vector<char>& code = entries[order[i]].second;
+        const auto sameIt = std::find_if(order.begin(), order.begin() + i, [&](size_t prev)
+        {
+            return entries[prev].second == code;
+        });
+        ShaderPackEntry& packEntry = packEntries[i];
+        packEntry.m_Key = entries[order[i]].first;
+        packEntry.m_Size = code.size();
+        if(sameIt != order.begin() + i)
+            packEntry.m_Offset = packEntries[sameIt - order.begin()].m_Offset;
+        else
+        {
+            const size_t offset = (outPack.size() + SHADER_PACK_DATA_ALIGNMENT - 1) & ~(SHADER_PACK_DATA_ALIGNMENT - 1);
+            outPack.resize(offset);
+            outPack.insert(outPack.end(), code.begin(), code.end());
+            packEntry.m_Offset = offset;
+        }
+    }
+    memcpy(outPack.data() + sizeof(header), packEntries.data(), packEntries.size() * sizeof(ShaderPackEntry));
+}
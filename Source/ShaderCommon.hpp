@@ -0,0 +1,117 @@
+#pragma once
+
+/*
+Shader code shared by the engine and the offline shader cooker (Tools/ShaderCooker).
+Uses only the standard library - no Windows headers and no precompiled header - so it builds on Linux too.
+
+Contains the description of all shaders and their permutations, the list of DXC arguments
+they are compiled with, the key identifying compiled bytecode, and the cooked shader pack format.
+Engine and cooker must compute identical keys, so hashing is platform-independent: FNV-1a over
+bytes of files and code points of arguments, not std::hash.
+*/
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <functional>
+
+enum class ShaderType
+{
+    Vertex, Pixel, Compute, Count
+};
+
+struct ShaderDesc
+{
+    ShaderType m_Type;
+    // Relative to the working directory.
+    const wchar_t* m_FilePath;
+    const wchar_t* m_EntryPointName;
+    // Empty for a shader without permutations. Macro i takes values 0...m_MacroValueCounts[i]-1.
+    std::span<const wchar_t* const> m_MacroNames = {};
+    std::span<const uint32_t> m_MacroValueCounts = {};
+
+    uint32_t GetPermutationCount() const;
+    // See MultiShader for the order of permutations.
+    uint32_t GetPermutationIndex(std::span<const uint32_t> macroValues) const;
+    void GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const;
+};
+
+/*
+Dense permutation index of a combination of macro values, and back, see MultiShader.
+Macro i takes values 0...macroValueCounts[i]-1.
+Used by ShaderDesc and MultiShader, benchmarked by Tools/ShaderPermutationBenchmark.
+*/
+uint32_t CalculatePermutationIndex(std::span<const uint32_t> macroValueCounts, std::span<const uint32_t> macroValues);
+void CalculateMacroValues(std::span<const uint32_t> macroValueCounts, uint32_t permutationIndex,
+    std::span<uint32_t> outMacroValues);
+
+enum class StandardShader
+{
+    GBufferVS, GBufferPS,
+    // Used instead of GBufferPS when setting "Renderer.Bindless.Enabled" is on.
+    GBufferBindlessPS,
+    AmbientVS, AmbientPS,
+    LightingVS, LightingPS,
+    PostprocessingVS, PostprocessingPS,
+    Count
+};
+
+const ShaderDesc& GetStandardShaderDesc(StandardShader shader);
+
+/*
+Fills arguments passed to DXC, except the source file, which is passed as buffer.
+extraParameters: setting "Shaders.ExtraParameters".
+embedDebugInformation: setting "Shaders.EmbedDebugInformation".
+*/
+void BuildShaderArguments(ShaderType type, std::wstring_view entryPointName,
+    std::span<const std::wstring> extraParameters, bool embedDebugInformation,
+    std::span<const std::wstring> macroNames, std::span<const uint32_t> macroValues,
+    std::vector<std::wstring>& outArguments);
+
+// Returns false if the file doesn't exist or cannot be read.
+using LoadShaderFileFunc = std::function<bool(const std::filesystem::path& path, std::vector<char>& outContents)>;
+
+/*
+Returns key identifying compiled bytecode: hash of contents of the source file and all files it includes,
+plus all arguments passed to the compiler. File paths and modification times don't matter, and neither do
+line endings: CR LF is hashed as LF.
+
+Includes are found by scanning #include lines, not by running the preprocessor, so every #include counts,
+also in inactive #if branches and in comments. It is conservative: an extra file can only cause a miss,
+not a stale hit. They are searched relative to dir, like the engine's include handler does.
+An include that doesn't exist contributes only its name - if it was really needed, compilation fails.
+outIncludes receives canonical paths of included files that exist.
+*/
+uint64_t CalculateShaderKey(std::span<const char> source, const std::filesystem::path& dir,
+    std::span<const std::wstring> arguments, const LoadShaderFileFunc& loadFile,
+    std::vector<std::filesystem::path>& outIncludes);
+
+/*
+Cooked shader pack: file with bytecode of many shaders, identified by keys from CalculateShaderKey.
+Layout: ShaderPackHeader, ShaderPackEntry[m_EntryCount] sorted by key, then bytecode.
+Entries with identical bytecode point to the same data.
+*/
+struct ShaderPackHeader
+{
+    char m_Magic[4];
+    uint32_t m_Version;
+    uint64_t m_EntryCount;
+};
+
+struct ShaderPackEntry
+{
+    uint64_t m_Key;
+    // From the beginning of the file.
+    uint64_t m_Offset;
+    uint64_t m_Size;
+};
+
+// Returns false if data is not a valid pack.
+bool GetShaderPackEntryCount(std::span<const char> pack, uint64_t& outEntryCount);
+// Returns false if data is not a valid pack or the key is not found.
+bool FindInShaderPack(std::span<const char> pack, uint64_t key, std::span<const char>& outCode);
+// Keys of entries must be unique.
+void BuildShaderPack(std::span<const std::pair<uint64_t, std::vector<char>>> entries, std::vector<char>& outPack);
@@ -3,12 +3,19 @@
 #include "Renderer.hpp"
 #include "Settings.hpp"
 #include "SmallFileCache.hpp"
+#include "LoadProfiler.hpp"
+#include "AssetPack.hpp"
+#include "Streams.hpp"
+#include "ParallelFor.hpp"
 #include "../ThirdParty/dxc_2021_12_08/inc/dxcapi.h"
 #pragma comment(lib, "../ThirdParty/dxc_2021_12_08/lib/x64/dxcompiler.lib")
-#include <unordered_map>
+#include <algorithm>
+#include <unordered_set>
 
 static StringSequenceSetting g_ShadersExtraParameters(SettingCategory::Load, "Shaders.ExtraParameters");
 static BoolSetting g_ShadersEmbedDebugInformation(SettingCategory::Load, "Shaders.EmbedDebugInformation", false);
+static BoolSetting g_ShadersCacheEnabled(SettingCategory::Load, "Shaders.Cache.Enabled", true);
+static StringSetting g_ShadersCookedPackPath(SettingCategory::Startup, "Shaders.CookedPackPath", "Shaders/Cooked.pack");
 
 static constexpr uint32_t CODE_PAGE = DXC_CP_UTF8;
 
@@ -20,8 +27,9 @@ static_assert(_countof(TYPE_NAMES) == (size_t)ShaderType::Count);
 class IncludeHandler : public IDxcIncludeHandler
 {
 public:
-    IncludeHandler(std::filesystem::path&& dir) :
-        m_Directory(dir)
+    IncludeHandler(std::filesystem::path&& dir, std::vector<ShaderDependency>& dependencies) :
+        m_Directory(dir),
+        m_Dependencies(dependencies)
     {
     }
 
@@ -35,29 +43,45 @@ public:
 
 private:
     std::filesystem::path m_Directory;
+    // Every loaded file is appended here.
+    std::vector<ShaderDependency>& m_Dependencies;
 };
 
 class ShaderPimpl
 {
 public:
     ComPtr<IDxcBlob> m_CompiledObject;
+    ShaderDependencies m_Dependencies;
+    // Used instead of m_CompiledObject when loaded from the cooked pack or g_AssetPack.
+    // m_CacheFile keeps m_CachedCode alive.
+    std::shared_ptr<const MappedFile> m_CacheFile;
+    std::span<const char> m_CachedCode;
 };
 
 class MultiShaderPimpl
 {
 public:
-    // it.second = null means shader compilation fails.
-    using MapType = std::unordered_map<size_t, unique_ptr<Shader>>;
+    struct Permutation
+    {
+        // Null when not compiled yet or compilation failed.
+        unique_ptr<Shader> m_Shader;
+        bool m_Compiled = false;
+    };
 
     ShaderType m_Type = ShaderType::Count;
     wstring m_FilePath;
     wstring m_EntryPointName;
     std::vector<wstring> m_MacroNames;
     std::vector<wstr_view> m_MacroNameViews;
-    MapType m_Shaders;
+    std::vector<uint32_t> m_MacroValueCounts;
+    // Indexed by permutation index.
+    std::vector<Permutation> m_Permutations;
 
     bool IsInitialized() const { return m_Type != ShaderType::Count && !m_FilePath.empty(); }
     wstring MacrosToDebugStr(std::span<const uint32_t> macroValues) const;
+    void GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const;
+    // On error: prints error, returns null.
+    unique_ptr<Shader> Compile(uint32_t permutationIndex) const;
 };
 
 wstring MultiShaderPimpl::MacrosToDebugStr(std::span<const uint32_t> macroValues) const
@@ -74,31 +98,185 @@ wstring MultiShaderPimpl::MacrosToDebugStr(std::span<const uint32_t> macroValues
     return result;
 }
 
+void MultiShaderPimpl::GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const
+{
+    // Same order as ShaderDesc::GetMacroValues, which Tools/ShaderCooker uses.
+    CalculateMacroValues(m_MacroValueCounts, permutationIndex, outMacroValues);
+}
+
 class ShaderCompilerPimpl
 {
 public:
-    ComPtr<IDxcUtils> m_Utils;
-    ComPtr<IDxcCompiler3> m_Compiler;
+    struct ThreadObjects
+    {
+        ComPtr<IDxcUtils> m_Utils;
+        ComPtr<IDxcCompiler3> m_Compiler;
+    };
+
+    // DXC objects must not be used from multiple threads at once, so every thread compiling shaders
+    // gets its own, created on first use and released when the thread ends.
+    static ThreadObjects& GetThreadObjects();
+
+    // Null if there is no cooked shader pack.
+    std::shared_ptr<const MappedFile> m_CookedPack;
+
+    // Hashes of bytecode queued to g_AssetPack in this session. AssetPack::Contains doesn't find them until
+    // they are written and flushed, while permutations compiled in parallel often produce identical bytecode.
+    std::mutex m_SavedCodeHashesMutex;
+    std::unordered_set<uint64_t> m_SavedCodeHashes;
+
+    void LoadCookedPack();
 };
 
+ShaderCompilerPimpl::ThreadObjects& ShaderCompilerPimpl::GetThreadObjects()
+{
+    thread_local ThreadObjects objects;
+    if(!objects.m_Compiler)
+    {
+        ERR_TRY;
+        CHECK_HR(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&objects.m_Utils)));
+        CHECK_HR(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&objects.m_Compiler)));
+        ERR_CATCH_MSG(L"Cannot initialize shader compiler.");
+    }
+    return objects;
+}
+
+void ShaderCompilerPimpl::LoadCookedPack()
+{
+    const string& pathStr = g_ShadersCookedPackPath.GetValue();
+    if(pathStr.empty())
+        return;
+    const wstring path = ConvertCharsToUnicode(pathStr, CP_UTF8);
+    std::filesystem::file_time_type lastWriteTime;
+    if(!GetFileLastWriteTime(lastWriteTime, StrToPath(path)))
+    {
+        LogInfoF(L"No cooked shader pack \"{}\".", path);
+        return;
+    }
+
+    try
+    {
+        ERR_TRY;
+        auto pack = std::make_shared<const MappedFile>(path);
+        uint64_t entryCount = 0;
+        if(!GetShaderPackEntryCount(std::span<const char>(pack->GetData(), pack->GetSize()), entryCount))
+            FAIL(L"Invalid shader pack.");
+        LogInfoF(L"Cooked shader pack \"{}\": {} entries, size {}.", path, entryCount, SizeToStr(pack->GetSize()));
+        m_CookedPack = std::move(pack);
+        ERR_CATCH_MSG(std::format(L"Cannot load cooked shader pack \"{}\". Shaders will be compiled.", path));
+    } CATCH_PRINT_ERROR(;)
+}
+
 HRESULT STDMETHODCALLTYPE IncludeHandler::LoadSource(
     _In_z_ LPCWSTR pFilename,
     _COM_Outptr_result_maybenull_ IDxcBlob** ppIncludeSource)
 {
-    assert(g_Renderer && g_Renderer->GetShaderCompiler());
-    ShaderCompilerPimpl* compiler = g_Renderer->GetShaderCompiler()->m_Pimpl.get();
+    // Called from Shader::Init, so objects of this thread already exist.
+    IDxcUtils* const utils = ShaderCompilerPimpl::GetThreadObjects().m_Utils.Get();
 
     std::filesystem::path filePath = m_Directory / pFilename;
     const wchar_t* const filePathNative = filePath.native().c_str();
 
+    ShaderDependency dependency = {.m_FilePath = filePath.native()};
+    if(GetFileLastWriteTime(dependency.m_LastWriteTime, filePath))
+        m_Dependencies.push_back(std::move(dependency));
+
     const auto contents = g_SmallFileCache->LoadFile(filePathNative);
     ComPtr<IDxcBlobEncoding> blobEncoding;
-    HRESULT hr = compiler->m_Utils->CreateBlob(contents.data(), (uint32_t)contents.size(), CODE_PAGE, &blobEncoding);
+    HRESULT hr = utils->CreateBlob(contents.data(), (uint32_t)contents.size(), CODE_PAGE, &blobEncoding);
     if(SUCCEEDED(hr))
         blobEncoding->QueryInterface(IID_PPV_ARGS(ppIncludeSource));
     return hr;
 }
 
+static size_t HashContents(std::span<const char> contents)
+{
+    return std::hash<std::string_view>()(std::string_view(contents.data(), contents.size()));
+}
+
+static bool LoadShaderSourceFile(const std::filesystem::path& path, std::vector<char>& outContents)
+{
+    std::filesystem::file_time_type lastWriteTime;
+    if(!GetFileLastWriteTime(lastWriteTime, path))
+        return false;
+    outContents = g_SmallFileCache->LoadFile(path.native());
+    return true;
+}
+
+/*
+Cache uses two kinds of entries, so permutations that compile to identical bytecode share one copy:
+AssetPack::Type::ShaderKey with key from CalculateShaderKey, holding uint64_t hash of the bytecode,
+AssetPack::Type::ShaderBytecode with hash of the bytecode, holding the bytecode.
+Source time is always 0, as the key already covers contents of the source files.
+*/
+static bool LoadShaderFromCache(uint64_t key, ShaderPimpl& outPimpl)
+{
+    std::span<const char> keyData;
+    std::shared_ptr<const MappedFile> keyFile;
+    if(!g_AssetPack->Find(AssetPack::Type::ShaderKey, key, 0, keyData, keyFile) || keyData.size() != sizeof(uint64_t))
+        return false;
+    uint64_t codeHash;
+    memcpy(&codeHash, keyData.data(), sizeof(codeHash));
+    std::span<const char> code;
+    std::shared_ptr<const MappedFile> codeFile;
+    if(!g_AssetPack->Find(AssetPack::Type::ShaderBytecode, codeHash, 0, code, codeFile) || code.empty())
+        return false;
+    outPimpl.m_CachedCode = code;
+    outPimpl.m_CacheFile = std::move(codeFile);
+    return true;
+}
+
+static void SaveShaderToCache(ShaderCompilerPimpl& compilerPimpl, uint64_t key, std::span<const char> code)
+{
+    const uint64_t codeHash = HashContents(code);
+    bool savedBefore;
+    {
+        std::lock_guard<std::mutex> lock(compilerPimpl.m_SavedCodeHashesMutex);
+        savedBefore = !compilerPimpl.m_SavedCodeHashes.insert(codeHash).second;
+    }
+    if(!savedBefore && !g_AssetPack->Contains(AssetPack::Type::ShaderBytecode, codeHash, 0))
+        g_AssetPack->Add(AssetPack::Type::ShaderBytecode, codeHash, 0, std::vector<char>(code.begin(), code.end()));
+    const char* const codeHashBytes = (const char*)&codeHash;
+    g_AssetPack->Add(AssetPack::Type::ShaderKey, key, 0,
+        std::vector<char>(codeHashBytes, codeHashBytes + sizeof(codeHash)));
+}
+
+// Settings that change compiler arguments for all shaders.
+static size_t HashShaderSettings()
+{
+    size_t hash = std::hash<bool>()(g_ShadersEmbedDebugInformation.GetValue());
+    for(const string& param : g_ShadersExtraParameters.m_Strings)
+        hash = CombineHash(hash, std::hash<string>()(param));
+    return hash;
+}
+
+void ShaderDependencies::Clear()
+{
+    m_Files.clear();
+    m_SettingsHash = 0;
+}
+
+void ShaderDependencies::Append(const ShaderDependencies& src)
+{
+    assert(m_Files.empty() || src.m_Files.empty() || m_SettingsHash == src.m_SettingsHash);
+    m_Files.insert(m_Files.end(), src.m_Files.begin(), src.m_Files.end());
+    if(!src.m_Files.empty())
+        m_SettingsHash = src.m_SettingsHash;
+}
+
+bool ShaderDependencies::IsOutdated() const
+{
+    if(m_Files.empty() || m_SettingsHash != HashShaderSettings())
+        return true;
+    for(const ShaderDependency& file : m_Files)
+    {
+        std::filesystem::file_time_type lastWriteTime;
+        if(!GetFileLastWriteTime(lastWriteTime, file.m_FilePath) || lastWriteTime != file.m_LastWriteTime)
+            return true;
+    }
+    return false;
+}
+
 Shader::Shader() :
     m_Pimpl(std::make_unique<ShaderPimpl>())
 {
@@ -114,24 +292,30 @@ void Shader::Init(ShaderType type, const wstr_view& filePath, const wstr_view& e
 {
     assert(g_Renderer && g_Renderer->GetShaderCompiler());
     assert(macroNames.size() == macroValues.size());
-    ShaderCompilerPimpl* compiler = g_Renderer->GetShaderCompiler()->m_Pimpl.get();
+    PROFILE_LOAD_SCOPE("Shader::Init");
 
     ERR_TRY;
 
     const size_t explicitMacroCount = macroNames.size();
-    if(explicitMacroCount == 0)
-        LogMessageF(L"Compiling {} shader from \"{}\"...", TYPE_NAMES[(size_t)type], filePath);
-    else
+    wstring explicitMacroDebugStr;
+    if(explicitMacroCount > 0)
     {
-        wstring explicitMacroDebugStr;
+        explicitMacroDebugStr = L" with macros:";
         for(size_t i = 0; i < explicitMacroCount; ++i)
             explicitMacroDebugStr += std::format(L" {}={}", macroNames[i], macroValues[i]);
-        LogMessageF(L"Compiling {} shader from \"{}\" with macros:{}...", TYPE_NAMES[(size_t)type], filePath, explicitMacroDebugStr);
     }
 
-    std::filesystem::path dir = StrToPath(filePath);
-    dir = dir.parent_path();
-    IncludeHandler includeHandler(std::move(dir));
+    const std::filesystem::path filePathP = StrToPath(filePath);
+    std::filesystem::path dir = filePathP.parent_path();
+
+    ShaderDependencies& dependencies = m_Pimpl->m_Dependencies;
+    dependencies.Clear();
+    dependencies.m_SettingsHash = HashShaderSettings();
+    {
+        ShaderDependency mainFile = {.m_FilePath = filePathP.native()};
+        if(GetFileLastWriteTime(mainFile.m_LastWriteTime, filePathP))
+            dependencies.m_Files.push_back(std::move(mainFile));
+    }
 
     const std::vector<char> source = g_SmallFileCache->LoadFile(filePath);
     CHECK_BOOL(!source.empty());
@@ -140,45 +324,66 @@ void Shader::Init(ShaderType type, const wstr_view& filePath, const wstr_view& e
         .Size = source.size(),
         .Encoding = CODE_PAGE};
 
-    const wchar_t* profileParam = nullptr;
-    const wchar_t* shaderTypeMacroParam = nullptr;
-    switch(type)
-    {
-    case ShaderType::Vertex:  profileParam = L"-T vs_6_0"; shaderTypeMacroParam = L"-D VERTEX_SHADER=1"; break;
-    case ShaderType::Pixel:   profileParam = L"-T ps_6_0"; shaderTypeMacroParam = L"-D PIXEL_SHADER=1"; break;
-    case ShaderType::Compute: profileParam = L"-T cs_6_0"; shaderTypeMacroParam = L"-D COMPUTE_SHADER=1"; break;
-    default: assert(0);
-    }
-
-    const wstring entryPointParam = std::format(L"-E {}", entryPointName);
-
-    std::vector<const wchar_t*> arguments = {
-        profileParam,
-        shaderTypeMacroParam,
-        entryPointParam.c_str()};
-    
+    // Built the same way by Tools/ShaderCooker, so keys of cooked shaders match.
     const size_t extraParamCount = g_ShadersExtraParameters.m_Strings.size();
     std::vector<wstring> extraParamsUnicode(extraParamCount);
     for(size_t i = 0; i < extraParamCount; ++i)
-    {
         extraParamsUnicode[i] = ConvertCharsToUnicode(g_ShadersExtraParameters.m_Strings[i], CP_UTF8);
-        arguments.push_back(extraParamsUnicode[i].c_str());
-    }
-    if(g_ShadersEmbedDebugInformation.GetValue())
-    {
-        arguments.push_back(L"-Zi");
-        arguments.push_back(L"-Qembed_debug");
-    }
-
+    std::vector<wstring> macroNameStrings(explicitMacroCount);
     for(size_t i = 0; i < explicitMacroCount; ++i)
+        macroNameStrings[i].assign(macroNames[i].data(), macroNames[i].length());
+    std::vector<wstring> argumentStrings;
+    BuildShaderArguments(type, std::wstring_view(entryPointName.data(), entryPointName.length()),
+        extraParamsUnicode, g_ShadersEmbedDebugInformation.GetValue(),
+        macroNameStrings, macroValues, argumentStrings);
+    std::vector<const wchar_t*> arguments(argumentStrings.size());
+    for(size_t i = 0; i < argumentStrings.size(); ++i)
+        arguments[i] = argumentStrings[i].c_str();
+
+    uint64_t key = 0;
+    ShaderCompilerPimpl& compilerPimpl = *g_Renderer->GetShaderCompiler()->m_Pimpl;
+    const std::shared_ptr<const MappedFile>& cookedPack = compilerPimpl.m_CookedPack;
+    const bool cacheEnabled = g_ShadersCacheEnabled.GetValue();
+    if(cookedPack || cacheEnabled)
     {
-        extraParamsUnicode.push_back(std::format(L"-D {}={}", macroNames[i], macroValues[i]));
-        arguments.push_back(extraParamsUnicode.back().c_str());
+        std::vector<std::filesystem::path> includes;
+        key = CalculateShaderKey(source, dir, argumentStrings, LoadShaderSourceFile, includes);
+
+        const wchar_t* loadedFrom = nullptr;
+        std::span<const char> cookedCode;
+        if(cookedPack &&
+            FindInShaderPack(std::span<const char>(cookedPack->GetData(), cookedPack->GetSize()), key, cookedCode) &&
+            !cookedCode.empty())
+        {
+            m_Pimpl->m_CachedCode = cookedCode;
+            m_Pimpl->m_CacheFile = cookedPack;
+            loadedFrom = L"cooked pack";
+        }
+        else if(cacheEnabled && LoadShaderFromCache(key, *m_Pimpl))
+            loadedFrom = L"cache";
+
+        if(loadedFrom)
+        {
+            // DXC didn't run, so take includes found by scanning the source.
+            for(const std::filesystem::path& include : includes)
+            {
+                ShaderDependency dependency = {.m_FilePath = include.native()};
+                if(GetFileLastWriteTime(dependency.m_LastWriteTime, include))
+                    dependencies.m_Files.push_back(std::move(dependency));
+            }
+            LogMessageF(L"Loaded {} shader from \"{}\"{} from {}.",
+                TYPE_NAMES[(size_t)type], filePath, explicitMacroDebugStr, loadedFrom);
+            return;
+        }
     }
 
+    LogMessageF(L"Compiling {} shader from \"{}\"{}...", TYPE_NAMES[(size_t)type], filePath, explicitMacroDebugStr);
+    IncludeHandler includeHandler(std::move(dir), dependencies.m_Files);
+
+    IDxcCompiler3* const compiler = ShaderCompilerPimpl::GetThreadObjects().m_Compiler.Get();
     ComPtr<IDxcResult> result;
     // This seems to always succeed. Real success is returned by IDxcOperationResult::GetStatus.
-    CHECK_HR(compiler->m_Compiler->Compile(
+    CHECK_HR(compiler->Compile(
         &sourceDxcBuffer,
         arguments.data(), (uint32_t)arguments.size(),
         &includeHandler,
@@ -207,6 +412,9 @@ void Shader::Init(ShaderType type, const wstr_view& filePath, const wstr_view& e
         
         if(!errorsView.empty())
             LogWarningF(L"{}", errorsView);
+
+        if(cacheEnabled)
+            SaveShaderToCache(compilerPimpl, key, GetCode());
     }
     else
     {
@@ -224,27 +432,34 @@ void Shader::Init(ShaderType type, const wstr_view& filePath, const wstr_view& e
     Init(type, filePath, entryPointName, {}, {});
 }
 
+void Shader::Init(const ShaderDesc& desc, std::span<const uint32_t> macroValues)
+{
+    std::vector<wstr_view> macroNames(desc.m_MacroNames.size());
+    for(size_t i = 0; i < macroNames.size(); ++i)
+        macroNames[i] = wstr_view{desc.m_MacroNames[i]};
+    Init(desc.m_Type, desc.m_FilePath, desc.m_EntryPointName, macroNames, macroValues);
+}
+
 bool Shader::IsNull() const
 {
-    return !m_Pimpl->m_CompiledObject;
+    return !m_Pimpl->m_CompiledObject && m_Pimpl->m_CachedCode.empty();
+}
+
+const ShaderDependencies& Shader::GetDependencies() const
+{
+    return m_Pimpl->m_Dependencies;
 }
 
 std::span<const char> Shader::GetCode() const
 {
+    if(!m_Pimpl->m_CachedCode.empty())
+        return m_Pimpl->m_CachedCode;
     assert(m_Pimpl->m_CompiledObject);
     return std::span<const char>(
         (const char*)m_Pimpl->m_CompiledObject->GetBufferPointer(),
         m_Pimpl->m_CompiledObject->GetBufferSize());
 }
 
-size_t MultiShader::HashMacroValues(std::span<const uint32_t> macroValues)
-{
-    size_t h = 0x262521a102765664llu;
-    for(auto val : macroValues)
-        h = CombineHash(h, val);
-    return h;
-}
-
 MultiShader::MultiShader() :
     m_Pimpl(std::make_unique<MultiShaderPimpl>())
 {
@@ -257,8 +472,9 @@ MultiShader::~MultiShader()
 }
 
 void MultiShader::Init(ShaderType type, const wstr_view& filePath, const wstr_view& entryPointName,
-    std::span<const wstr_view> macroNames)
+    std::span<const wstr_view> macroNames, std::span<const uint32_t> macroValueCounts)
 {
+    assert(macroNames.size() == macroValueCounts.size());
     m_Pimpl->m_Type = type;
     m_Pimpl->m_FilePath.assign(filePath.data(), filePath.length());
     m_Pimpl->m_EntryPointName.assign(entryPointName.data(), entryPointName.length());
@@ -266,50 +482,134 @@ void MultiShader::Init(ShaderType type, const wstr_view& filePath, const wstr_vi
     const size_t macroCount = macroNames.size();
     m_Pimpl->m_MacroNames.resize(macroCount);
     m_Pimpl->m_MacroNameViews.resize(macroCount);
+    m_Pimpl->m_MacroValueCounts.assign(macroValueCounts.begin(), macroValueCounts.end());
+    uint32_t permutationCount = 1;
     for(size_t i = 0; i < macroCount; ++i)
     {
         m_Pimpl->m_MacroNames[i].assign(macroNames[i].data(), macroNames[i].length());
         m_Pimpl->m_MacroNameViews[i] = wstr_view{m_Pimpl->m_MacroNames[i]};
+        assert(macroValueCounts[i] > 0);
+        permutationCount *= macroValueCounts[i];
     }
+    m_Pimpl->m_Permutations.clear();
+    m_Pimpl->m_Permutations.resize(permutationCount);
+}
+
+void MultiShader::Init(const ShaderDesc& desc)
+{
+    std::vector<wstr_view> macroNames(desc.m_MacroNames.size());
+    for(size_t i = 0; i < macroNames.size(); ++i)
+        macroNames[i] = wstr_view{desc.m_MacroNames[i]};
+    Init(desc.m_Type, desc.m_FilePath, desc.m_EntryPointName, macroNames, desc.m_MacroValueCounts);
+}
+
+uint32_t MultiShader::GetPermutationCount() const
+{
+    return (uint32_t)m_Pimpl->m_Permutations.size();
+}
+
+uint32_t MultiShader::GetPermutationIndex(std::span<const uint32_t> macroValues) const
+{
+    return CalculatePermutationIndex(m_Pimpl->m_MacroValueCounts, macroValues);
+}
+
+void MultiShader::GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const
+{
+    assert(permutationIndex < GetPermutationCount());
+    m_Pimpl->GetMacroValues(permutationIndex, outMacroValues);
 }
 
 void MultiShader::Clear()
 {
-    m_Pimpl->m_Shaders.clear();
+    for(MultiShaderPimpl::Permutation& permutation : m_Pimpl->m_Permutations)
+        permutation = {};
 }
 
-const Shader* MultiShader::GetShader(std::span<const uint32_t> macroValues)
+uint32_t MultiShader::RemoveOutdated()
 {
-    assert(m_Pimpl->IsInitialized());
-    assert(macroValues.size() == m_Pimpl->m_MacroNames.size());
-    const size_t h = HashMacroValues(macroValues);
-    
-    const auto it = m_Pimpl->m_Shaders.find(h);
-    if(it != m_Pimpl->m_Shaders.end())
-        return it->second.get();
-    
+    uint32_t removedCount = 0;
+    for(MultiShaderPimpl::Permutation& permutation : m_Pimpl->m_Permutations)
+    {
+        if(permutation.m_Compiled &&
+            (!permutation.m_Shader || permutation.m_Shader->GetDependencies().IsOutdated()))
+        {
+            permutation = {};
+            ++removedCount;
+        }
+    }
+    return removedCount;
+}
+
+bool MultiShader::IsCompiled(uint32_t permutationIndex) const
+{
+    assert(permutationIndex < GetPermutationCount());
+    return m_Pimpl->m_Permutations[permutationIndex].m_Compiled;
+}
+
+unique_ptr<Shader> MultiShaderPimpl::Compile(uint32_t permutationIndex) const
+{
+    std::vector<uint32_t> macroValues(m_MacroValueCounts.size());
+    GetMacroValues(permutationIndex, macroValues);
+
     try
     {
         ERR_TRY
 
         unique_ptr<Shader> shader = std::make_unique<Shader>();
-        Shader* const shaderPtr = shader.get();
-        shader->Init(m_Pimpl->m_Type, m_Pimpl->m_FilePath, m_Pimpl->m_EntryPointName,
-            m_Pimpl->m_MacroNameViews, macroValues);
-        m_Pimpl->m_Shaders.insert({h, std::move(shader)});
-        return shaderPtr;
+        shader->Init(m_Type, m_FilePath, m_EntryPointName, m_MacroNameViews, macroValues);
+        return shader;
 
         ERR_CATCH_MSG(std::format(L"Cannot compile multishader \"{}\" with macros: {}",
-            m_Pimpl->m_FilePath, m_Pimpl->MacrosToDebugStr(macroValues)));
+            m_FilePath, MacrosToDebugStr(macroValues)));
     }
     catch(const Exception& ex)
     {
         ex.Print();
-        m_Pimpl->m_Shaders.insert({h, nullptr});
         return nullptr;
     }
 }
 
+const Shader* MultiShader::GetShader(uint32_t permutationIndex)
+{
+    assert(m_Pimpl->IsInitialized());
+    assert(permutationIndex < GetPermutationCount());
+    MultiShaderPimpl::Permutation& permutation = m_Pimpl->m_Permutations[permutationIndex];
+    if(!permutation.m_Compiled)
+    {
+        // Failure is remembered too, so it is not compiled again on every call.
+        permutation.m_Shader = m_Pimpl->Compile(permutationIndex);
+        permutation.m_Compiled = true;
+    }
+    return permutation.m_Shader.get();
+}
+
+uint32_t MultiShader::Precompile(std::span<const uint32_t> permutationIndices, uint32_t threadCount)
+{
+    assert(m_Pimpl->IsInitialized());
+
+    std::vector<uint32_t> jobs;
+    for(uint32_t permutationIndex : permutationIndices)
+    {
+        if(!IsCompiled(permutationIndex) && std::find(jobs.begin(), jobs.end(), permutationIndex) == jobs.end())
+            jobs.push_back(permutationIndex);
+    }
+
+    std::vector<unique_ptr<Shader>> shaders(jobs.size());
+    ParallelFor(jobs.size(), threadCount, [&](size_t jobIndex)
+    {
+        shaders[jobIndex] = m_Pimpl->Compile(jobs[jobIndex]);
+    });
+
+    // Failed permutations are remembered as null, like in GetShader.
+    for(size_t i = 0; i < jobs.size(); ++i)
+    {
+        MultiShaderPimpl::Permutation& permutation = m_Pimpl->m_Permutations[jobs[i]];
+        permutation.m_Shader = std::move(shaders[i]);
+        permutation.m_Compiled = true;
+    }
+    return (uint32_t)jobs.size();
+}
+
 ShaderCompiler::ShaderCompiler() :
     m_Pimpl(std::make_unique<ShaderCompilerPimpl>())
 {
@@ -318,12 +618,9 @@ ShaderCompiler::ShaderCompiler() :
 
 void ShaderCompiler::Init()
 {
-    ERR_TRY;
-    
-    CHECK_HR(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&m_Pimpl->m_Utils)));
-    CHECK_HR(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&m_Pimpl->m_Compiler)));
-    
-    ERR_CATCH_MSG(L"Cannot initialize shader compiler.");
+    // Fail early if DXC is not available. Objects of other threads are created when they compile.
+    ShaderCompilerPimpl::GetThreadObjects();
+    m_Pimpl->LoadCookedPack();
 }
 
 ShaderCompiler::~ShaderCompiler()
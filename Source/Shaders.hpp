@@ -1,8 +1,27 @@
 #pragma once
 
-enum class ShaderType
+#include "ShaderCommon.hpp"
+
+struct ShaderDependency
 {
-    Vertex, Pixel, Compute, Count
+    wstring m_FilePath;
+    std::filesystem::file_time_type m_LastWriteTime;
+};
+
+// Files and settings a compiled shader depends on, to recompile it only when one of them changes.
+struct ShaderDependencies
+{
+    // Source file and all files it includes.
+    std::vector<ShaderDependency> m_Files;
+    // Hash of settings affecting compilation, e.g. "Shaders.ExtraParameters".
+    size_t m_SettingsHash = 0;
+
+    void Clear();
+    // Merges dependencies of another shader, e.g. to track all shaders of a pipeline state together.
+    void Append(const ShaderDependencies& src);
+    // Returns true if any file was modified or deleted or the settings changed.
+    // Also true when empty, e.g. when compilation failed.
+    bool IsOutdated() const;
 };
 
 class ShaderPimpl;
@@ -18,32 +37,63 @@ public:
     void Init(ShaderType type, const wstr_view& filePath, const wstr_view& entryPointName,
         std::span<const wstr_view> macroNames, std::span<const uint32_t> macroValues);
     void Init(ShaderType type, const wstr_view& filePath, const wstr_view& entryPointName);
+    // macroValues must match desc.m_MacroNames.
+    void Init(const ShaderDesc& desc, std::span<const uint32_t> macroValues = {});
     bool IsNull() const;
     std::span<const char> GetCode() const;
+    // Filled by Init, also when it fails.
+    const ShaderDependencies& GetDependencies() const;
 
 private:
     unique_ptr<ShaderPimpl> m_Pimpl;
 };
 
+/*
+Shader compiled in multiple permutations, with different values of macros.
+
+Macro i takes values 0...macroValueCounts[i]-1. Each combination has a dense permutation index:
+value of the first macro + count of the first * (value of the second + count of the second * (...)),
+so for binary macros bit i of the index is the value of macro i. Permutations are stored in an array
+indexed by it - no hashing, no collisions.
+*/
 class MultiShader
 {
 public:
-    static size_t HashMacroValues(std::span<const uint32_t> macroValues);
-
     MultiShader();
     ~MultiShader();
     // Doesn't fail in this one.
     void Init(ShaderType type, const wstr_view& filePath, const wstr_view& entryPointName,
-        std::span<const wstr_view> macroNames);
+        std::span<const wstr_view> macroNames, std::span<const uint32_t> macroValueCounts);
+    void Init(const ShaderDesc& desc);
     void Clear();
+    // Removes permutations whose dependencies changed and those that failed to compile,
+    // so GetShader compiles them again. Returns number of removed permutations.
+    uint32_t RemoveOutdated();
+
+    uint32_t GetPermutationCount() const;
+    uint32_t GetPermutationIndex(std::span<const uint32_t> macroValues) const;
+    void GetMacroValues(uint32_t permutationIndex, std::span<uint32_t> outMacroValues) const;
+    // Returns true if the permutation was compiled, successfully or not.
+    bool IsCompiled(uint32_t permutationIndex) const;
     
-    // On error: prints error, returns null.
-    const Shader* GetShader(std::span<const uint32_t> macroValues);
+    // Compiles the permutation on first use. On error: prints error, returns null.
+    const Shader* GetShader(uint32_t permutationIndex);
+    const Shader* GetShader(std::span<const uint32_t> macroValues) { return GetShader(GetPermutationIndex(macroValues)); }
+    /*
+    Compiles permutations that were not requested yet, in parallel, so GetShader returns them immediately.
+    threadCount = 0 means number of hardware threads. Errors are printed, like in GetShader.
+    Returns number of permutations compiled.
+    */
+    uint32_t Precompile(std::span<const uint32_t> permutationIndices, uint32_t threadCount);
 
 private:
     unique_ptr<MultiShaderPimpl> m_Pimpl;
 };
 
+/*
+Also loads the cooked shader pack made by Tools/ShaderCooker, from setting "Shaders.CookedPackPath".
+Shader::Init takes bytecode from it when its key matches, before trying the cache and compiling.
+*/
 class ShaderCompiler
 {
 public:
@@ -2,6 +2,7 @@
 #include "SmallFileCache.hpp"
 #include "Streams.hpp"
 #include <unordered_map>
+#include <mutex>
 
 constexpr size_t MAX_CACHED_FILE_SIZE = 128llu * 1024;
 
@@ -17,6 +18,8 @@ public:
     };
     // Key is file path converted to absolute-cannonical-uppercase
     using MapType = std::unordered_map<wstring, Entry>;
+    // Shaders can be compiled on multiple threads at once.
+    std::mutex m_Mutex;
     MapType m_Entries;
 };
 
@@ -33,6 +36,7 @@ SmallFileCache::~SmallFileCache()
 
 void SmallFileCache::Clear()
 {
+    std::lock_guard<std::mutex> lock(m_Pimpl->m_Mutex);
     m_Pimpl->m_Entries.clear();
 }
 
@@ -48,6 +52,8 @@ std::vector<char> SmallFileCache::LoadFile(const wstr_view& path)
     wstring key = std::filesystem::canonical(pathP);
     ToUpperCase(key);
 
+    std::lock_guard<std::mutex> lock(m_Pimpl->m_Mutex);
+
     const auto it = m_Pimpl->m_Entries.find(key);
     // Found in cache.
     if(it != m_Pimpl->m_Entries.end())
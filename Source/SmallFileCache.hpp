@@ -6,6 +6,7 @@ class SmallFileCachePimpl;
 Offers loading entire content from a file.
 Caches the content of small files indefinitely so they are not loaded again if not needed.
 When asking for the same file again, it checks its modification date.
+Thread-safe.
 */
 class SmallFileCache
 {
@@ -48,9 +48,14 @@ FileStream::FileStream(const wstr_view& path, uint32_t flags)
     if((flags & Flag_Write) != 0)
         desiredAccess |= GENERIC_WRITE;
 
-    DWORD shareMode = (flags & Flag_Write) != 0 ? 0 : FILE_SHARE_READ;
+    const bool append = (flags & Flag_Write) != 0 && (flags & Flag_Append) != 0;
+    DWORD shareMode = (flags & Flag_Write) != 0 && !append ? 0 : FILE_SHARE_READ;
 
-    DWORD creationDisposition = (flags & Flag_Write) != 0 ? CREATE_ALWAYS : OPEN_EXISTING;
+    DWORD creationDisposition = OPEN_EXISTING;
+    if(append)
+        creationDisposition = OPEN_ALWAYS;
+    else if((flags & Flag_Write) != 0)
+        creationDisposition = CREATE_ALWAYS;
 
     DWORD flagsAndAttributes = FILE_ATTRIBUTE_NORMAL;
     if((flags & Flag_Sequential) != 0)
@@ -67,6 +72,9 @@ FileStream::FileStream(const wstr_view& path, uint32_t flags)
 	CHECK_BOOL_WINAPI(handle != INVALID_HANDLE_VALUE);
 	m_Handle.reset(handle);
 
+    if(append)
+        SetPosition(0, MoveMethod::End);
+
     ERR_CATCH_MSG(std::format(L"Cannot open file \"{}\".", path));
 }
 
@@ -119,6 +127,50 @@ void FileStream::Write(const void* bytes, size_t bytesToWrite)
     CHECK_BOOL(numberOfBytesWritten == numberOfBytesToWrite);
 }
 
+void FileStream::Truncate()
+{
+    assert(m_Handle.get() != INVALID_HANDLE_VALUE);
+    CHECK_BOOL_WINAPI(SetEndOfFile(m_Handle.get()));
+}
+
+MappedFile::MappedFile(const wstr_view& path)
+{
+    ERR_TRY;
+
+    HANDLE file = CreateFile(
+        path.c_str(), // lpFileName
+        GENERIC_READ, // dwDesiredAccess
+        FILE_SHARE_READ | FILE_SHARE_WRITE, // dwShareMode
+        NULL, // lpSecurityAttributes
+        OPEN_EXISTING, // dwCreationDisposition
+        FILE_ATTRIBUTE_NORMAL, // dwFlagsAndAttributes
+        NULL); // hTemplateFile
+    CHECK_BOOL_WINAPI(file != INVALID_HANDLE_VALUE);
+    m_File.reset(file);
+
+    LARGE_INTEGER size;
+    CHECK_BOOL_WINAPI(GetFileSizeEx(file, &size));
+    // Mapping of an empty file is not allowed.
+    CHECK_BOOL(size.QuadPart > 0);
+    m_Size = (size_t)size.QuadPart;
+
+    // CreateFileMapping returns NULL not INVALID_HANDLE_VALUE on failure.
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CHECK_BOOL_WINAPI(mapping != NULL);
+    m_Mapping.reset(mapping);
+
+    m_Data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CHECK_BOOL_WINAPI(m_Data != nullptr);
+
+    ERR_CATCH_MSG(std::format(L"Cannot map file \"{}\".", path));
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_Data)
+        UnmapViewOfFile(m_Data);
+}
+
 std::vector<char> LoadFile(const wstr_view& path)
 {
     ERR_TRY;
@@ -69,6 +69,9 @@ public:
         Flag_Read = 0x1,
         Flag_Write = 0x2,
         Flag_Sequential = 0x4,
+        // Together with Flag_Write: opens existing file or creates new one, sets position at the end.
+        // Other handles can keep reading the file, e.g. MappedFile.
+        Flag_Append = 0x8,
     };
 
     FileStream(const wstr_view& path, uint32_t flags);
@@ -78,10 +81,35 @@ public:
     size_t TryRead(void* outBytes, size_t maxBytesToRead) override;
     void Write(const void* bytes, size_t bytesToWrite) override;
     using BaseStream::Write;
+    // Sets end of the file at current position.
+    void Truncate();
 
 private:
     unique_ptr<HANDLE, CloseHandleDeleter> m_Handle;
 };
 
+/*
+Read-only view of a whole file mapped into memory.
+Pages are loaded by the OS on first access, so reading only a part of the file is cheap.
+The file can be appended while mapped, e.g. with FileStream::Flag_Append - the view keeps its original size.
+*/
+class MappedFile
+{
+public:
+    MappedFile(const wstr_view& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+private:
+    unique_ptr<HANDLE, CloseHandleDeleter> m_File;
+    unique_ptr<HANDLE, CloseHandleDeleter> m_Mapping;
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
 std::vector<char> LoadFile(const wstr_view& path);
 void SaveFile(const wstr_view& path, std::span<const char> bytes);
@@ -3,15 +3,28 @@
 #include "CommandList.hpp"
 #include "Renderer.hpp"
 #include "Streams.hpp"
+#include "Time.hpp"
+#include "Settings.hpp"
+#include "MipmapGenerator.hpp"
+#include "AssetPack.hpp"
+#include "TextureCacheFormat.hpp"
+#include "LoadProfiler.hpp"
+#include "BlockCompressor.hpp"
 #include <DirectXTex.h>
 
+// Levels of a streaming texture not larger than this are always resident.
+static UintSetting g_TextureStreamingTailSize(SettingCategory::Load, "Textures.Streaming.TailSize", 128);
+// Textures larger than this are downscaled on import. 0 = no limit.
+static UintSetting g_TextureMaxSize(SettingCategory::Load, "Textures.MaxSize", 0);
+
 Texture::~Texture()
 {
     g_Renderer->GetSRVDescriptorManager()->FreePersistent(m_Descriptor);
 }
 
-void Texture::LoadFromFile(uint32_t flags, const wstr_view& filePath)
+void Texture::LoadFromFile(uint32_t flags, const wstr_view& filePath, float alphaCutoff)
 {
+    PROFILE_LOAD_SCOPE("Texture::LoadFromFile");
     assert(IsEmpty());
 
     if(filePath.empty())
@@ -20,38 +33,32 @@ void Texture::LoadFromFile(uint32_t flags, const wstr_view& filePath)
     ERR_TRY;
 
     LogMessageF(L"Loading texture from \"{}\"...", filePath);
+    filePath.to_string(m_Name);
 
     const std::filesystem::path sourceFilePath = StrToPath(filePath);
-    const size_t hash = CalculateHash(flags, sourceFilePath);
-    const std::filesystem::path cacheFilePath = StrToPath(std::format(L"Cache/Textures/{:016X}", hash));
-    const bool sourceFileExists = FileExists(sourceFilePath);
-
-    bool cacheIsValid = (flags & FLAG_CACHE_LOAD) != 0 && FileExists(cacheFilePath);
-    if(cacheIsValid)
+    const size_t hash = CalculateHash(flags, alphaCutoff, sourceFilePath);
+    // Single query of the file system per texture.
+    int64_t sourceTime = AssetPack::ANY_SOURCE_TIME;
+    std::filesystem::file_time_type sourceWriteTime;
+    if(GetFileLastWriteTime(sourceWriteTime, sourceFilePath))
+        sourceTime = (int64_t)sourceWriteTime.time_since_epoch().count();
+    // else: Can load only from cache not from source file. Cache is always valid.
+
+    if((flags & FLAG_CACHE_LOAD) != 0)
     {
-        std::filesystem::file_time_type cacheWriteTime;
-        cacheIsValid = GetFileLastWriteTime(cacheWriteTime, cacheFilePath);
-        if(cacheIsValid)
+        std::span<const char> cacheData;
+        std::shared_ptr<const MappedFile> cacheFile;
+        if(g_AssetPack->Find(AssetPack::Type::Texture, hash, sourceTime, cacheData, cacheFile))
         {
-            if(sourceFileExists)
+            try
             {
-                std::filesystem::file_time_type sourceWriteTime;
-                cacheIsValid = GetFileLastWriteTime(sourceWriteTime, sourceFilePath) &&
-                    cacheWriteTime > sourceWriteTime;
-            }
-            // else: Can load only from cache not from source file. Cache is always valid.
+                LoadFromCacheData(flags, cacheData, std::move(cacheFile));
+            } CATCH_PRINT_ERROR(;)
         }
     }
-    if(cacheIsValid)
-    {
-        try
-        {
-            LoadFromCacheFile(flags, cacheFilePath);
-        } CATCH_PRINT_ERROR(;)
-    }
 
     if(IsEmpty())
-        LoadFromSourceFile(flags, filePath, cacheFilePath);
+        LoadFromSourceFile(flags, alphaCutoff, filePath, hash, sourceTime);
 
     assert(!IsEmpty());
     SetD3D12ObjectName(m_Resource, filePath);
@@ -70,21 +77,92 @@ void Texture::LoadFromMemory(
     ERR_TRY;
     
     m_Desc = resDesc;
+    m_FullSize = uvec2((uint32_t)resDesc.Width, resDesc.Height);
     CreateTexture();
     assert(m_Resource.Get());
     if(!name.empty())
         SetD3D12ObjectName(m_Resource.Get(), name);
-    UploadMipLevel(0, uvec2((uint32_t)resDesc.Width, resDesc.Height), data,
-        true); // lastLevel
+    UploadMipLevel(0, data, true); // lastLevel
     CreateDescriptor();
 
     ERR_CATCH_FUNC;
 }
 
-size_t Texture::CalculateHash(uint32_t flags, const std::filesystem::path& filePath)
+void Texture::LoadArray(std::span<const Texture* const> slices, const wstr_view& name)
 {
-    flags &= FLAG_SRGB | FLAG_GENERATE_MIPMAPS;
+    assert(IsEmpty());
+    PROFILE_LOAD_SCOPE("Texture::LoadArray");
+
+    ERR_TRY;
+
+    CHECK_BOOL(!slices.empty() && slices.size() <= D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION);
+    const D3D12_RESOURCE_DESC& sliceDesc = slices[0]->GetDesc();
+    for(const Texture* slice : slices)
+    {
+        const D3D12_RESOURCE_DESC& desc = slice->GetDesc();
+        CHECK_BOOL(desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && desc.DepthOrArraySize == 1 &&
+            desc.Format == sliceDesc.Format && desc.Width == sliceDesc.Width && desc.Height == sliceDesc.Height &&
+            desc.MipLevels == sliceDesc.MipLevels);
+        CHECK_BOOL(slice->GetFirstResidentMip() == 0 && slice->GetMaxFirstResidentMip() == 0);
+    }
+
+    m_Desc = sliceDesc;
+    m_Desc.DepthOrArraySize = (UINT16)slices.size();
+    m_FullSize = uvec2((uint32_t)sliceDesc.Width, sliceDesc.Height);
+    CreateTexture();
+    if(!name.empty())
+    {
+        name.to_string(m_Name);
+        SetD3D12ObjectName(m_Resource, m_Name);
+    }
+
+    {
+        CommandList cmdList;
+        g_Renderer->BeginUploadCommandList(cmdList);
+
+        std::vector<D3D12_RESOURCE_BARRIER> barriers(slices.size());
+        for(size_t i = 0; i < slices.size(); ++i)
+        {
+            barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(slices[i]->GetResource(),
+                D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        }
+        cmdList.GetCmdList()->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+        for(uint32_t arraySlice = 0; arraySlice < (uint32_t)slices.size(); ++arraySlice)
+        {
+            for(uint32_t mip = 0; mip < m_Desc.MipLevels; ++mip)
+            {
+                CD3DX12_TEXTURE_COPY_LOCATION dst{m_Resource.Get(),
+                    D3D12CalcSubresource(mip, arraySlice, 0, m_Desc.MipLevels, m_Desc.DepthOrArraySize)};
+                CD3DX12_TEXTURE_COPY_LOCATION src{slices[arraySlice]->GetResource(), mip};
+                cmdList.GetCmdList()->CopyTextureRegion(&dst,
+                    0, 0, 0, // DstX, DstY, DstZ
+                    &src, nullptr); // pSrcBox
+            }
+        }
+
+        for(D3D12_RESOURCE_BARRIER& barrier : barriers)
+            std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+            m_Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+        cmdList.GetCmdList()->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+        g_Renderer->CompleteUploadCommandList(cmdList);
+    }
+
+    CreateDescriptor();
+
+    ERR_CATCH_MSG(std::format(L"Cannot create texture array \"{}\".", name));
+}
+
+size_t Texture::CalculateHash(uint32_t flags, float alphaCutoff, const std::filesystem::path& filePath)
+{
+    flags &= FLAG_SRGB | FLAG_GENERATE_MIPMAPS | FLAG_COMPRESS | FLAG_NORMAL_MAP | FLAG_COMPRESS_HIGH_QUALITY |
+        FLAG_ALPHA_TEST;
     size_t hash = std::hash<uint32_t>()(flags);
+    if((flags & FLAG_ALPHA_TEST) != 0)
+        hash = CombineHash(hash, std::hash<float>()(alphaCutoff));
+    hash = CombineHash(hash, std::hash<uint32_t>()(g_TextureMaxSize.GetValue()));
     
     wstring processedPath = std::filesystem::weakly_canonical(filePath).native();
     ToUpperCase(processedPath);
@@ -93,109 +171,114 @@ size_t Texture::CalculateHash(uint32_t flags, const std::filesystem::path& fileP
     return hash;
 }
 
-void Texture::LoadFromSourceFile(uint32_t flags, const wstr_view& filePath,
-    const std::filesystem::path& cacheFilePath)
+void Texture::LoadFromSourceFile(uint32_t flags, float alphaCutoff, const wstr_view& filePath,
+    size_t hash, int64_t sourceTime)
 {
     DirectX::ScratchImage image;
 
-    if(filePath.ends_with(L".tga", false))
-    {
-        constexpr DirectX::TGA_FLAGS TGAFlags = DirectX::TGA_FLAGS_NONE;
-        CHECK_HR(DirectX::LoadFromTGAFile(filePath.c_str(), TGAFlags, nullptr, image));
-    }
-    else if(filePath.ends_with(L".dds", false))
     {
-        constexpr DirectX::DDS_FLAGS DDSFlags = DirectX::DDS_FLAGS_NONE;
-        CHECK_HR(DirectX::LoadFromDDSFile(filePath.c_str(), DDSFlags, nullptr, image));
-    }
-    else
-    {
-        constexpr DirectX::WIC_FLAGS WICFlags = DirectX::WIC_FLAGS_NONE;
-        CHECK_HR(DirectX::LoadFromWICFile(filePath.c_str(), WICFlags, nullptr, image));
+        PROFILE_LOAD_SCOPE("Texture decode");
+        if(filePath.ends_with(L".tga", false))
+        {
+            constexpr DirectX::TGA_FLAGS TGAFlags = DirectX::TGA_FLAGS_NONE;
+            CHECK_HR(DirectX::LoadFromTGAFile(filePath.c_str(), TGAFlags, nullptr, image));
+        }
+        else if(filePath.ends_with(L".dds", false))
+        {
+            constexpr DirectX::DDS_FLAGS DDSFlags = DirectX::DDS_FLAGS_NONE;
+            CHECK_HR(DirectX::LoadFromDDSFile(filePath.c_str(), DDSFlags, nullptr, image));
+        }
+        else
+        {
+            constexpr DirectX::WIC_FLAGS WICFlags = DirectX::WIC_FLAGS_NONE;
+            CHECK_HR(DirectX::LoadFromWICFile(filePath.c_str(), WICFlags, nullptr, image));
+        }
     }
 
-    Load(flags, image);
+    Process(flags, alphaCutoff, image);
 
     if((flags & FLAG_CACHE_SAVE) != 0)
     {
-        ERR_TRY;
-        SaveCacheFile(cacheFilePath, image);
-       } CATCH_PRINT_ERROR(;)
+        PROFILE_LOAD_SCOPE("Texture cache save");
+        try
+        {
+            std::vector<char> cacheData;
+            SaveCacheData(cacheData, image);
+            g_AssetPack->Add(AssetPack::Type::Texture, hash, sourceTime, std::move(cacheData));
+        } CATCH_PRINT_ERROR(;)
     }
+
+    Load(flags, image);
 }
 
-static const char* const CACHE_FILE_HEADER = "RegEngine Cache Texture 100";
+static_assert(TEXTURE_CACHE_LEVEL_ALIGNMENT == D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+static_assert(TEXTURE_CACHE_ROW_PITCH_ALIGNMENT == D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+static_assert(TEXTURE_CACHE_MAX_MIP_LEVELS == D3D12_REQ_MIP_LEVELS);
 
-void Texture::SaveCacheFile(const std::filesystem::path& cacheFilePath, const DirectX::ScratchImage& image) const
+void Texture::SaveCacheData(std::vector<char>& outData, const DirectX::ScratchImage& image)
 {
-    const wstring pathStr = cacheFilePath.native();
-    LogInfoF(L"Saving texture cache to file \"{}\"...", pathStr);
-
-    ERR_TRY;
-
-    DirectX::Blob DDSBlob;
-    CHECK_HR(DirectX::SaveToDDSMemory(
-        image.GetImages(),
-        image.GetImageCount(),
-        image.GetMetadata(),
-        DirectX::DDS_FLAGS_NONE,
-        DDSBlob));
-
+    const DirectX::TexMetadata& metadata = image.GetMetadata();
+    CHECK_BOOL(image.GetImageCount() == metadata.mipLevels);
+
+    const TextureCacheDesc desc = {
+        .m_Format = (uint32_t)metadata.format,
+        .m_Width = (uint32_t)metadata.width,
+        .m_Height = (uint32_t)metadata.height,
+        .m_MipLevels = (uint32_t)metadata.mipLevels };
+    std::vector<TextureCacheLevel> levels(metadata.mipLevels);
+    for(size_t mip = 0; mip < levels.size(); ++mip)
     {
-        FileStream stream(pathStr, FileStream::Flag_Write | FileStream::Flag_Sequential);
-        const str_view headerStr{CACHE_FILE_HEADER};
-        stream.WriteString(headerStr);
-        stream.WriteValue((uint32_t)DDSBlob.GetBufferSize());
-        stream.Write(DDSBlob.GetBufferPointer(), DDSBlob.GetBufferSize());
-        stream.WriteString(headerStr);
+        const DirectX::Image* const img = image.GetImage(mip, 0, 0);
+        levels[mip] = {
+            .m_Data = (const char*)img->pixels,
+            .m_RowPitch = img->rowPitch,
+            .m_RowCount = (uint32_t)DirectX::ComputeScanlines(img->format, img->height) };
     }
-       
-    ERR_CATCH_MSG(std::format(L"Cannot save texture cache file \"{}\".", pathStr));
+    SaveTextureCacheData(desc, levels, outData);
 }
 
-void Texture::LoadFromCacheFile(uint32_t flags, const std::filesystem::path& path)
+void Texture::LoadFromCacheData(uint32_t flags, std::span<const char> data, std::shared_ptr<const MappedFile> file)
 {
-    const wstring pathStr = path.native();
-    LogInfoF(L"Loading texture cache from file \"{}\"...", pathStr);
+    PROFILE_LOAD_SCOPE("Texture::LoadFromCacheData");
+    LogInfo(L"Loading texture from cache...");
     ERR_TRY;
 
-    FileStream stream(pathStr, FileStream::Flag_Read);
-    
-    const size_t headerLen = strlen(CACHE_FILE_HEADER);
-    char header[32];
-    stream.Read(header, headerLen);
-    if(memcmp(header, CACHE_FILE_HEADER, headerLen) != 0)
-        FAIL(L"Invalid begin header.");
-
-    uint32_t contentLen;
-    stream.ReadValue(contentLen);
-    CHECK_BOOL(contentLen > 0);
-
-    // Validate header at the end.
+    const Time beginTime = Now();
+    // Pointing directly to the mapped file - no copy until upload.
+    TextureCacheDesc desc;
+    std::vector<TextureCacheLevel> levels;
+    if(!LoadTextureCacheData(data, desc, levels))
+        FAIL(L"Invalid or old version of the data.");
+    const DXGI_FORMAT format = (DXGI_FORMAT)desc.m_Format;
+    CHECK_BOOL(format != DXGI_FORMAT_UNKNOWN);
+
+    std::vector<D3D12_SUBRESOURCE_DATA> mips(desc.m_MipLevels);
+    for(uint32_t mip = 0; mip < desc.m_MipLevels; ++mip)
     {
-        const size_t fileSize = stream.GetSize();
-        size_t pos = stream.GetPosition();
-        CHECK_BOOL(pos + contentLen + headerLen == fileSize);
-        stream.SetPosition((ptrdiff_t)contentLen, BaseStream::MoveMethod::Current);
-        stream.Read(header, headerLen);
-        if(memcmp(header, CACHE_FILE_HEADER, headerLen) != 0)
-            FAIL(L"Invalid end header.");
-        stream.SetPosition((ptrdiff_t)pos, BaseStream::MoveMethod::Begin);
+        const TextureCacheLevel& level = levels[mip];
+        CHECK_BOOL(level.m_RowCount == DirectX::ComputeScanlines(format, std::max(desc.m_Height >> mip, 1u)));
+        mips[mip] = {
+            .pData = level.m_Data,
+            .RowPitch = (LONG_PTR)level.m_RowPitch,
+            .SlicePitch = (LONG_PTR)(level.m_RowPitch * level.m_RowCount) };
     }
 
-    std::vector<char> content(contentLen);
-    stream.Read(content.data(), contentLen);
+    m_FullSize = uvec2(desc.m_Width, desc.m_Height);
+    LoadMips(flags, format, std::move(mips));
+    // Streaming texture keeps reading levels from the mapped file.
+    if(IsStreaming())
+        m_StreamingFile = std::move(file);
 
-    DirectX::ScratchImage image;
-    CHECK_HR(DirectX::LoadFromDDSMemory(content.data(), contentLen, DirectX::DDS_FLAGS_NONE, NULL, image));
+    LogInfoF(L"Width={}, Height={}, Format={}, MipLevels={}, loaded in {:.1f} ms.",
+        desc.m_Width, desc.m_Height, DXGIFormatToStr(format), desc.m_MipLevels,
+        TimeToMilliseconds<float>(Now() - beginTime));
 
-    Load(flags, image);
-
-    ERR_CATCH_MSG(std::format(L"Cannot load texture cache from file \"{}\"...", pathStr));
+    ERR_CATCH_MSG(L"Cannot load texture from cache.");
 }
 
-void Texture::Load(uint32_t flags, DirectX::ScratchImage& image)
+void Texture::Process(uint32_t flags, float alphaCutoff, DirectX::ScratchImage& image)
 {
+    PROFILE_LOAD_SCOPE("Texture::Process");
     const DirectX::TexMetadata* metadata = &image.GetMetadata();
     CHECK_BOOL(metadata->depth == 1);
     CHECK_BOOL(metadata->arraySize == 1);
@@ -219,39 +302,377 @@ void Texture::Load(uint32_t flags, DirectX::ScratchImage& image)
     LogInfoF(L"Width={}, Height={}, Format={}, MipLevels={}",
         metadata->width, metadata->height, DXGIFormatToStr(metadata->format), metadata->mipLevels);
 
+    LimitSize(image);
+    metadata = &image.GetMetadata();
+
     if(metadata->mipLevels == 1 && (flags & FLAG_GENERATE_MIPMAPS) != 0)
     {
-        LogInfo(L"Generating mipmaps...");
+        if(DirectX::IsCompressed(metadata->format))
+            LogWarning(L"Cannot generate mipmaps for a block-compressed texture.");
+        else
+        {
+            GenerateMipmaps(flags, alphaCutoff, image);
+            metadata = &image.GetMetadata(); // Have to refresh.
+        }
+    }
+
+    if((flags & FLAG_COMPRESS) != 0 && !DirectX::IsCompressed(metadata->format))
+    {
+        Compress(flags, image);
+    }
+}
+
+void Texture::LimitSize(DirectX::ScratchImage& image)
+{
+    const size_t maxSize = g_TextureMaxSize.GetValue();
+    const DirectX::TexMetadata metadata = image.GetMetadata();
+    if(maxSize == 0 || std::max(metadata.width, metadata.height) <= maxSize)
+        return;
 
-        DirectX::ScratchImage mipImage;
+    // Existing mip chain: skip levels that are too large. Cheap, works also for block-compressed formats.
+    size_t firstMip = 0;
+    while(firstMip + 1 < metadata.mipLevels &&
+        std::max(metadata.width >> firstMip, metadata.height >> firstMip) > maxSize)
+    {
+        ++firstMip;
+    }
+    DirectX::ScratchImage result;
+    if(firstMip > 0)
+    {
+        DirectX::TexMetadata resultMetadata = metadata;
+        resultMetadata.width = std::max<size_t>(metadata.width >> firstMip, 1);
+        resultMetadata.height = std::max<size_t>(metadata.height >> firstMip, 1);
+        resultMetadata.mipLevels = metadata.mipLevels - firstMip;
+        CHECK_HR(result.Initialize(resultMetadata));
+        for(size_t mip = 0; mip < resultMetadata.mipLevels; ++mip)
+        {
+            const DirectX::Image* const src = image.GetImage(firstMip + mip, 0, 0);
+            const DirectX::Image* const dst = result.GetImage(mip, 0, 0);
+            CHECK_BOOL(src->slicePitch == dst->slicePitch);
+            memcpy(dst->pixels, src->pixels, dst->slicePitch);
+        }
+    }
+    else
+    {
+        if(DirectX::IsCompressed(metadata.format))
+        {
+            LogWarning(L"Cannot downscale a block-compressed texture without mipmaps.");
+            return;
+        }
+        const size_t largerSize = std::max(metadata.width, metadata.height);
+        const size_t width = std::max<size_t>(metadata.width * maxSize / largerSize, 1);
+        const size_t height = std::max<size_t>(metadata.height * maxSize / largerSize, 1);
+        CHECK_HR(DirectX::Resize(*image.GetImage(0, 0, 0), width, height, DirectX::TEX_FILTER_DEFAULT, result));
+    }
+
+    const DirectX::TexMetadata& resultMetadata = result.GetMetadata();
+    LogInfoF(L"Downscaled to Width={}, Height={}, MipLevels={}",
+        resultMetadata.width, resultMetadata.height, resultMetadata.mipLevels);
+    image = std::move(result);
+}
+
+void Texture::GenerateMipmaps(uint32_t flags, float alphaCutoff, DirectX::ScratchImage& image)
+{
+    PROFILE_LOAD_SCOPE("Texture::GenerateMipmaps");
+    const DirectX::Image* const img0 = image.GetImage(0, 0, 0);
+    const DXGI_FORMAT format = img0->format;
+    const bool supportedFormat =
+        format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB ||
+        format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+
+    LogInfo(L"Generating mipmaps...");
+    const Time beginTime = Now();
+
+    DirectX::ScratchImage mipImage;
+    if(supportedFormat)
+    {
+        CHECK_HR(mipImage.Initialize2D(format, img0->width, img0->height, 1, 0)); // mipLevels = 0 means full chain.
+        const size_t levelCount = mipImage.GetMetadata().mipLevels;
+        std::vector<MipmapGenerator::Level> levels(levelCount);
+        for(size_t mip = 0; mip < levelCount; ++mip)
+        {
+            const DirectX::Image* const dstImg = mipImage.GetImage(mip, 0, 0);
+            levels[mip] = {
+                .m_Pixels = dstImg->pixels,
+                .m_Width = (uint32_t)dstImg->width,
+                .m_Height = (uint32_t)dstImg->height,
+                .m_RowPitch = dstImg->rowPitch };
+        }
+        // Level 0 is copied row by row, as row pitch may differ.
+        const size_t rowSize = std::min(img0->rowPitch, levels[0].m_RowPitch);
+        for(size_t y = 0; y < img0->height; ++y)
+            memcpy(levels[0].m_Pixels + y * levels[0].m_RowPitch, img0->pixels + y * img0->rowPitch, rowSize);
+
+        uint32_t generatorFlags = 0;
+        if(DirectX::IsSRGB(format))
+            generatorFlags |= MipmapGenerator::FLAG_SRGB;
+        if((flags & FLAG_NORMAL_MAP) != 0)
+            generatorFlags |= MipmapGenerator::FLAG_NORMAL_MAP;
+        if((flags & FLAG_ALPHA_TEST) != 0)
+            generatorFlags |= MipmapGenerator::FLAG_PRESERVE_ALPHA_COVERAGE;
+        MipmapGenerator generator(generatorFlags, alphaCutoff);
+        generator.Generate(levels);
+    }
+    else
+    {
+        if((flags & FLAG_ALPHA_TEST) != 0)
+            LogWarningF(L"Alpha coverage not preserved in mipmaps of format {}.", DXGIFormatToStr(format));
         CHECK_HR(DirectX::GenerateMipMaps(*img0, DirectX::TEX_FILTER_DEFAULT, 0, mipImage));
-        const DirectX::TexMetadata& mipMetadata = mipImage.GetMetadata();
-        image = std::move(mipImage);
-        metadata = &image.GetMetadata(); // Have to refresh.
     }
 
-    m_Desc = CD3DX12_RESOURCE_DESC::Tex2D(
-        metadata->format,
-        (uint64_t)metadata->width,
-        (uint32_t)metadata->height,
-        (uint16_t)metadata->arraySize,
-        (uint16_t)metadata->mipLevels,
+    const float durationMilliseconds = TimeToMilliseconds<float>(Now() - beginTime);
+    LogInfoF(L"Generated {} mip levels in {:.1f} ms.", mipImage.GetMetadata().mipLevels, durationMilliseconds);
+    image = std::move(mipImage);
+}
+
+void Texture::Load(uint32_t flags, DirectX::ScratchImage& image)
+{
+    const DirectX::TexMetadata& metadata = image.GetMetadata();
+    CHECK_BOOL(image.GetImageCount() == metadata.mipLevels);
+    m_FullSize = uvec2((uint32_t)metadata.width, (uint32_t)metadata.height);
+
+    // Streaming texture keeps reading levels from the image, so it must not move after building mips.
+    if((flags & FLAG_STREAMING) != 0 && metadata.mipLevels > 1)
+        m_StreamingImage = std::make_unique<DirectX::ScratchImage>(std::move(image));
+    const DirectX::ScratchImage& srcImage = m_StreamingImage ? *m_StreamingImage : image;
+
+    std::vector<D3D12_SUBRESOURCE_DATA> mips(srcImage.GetMetadata().mipLevels);
+    for(size_t mip = 0; mip < mips.size(); ++mip)
+    {
+        const DirectX::Image* const img = srcImage.GetImage(mip, 0, 0);
+        mips[mip] = {
+            .pData = img->pixels,
+            .RowPitch = (LONG_PTR)img->rowPitch,
+            .SlicePitch = (LONG_PTR)img->slicePitch };
+    }
+    LoadMips(flags, srcImage.GetMetadata().format, std::move(mips));
+}
+
+void Texture::LoadMips(uint32_t flags, DXGI_FORMAT format, std::vector<D3D12_SUBRESOURCE_DATA>&& mips)
+{
+    const uint32_t mipLevels = (uint32_t)mips.size();
+    CHECK_BOOL(mipLevels > 0);
+
+    if((flags & FLAG_STREAMING) == 0 || mipLevels == 1)
+    {
+        CreateResidentTexture(format, mips, 0);
+        return;
+    }
+
+    // Tightly packed size, same no matter where the levels come from.
+    m_MipSizes.resize(mipLevels);
+    for(uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        size_t rowPitch = 0, slicePitch = 0;
+        CHECK_HR(DirectX::ComputePitch(format,
+            std::max(m_FullSize.x >> mip, 1u), std::max(m_FullSize.y >> mip, 1u), rowPitch, slicePitch));
+        m_MipSizes[mip] = slicePitch;
+    }
+
+    // Tail: levels not larger than g_TextureStreamingTailSize.
+    const uint32_t tailSize = std::max(g_TextureStreamingTailSize.GetValue(), 1u);
+    uint32_t maxFirstMip = 0;
+    while(maxFirstMip + 1 < mipLevels &&
+        std::max(m_FullSize.x, m_FullSize.y) >> maxFirstMip > tailSize)
+    {
+        ++maxFirstMip;
+    }
+    // Top level of a block-compressed texture must have size multiple of 4.
+    if(DirectX::IsCompressed(format))
+    {
+        while(maxFirstMip > 0 &&
+            (std::max(m_FullSize.x >> maxFirstMip, 1u) % 4 != 0 ||
+            std::max(m_FullSize.y >> maxFirstMip, 1u) % 4 != 0))
+        {
+            --maxFirstMip;
+        }
+    }
+    m_MaxFirstResidentMip = maxFirstMip;
+
+    m_StreamingMips = std::move(mips);
+    CreateResidentTexture(format, m_StreamingMips, m_MaxFirstResidentMip);
+}
+
+void Texture::SetFirstResidentMip(uint32_t firstMip, CommandList& cmdList,
+    std::vector<ComPtr<D3D12MA::Allocation>>& outRetiredAllocations)
+{
+    assert(IsStreaming());
+    firstMip = std::min(firstMip, m_MaxFirstResidentMip);
+    if(firstMip == m_FirstResidentMip)
+        return;
+
+    ERR_TRY;
+
+    // Frames in flight keep sampling the previous texture through the previous descriptor.
+    // If anything fails, they stay as they were.
+    const D3D12_RESOURCE_DESC prevDesc = m_Desc;
+    ComPtr<D3D12MA::Allocation> prevAllocation = std::move(m_Allocation);
+    ComPtr<ID3D12Resource> prevResource = std::move(m_Resource);
+    const Descriptor prevDescriptor = m_Descriptor;
+    ComPtr<D3D12MA::Allocation> srcBuf;
+    try
+    {
+        m_Desc = GetResidentDesc(prevDesc.Format, (uint32_t)m_StreamingMips.size(), firstMip);
+        CreateTexture();
+        if(!m_Name.empty())
+            SetD3D12ObjectName(m_Resource, m_Name);
+        srcBuf = RecordUpload(cmdList, std::span(m_StreamingMips).subspan(firstMip));
+        m_Descriptor = {};
+        CreateDescriptor();
+    }
+    catch(...)
+    {
+        // Upload may be recorded already.
+        outRetiredAllocations.push_back(std::move(m_Allocation));
+        outRetiredAllocations.push_back(std::move(srcBuf));
+        m_Desc = prevDesc;
+        m_Allocation = std::move(prevAllocation);
+        m_Resource = std::move(prevResource);
+        m_Descriptor = prevDescriptor;
+        throw;
+    }
+    m_FirstResidentMip = firstMip;
+    outRetiredAllocations.push_back(std::move(prevAllocation));
+    outRetiredAllocations.push_back(std::move(srcBuf));
+    g_Renderer->GetSRVDescriptorManager()->FreePersistentDeferred(prevDescriptor);
+
+    ERR_CATCH_MSG(std::format(L"Cannot change resident mip levels of texture \"{}\".", m_Name));
+}
+
+D3D12_RESOURCE_DESC Texture::GetResidentDesc(DXGI_FORMAT format, uint32_t mipCount, uint32_t firstMip) const
+{
+    assert(firstMip < mipCount);
+    return CD3DX12_RESOURCE_DESC::Tex2D(
+        format,
+        (uint64_t)std::max(m_FullSize.x >> firstMip, 1u),
+        std::max(m_FullSize.y >> firstMip, 1u),
+        1, // arraySize
+        (uint16_t)(mipCount - firstMip),
         1, // sampleCount
         0, // sampleQuality
         D3D12_RESOURCE_FLAG_NONE);
+}
+
+void Texture::CreateResidentTexture(DXGI_FORMAT format, std::span<const D3D12_SUBRESOURCE_DATA> mips,
+    uint32_t firstMip)
+{
+    assert(IsEmpty());
+    m_Desc = GetResidentDesc(format, (uint32_t)mips.size(), firstMip);
     CreateTexture();
-    CHECK_BOOL(image.GetImageCount() == metadata->mipLevels);
-    for(uint32_t mip = 0; mip < (uint32_t)metadata->mipLevels; ++mip)
-    {
-        const DirectX::Image* const currImg = image.GetImage(mip, 0, 0);
-        D3D12_SUBRESOURCE_DATA subresourceData = {
-            .pData = currImg->pixels,
-            .RowPitch = (LONG_PTR)currImg->rowPitch,
-            .SlicePitch = (LONG_PTR)currImg->slicePitch
-        };
-        const bool lastLevel = mip == metadata->mipLevels - 1;
-        UploadMipLevel(mip, uvec2((uint32_t)currImg->width, (uint32_t)currImg->height), subresourceData, lastLevel);
+    m_FirstResidentMip = firstMip;
+
+    CommandList cmdList;
+    g_Renderer->BeginUploadCommandList(cmdList);
+    // Source buffer must stay alive until the upload completes.
+    const ComPtr<D3D12MA::Allocation> srcBuf = RecordUpload(cmdList, mips.subspan(firstMip));
+    g_Renderer->CompleteUploadCommandList(cmdList);
+}
+
+static bool IsSingleChannelFormat(DXGI_FORMAT format)
+{
+    switch(format)
+    {
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Returns false if BlockCompressor doesn't support this combination of formats - then DirectXTex is used.
+static bool CompressWithBlockCompressor(const DirectX::ScratchImage& image, DXGI_FORMAT dstFormat,
+    DirectX::ScratchImage& outImage)
+{
+    BlockCompressor::Format blockFormat;
+    switch(dstFormat)
+    {
+    case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: blockFormat = BlockCompressor::Format::BC1; break;
+    case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB: blockFormat = BlockCompressor::Format::BC3; break;
+    case DXGI_FORMAT_BC4_UNORM: blockFormat = BlockCompressor::Format::BC4; break;
+    case DXGI_FORMAT_BC5_UNORM: blockFormat = BlockCompressor::Format::BC5; break;
+    default: return false;
+    }
+
+    const DirectX::TexMetadata& metadata = image.GetMetadata();
+    uint32_t sourceChannelCount = 4;
+    uint32_t compressorFlags = 0;
+    switch(metadata.format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM: case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM: case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        compressorFlags |= BlockCompressor::FLAG_BGRA;
+        break;
+    case DXGI_FORMAT_R8_UNORM:
+        if(blockFormat != BlockCompressor::Format::BC4)
+            return false;
+        sourceChannelCount = 1;
+        break;
+    default:
+        return false;
+    }
+    if(metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.depth != 1)
+        return false;
+
+    CHECK_HR(outImage.Initialize2D(dstFormat, metadata.width, metadata.height, metadata.arraySize, metadata.mipLevels));
+    const BlockCompressor compressor(blockFormat, sourceChannelCount, compressorFlags);
+    for(size_t imageIndex = 0; imageIndex < image.GetImageCount(); ++imageIndex)
+    {
+        const DirectX::Image& srcImage = image.GetImages()[imageIndex];
+        const DirectX::Image& dstImage = outImage.GetImages()[imageIndex];
+        const BlockCompressor::Image src = {
+            .m_Pixels = srcImage.pixels,
+            .m_Width = (uint32_t)srcImage.width,
+            .m_Height = (uint32_t)srcImage.height,
+            .m_RowPitch = srcImage.rowPitch};
+        compressor.Compress(src, dstImage.pixels, dstImage.rowPitch);
     }
+    return true;
+}
+
+void Texture::Compress(uint32_t flags, DirectX::ScratchImage& image)
+{
+    PROFILE_LOAD_SCOPE("Texture::Compress");
+    const DirectX::TexMetadata& metadata = image.GetMetadata();
+    // Direct3D 12 requires dimensions of the top level of a block-compressed texture to be multiple of 4.
+    if(metadata.width % 4 != 0 || metadata.height % 4 != 0)
+    {
+        LogWarningF(L"Cannot compress texture of size {}x{} - not a multiple of 4.",
+            metadata.width, metadata.height);
+        return;
+    }
+
+    const bool sRGB = DirectX::IsSRGB(metadata.format);
+    DXGI_FORMAT dstFormat;
+    if((flags & FLAG_NORMAL_MAP) != 0)
+        dstFormat = DXGI_FORMAT_BC5_UNORM;
+    else if(IsSingleChannelFormat(metadata.format))
+        dstFormat = DXGI_FORMAT_BC4_UNORM;
+    else if((flags & FLAG_COMPRESS_HIGH_QUALITY) != 0)
+        dstFormat = sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    else if(image.IsAlphaAllOpaque())
+        dstFormat = sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    else
+        dstFormat = sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+
+    LogInfoF(L"Compressing to {}...", DXGIFormatToStr(dstFormat));
+
+    const Time beginTime = Now();
+    DirectX::ScratchImage compressedImage;
+    if(!CompressWithBlockCompressor(image, dstFormat, compressedImage))
+    {
+        // TEX_COMPRESS_PARALLEL spreads blocks across all CPU cores. Applies to all BC formats.
+        CHECK_HR(DirectX::Compress(image.GetImages(), image.GetImageCount(), metadata,
+            dstFormat, DirectX::TEX_COMPRESS_PARALLEL, DirectX::TEX_THRESHOLD_DEFAULT, compressedImage));
+    }
+    const float durationMilliseconds = TimeToMilliseconds<float>(Now() - beginTime);
+
+    LogInfoF(L"Compressed {} to {} in {:.1f} ms.",
+        SizeToStr(image.GetPixelsSize()), SizeToStr(compressedImage.GetPixelsSize()), durationMilliseconds);
+    image = std::move(compressedImage);
 }
 
 void Texture::CreateTexture()
@@ -268,44 +689,61 @@ void Texture::CreateTexture()
         IID_PPV_ARGS(&m_Resource))); // riidResource, ppvResource
 }
 
-void Texture::UploadMipLevel(uint32_t mipLevel, const uvec2& size, const D3D12_SUBRESOURCE_DATA& data,
-    bool lastLevel)
+static ComPtr<D3D12MA::Allocation> CreateSourceBuffer(UINT64 size)
 {
-    assert(m_Desc.Format != DXGI_FORMAT_UNKNOWN);
-    const uint8_t bitsPerPixel = DXGIFormatToBitsPerPixel(m_Desc.Format);
-    CHECK_BOOL(bitsPerPixel > 0 && bitsPerPixel % 8 == 0);
-    const uint32_t bytesPerPixel = bitsPerPixel / 8;
-
-    // Create source buffer.
-    const size_t srcBufRowPitch = AlignUp<size_t>(size.x * bytesPerPixel, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
-    const size_t srcBufSize = srcBufRowPitch * size.y;
     ComPtr<D3D12MA::Allocation> srcBuf;
+    const CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    D3D12MA::ALLOCATION_DESC srcBufAllocDesc = {};
+    srcBufAllocDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
+    CHECK_HR(g_Renderer->GetMemoryAllocator()->CreateResource(
+        &srcBufAllocDesc,
+        &desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr, // pOptimizedClearValue
+        &srcBuf,
+        IID_NULL, NULL)); // riidResource, ppvResource
+    SetD3D12ObjectName(srcBuf->GetResource(), L"Texture source buffer");
+    return srcBuf;
+}
+
+static void FillSourceBuffer(char* dst, size_t dstRowPitch, const D3D12_SUBRESOURCE_DATA& data,
+    UINT rowCount, UINT64 rowSizeInBytes)
+{
+    const char* textureDataPtr = (const char*)data.pData;
+    // Data already laid out like the footprint, e.g. from the texture cache: single copy.
+    if((size_t)data.RowPitch == dstRowPitch)
+        memcpy(dst, textureDataPtr, (rowCount - 1) * dstRowPitch + (size_t)rowSizeInBytes);
+    else
     {
-        const CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(srcBufSize);
-        D3D12MA::ALLOCATION_DESC srcBufAllocDesc = {};
-        srcBufAllocDesc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
-        CHECK_HR(g_Renderer->GetMemoryAllocator()->CreateResource(
-            &srcBufAllocDesc,
-            &desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr, // pOptimizedClearValue
-            &srcBuf,
-            IID_NULL, NULL)); // riidResource, ppvResource
-        SetD3D12ObjectName(srcBuf->GetResource(), L"Font texture source buffer");
+        for(uint32_t y = 0; y < rowCount; ++y)
+        {
+            memcpy(dst, textureDataPtr, (size_t)rowSizeInBytes);
+            textureDataPtr += data.RowPitch;
+            dst += dstRowPitch;
+        }
     }
+}
+
+void Texture::UploadMipLevel(uint32_t mipLevel, const D3D12_SUBRESOURCE_DATA& data, bool lastLevel)
+{
+    PROFILE_LOAD_SCOPE("Texture::UploadMipLevel");
+    assert(m_Desc.Format != DXGI_FORMAT_UNKNOWN);
 
-    // Fill source buffer.
+    // Footprint takes care of block-compressed formats, where a row is a row of 4x4 blocks.
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT srcFootprint = {};
+    UINT rowCount = 0;
+    UINT64 rowSizeInBytes = 0;
+    UINT64 srcBufSize = 0;
+    g_Renderer->GetDevice()->GetCopyableFootprints(&m_Desc, mipLevel, 1, 0, // FirstSubresource, NumSubresources, BaseOffset
+        &srcFootprint, &rowCount, &rowSizeInBytes, &srcBufSize);
+    CHECK_BOOL(rowCount > 0 && srcBufSize > 0 && srcBufSize != UINT64_MAX);
+    CHECK_BOOL((uint64_t)data.RowPitch >= rowSizeInBytes);
+
+    ComPtr<D3D12MA::Allocation> srcBuf = CreateSourceBuffer(srcBufSize);
     {
-        CD3DX12_RANGE readEmptyRange{0, 0};
         char* srcBufMappedPtr = nullptr;
-        const char* textureDataPtr = (const char*)data.pData;
         CHECK_HR(srcBuf->GetResource()->Map(0, D3D12_RANGE_NONE, (void**)&srcBufMappedPtr));
-        for(uint32_t y = 0; y < size.y; ++y)
-        {
-            memcpy(srcBufMappedPtr, textureDataPtr, size.x * bytesPerPixel);
-            textureDataPtr = (char*)textureDataPtr + data.RowPitch;
-            srcBufMappedPtr += srcBufRowPitch;
-        }
+        FillSourceBuffer(srcBufMappedPtr, srcFootprint.Footprint.RowPitch, data, rowCount, rowSizeInBytes);
         srcBuf->GetResource()->Unmap(0, D3D12_RANGE_ALL); // pWrittenRange
     }
 
@@ -315,16 +753,12 @@ void Texture::UploadMipLevel(uint32_t mipLevel, const uvec2& size, const D3D12_S
         g_Renderer->BeginUploadCommandList(cmdList);
 
         CD3DX12_TEXTURE_COPY_LOCATION dst{m_Resource.Get(), mipLevel};
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT srcFootprint = {0, // Offset
-            {m_Desc.Format, size.x, size.y, 1, (UINT)srcBufRowPitch}};
         CD3DX12_TEXTURE_COPY_LOCATION src{srcBuf->GetResource(), srcFootprint};
-        CD3DX12_BOX srcBox{
-            0, 0, 0, // Left, Top, Front
-            (LONG)size.x, (LONG)size.y, 1}; // Right, Bottom, Back
-
+        // pSrcBox = null copies whole footprint, which for small mips of block-compressed
+        // textures is a full 4x4 block, as required.
         cmdList.GetCmdList()->CopyTextureRegion(&dst,
             0, 0, 0, // DstX, DstY, DstZ
-            &src, &srcBox);
+            &src, nullptr); // pSrcBox
 
         if(lastLevel)
         {
@@ -337,6 +771,52 @@ void Texture::UploadMipLevel(uint32_t mipLevel, const uvec2& size, const D3D12_S
     }
 }
 
+ComPtr<D3D12MA::Allocation> Texture::RecordUpload(CommandList& cmdList,
+    std::span<const D3D12_SUBRESOURCE_DATA> levels)
+{
+    PROFILE_LOAD_SCOPE("Texture::RecordUpload");
+    assert(m_Desc.Format != DXGI_FORMAT_UNKNOWN);
+    const uint32_t levelCount = (uint32_t)levels.size();
+    CHECK_BOOL(levelCount == m_Desc.MipLevels && levelCount <= D3D12_REQ_MIP_LEVELS);
+
+    // All levels go through one source buffer, at offsets given by their footprints.
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[D3D12_REQ_MIP_LEVELS] = {};
+    UINT rowCounts[D3D12_REQ_MIP_LEVELS] = {};
+    UINT64 rowSizesInBytes[D3D12_REQ_MIP_LEVELS] = {};
+    UINT64 srcBufSize = 0;
+    g_Renderer->GetDevice()->GetCopyableFootprints(&m_Desc, 0, levelCount, 0, // FirstSubresource, NumSubresources, BaseOffset
+        footprints, rowCounts, rowSizesInBytes, &srcBufSize);
+    CHECK_BOOL(srcBufSize > 0 && srcBufSize != UINT64_MAX);
+    for(uint32_t level = 0; level < levelCount; ++level)
+        CHECK_BOOL(rowCounts[level] > 0 && (uint64_t)levels[level].RowPitch >= rowSizesInBytes[level]);
+
+    ComPtr<D3D12MA::Allocation> srcBuf = CreateSourceBuffer(srcBufSize);
+    {
+        char* srcBufMappedPtr = nullptr;
+        CHECK_HR(srcBuf->GetResource()->Map(0, D3D12_RANGE_NONE, (void**)&srcBufMappedPtr));
+        for(uint32_t level = 0; level < levelCount; ++level)
+        {
+            FillSourceBuffer(srcBufMappedPtr + footprints[level].Offset, footprints[level].Footprint.RowPitch,
+                levels[level], rowCounts[level], rowSizesInBytes[level]);
+        }
+        srcBuf->GetResource()->Unmap(0, D3D12_RANGE_ALL); // pWrittenRange
+    }
+
+    for(uint32_t level = 0; level < levelCount; ++level)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst{m_Resource.Get(), level};
+        CD3DX12_TEXTURE_COPY_LOCATION src{srcBuf->GetResource(), footprints[level]};
+        // See UploadMipLevel about pSrcBox.
+        cmdList.GetCmdList()->CopyTextureRegion(&dst,
+            0, 0, 0, // DstX, DstY, DstZ
+            &src, nullptr); // pSrcBox
+    }
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+        m_Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    cmdList.GetCmdList()->ResourceBarrier(1, &barrier);
+    return srcBuf;
+}
+
 void Texture::CreateDescriptor()
 {
     assert(m_Resource);
@@ -345,39 +825,41 @@ void Texture::CreateDescriptor()
     CHECK_BOOL(m_Desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D);
 
     DescriptorManager* SRVDescManager = g_Renderer->GetSRVDescriptorManager();
-    m_Descriptor = SRVDescManager->AllocatePersistent(1);
+    if(m_Descriptor.IsNull())
+        SRVDescManager->AllocatePersistentMovable(1, m_Descriptor);
 
-    /*
+    // Array view also for a single texture - see class comment.
     D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {
         .Format = m_Desc.Format,
-        .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
-        .Shader4ComponentMapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(
-            D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0,
-            D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_1,
-            D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_2,
-            D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_3)};
-    SRVDesc.Texture2D = {
+        .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING};
+    SRVDesc.Texture2DArray = {
         .MostDetailedMip = 0,
         .MipLevels = UINT32_MAX,
+        .FirstArraySlice = 0,
+        .ArraySize = m_Desc.DepthOrArraySize,
         .PlaneSlice = 0,
         .ResourceMinLODClamp = 0.f};
-    */
     g_Renderer->GetDevice()->CreateShaderResourceView(
-        m_Resource.Get(), nullptr, SRVDescManager->GetCPUHandle(m_Descriptor));
+        m_Resource.Get(), &SRVDesc, SRVDescManager->GetCPUHandle(m_Descriptor));
 }
 
 /*
 Texture cache:
 
-File path: std::format("Cache/Textures/{:016X}", hash)
+Entry of type AssetPack::Type::Texture in g_AssetPack, with hash returned by CalculateHash.
 
-Validation: last write time of cache file > last write time of source file
+Validation: last write time of source file == source time of the entry
 
-File format:
+Entry format, version TEXTURE_CACHE_VERSION, all numbers little-endian, see TextureCacheFormat.cpp:
 
-- Header: chars = "RegEngine Cache Texture 100"
-- ContentSize: uint32
-- Content: bytes[ContentSize] - contents of DDS file
-- Header: chars - same as above
+- TextureCacheHeader: Magic = "RegEngineTexture", Version, Format (DXGI_FORMAT), Width, Height,
+  MipLevels, Reserved, TotalSize.
+- TextureCacheMip[MipLevels]: Offset, RowPitch, RowCount.
+- Data of each mip at its Offset, aligned to D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT,
+  with rows aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, like a copyable footprint,
+  so each level can be copied from the mapped pack to an upload buffer with a single memcpy,
+  or only selected levels read. May be in a block-compressed format if texture was loaded with FLAG_COMPRESS.
 
+The texture is stored fully processed: sRGB format, mipmaps, compression.
 */
@@ -3,10 +3,13 @@
 #include "Descriptors.hpp"
 
 namespace DirectX { class ScratchImage; }
+class MappedFile;
+class CommandList;
 
 /*
 Represents a texture, initialized once, then available for sampling.
-Also creates and keeps its SRV descriptor.
+Also creates and keeps its SRV descriptor. The SRV is always a Texture2DArray view, also for
+a single texture, so shaders sample separate textures and slices of texture arrays the same way.
 */
 class Texture
 {
@@ -21,21 +24,63 @@ public:
         FLAG_CACHE_LOAD = 0x4,
         // If loaded from source file, save processed texture to cache.
         FLAG_CACHE_SAVE = 0x8,
+        // Compress to a block-compressed (BC) format after generating mipmaps, unless already compressed.
+        // Format is selected according to usage and contents: BC5 for normal maps, BC4 for single-channel,
+        // BC7 or BC1/BC3 for color.
+        FLAG_COMPRESS = 0x10,
+        // Texture contains tangent-space normals. Only XY is needed, Z is reconstructed in shader.
+        FLAG_NORMAL_MAP = 0x20,
+        // Together with FLAG_COMPRESS: use BC7 instead of BC1/BC3 for color textures. Slower to encode.
+        FLAG_COMPRESS_HIGH_QUALITY = 0x40,
+        // Keep all mip levels in CPU memory, create GPU texture with only the smallest levels.
+        // Finer levels can be made resident later using SetFirstResidentMip.
+        FLAG_STREAMING = 0x80,
+        // Alpha is used for alpha test. Alpha of generated mipmaps is scaled to preserve
+        // the fraction of pixels passing the test with alphaCutoff, so objects don't fade out in the distance.
+        FLAG_ALPHA_TEST = 0x100,
     };
 
     ~Texture();
-    void LoadFromFile(uint32_t flags, const wstr_view& filePath);
+    // alphaCutoff: used only with FLAG_ALPHA_TEST.
+    void LoadFromFile(uint32_t flags, const wstr_view& filePath, float alphaCutoff = 0.5f);
     void LoadFromMemory(
         const D3D12_RESOURCE_DESC& resDesc,
         const D3D12_SUBRESOURCE_DATA& data,
         const wstr_view& name);
+    /*
+    Creates texture array with slice i copied on the GPU from slices[i]. They must have the same format,
+    size and number of mip levels, all of them resident. They can be destroyed afterwards.
+    GPU must not be using them when calling this function.
+    */
+    void LoadArray(std::span<const Texture* const> slices, const wstr_view& name);
 
     bool IsEmpty() const { return !m_Resource; }
     ID3D12Resource* GetResource() const { return m_Resource.Get(); }
     const D3D12_RESOURCE_DESC& GetDesc() const { return m_Desc; }
+    uint32_t GetArraySize() const { return GetDesc().DepthOrArraySize; }
+    // Size of GPU memory allocated for resident levels. 0 if not created with D3D12MA.
+    uint64_t GetAllocatedSize() const { return m_Allocation ? m_Allocation->GetSize() : 0; }
+    // Size of the first resident level.
     uvec2 GetSize() const { return uvec2((uint32_t)GetDesc().Width, (uint32_t)GetDesc().Height); }
     Descriptor GetDescriptor() const { return m_Descriptor; }
 
+    bool IsStreaming() const { return !m_StreamingMips.empty(); }
+    // Size of mip 0 of the full mip chain, also for streaming texture.
+    uvec2 GetFullSize() const { return m_FullSize; }
+    // Valid only for streaming texture - byte size of each level of the full mip chain.
+    std::span<const uint64_t> GetMipSizes() const { return m_MipSizes; }
+    uint32_t GetFirstResidentMip() const { return m_FirstResidentMip; }
+    uint32_t GetMaxFirstResidentMip() const { return m_MaxFirstResidentMip; }
+    /*
+    Valid only for streaming texture. Creates new GPU texture with levels firstMip..last, records their upload
+    to cmdList and switches to a new descriptor, so it doesn't wait for the GPU. Frames in flight keep using
+    the previous texture and descriptor. The descriptor is freed with FreePersistentDeferred. The previous
+    texture and the upload buffer are added to outRetiredAllocations - release them when cmdList finishes
+    executing. cmdList must execute before draws using the new descriptor.
+    */
+    void SetFirstResidentMip(uint32_t firstMip, CommandList& cmdList,
+        std::vector<ComPtr<D3D12MA::Allocation>>& outRetiredAllocations);
+
 private:
     // May be null in case m_Resource was created by DirectXTK12, without D3D12MA.
     // If not null, m_Resource == m_Allocation->GetResource().
@@ -43,19 +88,52 @@ private:
     ComPtr<ID3D12Resource> m_Resource;
     D3D12_RESOURCE_DESC m_Desc = {};
     Descriptor m_Descriptor;
+    uvec2 m_FullSize = uvec2(0, 0);
+    wstring m_Name;
+    // Valid only for streaming texture - full mip chain, pointing to m_StreamingImage or m_StreamingFile.
+    std::vector<D3D12_SUBRESOURCE_DATA> m_StreamingMips;
+    // At most one of them not null, when texture is streaming, depending on where it was loaded from.
+    unique_ptr<DirectX::ScratchImage> m_StreamingImage;
+    // Mapped asset pack, shared with other textures loaded from cache.
+    std::shared_ptr<const MappedFile> m_StreamingFile;
+    std::vector<uint64_t> m_MipSizes;
+    uint32_t m_FirstResidentMip = 0;
+    uint32_t m_MaxFirstResidentMip = 0;
 
-    static size_t CalculateHash(uint32_t flags, const std::filesystem::path& filePath);
+    static size_t CalculateHash(uint32_t flags, float alphaCutoff, const std::filesystem::path& filePath);
 
-    // Includes saving to cache file.
-    void LoadFromSourceFile(uint32_t flags, const wstr_view& filePath,
-        const std::filesystem::path& cacheFilePath);
-    void SaveCacheFile(const std::filesystem::path& cacheFilePath,
-        const DirectX::ScratchImage& image) const;
-    void LoadFromCacheFile(uint32_t flags, const std::filesystem::path& path);
+    // Includes saving to cache. hash, sourceTime: identify the cache entry.
+    void LoadFromSourceFile(uint32_t flags, float alphaCutoff, const wstr_view& filePath,
+        size_t hash, int64_t sourceTime);
+    static void SaveCacheData(std::vector<char>& outData, const DirectX::ScratchImage& image);
+    // file: keeps data alive, for streaming texture.
+    void LoadFromCacheData(uint32_t flags, std::span<const char> data, std::shared_ptr<const MappedFile> file);
+    // Validates image and applies processing requested by flags: sRGB, mipmaps, compression.
+    static void Process(uint32_t flags, float alphaCutoff, DirectX::ScratchImage& image);
+    // Downscales image larger than setting "Textures.MaxSize".
+    static void LimitSize(DirectX::ScratchImage& image);
+    // Uses MipmapGenerator for 8-bit RGBA/BGRA formats, DirectX::GenerateMipMaps for others.
+    static void GenerateMipmaps(uint32_t flags, float alphaCutoff, DirectX::ScratchImage& image);
+    static void Compress(uint32_t flags, DirectX::ScratchImage& image);
+    // Creates GPU texture from processed image. With FLAG_STREAMING, takes ownership of the image.
     void Load(uint32_t flags, DirectX::ScratchImage& image);
+    // Creates GPU texture from full mip chain, where mip 0 has size m_FullSize.
+    // With FLAG_STREAMING, keeps mips, so memory they point to must stay alive as long as the texture.
+    void LoadMips(uint32_t flags, DXGI_FORMAT format, std::vector<D3D12_SUBRESOURCE_DATA>&& mips);
+    // Description of 2D texture with levels firstMip..mipCount-1 of the full mip chain.
+    D3D12_RESOURCE_DESC GetResidentDesc(DXGI_FORMAT format, uint32_t mipCount, uint32_t firstMip) const;
+    // Creates m_Resource with levels firstMip..last and uploads them, waiting for the upload.
+    void CreateResidentTexture(DXGI_FORMAT format, std::span<const D3D12_SUBRESOURCE_DATA> mips, uint32_t firstMip);
     void CreateTexture();
+    // Works with any format, including block-compressed.
     // lastLevel = true issues a barrier to transition texture to D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE.
-    void UploadMipLevel(uint32_t mipLevel, const uvec2& size, const D3D12_SUBRESOURCE_DATA& data,
-        bool lastLevel);
+    void UploadMipLevel(uint32_t mipLevel, const D3D12_SUBRESOURCE_DATA& data, bool lastLevel);
+    /*
+    Records copy of all levels of m_Resource from levels to cmdList, through one upload buffer, then transition
+    to D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE. Returns the upload buffer, which must stay alive until
+    cmdList finishes executing.
+    */
+    ComPtr<D3D12MA::Allocation> RecordUpload(CommandList& cmdList, std::span<const D3D12_SUBRESOURCE_DATA> levels);
+    // Allocates descriptor if not allocated yet, then writes SRV of m_Resource to it.
     void CreateDescriptor();
 };
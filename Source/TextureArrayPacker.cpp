@@ -0,0 +1,66 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "TextureArrayPacker.hpp"
+#include <algorithm>
+
+TextureArrayPacker::TextureArrayPacker(uint32_t maxSize, uint32_t maxSlices) :
+    m_MaxSize(maxSize),
+    m_MaxSlices(std::max(maxSlices, 2u))
+{
+}
+
+void TextureArrayPacker::Pack(std::span<const Item> items, std::vector<Array>& outArrays) const
+{
+    outArrays.clear();
+
+    std::vector<size_t> order;
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        if(items[i].m_Width <= m_MaxSize && items[i].m_Height <= m_MaxSize)
+            order.push_back(i);
+    }
+    // Stable, so slices follow the order of items, which makes the result deterministic.
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+    {
+        return ItemLess(items[lhs], items[rhs]);
+    });
+
+    for(size_t groupBegin = 0; groupBegin < order.size(); )
+    {
+        size_t groupEnd = groupBegin + 1;
+        while(groupEnd < order.size() && ItemEqual(items[order[groupBegin]], items[order[groupEnd]]))
+            ++groupEnd;
+
+        const size_t groupSize = groupEnd - groupBegin;
+        if(groupSize >= 2)
+        {
+            // Split evenly, so no array is left with a single item. Only with m_MaxSlices == 2
+            // an odd group has one, which stays a separate texture.
+            const size_t arrayCount = (groupSize + m_MaxSlices - 1) / m_MaxSlices;
+            for(size_t arrayIndex = 0; arrayIndex < arrayCount; ++arrayIndex)
+            {
+                const size_t begin = groupBegin + groupSize * arrayIndex / arrayCount;
+                const size_t end = groupBegin + groupSize * (arrayIndex + 1) / arrayCount;
+                if(end - begin >= 2)
+                    outArrays.push_back({std::vector<size_t>(order.begin() + begin, order.begin() + end)});
+            }
+        }
+        groupBegin = groupEnd;
+    }
+}
+
+bool TextureArrayPacker::ItemLess(const Item& lhs, const Item& rhs)
+{
+    if(lhs.m_Format != rhs.m_Format)
+        return lhs.m_Format < rhs.m_Format;
+    if(lhs.m_Width != rhs.m_Width)
+        return lhs.m_Width < rhs.m_Width;
+    if(lhs.m_Height != rhs.m_Height)
+        return lhs.m_Height < rhs.m_Height;
+    return lhs.m_MipLevels < rhs.m_MipLevels;
+}
+
+bool TextureArrayPacker::ItemEqual(const Item& lhs, const Item& rhs)
+{
+    return lhs.m_Format == rhs.m_Format && lhs.m_Width == rhs.m_Width &&
+        lhs.m_Height == rhs.m_Height && lhs.m_MipLevels == rhs.m_MipLevels;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+Selects textures that can be merged into 2D texture arrays, so materials using them share
+one resource and one descriptor.
+
+Only textures with identical format, size and number of mip levels can share an array.
+Unlike an atlas, an array keeps texture coordinates, wrap addressing and all mip levels
+of each texture unchanged, so no padding or UV remapping is needed.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+class TextureArrayPacker
+{
+public:
+    struct Item
+    {
+        // E.g. DXGI_FORMAT. Only compared for equality.
+        uint32_t m_Format;
+        uint32_t m_Width;
+        uint32_t m_Height;
+        uint32_t m_MipLevels;
+    };
+
+    struct Array
+    {
+        // Indices of items passed to Pack. Position in this vector is the array slice of the item.
+        std::vector<size_t> m_Items;
+    };
+
+    // maxSize: only items with width and height not larger than this are packed.
+    // maxSlices: maximum number of items in one array, at least 2.
+    TextureArrayPacker(uint32_t maxSize, uint32_t maxSlices);
+
+    // Each returned array has at least 2 items. Items not returned in any array should stay separate textures.
+    // Groups larger than maxSlices are split into arrays of similar size. With maxSlices 2, one item
+    // of a group with odd size stays separate.
+    void Pack(std::span<const Item> items, std::vector<Array>& outArrays) const;
+
+private:
+    const uint32_t m_MaxSize;
+    const uint32_t m_MaxSlices;
+
+    static bool ItemLess(const Item& lhs, const Item& rhs);
+    static bool ItemEqual(const Item& lhs, const Item& rhs);
+};
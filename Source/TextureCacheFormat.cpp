@@ -0,0 +1,117 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "TextureCacheFormat.hpp"
+#include <cstring>
+
+static const char TEXTURE_CACHE_MAGIC[16] = {'R','e','g','E','n','g','i','n','e','T','e','x','t','u','r','e'};
+
+struct TextureCacheHeader
+{
+    char m_Magic[16];
+    uint32_t m_Version;
+    uint32_t m_Format;
+    uint32_t m_Width;
+    uint32_t m_Height;
+    uint32_t m_MipLevels;
+    uint32_t m_Reserved;
+    // Size of the whole entry, to detect truncated data.
+    uint64_t m_TotalSize;
+};
+static_assert(sizeof(TextureCacheHeader) == 48);
+
+struct TextureCacheMip
+{
+    // From the beginning of the entry. Multiple of TEXTURE_CACHE_LEVEL_ALIGNMENT.
+    uint64_t m_Offset;
+    // Multiple of TEXTURE_CACHE_ROW_PITCH_ALIGNMENT, same as row pitch of the copyable footprint.
+    uint32_t m_RowPitch;
+    uint32_t m_RowCount;
+};
+static_assert(sizeof(TextureCacheMip) == 16);
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void SaveTextureCacheData(const TextureCacheDesc& desc, std::span<const TextureCacheLevel> levels,
+    std::vector<char>& outData)
+{
+    TextureCacheHeader header = {};
+    header.m_Version = TEXTURE_CACHE_VERSION;
+    header.m_Format = desc.m_Format;
+    header.m_Width = desc.m_Width;
+    header.m_Height = desc.m_Height;
+    header.m_MipLevels = (uint32_t)levels.size();
+    memcpy(header.m_Magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+
+    std::vector<TextureCacheMip> mips(levels.size());
+    uint64_t offset = AlignUp(sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * mips.size(),
+        TEXTURE_CACHE_LEVEL_ALIGNMENT);
+    for(size_t mip = 0; mip < mips.size(); ++mip)
+    {
+        mips[mip].m_Offset = offset;
+        mips[mip].m_RowPitch = (uint32_t)AlignUp(levels[mip].m_RowPitch, TEXTURE_CACHE_ROW_PITCH_ALIGNMENT);
+        mips[mip].m_RowCount = levels[mip].m_RowCount;
+        offset = AlignUp(offset + (uint64_t)mips[mip].m_RowPitch * mips[mip].m_RowCount,
+            TEXTURE_CACHE_LEVEL_ALIGNMENT);
+    }
+    header.m_TotalSize = offset;
+
+    // Padding stays zero.
+    outData.clear();
+    outData.resize((size_t)header.m_TotalSize);
+    memcpy(outData.data(), &header, sizeof(header));
+    memcpy(outData.data() + sizeof(header), mips.data(), sizeof(TextureCacheMip) * mips.size());
+    for(size_t mip = 0; mip < mips.size(); ++mip)
+    {
+        const TextureCacheLevel& level = levels[mip];
+        for(uint32_t row = 0; row < mips[mip].m_RowCount; ++row)
+        {
+            memcpy(outData.data() + mips[mip].m_Offset + (size_t)row * mips[mip].m_RowPitch,
+                level.m_Data + row * level.m_RowPitch, level.m_RowPitch);
+        }
+    }
+}
+
+bool LoadTextureCacheData(std::span<const char> data, TextureCacheDesc& outDesc,
+    std::vector<TextureCacheLevel>& outLevels)
+{
+    // Entries come from a mapped file, so they are read with memcpy, not assumed to be aligned.
+    TextureCacheHeader header;
+    if(data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if(memcmp(header.m_Magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0 ||
+        header.m_Version != TEXTURE_CACHE_VERSION ||
+        header.m_TotalSize != data.size() ||
+        header.m_Width == 0 || header.m_Height == 0 ||
+        header.m_MipLevels == 0 || header.m_MipLevels > TEXTURE_CACHE_MAX_MIP_LEVELS ||
+        sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * header.m_MipLevels > data.size())
+    {
+        return false;
+    }
+
+    outLevels.resize(header.m_MipLevels);
+    for(uint32_t mip = 0; mip < header.m_MipLevels; ++mip)
+    {
+        TextureCacheMip cacheMip;
+        memcpy(&cacheMip, data.data() + sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * mip, sizeof(cacheMip));
+        const uint64_t mipSize = (uint64_t)cacheMip.m_RowPitch * cacheMip.m_RowCount;
+        if(cacheMip.m_Offset % TEXTURE_CACHE_LEVEL_ALIGNMENT != 0 ||
+            cacheMip.m_RowPitch % TEXTURE_CACHE_ROW_PITCH_ALIGNMENT != 0 ||
+            cacheMip.m_Offset > data.size() || mipSize > data.size() - cacheMip.m_Offset)
+        {
+            return false;
+        }
+        outLevels[mip] = {
+            .m_Data = data.data() + cacheMip.m_Offset,
+            .m_RowPitch = cacheMip.m_RowPitch,
+            .m_RowCount = cacheMip.m_RowCount };
+    }
+    outDesc = {
+        .m_Format = header.m_Format,
+        .m_Width = header.m_Width,
+        .m_Height = header.m_Height,
+        .m_MipLevels = header.m_MipLevels };
+    return true;
+}
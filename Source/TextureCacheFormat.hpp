@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+Format of cooked texture entries in the asset pack, see "Texture cache" at the end of Texture.cpp.
+
+Levels are stored with rows aligned like a copyable footprint, so Texture can copy each level from
+the mapped pack to an upload buffer with a single memcpy, or read only selected levels.
+Knows nothing about pixel formats: the format is stored as a number and the caller provides
+row pitch and row count of each level.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Bump when layout of the entry changes.
+static const uint32_t TEXTURE_CACHE_VERSION = 200;
+// Same as D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+static const uint32_t TEXTURE_CACHE_LEVEL_ALIGNMENT = 512;
+// Same as D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+static const uint32_t TEXTURE_CACHE_ROW_PITCH_ALIGNMENT = 256;
+// Same as D3D12_REQ_MIP_LEVELS.
+static const uint32_t TEXTURE_CACHE_MAX_MIP_LEVELS = 15;
+
+struct TextureCacheDesc
+{
+    uint32_t m_Format = 0; // DXGI_FORMAT
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    uint32_t m_MipLevels = 0;
+};
+
+struct TextureCacheLevel
+{
+    const char* m_Data = nullptr;
+    // Distance between rows in m_Data.
+    size_t m_RowPitch = 0;
+    // Rows of pixels, or rows of 4x4 blocks for block-compressed formats.
+    uint32_t m_RowCount = 0;
+};
+
+/*
+Serializes a texture to outData, replacing its contents.
+levels: desc.m_MipLevels levels, first is the largest. m_RowPitch is the number of bytes copied from each row.
+*/
+void SaveTextureCacheData(const TextureCacheDesc& desc, std::span<const TextureCacheLevel> levels,
+    std::vector<char>& outData);
+
+/*
+Validates data and fills outLevels with pointers into it - no pixels are copied.
+Returned m_RowPitch is a multiple of TEXTURE_CACHE_ROW_PITCH_ALIGNMENT.
+Returns false if the data is truncated, has other version or inconsistent offsets.
+The caller still has to check the format and that row counts match it.
+*/
+bool LoadTextureCacheData(std::span<const char> data, TextureCacheDesc& outDesc,
+    std::vector<TextureCacheLevel>& outLevels);
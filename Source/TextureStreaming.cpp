@@ -0,0 +1,125 @@
+#include "BaseUtils.hpp"
+#include "TextureStreaming.hpp"
+#include "Renderer.hpp"
+#include "Texture.hpp"
+#include "Mesh.hpp"
+#include "Settings.hpp"
+#include "ImGuiUtils.hpp"
+#include "FrameArena.hpp"
+#include <algorithm>
+
+static UintSetting g_TextureStreamingBudgetMB(SettingCategory::Runtime, "Textures.Streaming.BudgetMB", 512);
+static UintSetting g_TextureStreamingMaxChangesPerFrame(SettingCategory::Runtime, "Textures.Streaming.MaxChangesPerFrame", 4);
+// Lower the budget when GPU memory usage reported by the OS exceeds this percent of its budget.
+static BoolSetting g_TextureStreamingAutoBudget(SettingCategory::Runtime, "Textures.Streaming.AutoBudget", true);
+static UintSetting g_TextureStreamingMaxGPUUsagePercent(SettingCategory::Runtime, "Textures.Streaming.MaxGPUUsagePercent", 90);
+static const float STREAMING_BUDGET_HYSTERESIS = 0.05f;
+
+float ComputeUVDensity(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+    double geometricArea = 0.;
+    double UVArea = 0.;
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const Vertex& v0 = vertices[indices[i]];
+        const Vertex& v1 = vertices[indices[i + 1]];
+        const Vertex& v2 = vertices[indices[i + 2]];
+        // Both areas are doubled, which cancels out in the ratio.
+        const vec3 p0 = v0.m_Position;
+        geometricArea += glm::length(glm::cross(vec3(v1.m_Position) - p0, vec3(v2.m_Position) - p0));
+        const vec2 t0 = v0.m_TexCoord;
+        const vec2 e1 = vec2(v1.m_TexCoord) - t0;
+        const vec2 e2 = vec2(v2.m_TexCoord) - t0;
+        UVArea += fabs(e1.x * e2.y - e1.y * e2.x);
+    }
+    if(geometricArea <= 0.)
+        return 0.f;
+    return (float)sqrt(UVArea / geometricArea);
+}
+
+void ComputeBoundingSphere(vec3& outCenter, float& outRadius, std::span<const Vertex> vertices)
+{
+    outCenter = vec3(0.f);
+    outRadius = 0.f;
+    if(vertices.empty())
+        return;
+
+    vec3 minPos = vertices[0].m_Position;
+    vec3 maxPos = minPos;
+    for(const Vertex& v : vertices)
+    {
+        minPos = glm::min(minPos, vec3(v.m_Position));
+        maxPos = glm::max(maxPos, vec3(v.m_Position));
+    }
+    outCenter = (minPos + maxPos) * 0.5f;
+
+    float radiusSq = 0.f;
+    for(const Vertex& v : vertices)
+    {
+        const vec3 d = vec3(v.m_Position) - outCenter;
+        radiusSq = std::max(radiusSq, glm::dot(d, d));
+    }
+    outRadius = sqrt(radiusSq);
+}
+
+bool IsSphereInFrustum(const vec3& center_View, float radius, float tanHalfFovX, float tanHalfFovY, float zNear)
+{
+    if(center_View.z + radius < zNear)
+        return false;
+    // Side planes pass through the origin, e.g. the right one has normal (1, 0, -tanHalfFovX), normalized.
+    const float planeDistanceX = (fabs(center_View.x) - center_View.z * tanHalfFovX) / sqrt(1.f + tanHalfFovX * tanHalfFovX);
+    if(planeDistanceX > radius)
+        return false;
+    const float planeDistanceY = (fabs(center_View.y) - center_View.z * tanHalfFovY) / sqrt(1.f + tanHalfFovY * tanHalfFovY);
+    if(planeDistanceY > radius)
+        return false;
+    return true;
+}
+
+void TextureStreamer::CalculateChanges(const std::vector<Scene::Texture>& textures, uint64_t deviceUsage,
+    uint64_t deviceBudget, std::pmr::vector<Change>& outChanges)
+{
+    m_Textures.resize(textures.size());
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        const ::Texture* const tex = textures[i].m_Texture.get();
+        if(tex && tex->IsStreaming())
+        {
+            m_Textures[i] = {
+                .m_MipSizes = tex->GetMipSizes(),
+                .m_MaxFirstMip = tex->GetMaxFirstResidentMip(),
+                .m_FirstResidentMip = tex->GetFirstResidentMip() };
+        }
+        else
+            m_Textures[i] = {};
+    }
+
+    const TextureStreamingPolicy::Params params = {
+        .m_MaxBudget = (uint64_t)g_TextureStreamingBudgetMB.GetValue() * 1024 * 1024,
+        .m_AutoBudget = g_TextureStreamingAutoBudget.GetValue(),
+        .m_TargetUsage = (float)g_TextureStreamingMaxGPUUsagePercent.GetValue() * 0.01f,
+        .m_Hysteresis = STREAMING_BUDGET_HYSTERESIS,
+        .m_MaxChangesPerFrame = g_TextureStreamingMaxChangesPerFrame.GetValue() };
+    m_DeviceUsage = deviceUsage;
+    m_DeviceBudget = deviceBudget;
+    m_Policy.CalculateChanges(m_Textures, deviceUsage, deviceBudget, params, outChanges);
+}
+
+void TextureStreamer::ImGui()
+{
+    const uint64_t budget = m_Policy.GetBudget();
+    const uint64_t residentSize = m_Policy.GetResidentSize();
+    ImGui::Text("Streaming textures: %u", m_Policy.GetStreamingTextureCount());
+    ImGui::Text("Resident: %s, target: %s, all levels: %s",
+        FrameSizeToStr(residentSize),
+        FrameSizeToStr(m_Policy.GetTargetSize()),
+        FrameSizeToStr(m_Policy.GetFullSize()));
+    ImGui::Text("Budget: %s (%.1f%%), max: %s",
+        FrameSizeToStr(budget),
+        budget ? (double)residentSize / (double)budget * 100. : 0.,
+        FrameSizeToStr((uint64_t)g_TextureStreamingBudgetMB.GetValue() * 1024 * 1024));
+    ImGui::Text("GPU memory usage: %s of %s",
+        FrameSizeToStr(m_DeviceUsage),
+        FrameSizeToStr(m_DeviceBudget));
+    ImGui::Text("Stream in: %llu, stream out: %llu", m_Policy.GetStreamInCount(), m_Policy.GetStreamOutCount());
+}
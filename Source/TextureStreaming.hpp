@@ -0,0 +1,51 @@
+#pragma once
+
+#include "TextureStreamingPolicy.hpp"
+
+struct Vertex;
+namespace Scene { struct Texture; }
+
+/*
+Texture mip streaming. Estimation of required levels and the budget are in TextureStreamingPolicy.
+Here are the parts that depend on meshes and textures of the renderer.
+*/
+
+// Returns average number of texture coordinate units per object space unit,
+// as square root of the ratio of total UV area to total geometric area. Returns 0 for degenerate mesh.
+float ComputeUVDensity(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+void ComputeBoundingSphere(vec3& outCenter, float& outRadius, std::span<const Vertex> vertices);
+
+// Sphere in view space, where camera looks in +Z direction.
+bool IsSphereInFrustum(const vec3& center_View, float radius, float tanHalfFovX, float tanHalfFovY, float zNear);
+
+/*
+Manages resident mip levels of textures loaded with Texture::FLAG_STREAMING.
+During rendering, call RequestMip for every texture used by a draw call.
+Once per frame, call CalculateChanges and apply them with Texture::SetFirstResidentMip.
+*/
+class TextureStreamer
+{
+public:
+    using Change = TextureStreamingPolicy::Change;
+
+    // Discards requests collected so far, e.g. when the scene is unloaded.
+    void Clear() { m_Policy.Clear(); }
+    // mip: as returned by EstimateRequiredMip. priority: e.g. object size on screen in pixels.
+    void RequestMip(size_t textureIndex, float mip, float priority) { m_Policy.RequestMip(textureIndex, mip, priority); }
+    /*
+    Uses requests collected since the previous call, then discards them.
+    deviceUsage, deviceBudget: current GPU memory usage and budget, e.g. from D3D12MA::Allocator::GetBudget.
+    Returns changes to make, sorted so the ones freeing memory go first, limited to a few per frame.
+    */
+    void CalculateChanges(const std::vector<Scene::Texture>& textures, uint64_t deviceUsage, uint64_t deviceBudget,
+        std::pmr::vector<Change>& outChanges);
+
+    void ImGui();
+
+private:
+    TextureStreamingPolicy m_Policy;
+    // Indexed like textures passed to CalculateChanges.
+    std::vector<TextureStreamingPolicy::Texture> m_Textures;
+    uint64_t m_DeviceUsage = 0;
+    uint64_t m_DeviceBudget = 0;
+};
@@ -0,0 +1,180 @@
+// Doesn't use the precompiled header, so it can be compiled on other platforms.
+#include "TextureStreamingPolicy.hpp"
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <cassert>
+#include <cmath>
+
+float CalculateProjectionScale(float fovY, float viewportHeight)
+{
+    return viewportHeight / (2.f * std::tan(fovY * 0.5f));
+}
+
+float EstimateRequiredMip(float textureSize, float UVDensity, float distance, float projectionScale)
+{
+    assert(distance > 0.f && projectionScale > 0.f);
+    const float texelsPerWorldUnit = textureSize * UVDensity;
+    const float pixelsPerWorldUnit = projectionScale / distance;
+    if(texelsPerWorldUnit <= pixelsPerWorldUnit)
+        return 0.f;
+    return std::log2(texelsPerWorldUnit / pixelsPerWorldUnit);
+}
+
+static uint64_t CalculateResidentSize(std::span<const uint64_t> mipSizes, uint32_t firstMip)
+{
+    uint64_t size = 0;
+    for(size_t mip = firstMip; mip < mipSizes.size(); ++mip)
+        size += mipSizes[mip];
+    return size;
+}
+
+uint64_t CalculateStreamingTargets(std::span<StreamingTextureState> textures, uint64_t budget)
+{
+    // Candidates to drop one more level. Lowest priority on top.
+    using Candidate = std::pair<float, size_t>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+
+    uint64_t totalSize = 0;
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        StreamingTextureState& t = textures[i];
+        assert(t.m_FirstResidentMip <= t.m_MaxFirstMip && t.m_MaxFirstMip < t.m_MipSizes.size());
+        float priority;
+        if(t.m_RequestedMip == UINT32_MAX)
+        {
+            t.m_TargetFirstMip = t.m_FirstResidentMip;
+            priority = -1.f - (float)t.m_FramesSinceRequest;
+        }
+        else
+        {
+            t.m_TargetFirstMip = std::min(t.m_RequestedMip, t.m_MaxFirstMip);
+            // Don't drop a single level, so texture doesn't flip back and forth at the boundary.
+            if(t.m_TargetFirstMip == t.m_FirstResidentMip + 1)
+                t.m_TargetFirstMip = t.m_FirstResidentMip;
+            priority = t.m_Priority;
+        }
+        totalSize += CalculateResidentSize(t.m_MipSizes, t.m_TargetFirstMip);
+        if(t.m_TargetFirstMip < t.m_MaxFirstMip)
+            candidates.push({priority, i});
+    }
+
+    while(totalSize > budget && !candidates.empty())
+    {
+        const Candidate candidate = candidates.top();
+        candidates.pop();
+        StreamingTextureState& t = textures[candidate.second];
+        totalSize -= t.m_MipSizes[t.m_TargetFirstMip++];
+        if(t.m_TargetFirstMip < t.m_MaxFirstMip)
+            candidates.push(candidate);
+    }
+
+    return totalSize;
+}
+
+uint64_t CalculateStreamingBudget(uint64_t deviceUsage, uint64_t deviceBudget, uint64_t streamingResidentSize,
+    uint64_t previousBudget, uint64_t maxBudget, float targetUsage, float hysteresis)
+{
+    const uint64_t otherUsage = deviceUsage > streamingResidentSize ? deviceUsage - streamingResidentSize : 0;
+    auto getAvailable = [&](float usage) -> uint64_t
+    {
+        const uint64_t limit = (uint64_t)((double)deviceBudget * std::max(usage, 0.f));
+        return limit > otherUsage ? limit - otherUsage : 0;
+    };
+
+    uint64_t budget = previousBudget;
+    const uint64_t maxAvailable = getAvailable(targetUsage);
+    if(budget > maxAvailable)
+        budget = maxAvailable;
+    else
+        budget = std::max(budget, getAvailable(targetUsage - hysteresis));
+    return std::min(budget, maxBudget);
+}
+
+void TextureStreamingPolicy::Clear()
+{
+    m_Requests.clear();
+    m_LastRequestFrames.clear();
+}
+
+void TextureStreamingPolicy::RequestMip(size_t textureIndex, float mip, float priority)
+{
+    if(textureIndex >= m_Requests.size())
+        m_Requests.resize(textureIndex + 1);
+    Request& r = m_Requests[textureIndex];
+    r.m_Mip = std::min(r.m_Mip, mip);
+    r.m_Priority = std::max(r.m_Priority, priority);
+}
+
+void TextureStreamingPolicy::CalculateChanges(std::span<const Texture> textures, uint64_t deviceUsage,
+    uint64_t deviceBudget, const Params& params, std::pmr::vector<Change>& outChanges)
+{
+    outChanges.clear();
+    m_Requests.resize(textures.size());
+    m_LastRequestFrames.resize(textures.size(), m_FrameIndex);
+
+    m_States.clear();
+    m_StateTextureIndices.clear();
+    m_ResidentSize = 0;
+    m_FullSize = 0;
+    for(size_t i = 0; i < textures.size(); ++i)
+    {
+        const Texture& tex = textures[i];
+        if(tex.m_MipSizes.empty())
+            continue;
+        StreamingTextureState state = {
+            .m_MipSizes = tex.m_MipSizes,
+            .m_MaxFirstMip = tex.m_MaxFirstMip,
+            .m_FirstResidentMip = tex.m_FirstResidentMip };
+        const Request& r = m_Requests[i];
+        if(r.m_Mip != FLT_MAX)
+        {
+            state.m_RequestedMip = (uint32_t)r.m_Mip;
+            state.m_Priority = r.m_Priority;
+            m_LastRequestFrames[i] = m_FrameIndex;
+        }
+        else
+            state.m_FramesSinceRequest = (uint32_t)std::min<uint64_t>(m_FrameIndex - m_LastRequestFrames[i], UINT32_MAX);
+        m_ResidentSize += CalculateResidentSize(state.m_MipSizes, state.m_FirstResidentMip);
+        m_FullSize += CalculateResidentSize(state.m_MipSizes, 0);
+        m_States.push_back(state);
+        m_StateTextureIndices.push_back(i);
+    }
+    std::fill(m_Requests.begin(), m_Requests.end(), Request{});
+    ++m_FrameIndex;
+
+    if(params.m_AutoBudget && deviceBudget > 0)
+    {
+        m_Budget = CalculateStreamingBudget(deviceUsage, deviceBudget, m_ResidentSize, m_Budget, params.m_MaxBudget,
+            params.m_TargetUsage, params.m_Hysteresis);
+    }
+    else
+        m_Budget = params.m_MaxBudget;
+    m_TargetSize = CalculateStreamingTargets(m_States, m_Budget);
+
+    for(size_t i = 0; i < m_States.size(); ++i)
+    {
+        if(m_States[i].m_TargetFirstMip != m_States[i].m_FirstResidentMip)
+            outChanges.push_back({m_StateTextureIndices[i], m_States[i].m_TargetFirstMip});
+    }
+    // Stream out first to free memory, most levels first, then stream in the ones requesting most levels,
+    // so those are not the ones cut off by m_MaxChangesPerFrame.
+    std::sort(outChanges.begin(), outChanges.end(), [&](const Change& lhs, const Change& rhs)
+    {
+        const int32_t lhsDelta = (int32_t)lhs.m_FirstResidentMip - (int32_t)textures[lhs.m_TextureIndex].m_FirstResidentMip;
+        const int32_t rhsDelta = (int32_t)rhs.m_FirstResidentMip - (int32_t)textures[rhs.m_TextureIndex].m_FirstResidentMip;
+        if((lhsDelta > 0) != (rhsDelta > 0))
+            return lhsDelta > 0;
+        return lhsDelta > 0 ? lhsDelta > rhsDelta : lhsDelta < rhsDelta;
+    });
+    if(outChanges.size() > params.m_MaxChangesPerFrame)
+        outChanges.resize(params.m_MaxChangesPerFrame);
+
+    for(const Change& c : outChanges)
+    {
+        if(c.m_FirstResidentMip < textures[c.m_TextureIndex].m_FirstResidentMip)
+            ++m_StreamInCount;
+        else
+            ++m_StreamOutCount;
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+/*
+Policy of texture mip streaming: estimation of the required mip level from object distance and
+UV density, and the choice of resident levels that fits requested levels into a memory budget,
+which follows the GPU memory budget reported by the OS. TextureStreamer feeds it with textures loaded with
+Texture::FLAG_STREAMING and applies its decisions.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <span>
+#include <vector>
+#include <memory_resource>
+
+// Returns number of screen pixels covered by 1 world unit seen at distance 1 from the camera.
+float CalculateProjectionScale(float fovY, float viewportHeight);
+
+/*
+Returns the finest mip level needed, so that there is no more than 1 texel per screen pixel,
+as fractional number >= 0.
+
+textureSize: larger dimension of mip 0, in texels.
+UVDensity: texture coordinate units per world unit, as returned by ComputeUVDensity, divided by object scale.
+distance: distance from the camera to the nearest point of the object, in world units. Must be > 0.
+projectionScale: as returned by CalculateProjectionScale.
+*/
+float EstimateRequiredMip(float textureSize, float UVDensity, float distance, float projectionScale);
+
+struct StreamingTextureState
+{
+    // Byte size of each mip level of the full mip chain.
+    std::span<const uint64_t> m_MipSizes;
+    // Coarsest mip that can be the first resident one. Levels after it are always resident.
+    uint32_t m_MaxFirstMip = 0;
+    uint32_t m_FirstResidentMip = 0;
+    // UINT32_MAX if not requested recently, e.g. not visible.
+    uint32_t m_RequestedMip = UINT32_MAX;
+    // Higher is more important. Used to decide which textures lose levels first when over budget.
+    float m_Priority = 0.f;
+    // Used when not requested: textures not visible for longer lose levels first.
+    uint32_t m_FramesSinceRequest = 0;
+
+    // Output of CalculateStreamingTargets.
+    uint32_t m_TargetFirstMip = 0;
+};
+
+/*
+Sets m_TargetFirstMip of every texture so that the total size of resident levels fits in budget, if possible.
+Textures get their requested level first. If over budget, levels are dropped starting from textures
+with lowest priority. Textures not requested keep what they have, but they are the first to lose levels,
+least recently requested first.
+Returns total size of resident levels after reaching the targets.
+*/
+uint64_t CalculateStreamingTargets(std::span<StreamingTextureState> textures, uint64_t budget);
+
+/*
+Returns budget for streaming textures, so that total GPU memory usage stays under
+deviceBudget * targetUsage. Memory used by everything else is assumed to stay as it is:
+deviceUsage - streamingResidentSize. When over, the budget shrinks immediately. It grows only while
+usage would stay under deviceBudget * (targetUsage - hysteresis), so it doesn't oscillate.
+Result is not larger than maxBudget. Pass UINT64_MAX as previousBudget for the first call.
+*/
+uint64_t CalculateStreamingBudget(uint64_t deviceUsage, uint64_t deviceBudget, uint64_t streamingResidentSize,
+    uint64_t previousBudget, uint64_t maxBudget, float targetUsage, float hysteresis);
+
+/*
+Decides resident mip levels of streaming textures.
+During rendering, call RequestMip for every texture used by a draw call.
+Once per frame, call CalculateChanges with the current state of all textures and apply the changes.
+
+Not thread-safe.
+*/
+class TextureStreamingPolicy
+{
+public:
+    struct Texture
+    {
+        // Byte size of each level of the full mip chain. Empty if the texture is not streaming.
+        std::span<const uint64_t> m_MipSizes;
+        uint32_t m_MaxFirstMip = 0;
+        uint32_t m_FirstResidentMip = 0;
+    };
+    struct Change
+    {
+        size_t m_TextureIndex;
+        uint32_t m_FirstResidentMip;
+    };
+    struct Params
+    {
+        // Upper limit of the budget, in bytes.
+        uint64_t m_MaxBudget = UINT64_MAX;
+        // Lower the budget while GPU memory usage exceeds m_TargetUsage of the device budget, see CalculateStreamingBudget.
+        bool m_AutoBudget = true;
+        float m_TargetUsage = 0.9f;
+        float m_Hysteresis = 0.05f;
+        uint32_t m_MaxChangesPerFrame = 4;
+    };
+
+    // Discards requests collected so far, e.g. when the scene is unloaded.
+    void Clear();
+    // mip: as returned by EstimateRequiredMip. priority: e.g. object size on screen in pixels.
+    void RequestMip(size_t textureIndex, float mip, float priority);
+    /*
+    Uses requests collected since the previous call, then discards them. textures are indexed like in RequestMip.
+    deviceUsage, deviceBudget: current GPU memory usage and budget, e.g. from D3D12MA::Allocator::GetBudget.
+    Returns changes to make, sorted so the ones freeing memory go first, limited to params.m_MaxChangesPerFrame.
+    */
+    void CalculateChanges(std::span<const Texture> textures, uint64_t deviceUsage, uint64_t deviceBudget,
+        const Params& params, std::pmr::vector<Change>& outChanges);
+
+    uint32_t GetStreamingTextureCount() const { return (uint32_t)m_States.size(); }
+    // Total size of levels resident before the last CalculateChanges.
+    uint64_t GetResidentSize() const { return m_ResidentSize; }
+    // Total size of levels resident after all changes from the last CalculateChanges are made.
+    uint64_t GetTargetSize() const { return m_TargetSize; }
+    // Total size of all levels of streaming textures.
+    uint64_t GetFullSize() const { return m_FullSize; }
+    uint64_t GetBudget() const { return m_Budget; }
+    uint64_t GetStreamInCount() const { return m_StreamInCount; }
+    uint64_t GetStreamOutCount() const { return m_StreamOutCount; }
+
+private:
+    struct Request
+    {
+        float m_Mip = FLT_MAX;
+        float m_Priority = 0.f;
+    };
+    std::vector<Request> m_Requests;
+    // Indexed like m_Requests.
+    std::vector<uint64_t> m_LastRequestFrames;
+    uint64_t m_FrameIndex = 0;
+    std::vector<StreamingTextureState> m_States;
+    std::vector<size_t> m_StateTextureIndices;
+
+    uint64_t m_ResidentSize = 0;
+    uint64_t m_TargetSize = 0;
+    uint64_t m_FullSize = 0;
+    uint64_t m_Budget = UINT64_MAX;
+    uint64_t m_StreamInCount = 0;
+    uint64_t m_StreamOutCount = 0;
+};
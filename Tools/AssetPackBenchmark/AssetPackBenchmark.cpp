@@ -0,0 +1,655 @@
+/*
+Test and benchmark of the asset pack file format (Source/AssetPackFormat.hpp), in which AssetPack
+stores cooked textures and shaders.
+
+PackWriter and PackReader below use the file the way AssetPack does on its thread, with stdio instead of
+FileStream and MappedFile: entries are appended at aligned offsets, Flush merges them into a new index
+written after them, and opening parses the footer at the end of the file.
+
+First checks adding, finding and replacing entries, recovery after a crash in the middle of appending,
+rejection of corrupted files, eviction of least recently used entries over budget, also on every flush, and
+two instances of the program flushing the same file. Then measures, for Count entries of EntrySize KB:
+writing and flushing the pack, opening it, looking up entries and reading all of them.
+Exit code is 1 if any check fails.
+
+Usage:
+    AssetPackBenchmark [-n Count] [-s EntrySizeKB] [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o AssetPackBenchmark \
+        Tools/AssetPackBenchmark/AssetPackBenchmark.cpp Source/AssetPackFormat.cpp
+*/
+
+#include "../../Source/AssetPackFormat.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static const uint32_t TYPE_TEXTURE = 1;
+static const uint32_t TYPE_SHADER_BYTECODE = 3;
+
+static std::vector<char> MakeData(uint64_t seed, size_t size)
+{
+    std::vector<char> data(size);
+    std::mt19937_64 rand(seed);
+    for(char& c : data)
+        c = (char)rand();
+    return data;
+}
+
+// Like opening in AssetPack, with the file read to memory instead of mapped.
+struct PackReader
+{
+    std::vector<char> m_Data;
+    std::span<const AssetPackEntry> m_Index;
+    uint64_t m_DeadSize = 0;
+
+    // Returns false if the file is invalid.
+    bool Open(const std::filesystem::path& path)
+    {
+        m_Index = {};
+        m_Data.resize((size_t)std::filesystem::file_size(path));
+        FILE* const file = fopen(path.string().c_str(), "rb");
+        if(!file)
+            return false;
+        const bool read = fread(m_Data.data(), 1, m_Data.size(), file) == m_Data.size();
+        fclose(file);
+        return read && ValidateAssetPackHeader(m_Data) && ParseAssetPackFooter(m_Data, m_Index, m_DeadSize);
+    }
+
+    std::span<const char> Find(uint32_t type, uint64_t hash) const
+    {
+        const AssetPackEntry* const entry = FindAssetPackEntry(m_Index, type, hash);
+        if(!entry)
+            return {};
+        return std::span<const char>(m_Data.data() + entry->m_Offset, (size_t)entry->m_Size);
+    }
+};
+
+// Like the writing part of AssetPack, with stdio instead of FileStream.
+class PackWriter
+{
+public:
+    // Creates new file with an empty index, like AssetPack::CreateEmpty.
+    static void CreateEmpty(const std::filesystem::path& path)
+    {
+        std::vector<char> bytes;
+        BuildAssetPackHeader(bytes);
+        uint64_t position = bytes.size();
+        BuildAssetPackIndex(position, {}, 0, bytes);
+        FILE* const file = fopen(path.string().c_str(), "wb");
+        TEST(file && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        if(file)
+            fclose(file);
+    }
+
+    /*
+    knownIndex: index of the file as this instance opened it, with access times to keep. Must stay valid until Flush.
+    Like AssetPack::OpenWriter, flush merges into the index at the end of the file now, which includes entries
+    flushed by other instances since then. What follows the last valid footer becomes dead space.
+    */
+    PackWriter(const std::filesystem::path& path, std::span<const AssetPackEntry> knownIndex) :
+        m_KnownIndex(knownIndex)
+    {
+        m_File = fopen(path.string().c_str(), "ab");
+        TEST(m_File != nullptr);
+        if(m_File)
+        {
+            fseek(m_File, 0, SEEK_END);
+            m_Position = (uint64_t)ftell(m_File);
+        }
+        if(!m_Current.Open(path))
+        {
+            const uint64_t validSize = FindLastValidAssetPackEnd(m_Current.m_Data);
+            TEST(validSize > 0);
+            uint64_t deadSize = 0;
+            TEST(ParseAssetPackFooter(std::span<const char>(m_Current.m_Data).first((size_t)validSize),
+                m_Current.m_Index, deadSize));
+        }
+    }
+    ~PackWriter()
+    {
+        if(m_File)
+            fclose(m_File);
+    }
+
+    void Add(uint32_t type, uint64_t hash, int64_t accessTime, const std::vector<char>& data)
+    {
+        const std::vector<char> zeros(ASSET_PACK_ALIGNMENT);
+        const uint64_t offset = AlignAssetPackOffset(m_Position);
+        fwrite(zeros.data(), 1, (size_t)(offset - m_Position), m_File);
+        fwrite(data.data(), 1, data.size(), m_File);
+        m_Position = offset + data.size();
+        m_PendingEntries.push_back({
+            .m_Type = type,
+            .m_Reserved = 0,
+            .m_Hash = hash,
+            .m_Offset = offset,
+            .m_Size = data.size(),
+            .m_SourceTime = 1,
+            .m_LastAccessTime = accessTime });
+    }
+    // Writes only part of the data, like a process killed while appending.
+    void AddTruncated(size_t size)
+    {
+        const std::vector<char> garbage = MakeData(size, size);
+        fwrite(garbage.data(), 1, garbage.size(), m_File);
+        m_Position += size;
+    }
+    // Returns number of evicted entries.
+    uint32_t Flush(uint64_t budget = UINT64_MAX)
+    {
+        std::vector<AssetPackEntry> currentEntries(m_Current.m_Index.begin(), m_Current.m_Index.end());
+        MergeAssetPackAccessTimes(m_KnownIndex, currentEntries);
+        std::vector<AssetPackEntry> entries;
+        MergeAssetPackEntries(m_PendingEntries, currentEntries, entries);
+        uint64_t evictedSize = 0;
+        const uint32_t evictCount = EvictAssetPackEntries(entries, budget, evictedSize);
+        uint64_t liveSize = 0;
+        for(const AssetPackEntry& entry : entries)
+            liveSize += entry.m_Size;
+        std::vector<char> bytes;
+        BuildAssetPackIndex(m_Position, entries, m_Position - ASSET_PACK_HEADER_SIZE - liveSize, bytes);
+        TEST(fwrite(bytes.data(), 1, bytes.size(), m_File) == bytes.size());
+        fflush(m_File);
+        m_PendingEntries.clear();
+        return evictCount;
+    }
+
+private:
+    FILE* m_File = nullptr;
+    uint64_t m_Position = 0;
+    std::span<const AssetPackEntry> m_KnownIndex;
+    PackReader m_Current;
+    std::vector<AssetPackEntry> m_PendingEntries;
+};
+
+static bool Equal(std::span<const char> lhs, const std::vector<char>& rhs)
+{
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+static std::filesystem::path GetTestPath(const char* name)
+{
+    return std::filesystem::temp_directory_path() / name;
+}
+
+static void TestEmpty()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    PackReader reader;
+    TEST(reader.Open(path));
+    TEST(reader.m_Index.empty() && reader.m_DeadSize == 0);
+    TEST(reader.m_Data.size() % ASSET_PACK_ALIGNMENT == 0);
+    TEST(reader.Find(TYPE_TEXTURE, 0).empty());
+    std::filesystem::remove(path);
+}
+
+static void TestAddFindReplace()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    const uint32_t entryCount = 100;
+    {
+        PackReader reader;
+        TEST(reader.Open(path));
+        PackWriter writer(path, reader.m_Index);
+        for(uint32_t i = 0; i < entryCount; ++i)
+        {
+            // Same hash under both types, sizes not aligned, some empty.
+            writer.Add(TYPE_TEXTURE, i * 7919, 0, MakeData(i, i * 37 % 1500));
+            writer.Add(TYPE_SHADER_BYTECODE, i * 7919, 0, MakeData(i + 1000, i * 11 % 700));
+        }
+        writer.Flush();
+    }
+
+    PackReader reader;
+    TEST(reader.Open(path));
+    TEST(reader.m_Index.size() == entryCount * 2);
+    for(uint32_t i = 0; i < entryCount; ++i)
+    {
+        TEST(Equal(reader.Find(TYPE_TEXTURE, i * 7919), MakeData(i, i * 37 % 1500)));
+        TEST(Equal(reader.Find(TYPE_SHADER_BYTECODE, i * 7919), MakeData(i + 1000, i * 11 % 700)));
+        TEST(reader.Find(TYPE_TEXTURE, i * 7919 + 1).empty());
+    }
+    for(const AssetPackEntry& entry : reader.m_Index)
+        TEST(entry.m_Offset % ASSET_PACK_ALIGNMENT == 0);
+    const uint64_t deadSizeBefore = reader.m_DeadSize;
+
+    // Replace some entries, twice in one flush - the last one wins.
+    {
+        PackWriter writer(path, reader.m_Index);
+        writer.Add(TYPE_TEXTURE, 0, 0, MakeData(1, 100));
+        writer.Add(TYPE_TEXTURE, 7919, 0, MakeData(2, 200));
+        writer.Add(TYPE_TEXTURE, 0, 0, MakeData(3, 300));
+        writer.Flush();
+    }
+    PackReader reader2;
+    TEST(reader2.Open(path));
+    TEST(reader2.m_Index.size() == entryCount * 2);
+    TEST(Equal(reader2.Find(TYPE_TEXTURE, 0), MakeData(3, 300)));
+    TEST(Equal(reader2.Find(TYPE_TEXTURE, 7919), MakeData(2, 200)));
+    TEST(Equal(reader2.Find(TYPE_SHADER_BYTECODE, 0), MakeData(1000, 0)));
+    // Replaced entries, the one replaced in the same flush and the previous index are dead.
+    TEST(reader2.m_DeadSize >= deadSizeBefore + 37 + 100 + entryCount * 2 * sizeof(AssetPackEntry));
+
+    uint64_t liveSize = 0;
+    for(const AssetPackEntry& entry : reader2.m_Index)
+        liveSize += entry.m_Size;
+    TEST(ASSET_PACK_HEADER_SIZE + liveSize + reader2.m_DeadSize <= reader2.m_Data.size());
+    std::filesystem::remove(path);
+}
+
+static void TestRecovery()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    uint64_t firstFlushSize = 0;
+    {
+        PackReader reader;
+        TEST(reader.Open(path));
+        PackWriter writer(path, reader.m_Index);
+        writer.Add(TYPE_TEXTURE, 1, 0, MakeData(1, 1000));
+        writer.Flush();
+        firstFlushSize = std::filesystem::file_size(path);
+    }
+    // Process killed while writing an entry, then while writing the index.
+    const size_t truncatedSizes[] = {1, 100, ASSET_PACK_ALIGNMENT, ASSET_PACK_ALIGNMENT * 3};
+    for(size_t truncatedSize : truncatedSizes)
+    {
+        {
+            PackWriter writer(path, {});
+            writer.AddTruncated(truncatedSize);
+        }
+        PackReader reader;
+        TEST(!reader.Open(path));
+        TEST(FindLastValidAssetPackEnd(reader.m_Data) == firstFlushSize);
+        std::filesystem::resize_file(path, firstFlushSize);
+        TEST(reader.Open(path));
+        TEST(Equal(reader.Find(TYPE_TEXTURE, 1), MakeData(1, 1000)));
+    }
+
+    // Second flush cut in the middle of its index: the first index is still valid, as the file is append-only.
+    {
+        PackReader reader;
+        TEST(reader.Open(path));
+        PackWriter writer(path, reader.m_Index);
+        for(uint64_t hash = 2; hash < 100; ++hash)
+            writer.Add(TYPE_TEXTURE, hash, 0, MakeData(hash, 10));
+        writer.Flush();
+    }
+    const uint64_t secondFlushSize = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, secondFlushSize - ASSET_PACK_ALIGNMENT);
+    PackReader reader;
+    TEST(!reader.Open(path));
+    const uint64_t validSize = FindLastValidAssetPackEnd(reader.m_Data);
+    TEST(validSize == firstFlushSize);
+    std::filesystem::resize_file(path, validSize);
+    TEST(reader.Open(path));
+    TEST(reader.m_Index.size() == 1);
+    std::filesystem::remove(path);
+}
+
+static void TestCorruption()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    {
+        PackReader reader;
+        TEST(reader.Open(path));
+        PackWriter writer(path, reader.m_Index);
+        for(uint64_t hash = 0; hash < 4; ++hash)
+            writer.Add(TYPE_TEXTURE, hash, 0, MakeData(hash, 600));
+        writer.Flush();
+    }
+    PackReader reader;
+    TEST(reader.Open(path));
+    const std::vector<char> valid = reader.m_Data;
+    const size_t indexOffset = (size_t)((const char*)reader.m_Index.data() - reader.m_Data.data());
+
+    // Copy aligned like a mapped file, so the index can be used in place.
+    std::vector<AssetPackEntry> storage(valid.size() / sizeof(AssetPackEntry) + 1);
+    char* const data = (char*)storage.data();
+    auto isValid = [&]()
+    {
+        std::span<const AssetPackEntry> index;
+        uint64_t deadSize = 0;
+        const std::span<const char> span(data, valid.size());
+        return ValidateAssetPackHeader(span) && ParseAssetPackFooter(span, index, deadSize);
+    };
+    memcpy(data, valid.data(), valid.size());
+    TEST(isValid());
+
+    // Version.
+    data[16] ^= 1;
+    TEST(!isValid());
+    memcpy(data, valid.data(), valid.size());
+    // Footer magic.
+    data[valid.size() - 1] ^= 1;
+    TEST(!isValid());
+    memcpy(data, valid.data(), valid.size());
+    // Entry reaching into the index.
+    AssetPackEntry* const entries = (AssetPackEntry*)(data + indexOffset);
+    entries[3].m_Size = indexOffset;
+    TEST(!isValid());
+    memcpy(data, valid.data(), valid.size());
+    // Index not sorted.
+    std::swap(entries[1], entries[2]);
+    TEST(!isValid());
+    memcpy(data, valid.data(), valid.size());
+    // Index offset beyond the footer.
+    const uint64_t badIndexOffset = valid.size();
+    memcpy(data + valid.size() - 32, &badIndexOffset, sizeof(badIndexOffset));
+    TEST(!isValid());
+    std::filesystem::remove(path);
+}
+
+static void TestMerge()
+{
+    auto entry = [](uint32_t type, uint64_t hash, uint64_t offset) -> AssetPackEntry
+    {
+        AssetPackEntry result = {};
+        result.m_Type = type;
+        result.m_Hash = hash;
+        result.m_Offset = offset;
+        return result;
+    };
+    const AssetPackEntry current[] = {entry(1, 10, 512), entry(1, 20, 1024), entry(3, 10, 1536)};
+    const AssetPackEntry added[] = {entry(3, 5, 2048), entry(1, 20, 2560), entry(3, 5, 3072), entry(2, 0, 3584)};
+    std::vector<AssetPackEntry> merged;
+    MergeAssetPackEntries(added, current, merged);
+    TEST(merged.size() == 5);
+    TEST(std::is_sorted(merged.begin(), merged.end(), AssetPackEntryLess));
+    const AssetPackEntry* const replaced = FindAssetPackEntry(merged, 1, 20);
+    TEST(replaced && replaced->m_Offset == 2560);
+    const AssetPackEntry* const addedTwice = FindAssetPackEntry(merged, 3, 5);
+    TEST(addedTwice && addedTwice->m_Offset == 3072);
+    TEST(FindAssetPackEntry(merged, 1, 10) && FindAssetPackEntry(merged, 3, 10) && FindAssetPackEntry(merged, 2, 0));
+}
+
+static void TestEviction()
+{
+    // Access times are shuffled against the order of hashes.
+    std::vector<AssetPackEntry> entries;
+    for(uint64_t i = 0; i < 10; ++i)
+    {
+        entries.push_back({.m_Type = 1, .m_Reserved = 0, .m_Hash = i, .m_Offset = 512 * (i + 1), .m_Size = 100,
+            .m_SourceTime = 0, .m_LastAccessTime = (int64_t)(i * 7 % 10)});
+    }
+    uint64_t evictedSize = 0;
+
+    // Within budget: nothing changes.
+    std::vector<AssetPackEntry> result = entries;
+    TEST(EvictAssetPackEntries(result, 1000, evictedSize) == 0);
+    TEST(result.size() == 10 && evictedSize == 0);
+
+    // Over budget: least recently used go first, the rest stay sorted.
+    result = entries;
+    TEST(EvictAssetPackEntries(result, 650, evictedSize) == 4);
+    TEST(evictedSize == 400);
+    TEST(result.size() == 6);
+    TEST(std::is_sorted(result.begin(), result.end(), AssetPackEntryLess));
+    for(const AssetPackEntry& entry : result)
+        TEST(entry.m_LastAccessTime >= 4);
+
+    // Statistics accumulate.
+    TEST(EvictAssetPackEntries(result, 300, evictedSize) == 3);
+    TEST(evictedSize == 700 && result.size() == 3);
+    for(const AssetPackEntry& entry : result)
+        TEST(entry.m_LastAccessTime >= 7);
+
+    // Budget 0 removes all except empty entries used after them.
+    result = entries;
+    result[0].m_Size = 0;
+    result[0].m_LastAccessTime = 100;
+    evictedSize = 0;
+    TEST(EvictAssetPackEntries(result, 0, evictedSize) == 9);
+    TEST(evictedSize == 900);
+    TEST(result.size() == 1 && result[0].m_Size == 0);
+
+    // Entry larger than the whole budget goes too, even if used most recently.
+    result = entries;
+    result[5].m_Size = 5000;
+    result[5].m_LastAccessTime = 100;
+    evictedSize = 0;
+    TEST(EvictAssetPackEntries(result, 1000, evictedSize) == 10);
+    TEST(result.empty() && evictedSize == 5900);
+}
+
+// Budget holds across many flushes in one session, not only when the pack is opened.
+static void TestEvictionOnFlush()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    const size_t entrySize = 1000;
+    const uint64_t budget = entrySize * 20;
+    PackReader reader;
+    TEST(reader.Open(path));
+    uint32_t evictCount = 0;
+    for(uint64_t flush = 0; flush < 10; ++flush)
+    {
+        {
+            PackWriter writer(path, reader.m_Index);
+            for(uint64_t i = 0; i < 8; ++i)
+            {
+                const uint64_t hash = flush * 8 + i;
+                writer.Add(TYPE_TEXTURE, hash, (int64_t)hash, MakeData(hash, entrySize));
+            }
+            evictCount += writer.Flush(budget);
+        }
+        TEST(reader.Open(path));
+        uint64_t liveSize = 0;
+        for(const AssetPackEntry& entry : reader.m_Index)
+            liveSize += entry.m_Size;
+        TEST(liveSize <= budget);
+    }
+    TEST(evictCount == 80 - 20);
+    TEST(reader.m_Index.size() == 20);
+    // The most recently used survive.
+    for(uint64_t hash = 60; hash < 80; ++hash)
+        TEST(Equal(reader.Find(TYPE_TEXTURE, hash), MakeData(hash, entrySize)));
+    TEST(reader.Find(TYPE_TEXTURE, 59).empty());
+    // Evicted data stays in the file as dead space.
+    TEST(reader.m_DeadSize >= 60 * entrySize);
+    std::filesystem::remove(path);
+}
+
+// Two instances of the program using one file, each flushing an index merged from the file as it opened it.
+static void TestTwoInstances()
+{
+    const std::filesystem::path path = GetTestPath("AssetPackTest.pack");
+    PackWriter::CreateEmpty(path);
+    {
+        PackReader reader;
+        TEST(reader.Open(path));
+        PackWriter writer(path, reader.m_Index);
+        writer.Add(TYPE_TEXTURE, 1, 5, MakeData(1, 1000));
+        writer.Add(TYPE_TEXTURE, 2, 5, MakeData(2, 1000));
+        writer.Flush();
+    }
+
+    // Both open the file, the second one uses entry 2.
+    PackReader reader1, reader2;
+    TEST(reader1.Open(path) && reader2.Open(path));
+    std::vector<AssetPackEntry> known2(reader2.m_Index.begin(), reader2.m_Index.end());
+    known2[1].m_LastAccessTime = 50;
+
+    // The first one adds entry 3 and flushes, then the second one, which doesn't know about it,
+    // replaces entry 1 and adds entry 4.
+    {
+        PackWriter writer(path, reader1.m_Index);
+        writer.Add(TYPE_TEXTURE, 3, 10, MakeData(3, 1000));
+        writer.Flush();
+    }
+    {
+        PackWriter writer(path, known2);
+        writer.Add(TYPE_TEXTURE, 1, 20, MakeData(10, 700));
+        writer.Add(TYPE_TEXTURE, 4, 20, MakeData(4, 1000));
+        writer.Flush();
+    }
+    PackReader reader;
+    TEST(reader.Open(path));
+    TEST(reader.m_Index.size() == 4);
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 1), MakeData(10, 700)));
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 2), MakeData(2, 1000)));
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 3), MakeData(3, 1000)));
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 4), MakeData(4, 1000)));
+    const AssetPackEntry* const used = FindAssetPackEntry(reader.m_Index, TYPE_TEXTURE, 2);
+    TEST(used && used->m_LastAccessTime == 50);
+
+    // Dead space is everything before the index not used by live entries: the replaced entry 1,
+    // old indices and padding, not the entry added by the other instance. Padding before the index is not counted.
+    const uint64_t indexOffset = (uint64_t)((const char*)reader.m_Index.data() - reader.m_Data.data());
+    uint64_t liveSize = 0;
+    for(const AssetPackEntry& entry : reader.m_Index)
+        liveSize += entry.m_Size;
+    const uint64_t unusedSize = indexOffset - ASSET_PACK_HEADER_SIZE - liveSize;
+    TEST(reader.m_DeadSize <= unusedSize && reader.m_DeadSize + ASSET_PACK_ALIGNMENT > unusedSize);
+    TEST(reader.m_DeadSize >= 1000 + 3 * sizeof(AssetPackEntry) && reader.m_DeadSize < 1000 + 6 * ASSET_PACK_ALIGNMENT);
+
+    // The first one is killed while appending, the second one flushes after it.
+    {
+        PackWriter writer(path, reader1.m_Index);
+        writer.Add(TYPE_TEXTURE, 5, 30, MakeData(5, 1000));
+        writer.AddTruncated(100);
+    }
+    {
+        PackWriter writer(path, reader.m_Index);
+        writer.Add(TYPE_TEXTURE, 6, 30, MakeData(6, 1000));
+        writer.Flush();
+    }
+    TEST(reader.Open(path));
+    TEST(reader.m_Index.size() == 5);
+    TEST(reader.Find(TYPE_TEXTURE, 5).empty());
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 6), MakeData(6, 1000)));
+    TEST(Equal(reader.Find(TYPE_TEXTURE, 3), MakeData(3, 1000)));
+    std::filesystem::remove(path);
+}
+
+static double SecondsSince(Clock::time_point beginTime)
+{
+    return std::chrono::duration<double>(Clock::now() - beginTime).count();
+}
+
+static void Benchmark(uint32_t count, uint32_t entrySizeKB, uint32_t iterations)
+{
+    const std::filesystem::path path = GetTestPath("AssetPackBenchmark.pack");
+    const size_t entrySize = (size_t)entrySizeKB * 1024;
+    const double totalMB = (double)count * entrySize / (1024.0 * 1024.0);
+    std::vector<uint64_t> hashes(count);
+    std::mt19937_64 rand(42);
+    for(uint64_t& hash : hashes)
+        hash = rand();
+    const std::vector<char> data = MakeData(0, entrySize);
+
+    PackWriter::CreateEmpty(path);
+    Clock::time_point beginTime = Clock::now();
+    {
+        PackWriter writer(path, {});
+        for(uint32_t i = 0; i < count; ++i)
+            writer.Add(TYPE_TEXTURE, hashes[i], i, data);
+        writer.Flush();
+    }
+    const double writeSeconds = SecondsSince(beginTime);
+
+    PackReader reader;
+    beginTime = Clock::now();
+    for(uint32_t i = 0; i < iterations; ++i)
+        TEST(reader.Open(path));
+    const double openSeconds = SecondsSince(beginTime) / iterations;
+    TEST(reader.m_Index.size() == count);
+
+    // Hits and misses alternate.
+    const uint32_t lookupCount = std::max(count, 1000000u);
+    uint64_t foundSize = 0;
+    beginTime = Clock::now();
+    for(uint32_t i = 0; i < lookupCount; ++i)
+    {
+        const uint64_t hash = hashes[i % count] + (i & 1);
+        foundSize += reader.Find(TYPE_TEXTURE, hash).size();
+    }
+    const double lookupSeconds = SecondsSince(beginTime);
+    TEST(foundSize >= (uint64_t)lookupCount / 2 * entrySize);
+
+    uint64_t checksum = 0;
+    beginTime = Clock::now();
+    for(uint32_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        for(const AssetPackEntry& entry : reader.m_Index)
+        {
+            const uint64_t* const words = (const uint64_t*)(reader.m_Data.data() + entry.m_Offset);
+            for(size_t i = 0; i < entry.m_Size / sizeof(uint64_t); ++i)
+                checksum += words[i];
+        }
+    }
+    const double readSeconds = SecondsSince(beginTime) / iterations;
+
+    // Replacing a tenth of the entries: append and flush with merge of the index.
+    beginTime = Clock::now();
+    {
+        PackWriter writer(path, reader.m_Index);
+        for(uint32_t i = 0; i < count; i += 10)
+            writer.Add(TYPE_TEXTURE, hashes[i], i, data);
+        writer.Flush();
+    }
+    const double replaceSeconds = SecondsSince(beginTime);
+    PackReader reader2;
+    TEST(reader2.Open(path));
+    TEST(reader2.m_Index.size() == count);
+    std::filesystem::remove(path);
+
+    printf("Pack: %u entries of %u KB, %.1f MB\n", count, entrySizeKB, totalMB);
+    printf("Write and flush:   %10.1f ms %10.0f MB/s\n", writeSeconds * 1e3, totalMB / writeSeconds);
+    printf("Open:              %10.1f ms %10.0f MB/s\n", openSeconds * 1e3, totalMB / openSeconds);
+    printf("Lookup:            %10.1f ns\n", lookupSeconds / lookupCount * 1e9);
+    printf("Read all entries:  %10.1f ms %10.0f MB/s (checksum %llx)\n", readSeconds * 1e3, totalMB / readSeconds,
+        (unsigned long long)checksum);
+    printf("Replace 10%%:       %10.1f ms\n", replaceSeconds * 1e3);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count = 4096;
+    uint32_t entrySizeKB = 64;
+    uint32_t iterations = 4;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            count = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            entrySizeKB = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: AssetPackBenchmark [-n Count] [-s EntrySizeKB] [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(count == 0 || entrySizeKB == 0 || iterations == 0)
+    {
+        fprintf(stderr, "Count, entry size and iterations must be at least 1.\n");
+        return 2;
+    }
+
+    TestEmpty();
+    TestAddFindReplace();
+    TestRecovery();
+    TestCorruption();
+    TestMerge();
+    TestEviction();
+    TestEvictionOnFlush();
+    TestTwoInstances();
+    Benchmark(count, entrySizeKB, iterations);
+
+    return ReportTestResults();
+}
@@ -0,0 +1,205 @@
+/*
+Randomized model test of BindlessMaterialTable (Source/BindlessMaterialTable.hpp), which Renderer uses
+to write only changed material records to the per-frame copies of the bindless material buffer.
+
+The table is compared with a simple model: contents of every record and, per copy, which records
+changed since the copy was last updated. Random sequences of SetRecord with few distinct values,
+so many calls don't change anything, and TakeDirtyRanges on copies in frame order as well as in random
+order, are checked after every call:
+- SetRecord returns whether the contents changed, GetRecord returns what was set,
+- TakeDirtyRanges returns exactly the records dirty in that copy, in ranges that are not empty,
+  ascending and merged, and their total count, then nothing until the next change,
+- a simulated GPU copy updated only from the returned ranges matches the table,
+- GetDirtyRecordCount equals the number of records dirty in any copy.
+Copy counts include 1 and MAX_COPY_COUNT, where the mask of all copies is full.
+
+Usage:
+    BindlessMaterialTableTest [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o BindlessMaterialTableTest \
+        Tools/BindlessMaterialTableTest/BindlessMaterialTableTest.cpp Source/BindlessMaterialTable.cpp
+*/
+
+#include "../../Source/BindlessMaterialTable.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Range = BindlessMaterialTable::Range;
+
+class Model
+{
+public:
+    Model(uint32_t recordSize, uint32_t recordCount, uint32_t copyCount) :
+        m_RecordSize(recordSize),
+        m_RecordCount(recordCount),
+        m_Data((size_t)recordSize * recordCount, 0),
+        // Like the uninitialized GPU buffer: differs from the zeroed records.
+        m_GPUCopies(copyCount, std::vector<char>((size_t)recordSize * recordCount, 0x55)),
+        m_Dirty(copyCount, std::vector<bool>(recordCount, true))
+    {
+        m_Table.Init(recordSize, recordCount, copyCount);
+    }
+
+    void SetRecord(uint32_t recordIndex, const char* data)
+    {
+        char* const record = m_Data.data() + (size_t)recordIndex * m_RecordSize;
+        const bool changed = memcmp(record, data, m_RecordSize) != 0;
+        TEST(m_Table.SetRecord(recordIndex, data) == changed);
+        if(changed)
+        {
+            memcpy(record, data, m_RecordSize);
+            for(std::vector<bool>& dirty : m_Dirty)
+                dirty[recordIndex] = true;
+        }
+        TEST(memcmp(m_Table.GetRecord(recordIndex), record, m_RecordSize) == 0);
+        CheckDirtyRecordCount();
+    }
+
+    void TakeDirtyRanges(uint32_t copyIndex)
+    {
+        const uint32_t takenCount = m_Table.TakeDirtyRanges(copyIndex, m_Ranges);
+        std::vector<bool>& dirty = m_Dirty[copyIndex];
+        std::vector<char>& gpuCopy = m_GPUCopies[copyIndex];
+        uint32_t rangeSum = 0;
+        uint32_t nextIndex = 0;
+        for(size_t i = 0; i < m_Ranges.size(); ++i)
+        {
+            const Range& range = m_Ranges[i];
+            TEST(range.m_RecordCount > 0);
+            // Ascending and merged: a gap between neighbors.
+            TEST(i == 0 || range.m_FirstRecord > nextIndex);
+            TEST(range.m_FirstRecord + range.m_RecordCount <= m_RecordCount);
+            if(range.m_FirstRecord + range.m_RecordCount > m_RecordCount)
+                return;
+            for(uint32_t recordIndex = nextIndex; recordIndex < range.m_FirstRecord; ++recordIndex)
+                TEST(!dirty[recordIndex]);
+            for(uint32_t recordIndex = range.m_FirstRecord; recordIndex < range.m_FirstRecord + range.m_RecordCount; ++recordIndex)
+            {
+                TEST(dirty[recordIndex]);
+                dirty[recordIndex] = false;
+            }
+            // Like Renderer::UpdateMaterialRecords.
+            memcpy(gpuCopy.data() + (size_t)range.m_FirstRecord * m_RecordSize,
+                m_Table.GetRecord(range.m_FirstRecord), (size_t)range.m_RecordCount * m_RecordSize);
+            rangeSum += range.m_RecordCount;
+            nextIndex = range.m_FirstRecord + range.m_RecordCount;
+        }
+        for(uint32_t recordIndex = nextIndex; recordIndex < m_RecordCount; ++recordIndex)
+            TEST(!dirty[recordIndex]);
+        TEST(takenCount == rangeSum);
+        TEST(gpuCopy == m_Data);
+        CheckDirtyRecordCount();
+
+        // Nothing more until the next change.
+        TEST(m_Table.TakeDirtyRanges(copyIndex, m_Ranges) == 0 && m_Ranges.empty());
+    }
+
+private:
+    const uint32_t m_RecordSize;
+    const uint32_t m_RecordCount;
+    BindlessMaterialTable m_Table;
+    std::vector<char> m_Data;
+    std::vector<std::vector<char>> m_GPUCopies;
+    // Indexed by copy, then record.
+    std::vector<std::vector<bool>> m_Dirty;
+    std::vector<Range> m_Ranges;
+
+    void CheckDirtyRecordCount()
+    {
+        uint32_t dirtyCount = 0;
+        for(uint32_t recordIndex = 0; recordIndex < m_RecordCount; ++recordIndex)
+        {
+            bool dirty = false;
+            for(const std::vector<bool>& copyDirty : m_Dirty)
+                dirty = dirty || copyDirty[recordIndex];
+            dirtyCount += dirty ? 1 : 0;
+        }
+        TEST(m_Table.GetDirtyRecordCount() == dirtyCount);
+    }
+};
+
+static void TestInit()
+{
+    BindlessMaterialTable table;
+    std::vector<Range> ranges;
+    table.Init(16, 10, 3);
+    TEST(table.GetRecordSize() == 16 && table.GetRecordCount() == 10 && table.GetDirtyRecordCount() == 10);
+    const char zeros[16] = {};
+    TEST(memcmp(table.GetRecord(9), zeros, sizeof(zeros)) == 0);
+    // Setting the initial contents changes nothing, but records are dirty in every copy.
+    TEST(!table.SetRecord(0, zeros));
+    for(uint32_t copyIndex = 0; copyIndex < 3; ++copyIndex)
+    {
+        TEST(table.TakeDirtyRanges(copyIndex, ranges) == 10);
+        TEST(ranges.size() == 1 && ranges[0].m_FirstRecord == 0 && ranges[0].m_RecordCount == 10);
+    }
+    TEST(table.GetDirtyRecordCount() == 0);
+
+    // Init again starts over.
+    table.Init(4, 5, BindlessMaterialTable::MAX_COPY_COUNT);
+    TEST(table.GetDirtyRecordCount() == 5);
+    for(uint32_t copyIndex = 0; copyIndex < BindlessMaterialTable::MAX_COPY_COUNT; ++copyIndex)
+        TEST(table.TakeDirtyRanges(copyIndex, ranges) == 5);
+    TEST(table.GetDirtyRecordCount() == 0);
+
+    table.Clear();
+    TEST(table.GetRecordCount() == 0 && table.GetDirtyRecordCount() == 0);
+    table.Init(8, 0, 2);
+    TEST(table.TakeDirtyRanges(1, ranges) == 0 && ranges.empty());
+}
+
+static void TestRandom(uint32_t iterationCount)
+{
+    const uint32_t copyCounts[] = {1, 2, 3, BindlessMaterialTable::MAX_COPY_COUNT};
+    std::mt19937 rand(1);
+    for(uint32_t copyCount : copyCounts)
+    {
+        const uint32_t recordSize = 12;
+        const uint32_t recordCount = 200;
+        Model model(recordSize, recordCount, copyCount);
+        for(uint32_t iteration = 0; iteration < iterationCount; ++iteration)
+        {
+            // Mostly frames where nothing changes, like a steady state, some with a burst of changes.
+            const uint32_t setCount = rand() % 4 == 0 ? rand() % 20 : 0;
+            for(uint32_t i = 0; i < setCount; ++i)
+            {
+                char record[recordSize];
+                for(char& c : record)
+                    c = (char)(rand() % 3);
+                model.SetRecord(rand() % recordCount, record);
+            }
+            // Like Renderer: one copy per frame in order. Sometimes random, so copies fall behind.
+            model.TakeDirtyRanges(rand() % 8 == 0 ? rand() % copyCount : iteration % copyCount);
+            if(g_FailureCount)
+            {
+                fprintf(stderr, "Copy count %u, iteration %u failed.\n", copyCount, iteration);
+                return;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterationCount = 5000;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterationCount = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: BindlessMaterialTableTest [-i Iterations]\n");
+            return 2;
+        }
+    }
+
+    TestInit();
+    TestRandom(iterationCount);
+
+    return ReportTestResults();
+}
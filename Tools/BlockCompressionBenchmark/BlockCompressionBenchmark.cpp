@@ -0,0 +1,227 @@
+/*
+Benchmark of BlockCompressor (Source/BlockCompressor.hpp), the BC1/BC3/BC4/BC5 encoder used by Texture.
+
+Encodes a synthetic image - smooth gradients with noise and sharp edges, like typical albedo and normal maps -
+to every format, on one thread and on all threads, and reports throughput in megapixels per second.
+Blocks are then decoded following the format specification and compared with the source, so the benchmark
+also checks correctness: exit code is 1 if PSNR of any format is below its threshold.
+
+Usage:
+    BlockCompressionBenchmark [-s Size] [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -pthread -o BlockCompressionBenchmark \
+        Tools/BlockCompressionBenchmark/BlockCompressionBenchmark.cpp Source/BlockCompressor.cpp
+*/
+
+#include "../../Source/BlockCompressor.hpp"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct FormatInfo
+{
+    BlockCompressor::Format m_Format;
+    const char* m_Name;
+    // Channels compared when measuring PSNR.
+    uint32_t m_ChannelCount;
+    float m_MinPSNR;
+};
+
+static const FormatInfo FORMATS[] = {
+    {BlockCompressor::Format::BC1, "BC1", 3, 30.f},
+    {BlockCompressor::Format::BC3, "BC3", 4, 30.f},
+    {BlockCompressor::Format::BC4, "BC4", 1, 38.f},
+    {BlockCompressor::Format::BC5, "BC5", 2, 38.f},
+};
+
+static std::vector<uint8_t> CreateTestImage(uint32_t size)
+{
+    std::mt19937 rand(42);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    std::vector<uint8_t> pixels((size_t)size * size * 4);
+    for(uint32_t y = 0; y < size; ++y)
+    {
+        for(uint32_t x = 0; x < size; ++x)
+        {
+            uint8_t* const pixel = &pixels[((size_t)y * size + x) * 4];
+            const float u = (float)x / size, v = (float)y / size;
+            // Checker of 16x16 cells adds sharp edges to the gradients.
+            const bool cell = ((x / 16) + (y / 16)) % 2 != 0;
+            const float values[4] = {
+                128.f + 100.f * std::sin(u * 12.f),
+                cell ? 200.f * v : 40.f + 150.f * u,
+                128.f + 100.f * std::cos((u + v) * 9.f),
+                cell ? 255.f : 255.f * u};
+            for(uint32_t c = 0; c < 4; ++c)
+                pixel[c] = (uint8_t)std::clamp((int)values[c] + noise(rand), 0, 255);
+        }
+    }
+    return pixels;
+}
+
+static void DecodeColorBlock(const uint8_t* block, uint8_t outPixels[16][4])
+{
+    const uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+    const uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+    int palette[4][3];
+    const uint16_t colors[2] = {color0, color1};
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        const int r = (colors[i] >> 11) & 31, g = (colors[i] >> 5) & 63, b = colors[i] & 31;
+        palette[i][0] = (r << 3) | (r >> 2);
+        palette[i][1] = (g << 2) | (g >> 4);
+        palette[i][2] = (b << 3) | (b >> 2);
+    }
+    for(uint32_t c = 0; c < 3; ++c)
+    {
+        if(color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+    for(uint32_t i = 0; i < 16; ++i)
+        for(uint32_t c = 0; c < 3; ++c)
+            outPixels[i][c] = (uint8_t)palette[(indices >> (i * 2)) & 3][c];
+}
+
+static void DecodeSingleChannelBlock(const uint8_t* block, uint32_t channel, uint8_t outPixels[16][4])
+{
+    const int value0 = block[0], value1 = block[1];
+    int palette[8] = {value0, value1};
+    if(value0 > value1)
+    {
+        for(int i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+    }
+    else
+    {
+        for(int i = 1; i < 5; ++i)
+            palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for(uint32_t i = 0; i < 6; ++i)
+        indices |= (uint64_t)block[2 + i] << (i * 8);
+    for(uint32_t i = 0; i < 16; ++i)
+        outPixels[i][channel] = (uint8_t)palette[(indices >> (i * 3)) & 7];
+}
+
+static double CalculatePSNR(const FormatInfo& info, const std::vector<uint8_t>& src, uint32_t size,
+    const std::vector<uint8_t>& blocks)
+{
+    const uint32_t blockCount = size / 4;
+    const uint32_t blockSize = BlockCompressor::GetBlockSize(info.m_Format);
+    double squaredErrorSum = 0.0;
+    for(uint32_t blockY = 0; blockY < blockCount; ++blockY)
+    {
+        for(uint32_t blockX = 0; blockX < blockCount; ++blockX)
+        {
+            const uint8_t* const block = &blocks[((size_t)blockY * blockCount + blockX) * blockSize];
+            uint8_t decoded[16][4] = {};
+            switch(info.m_Format)
+            {
+            case BlockCompressor::Format::BC1:
+                DecodeColorBlock(block, decoded);
+                break;
+            case BlockCompressor::Format::BC3:
+                DecodeSingleChannelBlock(block, 3, decoded);
+                DecodeColorBlock(block + 8, decoded);
+                break;
+            case BlockCompressor::Format::BC4:
+                DecodeSingleChannelBlock(block, 0, decoded);
+                break;
+            case BlockCompressor::Format::BC5:
+                DecodeSingleChannelBlock(block, 0, decoded);
+                DecodeSingleChannelBlock(block + 8, 1, decoded);
+                break;
+            }
+            for(uint32_t i = 0; i < 16; ++i)
+            {
+                const uint8_t* const pixel = &src[(((size_t)blockY * 4 + i / 4) * size + blockX * 4 + i % 4) * 4];
+                for(uint32_t c = 0; c < info.m_ChannelCount; ++c)
+                {
+                    const double d = (double)pixel[c] - decoded[i][c];
+                    squaredErrorSum += d * d;
+                }
+            }
+        }
+    }
+    const double mse = squaredErrorSum / ((double)size * size * info.m_ChannelCount);
+    return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Returns megapixels per second.
+static double Measure(const BlockCompressor& compressor, const BlockCompressor::Image& image,
+    std::vector<uint8_t>& blocks, size_t blockRowPitch, uint32_t threadCount, uint32_t iterations)
+{
+    compressor.Compress(image, blocks.data(), blockRowPitch, threadCount); // Warm-up
+    const Clock::time_point beginTime = Clock::now();
+    for(uint32_t i = 0; i < iterations; ++i)
+        compressor.Compress(image, blocks.data(), blockRowPitch, threadCount);
+    const double seconds = std::chrono::duration<double>(Clock::now() - beginTime).count();
+    return (double)image.m_Width * image.m_Height * iterations / seconds * 1e-6;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 2048;
+    uint32_t iterations = 4;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            size = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: BlockCompressionBenchmark [-s Size] [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(size < 4 || size % 4 != 0 || iterations == 0)
+    {
+        fprintf(stderr, "Size must be a multiple of 4 and iterations at least 1.\n");
+        return 2;
+    }
+
+    const std::vector<uint8_t> pixels = CreateTestImage(size);
+    const BlockCompressor::Image image = {pixels.data(), size, size, (size_t)size * 4};
+    const uint32_t hardwareThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    printf("Image: %ux%u, iterations: %u, hardware threads: %u\n", size, size, iterations, hardwareThreadCount);
+    printf("%-8s %14s %14s %10s\n", "Format", "1 thread MP/s", "All MP/s", "PSNR dB");
+    bool success = true;
+    for(const FormatInfo& info : FORMATS)
+    {
+        const BlockCompressor compressor(info.m_Format, 4);
+        const size_t blockRowPitch = (size_t)size / 4 * BlockCompressor::GetBlockSize(info.m_Format);
+        std::vector<uint8_t> blocks(blockRowPitch * (size / 4));
+        const double singleThreadSpeed = Measure(compressor, image, blocks, blockRowPitch, 1, iterations);
+        const double allThreadsSpeed = Measure(compressor, image, blocks, blockRowPitch, 0, iterations);
+        const double psnr = CalculatePSNR(info, pixels, size, blocks);
+        printf("%-8s %14.1f %14.1f %10.2f\n", info.m_Name, singleThreadSpeed, allThreadsSpeed, psnr);
+        if(psnr < info.m_MinPSNR)
+        {
+            fprintf(stderr, "%s: PSNR %.2f dB is below %.1f dB.\n", info.m_Name, psnr, info.m_MinPSNR);
+            success = false;
+        }
+    }
+    return success ? 0 : 1;
+}
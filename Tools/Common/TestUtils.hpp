@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+Checks shared by the tests and benchmarks in Tools. A failed TEST prints the expression with its location
+and the run continues, so it reports all failures. main ends with ReportTestResults.
+*/
+
+#include <cstdint>
+#include <cstdio>
+
+inline uint32_t g_FailureCount = 0;
+
+#define TEST(expr) \
+    do { \
+        if(!(expr)) \
+        { \
+            fprintf(stderr, "%s(%d): Failed: %s\n", __FILE__, __LINE__, #expr); \
+            ++g_FailureCount; \
+        } \
+    } while(false)
+
+// Prints the number of failed checks, if any. Returns exit code: 1 if any check failed, 0 otherwise.
+inline int ReportTestResults()
+{
+    if(g_FailureCount)
+    {
+        fprintf(stderr, "%u checks failed.\n", g_FailureCount);
+        return 1;
+    }
+    printf("All tests passed.\n");
+    return 0;
+}
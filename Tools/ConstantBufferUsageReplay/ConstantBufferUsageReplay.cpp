@@ -0,0 +1,252 @@
+/*
+Replays temporary constant buffer allocations of frames of Renderer for a scene through
+ConcurrentMultiFrameRingBuffer (Source/MultiFrameRingBuffer.hpp), set up like TemporaryConstantBufferManager,
+and prints "Used per frame" as its statistics show it: space the frame took from the ring buffer,
+including unused rest of chunks, plus overflow. Compares layouts of per-draw constants:
+- Per-draw buffers: a 256 B aligned constant buffer and CBV descriptor for every object, every distinct
+  material drawn and every light, like Renderer before per-draw indices were passed as root constants,
+- Packed: constants of all objects, all materials and enabled lights tightly packed in one buffer each,
+  selected by root constants ObjectIndex and MaterialIndex, like Renderer now,
+- Packed, bindless: the same without materials, which use the persistent material records.
+
+Counts of the scene are taken from a glTF file the way Renderer loads it with Assimp: an object for every
+node with a mesh, materials of the file and the default one Assimp adds, distinct materials of primitives
+of those meshes as drawn materials. The file can be given directly or by "Assimp.ModelPath" of a settings
+file, e.g. WorkingDir/LoadSettings.json. Counts can also be given on the command line. Lights are those
+of Renderer::CreateLights, of which 1 is enabled.
+
+Usage:
+    ConstantBufferUsageReplay -s ScenePath.gltf
+    ConstantBufferUsageReplay -c LoadSettingsPath.json
+    ConstantBufferUsageReplay -o ObjectCount -m MaterialCount [-u DrawnMaterialCount] [-l LightCount]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o ConstantBufferUsageReplay Tools/ConstantBufferUsageReplay/ConstantBufferUsageReplay.cpp
+*/
+
+#include "../../Source/MultiFrameRingBuffer.hpp"
+#include "../../ThirdParty/rapidjson/include/rapidjson/document.h"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <set>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Like Source/ConstantBuffers.cpp.
+static const uint32_t ALIGNMENT = 256;
+static const uint32_t THREAD_CHUNK_SIZE = 16 * ALIGNMENT;
+// Defaults of "FrameCount" and "ConstantBuffers.Temporary.MaxSizePerFrame" in WorkingDir/StartupSettings.json.
+static const uint32_t FRAME_COUNT = 3;
+static const uint32_t MAX_SIZE_PER_FRAME = 200000;
+// Same as sizeof of the structures in Source/Renderer.cpp.
+static const uint32_t PER_FRAME_CONSTANTS_SIZE = 208;
+static const uint32_t PER_OBJECT_CONSTANTS_SIZE = 128;
+static const uint32_t PER_MATERIAL_CONSTANTS_SIZE = 32;
+static const uint32_t LIGHT_CONSTANTS_SIZE = 32;
+
+struct SceneCounts
+{
+    uint32_t m_ObjectCount = 0;
+    uint32_t m_MaterialCount = 0;
+    uint32_t m_DrawnMaterialCount = UINT32_MAX;
+    // Renderer::CreateLights enables 1 of 3.
+    uint32_t m_LightCount = 1;
+};
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool ReadJson(const std::string& path, rapidjson::Document& outDoc)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        fprintf(stderr, "Cannot open \"%s\".\n", path.c_str());
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    // Settings files have comments, like Source/Settings.cpp accepts.
+    outDoc.Parse<rapidjson::kParseCommentsFlag | rapidjson::kParseTrailingCommasFlag>(contents.str().c_str());
+    if(outDoc.HasParseError() || !outDoc.IsObject())
+    {
+        fprintf(stderr, "Cannot parse \"%s\".\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void CountNode(const rapidjson::Document& doc, uint32_t nodeIndex, std::set<int64_t>& drawnMaterials,
+    SceneCounts& counts)
+{
+    const rapidjson::Value& node = doc["nodes"][nodeIndex];
+    if(node.HasMember("mesh"))
+    {
+        ++counts.m_ObjectCount;
+        for(const rapidjson::Value& primitive : doc["meshes"][node["mesh"].GetUint()]["primitives"].GetArray())
+            drawnMaterials.insert(primitive.HasMember("material") ? primitive["material"].GetInt64() : -1);
+    }
+    if(node.HasMember("children"))
+    {
+        for(const rapidjson::Value& child : node["children"].GetArray())
+            CountNode(doc, child.GetUint(), drawnMaterials, counts);
+    }
+}
+
+static bool CountScene(const std::string& path, SceneCounts& outCounts)
+{
+    rapidjson::Document doc;
+    if(!ReadJson(path, doc))
+        return false;
+    if(!doc.HasMember("scenes") || !doc.HasMember("nodes"))
+    {
+        fprintf(stderr, "\"%s\" has no scenes or nodes. Only .gltf files are supported.\n", path.c_str());
+        return false;
+    }
+    const uint32_t sceneIndex = doc.HasMember("scene") ? doc["scene"].GetUint() : 0;
+    std::set<int64_t> drawnMaterials;
+    outCounts.m_ObjectCount = 0;
+    for(const rapidjson::Value& root : doc["scenes"][sceneIndex]["nodes"].GetArray())
+        CountNode(doc, root.GetUint(), drawnMaterials, outCounts);
+    // Assimp appends a default material, used by primitives without one.
+    const uint32_t fileMaterialCount = doc.HasMember("materials") ? doc["materials"].Size() : 0;
+    outCounts.m_MaterialCount = fileMaterialCount + 1;
+    outCounts.m_DrawnMaterialCount = (uint32_t)drawnMaterials.size();
+    return true;
+}
+
+static bool GetModelPath(const std::string& settingsPath, std::string& outModelPath)
+{
+    rapidjson::Document doc;
+    if(!ReadJson(settingsPath, doc))
+        return false;
+    if(!doc.HasMember("Assimp.ModelPath") || !doc["Assimp.ModelPath"].IsString())
+    {
+        fprintf(stderr, "\"%s\" has no \"Assimp.ModelPath\".\n", settingsPath.c_str());
+        return false;
+    }
+    outModelPath = doc["Assimp.ModelPath"].GetString();
+    return true;
+}
+
+struct ReplayResult
+{
+    uint32_t m_AllocationCount = 0;
+    uint32_t m_CBVDescriptorCount = 0;
+    // Sum of aligned sizes of allocations.
+    uint64_t m_RequestedSize = 0;
+    // Like "Used per frame" of the last frame.
+    uint64_t m_UsedSize = 0;
+};
+
+// sizes: unaligned sizes of allocations of one frame, in order. Replays enough frames to reach a steady state.
+static ReplayResult Replay(const std::vector<uint32_t>& sizes, uint32_t CBVDescriptorCount)
+{
+    ConcurrentMultiFrameRingBuffer<uint32_t> ringBuffer;
+    ringBuffer.Init(AlignUp(MAX_SIZE_PER_FRAME * FRAME_COUNT, THREAD_CHUNK_SIZE), FRAME_COUNT, THREAD_CHUNK_SIZE);
+    ReplayResult result = {};
+    result.m_AllocationCount = (uint32_t)sizes.size();
+    result.m_CBVDescriptorCount = CBVDescriptorCount;
+    for(uint32_t size : sizes)
+        result.m_RequestedSize += AlignUp(size, ALIGNMENT);
+    for(uint32_t frame = 0; frame < FRAME_COUNT * 4; ++frame)
+    {
+        // Like TemporaryConstantBufferManager: what doesn't fit goes to overflow buffers.
+        uint64_t overflowSize = 0;
+        for(uint32_t size : sizes)
+        {
+            uint32_t offset = 0;
+            if(!ringBuffer.Allocate(AlignUp(size, ALIGNMENT), offset))
+                overflowSize += AlignUp(size, ALIGNMENT);
+        }
+        ringBuffer.NewFrame();
+        result.m_UsedSize = ringBuffer.GetLastFrameSize() + overflowSize;
+    }
+    TEST(result.m_UsedSize >= result.m_RequestedSize);
+    return result;
+}
+
+static void Print(const char* name, const ReplayResult& result)
+{
+    printf("%-20s %12u %12u %14llu %18llu\n", name, result.m_AllocationCount, result.m_CBVDescriptorCount,
+        (unsigned long long)result.m_RequestedSize, (unsigned long long)result.m_UsedSize);
+}
+
+int main(int argc, char** argv)
+{
+    SceneCounts counts;
+    std::string scenePath;
+    std::string settingsPath;
+    bool countsGiven = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            scenePath = argv[++i];
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            settingsPath = argv[++i];
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            counts.m_ObjectCount = (uint32_t)atoi(argv[++i]);
+            countsGiven = true;
+        }
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            counts.m_MaterialCount = (uint32_t)atoi(argv[++i]);
+        else if(strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            counts.m_DrawnMaterialCount = (uint32_t)atoi(argv[++i]);
+        else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            counts.m_LightCount = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: ConstantBufferUsageReplay -s ScenePath.gltf | -c LoadSettingsPath.json | "
+                "-o ObjectCount -m MaterialCount [-u DrawnMaterialCount] [-l LightCount]\n");
+            return 2;
+        }
+    }
+    if((int)!scenePath.empty() + (int)!settingsPath.empty() + (int)countsGiven != 1)
+    {
+        fprintf(stderr, "Give exactly one of ScenePath, LoadSettingsPath or ObjectCount.\n");
+        return 2;
+    }
+
+    if(!settingsPath.empty() && !GetModelPath(settingsPath, scenePath))
+        return 2;
+    if(!scenePath.empty() && !CountScene(scenePath, counts))
+        return 2;
+    if(counts.m_DrawnMaterialCount == UINT32_MAX)
+        counts.m_DrawnMaterialCount = counts.m_MaterialCount;
+
+    printf("Objects: %u, materials: %u, drawn materials: %u, lights: %u\n", counts.m_ObjectCount,
+        counts.m_MaterialCount, counts.m_DrawnMaterialCount, counts.m_LightCount);
+    printf("Ring buffer: %u B per frame, frames: %u, chunk: %u B\n", MAX_SIZE_PER_FRAME, FRAME_COUNT, THREAD_CHUNK_SIZE);
+
+    std::vector<uint32_t> perDrawSizes = {PER_FRAME_CONSTANTS_SIZE};
+    perDrawSizes.insert(perDrawSizes.end(), counts.m_ObjectCount, PER_OBJECT_CONSTANTS_SIZE);
+    perDrawSizes.insert(perDrawSizes.end(), counts.m_DrawnMaterialCount, PER_MATERIAL_CONSTANTS_SIZE);
+    perDrawSizes.insert(perDrawSizes.end(), counts.m_LightCount, LIGHT_CONSTANTS_SIZE);
+    const ReplayResult perDraw = Replay(perDrawSizes, (uint32_t)perDrawSizes.size());
+
+    // In the order Renderer::Render allocates them. Empty ones are skipped, like there.
+    std::vector<uint32_t> bindlessSizes = {PER_FRAME_CONSTANTS_SIZE};
+    if(counts.m_ObjectCount > 0)
+        bindlessSizes.push_back(counts.m_ObjectCount * PER_OBJECT_CONSTANTS_SIZE);
+    if(counts.m_LightCount > 0)
+        bindlessSizes.push_back(counts.m_LightCount * LIGHT_CONSTANTS_SIZE);
+    std::vector<uint32_t> packedSizes = bindlessSizes;
+    if(counts.m_MaterialCount > 0)
+        packedSizes.insert(packedSizes.begin() + 1, counts.m_MaterialCount * PER_MATERIAL_CONSTANTS_SIZE);
+    const ReplayResult packed = Replay(packedSizes, 1);
+    const ReplayResult bindless = Replay(bindlessSizes, 1);
+
+    printf("%-20s %12s %12s %14s %18s\n", "Layout", "Allocations", "CBVs", "Requested B", "Used per frame B");
+    Print("Per-draw buffers", perDraw);
+    Print("Packed", packed);
+    Print("Packed, bindless", bindless);
+
+    return ReportTestResults();
+}
@@ -0,0 +1,278 @@
+/*
+Microbenchmark of persistent descriptor allocation.
+
+Compares DescriptorSlotAllocator (Source/DescriptorSlotAllocator.hpp), used by DescriptorManager
+for single descriptors, with a general best-fit allocator with coalescing of free ranges, like the path
+through D3D12MA::VirtualBlock that all persistent descriptors took before. D3D12MA itself needs
+Direct3D 12 headers, so BestFitAllocator below stands in for it to keep the benchmark portable.
+Pages of DescriptorSlotAllocator are taken from the same BestFitAllocator, like DescriptorManager does.
+
+Both are also checked for correctness: every live index is unique.
+
+Usage:
+    DescriptorAllocatorBenchmark [-n DescriptorCount] [-i Iterations]
+
+Builds on Windows and Linux. On Linux:
+    g++ -std=c++20 -O2 -o DescriptorAllocatorBenchmark \
+        Tools/DescriptorAllocatorBenchmark/DescriptorAllocatorBenchmark.cpp Source/DescriptorSlotAllocator.cpp
+*/
+
+#include "../../Source/DescriptorSlotAllocator.hpp"
+#include <map>
+#include <set>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Best fit over free ranges sorted by size, with coalescing of neighbors on free.
+class BestFitAllocator
+{
+public:
+    explicit BestFitAllocator(uint64_t size)
+    {
+        AddFreeRange(0, size);
+    }
+
+    // Returns false if there is no space.
+    bool Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset)
+    {
+        for(auto it = m_FreeBySize.lower_bound({size, 0}); it != m_FreeBySize.end(); ++it)
+        {
+            const uint64_t rangeSize = it->first;
+            const uint64_t rangeOffset = it->second;
+            const uint64_t offset = (rangeOffset + alignment - 1) / alignment * alignment;
+            if(offset + size > rangeOffset + rangeSize)
+                continue;
+            RemoveFreeRange(rangeOffset, rangeSize);
+            if(offset > rangeOffset)
+                AddFreeRange(rangeOffset, offset - rangeOffset);
+            if(offset + size < rangeOffset + rangeSize)
+                AddFreeRange(offset + size, rangeOffset + rangeSize - offset - size);
+            m_AllocatedSizes[offset] = size;
+            outOffset = offset;
+            return true;
+        }
+        return false;
+    }
+
+    void Free(uint64_t offset)
+    {
+        const auto allocIt = m_AllocatedSizes.find(offset);
+        assert(allocIt != m_AllocatedSizes.end());
+        uint64_t size = allocIt->second;
+        m_AllocatedSizes.erase(allocIt);
+
+        const auto nextIt = m_FreeByOffset.find(offset + size);
+        if(nextIt != m_FreeByOffset.end())
+        {
+            size += nextIt->second;
+            RemoveFreeRange(nextIt->first, nextIt->second);
+        }
+        auto prevIt = m_FreeByOffset.lower_bound(offset);
+        if(prevIt != m_FreeByOffset.begin())
+        {
+            --prevIt;
+            if(prevIt->first + prevIt->second == offset)
+            {
+                offset = prevIt->first;
+                size += prevIt->second;
+                RemoveFreeRange(prevIt->first, prevIt->second);
+            }
+        }
+        AddFreeRange(offset, size);
+    }
+
+private:
+    // Pairs of size, offset.
+    std::set<std::pair<uint64_t, uint64_t>> m_FreeBySize;
+    std::map<uint64_t, uint64_t> m_FreeByOffset;
+    std::map<uint64_t, uint64_t> m_AllocatedSizes;
+
+    void AddFreeRange(uint64_t offset, uint64_t size)
+    {
+        m_FreeBySize.emplace(size, offset);
+        m_FreeByOffset.emplace(offset, size);
+    }
+    void RemoveFreeRange(uint64_t offset, uint64_t size)
+    {
+        m_FreeBySize.erase({size, offset});
+        m_FreeByOffset.erase(offset);
+    }
+};
+
+// Like DescriptorManager: single descriptors from pages, pages from the general allocator.
+class SegregatedAllocator
+{
+public:
+    explicit SegregatedAllocator(uint64_t size) :
+        m_General(size)
+    {
+        m_Slots.Init(size);
+    }
+
+    bool Allocate(uint64_t& outIndex)
+    {
+        if(m_Slots.Allocate(outIndex))
+            return true;
+        uint64_t pageOffset = 0;
+        if(!m_General.Allocate(DescriptorSlotAllocator::PAGE_SIZE, DescriptorSlotAllocator::PAGE_SIZE, pageOffset))
+            return false;
+        m_Slots.AddPage(pageOffset / DescriptorSlotAllocator::PAGE_SIZE);
+        return m_Slots.Allocate(outIndex);
+    }
+
+    void Free(uint64_t index)
+    {
+        uint64_t pageIndex = 0;
+        if(m_Slots.Free(index, pageIndex))
+            m_General.Free(pageIndex * DescriptorSlotAllocator::PAGE_SIZE);
+    }
+
+private:
+    BestFitAllocator m_General;
+    DescriptorSlotAllocator m_Slots;
+};
+
+struct GeneralAdapter
+{
+    BestFitAllocator m_Allocator;
+    explicit GeneralAdapter(uint64_t size) : m_Allocator(size) { }
+    bool Allocate(uint64_t& outIndex) { return m_Allocator.Allocate(1, 1, outIndex); }
+    void Free(uint64_t index) { m_Allocator.Free(index); }
+};
+
+static void CheckUnique(const std::vector<uint64_t>& live, uint64_t descriptorCount, const char* name)
+{
+    std::vector<bool> used(descriptorCount, false);
+    for(uint64_t index : live)
+    {
+        if(index >= descriptorCount || used[index])
+        {
+            fprintf(stderr, "%s: invalid or duplicate index %llu.\n", name, (unsigned long long)index);
+            exit(1);
+        }
+        used[index] = true;
+    }
+}
+
+/*
+Fills the allocator to 3/4 of capacity, then frees a random descriptor and allocates a new one,
+like textures being streamed in and out. Returns nanoseconds per pair of Free + Allocate.
+*/
+template<typename AllocatorT>
+static double RunChurn(const char* name, uint64_t descriptorCount, uint64_t iterations)
+{
+    AllocatorT allocator(descriptorCount);
+    std::vector<uint64_t> live;
+    live.reserve(descriptorCount);
+    for(uint64_t i = 0; i < descriptorCount * 3 / 4; ++i)
+    {
+        uint64_t index = 0;
+        if(!allocator.Allocate(index))
+        {
+            fprintf(stderr, "%s: out of space when filling.\n", name);
+            exit(1);
+        }
+        live.push_back(index);
+    }
+    CheckUnique(live, descriptorCount, name);
+
+    std::mt19937_64 random(0);
+    std::vector<uint32_t> victims(iterations);
+    for(uint32_t& victim : victims)
+        victim = (uint32_t)(random() % live.size());
+
+    const auto beginTime = Clock::now();
+    for(uint64_t i = 0; i < iterations; ++i)
+    {
+        uint64_t& index = live[victims[i]];
+        allocator.Free(index);
+        if(!allocator.Allocate(index))
+        {
+            fprintf(stderr, "%s: out of space.\n", name);
+            exit(1);
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - beginTime).count() / (double)iterations;
+    CheckUnique(live, descriptorCount, name);
+    return ns;
+}
+
+// Allocates all, then frees all in random order. Returns nanoseconds per Allocate + Free.
+template<typename AllocatorT>
+static double RunFillDrain(const char* name, uint64_t descriptorCount, uint64_t rounds)
+{
+    AllocatorT allocator(descriptorCount);
+    std::vector<uint64_t> live;
+    live.reserve(descriptorCount);
+    std::mt19937_64 random(1);
+    double totalNs = 0.;
+    for(uint64_t round = 0; round < rounds; ++round)
+    {
+        live.clear();
+        const auto beginTime = Clock::now();
+        uint64_t index = 0;
+        while(allocator.Allocate(index))
+            live.push_back(index);
+        const auto fillEndTime = Clock::now();
+        std::shuffle(live.begin(), live.end(), random);
+        const auto drainBeginTime = Clock::now();
+        for(uint64_t liveIndex : live)
+            allocator.Free(liveIndex);
+        const auto endTime = Clock::now();
+        totalNs += std::chrono::duration<double, std::nano>(fillEndTime - beginTime + endTime - drainBeginTime).count();
+        if(round == 0)
+        {
+            if(live.size() != descriptorCount / DescriptorSlotAllocator::PAGE_SIZE * DescriptorSlotAllocator::PAGE_SIZE &&
+                live.size() != descriptorCount)
+            {
+                fprintf(stderr, "%s: allocated %zu of %llu.\n", name, live.size(), (unsigned long long)descriptorCount);
+                exit(1);
+            }
+            CheckUnique(live, descriptorCount, name);
+        }
+    }
+    return totalNs / (double)(rounds * live.size());
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t descriptorCount = 65536;
+    uint64_t iterations = 4000000;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            descriptorCount = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: DescriptorAllocatorBenchmark [-n DescriptorCount] [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(descriptorCount < DescriptorSlotAllocator::PAGE_SIZE * 4)
+    {
+        fprintf(stderr, "DescriptorCount must be at least %llu.\n",
+            (unsigned long long)DescriptorSlotAllocator::PAGE_SIZE * 4);
+        return 2;
+    }
+
+    printf("Descriptors: %llu, iterations: %llu\n", (unsigned long long)descriptorCount, (unsigned long long)iterations);
+    const uint64_t rounds = std::max<uint64_t>(iterations / descriptorCount, 1);
+    printf("%-12s %16s %20s\n", "Allocator", "Churn ns/pair", "Fill+drain ns/pair");
+    printf("%-12s %16.1f %20.1f\n", "Best fit",
+        RunChurn<GeneralAdapter>("Best fit", descriptorCount, iterations),
+        RunFillDrain<GeneralAdapter>("Best fit", descriptorCount, rounds));
+    printf("%-12s %16.1f %20.1f\n", "Slots",
+        RunChurn<SegregatedAllocator>("Slots", descriptorCount, iterations),
+        RunFillDrain<SegregatedAllocator>("Slots", descriptorCount, rounds));
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+Test of the planner of descriptor defragmentation (Source/DescriptorDefragmentation.hpp),
+which DescriptorManager::Defragment uses to compact the persistent section of a descriptor heap.
+
+Checks plans of small hand-made layouts, then of random ones with pinned and movable ranges and single
+descriptors. Every plan must pass ValidateDescriptorDefragmentationPlan, and also:
+- applying its moves to a heap of tagged descriptors, copying from a snapshot like MoveDescriptors,
+  leaves every range and single descriptor with its own contents at its new index,
+- movable ranges never move up, pages are never added, every page keeps at least one single descriptor.
+Then checks that ValidateDescriptorDefragmentationPlan rejects plans broken in various ways,
+so Defragment doesn't apply them.
+
+Usage:
+    DescriptorDefragmentationTest [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o DescriptorDefragmentationTest \
+        Tools/DescriptorDefragmentationTest/DescriptorDefragmentationTest.cpp Source/DescriptorDefragmentation.cpp
+*/
+
+#include "../../Source/DescriptorDefragmentation.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <set>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Input = DescriptorDefragmentationInput;
+using Plan = DescriptorDefragmentationPlan;
+
+// Checks the properties listed at the top of the file.
+static void CheckPlan(const Input& input, const Plan& plan)
+{
+    TEST(ValidateDescriptorDefragmentationPlan(input, plan));
+    if(plan.m_RangeIndices.size() != input.m_Ranges.size() || plan.m_SingleIndices.size() != input.m_Singles.size())
+        return;
+
+    // Tag of every descriptor = 1 + its position in the input, 0 = free.
+    std::vector<uint64_t> heap(input.m_DescriptorCount, 0);
+    uint64_t tag = 1;
+    for(const Input::Single& single : input.m_Singles)
+        heap[single.m_Index] = tag++;
+    for(const Input::Range& range : input.m_Ranges)
+    {
+        for(uint64_t i = 0; i < range.m_Size; ++i)
+            heap[range.m_Index + i] = tag++;
+    }
+    const std::vector<uint64_t> snapshot = heap;
+    for(const Plan::Move& move : plan.m_Moves)
+    {
+        TEST(move.m_SrcIndex + move.m_Count <= heap.size() && move.m_DstIndex + move.m_Count <= heap.size());
+        if(move.m_SrcIndex + move.m_Count > heap.size() || move.m_DstIndex + move.m_Count > heap.size())
+            return;
+        for(uint64_t i = 0; i < move.m_Count; ++i)
+            heap[move.m_DstIndex + i] = snapshot[move.m_SrcIndex + i];
+    }
+
+    for(size_t i = 0; i < input.m_Singles.size(); ++i)
+    {
+        const uint64_t newIndex = plan.m_SingleIndices[i];
+        TEST(newIndex < heap.size() && heap[newIndex] == snapshot[input.m_Singles[i].m_Index]);
+    }
+    for(size_t i = 0; i < input.m_Ranges.size(); ++i)
+    {
+        const Input::Range& range = input.m_Ranges[i];
+        const uint64_t newIndex = plan.m_RangeIndices[i];
+        TEST(newIndex <= range.m_Index);
+        for(uint64_t j = 0; j < range.m_Size && newIndex + j < heap.size(); ++j)
+            TEST(heap[newIndex + j] == snapshot[range.m_Index + j]);
+    }
+
+    std::set<uint64_t> oldPages;
+    for(const Input::Single& single : input.m_Singles)
+        oldPages.insert(single.m_Index / input.m_PageSize);
+    TEST(plan.m_Pages.size() <= oldPages.size());
+}
+
+static void TestSimple()
+{
+    // Fragmented movable single descriptors gather into one page at the beginning, the range follows it.
+    Input input;
+    input.m_DescriptorCount = 1024;
+    input.m_PageSize = 64;
+    for(uint64_t page = 0; page < 10; ++page)
+        input.m_Singles.push_back({page * 64 + 5, true});
+    input.m_Ranges.push_back({700, 100, true});
+    Plan plan = PlanDescriptorDefragmentation(input);
+    CheckPlan(input, plan);
+    TEST(plan.m_Pages == std::vector<uint64_t>{0});
+    TEST(plan.m_RangeIndices[0] == 64);
+    TEST(plan.m_UsedEnd == 164);
+
+    // Pinned single descriptor keeps its page, which receives the others. Pinned range stays.
+    input.m_Singles[9].m_Movable = false;
+    input.m_Ranges.push_back({900, 10, false});
+    plan = PlanDescriptorDefragmentation(input);
+    CheckPlan(input, plan);
+    TEST(plan.m_Pages == std::vector<uint64_t>{9});
+    TEST(plan.m_SingleIndices[9] == 9 * 64 + 5);
+    TEST(plan.m_RangeIndices[0] == 0);
+    TEST(plan.m_RangeIndices[1] == 900);
+    TEST(plan.m_UsedEnd == 910);
+
+    // Already compact: no moves.
+    Input compact;
+    compact.m_DescriptorCount = 256;
+    compact.m_PageSize = 64;
+    compact.m_Singles.push_back({0, true});
+    compact.m_Singles.push_back({1, true});
+    compact.m_Ranges.push_back({64, 32, true});
+    plan = PlanDescriptorDefragmentation(compact);
+    CheckPlan(compact, plan);
+    TEST(plan.m_Moves.empty() && plan.m_UsedEnd == 96);
+
+    // Empty section.
+    Input empty;
+    empty.m_DescriptorCount = 128;
+    empty.m_PageSize = 64;
+    plan = PlanDescriptorDefragmentation(empty);
+    CheckPlan(empty, plan);
+    TEST(plan.m_Moves.empty() && plan.m_Pages.empty() && plan.m_UsedEnd == 0);
+}
+
+static Input MakeRandomInput(std::mt19937_64& rand)
+{
+    Input input;
+    input.m_PageSize = rand() % 3 == 0 ? 64 : 1 + rand() % 8;
+    const uint64_t pageSize = input.m_PageSize;
+    input.m_DescriptorCount = pageSize * (1 + rand() % 40) + rand() % 10;
+    std::vector<bool> used(input.m_DescriptorCount, false);
+    // Some pages with single descriptors, a few of them pinned.
+    for(uint64_t page = 0; (page + 1) * pageSize <= input.m_DescriptorCount; ++page)
+    {
+        if(rand() % 2 == 0)
+            continue;
+        for(uint64_t slot = 0; slot < pageSize; ++slot)
+        {
+            if(rand() % 3 == 0)
+                input.m_Singles.push_back({page * pageSize + slot, rand() % 8 != 0});
+            used[page * pageSize + slot] = true;
+        }
+        // Page without a single descriptor is not allocated.
+        if(input.m_Singles.empty() || input.m_Singles.back().m_Index / pageSize != page)
+            input.m_Singles.push_back({page * pageSize, rand() % 8 != 0});
+    }
+    // Ranges in free space between them.
+    for(uint32_t i = 0; i < 20; ++i)
+    {
+        const uint64_t size = 1 + rand() % (2 * pageSize + 1);
+        const uint64_t index = rand() % input.m_DescriptorCount;
+        if(index + size > input.m_DescriptorCount)
+            continue;
+        bool free = true;
+        for(uint64_t j = index; j < index + size; ++j)
+            free = free && !used[j];
+        if(!free)
+            continue;
+        for(uint64_t j = index; j < index + size; ++j)
+            used[j] = true;
+        input.m_Ranges.push_back({index, size, rand() % 6 != 0});
+    }
+    return input;
+}
+
+static void TestRandom(uint32_t iterationCount)
+{
+    std::mt19937_64 rand(5);
+    for(uint32_t iteration = 0; iteration < iterationCount; ++iteration)
+    {
+        const Input input = MakeRandomInput(rand);
+        const Plan plan = PlanDescriptorDefragmentation(input);
+        CheckPlan(input, plan);
+        // Planning again from the result is valid too and never uses more of the section.
+        Input again = input;
+        for(size_t i = 0; i < again.m_Ranges.size(); ++i)
+            again.m_Ranges[i].m_Index = plan.m_RangeIndices[i];
+        for(size_t i = 0; i < again.m_Singles.size(); ++i)
+            again.m_Singles[i].m_Index = plan.m_SingleIndices[i];
+        const Plan planAgain = PlanDescriptorDefragmentation(again);
+        CheckPlan(again, planAgain);
+        TEST(planAgain.m_UsedEnd <= plan.m_UsedEnd);
+        if(g_FailureCount)
+        {
+            fprintf(stderr, "Iteration %u failed.\n", iteration);
+            return;
+        }
+    }
+}
+
+// Plans broken after planning, like a bug in the planner would, must be rejected.
+static void TestValidation()
+{
+    Input input;
+    input.m_DescriptorCount = 1024;
+    input.m_PageSize = 64;
+    for(uint64_t page = 0; page < 4; ++page)
+        input.m_Singles.push_back({page * 64 + 5, true});
+    input.m_Singles.push_back({10 * 64 + 1, false});
+    input.m_Singles.push_back({12 * 64 + 3, false});
+    input.m_Ranges.push_back({300, 20, true});
+    input.m_Ranges.push_back({500, 8, false});
+    input.m_Ranges.push_back({800, 30, true});
+    const Plan plan = PlanDescriptorDefragmentation(input);
+    CheckPlan(input, plan);
+    TEST(!plan.m_Moves.empty() && plan.m_Pages.size() == 2);
+
+    const std::function<void(Plan&)> breakers[] = {
+        // Pinned single and range moved.
+        [](Plan& p) { p.m_SingleIndices[4] = 10 * 64 + 2; },
+        [](Plan& p) { p.m_RangeIndices[1] = 0; },
+        // Out of the section.
+        [](Plan& p) { p.m_RangeIndices[2] = 1000; },
+        [](Plan& p) { p.m_Pages.push_back(16); },
+        // Two single descriptors at one index.
+        [](Plan& p) { p.m_SingleIndices[1] = p.m_SingleIndices[0]; },
+        // Single descriptor outside of pages, page without single descriptors.
+        [](Plan& p) { p.m_SingleIndices[0] = 200; },
+        [](Plan& p) { p.m_Pages.push_back(15); },
+        // Pages not ascending.
+        [](Plan& p) { std::swap(p.m_Pages.front(), p.m_Pages.back()); },
+        // Range over a page, ranges overlapping.
+        [](Plan& p) { p.m_RangeIndices[0] = p.m_Pages[0] * 64; },
+        [](Plan& p) { p.m_RangeIndices[2] = p.m_RangeIndices[0] + 10; },
+        [](Plan& p) { p.m_UsedEnd += 1; },
+        // Move missing, added, shortened, or to a wrong place.
+        [](Plan& p) { p.m_Moves.pop_back(); },
+        [](Plan& p) { p.m_Moves.push_back(p.m_Moves.back()); },
+        [](Plan& p) { p.m_Moves.push_back({900, 900, 1}); },
+        [](Plan& p) { p.m_Moves.front().m_Count -= 1; },
+        [](Plan& p) { p.m_Moves.front().m_DstIndex += 1; },
+        [](Plan& p) { p.m_Moves.front().m_SrcIndex = 1020; },
+        [](Plan& p) { p.m_RangeIndices.pop_back(); },
+    };
+    for(const std::function<void(Plan&)>& breaker : breakers)
+    {
+        Plan broken = plan;
+        breaker(broken);
+        TEST(!ValidateDescriptorDefragmentationPlan(input, broken));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterationCount = 20000;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterationCount = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: DescriptorDefragmentationTest [-i Iterations]\n");
+            return 2;
+        }
+    }
+
+    TestSimple();
+    TestRandom(iterationCount);
+    TestValidation();
+
+    return ReportTestResults();
+}
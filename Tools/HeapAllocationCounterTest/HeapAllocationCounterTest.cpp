@@ -0,0 +1,141 @@
+/*
+Test of HeapAllocationCounter (Source/HeapAllocationCounter.hpp), the replacement of the global operator new
+that Renderer uses to check that frames in a steady state don't allocate from the heap.
+
+Checks that all forms of operator new are counted, per thread and for all threads, and that the check
+Renderer makes - count of the thread not changing across frames - passes for a frame that reuses its memory
+and fails for one that allocates.
+
+Usage:
+    HeapAllocationCounterTest
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o HeapAllocationCounterTest \
+        Tools/HeapAllocationCounterTest/HeapAllocationCounterTest.cpp Source/HeapAllocationCounter.cpp -lpthread
+*/
+
+#include "../../Source/HeapAllocationCounter.hpp"
+#include "../Common/TestUtils.hpp"
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+// The compiler may remove a new paired with delete. Passing the pointer through a volatile keeps the allocation.
+static void* volatile g_Escape = nullptr;
+template<typename T>
+static T* Escape(T* ptr)
+{
+    g_Escape = ptr;
+    return ptr;
+}
+
+struct alignas(64) AlignedItem
+{
+    char m_Data[64];
+};
+
+// Returns number of allocations of this thread made by func.
+template<typename Func>
+static uint64_t CountAllocations(const Func& func)
+{
+    const uint64_t countBefore = GetThreadHeapAllocationCount();
+    func();
+    return GetThreadHeapAllocationCount() - countBefore;
+}
+
+static void TestForms()
+{
+    TEST(CountAllocations([]() { delete Escape(new int(1)); }) == 1);
+    TEST(CountAllocations([]() { delete[] Escape(new int[16]); }) == 1);
+    TEST(CountAllocations([]() { delete Escape(new(std::nothrow) int(1)); }) == 1);
+    TEST(CountAllocations([]() { delete[] Escape(new(std::nothrow) int[16]); }) == 1);
+    TEST(CountAllocations([]()
+    {
+        AlignedItem* const item = Escape(new AlignedItem());
+        TEST((uintptr_t)item % alignof(AlignedItem) == 0);
+        delete item;
+    }) == 1);
+    TEST(CountAllocations([]() { delete[] Escape(new AlignedItem[3]); }) == 1);
+    TEST(CountAllocations([]() { Escape(std::make_unique<std::string>(100, 'a').get()); }) == 2);
+    // Zero-size allocations are valid and distinct.
+    TEST(CountAllocations([]()
+    {
+        int* const first = Escape(new int[0]);
+        int* const second = Escape(new int[0]);
+        TEST(first != second);
+        delete[] first;
+        delete[] second;
+    }) == 2);
+    // No allocation, no count.
+    TEST(CountAllocations([]() { int value = 0; Escape(&value); }) == 0);
+}
+
+static void TestThreads()
+{
+    const uint64_t totalBefore = GetHeapAllocationCount();
+    const uint64_t threadBefore = GetThreadHeapAllocationCount();
+    uint64_t otherThreadCount = 0;
+    // std::thread allocates its state from the calling thread too, so only the other thread is checked exactly.
+    std::thread thread([&]()
+    {
+        const uint64_t before = GetThreadHeapAllocationCount();
+        for(int i = 0; i < 100; ++i)
+            delete Escape(new int(i));
+        otherThreadCount = GetThreadHeapAllocationCount() - before;
+    });
+    thread.join();
+    TEST(otherThreadCount == 100);
+    TEST(GetHeapAllocationCount() - totalBefore >= 100 + (GetThreadHeapAllocationCount() - threadBefore));
+    TEST(GetThreadHeapAllocationCount() - threadBefore < 100);
+}
+
+// Like the check in Renderer: frames after warm-up don't change the count of the thread.
+static void TestSteadyState()
+{
+    // Reuses capacity of its containers, like data in FrameArena.
+    std::vector<int> items;
+    std::string name;
+    auto reusingFrame = [&](int frame)
+    {
+        items.clear();
+        for(int i = 0; i < 1000; ++i)
+            items.push_back(i * frame);
+        name.assign(200, (char)('a' + frame % 26));
+    };
+    uint64_t warmUpCount = 0;
+    for(int frame = 0; frame < 3; ++frame)
+        warmUpCount += CountAllocations([&]() { reusingFrame(frame); });
+    TEST(warmUpCount > 0);
+    for(int frame = 3; frame < 100; ++frame)
+        TEST(CountAllocations([&]() { reusingFrame(frame); }) == 0);
+
+    // Builds new containers every frame.
+    auto allocatingFrame = [](int frame)
+    {
+        std::vector<int> newItems(1000, frame);
+        std::string newName(200, (char)('a' + frame % 26));
+        Escape(newItems.data());
+        Escape(newName.data());
+    };
+    for(int frame = 0; frame < 100; ++frame)
+        TEST(CountAllocations([&]() { allocatingFrame(frame); }) == 2);
+}
+
+int main(int argc, char**)
+{
+    if(argc > 1)
+    {
+        fprintf(stderr, "Usage: HeapAllocationCounterTest\n");
+        return 2;
+    }
+
+    TestForms();
+    TestThreads();
+    TestSteadyState();
+
+    return ReportTestResults();
+}
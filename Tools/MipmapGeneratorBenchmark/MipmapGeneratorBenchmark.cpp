@@ -0,0 +1,296 @@
+/*
+Benchmark and quality test of MipmapGenerator (Source/MipmapGenerator.hpp), used by Texture to generate
+mipmaps of 8-bit RGBA textures.
+
+Measures throughput of generating the full mip chain of a synthetic image, with each combination of flags,
+in megapixels of level 0 per second.
+
+Then compares levels of images of many sizes, including odd and 1-pixel wide ones, with a reference
+implementation written for clarity: every destination pixel is the average of the area of the previous
+level it covers, calculated in double precision with exact sRGB conversion. Also checks that the average
+of every level stays the same as of level 0, which fails when an edge row or column is dropped.
+Exit code is 1 if any level differs by more than 1 from the reference or the average drifts.
+
+Usage:
+    MipmapGeneratorBenchmark [-s Size] [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -pthread -o MipmapGeneratorBenchmark \
+        Tools/MipmapGeneratorBenchmark/MipmapGeneratorBenchmark.cpp Source/MipmapGenerator.cpp
+Add -mavx2 to measure the AVX2 path.
+*/
+
+#include "../../Source/MipmapGenerator.hpp"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Maximum difference of an 8-bit value from the reference. The generator uses lookup tables for sRGB.
+static const int MAX_DIFFERENCE = 1;
+// Maximum difference of the average of a level from the average of level 0, in 8-bit units.
+static const double MAX_AVERAGE_DRIFT = 0.75;
+
+struct FlagsInfo
+{
+    uint32_t m_Flags;
+    const char* m_Name;
+};
+
+static const FlagsInfo FLAGS[] = {
+    {0, "Linear"},
+    {MipmapGenerator::FLAG_SRGB, "sRGB"},
+    {MipmapGenerator::FLAG_NORMAL_MAP, "Normal map"},
+    {MipmapGenerator::FLAG_SRGB | MipmapGenerator::FLAG_PRESERVE_ALPHA_COVERAGE, "sRGB, alpha coverage"},
+};
+
+// Full mip chain with levels in separate buffers.
+class MipChain
+{
+public:
+    std::vector<std::vector<uint8_t>> m_Buffers;
+    std::vector<MipmapGenerator::Level> m_Levels;
+
+    MipChain(uint32_t width, uint32_t height)
+    {
+        for(;;)
+        {
+            m_Buffers.emplace_back((size_t)width * height * 4);
+            m_Levels.push_back({m_Buffers.back().data(), width, height, (size_t)width * 4});
+            if(width == 1 && height == 1)
+                break;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+};
+
+// Smooth gradients with noise and sharp edges. Alpha has cutouts, like foliage.
+static void FillTestImage(const MipmapGenerator::Level& level, uint32_t seed)
+{
+    std::mt19937 rand(seed);
+    std::uniform_int_distribution<int> noise(-20, 20);
+    for(uint32_t y = 0; y < level.m_Height; ++y)
+    {
+        for(uint32_t x = 0; x < level.m_Width; ++x)
+        {
+            uint8_t* const pixel = level.m_Pixels + y * level.m_RowPitch + x * 4;
+            const float u = (float)x / (float)level.m_Width, v = (float)y / (float)level.m_Height;
+            const bool cell = ((x / 8) + (y / 8)) % 2 != 0;
+            const float values[4] = {
+                128.f + 100.f * std::sin(u * 9.f),
+                cell ? 220.f * v : 30.f + 160.f * u,
+                128.f + 100.f * std::cos((u + v) * 7.f),
+                cell ? 255.f : 100.f * u};
+            for(uint32_t c = 0; c < 4; ++c)
+                pixel[c] = (uint8_t)std::clamp((int)values[c] + noise(rand), 0, 255);
+        }
+    }
+}
+
+static double SRGBToLinear(double v)
+{
+    return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double LinearToSRGB(double v)
+{
+    return v <= 0.0031308 ? v * 12.92 : std::pow(v, 1.0 / 2.4) * 1.055 - 0.055;
+}
+
+// Weight of every source pixel along one axis for destination pixel dstIndex: length of overlap
+// of intervals they cover, in units of the source, divided by the length covered by the destination pixel.
+static void CalculateReferenceWeights(uint32_t srcSize, uint32_t dstSize, uint32_t dstIndex, std::vector<double>& outWeights)
+{
+    outWeights.assign(srcSize, 0.0);
+    const double scale = (double)srcSize / (double)dstSize;
+    const double begin = dstIndex * scale, end = (dstIndex + 1) * scale;
+    for(uint32_t i = 0; i < srcSize; ++i)
+    {
+        const double overlap = std::min(end, (double)(i + 1)) - std::max(begin, (double)i);
+        if(overlap > 0.0)
+            outWeights[i] = overlap / scale;
+    }
+}
+
+// Generates levels 1.. of chain from level 0, without alpha coverage.
+static void GenerateReference(uint32_t flags, MipChain& chain)
+{
+    const bool sRGB = (flags & MipmapGenerator::FLAG_SRGB) != 0;
+    const MipmapGenerator::Level& level0 = chain.m_Levels[0];
+    std::vector<double> src((size_t)level0.m_Width * level0.m_Height * 4);
+    for(size_t i = 0; i < src.size(); ++i)
+    {
+        const double value = level0.m_Pixels[i] / 255.0;
+        src[i] = sRGB && i % 4 != 3 ? SRGBToLinear(value) : value;
+    }
+
+    std::vector<double> weightsX, weightsY, dst;
+    for(size_t levelIndex = 1; levelIndex < chain.m_Levels.size(); ++levelIndex)
+    {
+        const MipmapGenerator::Level& srcLevel = chain.m_Levels[levelIndex - 1];
+        const MipmapGenerator::Level& dstLevel = chain.m_Levels[levelIndex];
+        dst.assign((size_t)dstLevel.m_Width * dstLevel.m_Height * 4, 0.0);
+        for(uint32_t y = 0; y < dstLevel.m_Height; ++y)
+        {
+            CalculateReferenceWeights(srcLevel.m_Height, dstLevel.m_Height, y, weightsY);
+            for(uint32_t x = 0; x < dstLevel.m_Width; ++x)
+            {
+                CalculateReferenceWeights(srcLevel.m_Width, dstLevel.m_Width, x, weightsX);
+                double* const dstPixel = &dst[((size_t)y * dstLevel.m_Width + x) * 4];
+                for(uint32_t srcY = 0; srcY < srcLevel.m_Height; ++srcY)
+                {
+                    for(uint32_t srcX = 0; srcX < srcLevel.m_Width; ++srcX)
+                    {
+                        const double weight = weightsY[srcY] * weightsX[srcX];
+                        if(weight == 0.0)
+                            continue;
+                        const double* const srcPixel = &src[((size_t)srcY * srcLevel.m_Width + srcX) * 4];
+                        for(uint32_t c = 0; c < 4; ++c)
+                            dstPixel[c] += srcPixel[c] * weight;
+                    }
+                }
+                if((flags & MipmapGenerator::FLAG_NORMAL_MAP) != 0)
+                {
+                    double n[3];
+                    for(uint32_t c = 0; c < 3; ++c)
+                        n[c] = dstPixel[c] * 2.0 - 1.0;
+                    const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for(uint32_t c = 0; c < 3; ++c)
+                        dstPixel[c] = length > 0.0 ? n[c] / length * 0.5 + 0.5 : (c == 2 ? 1.0 : 0.5);
+                }
+            }
+        }
+
+        for(size_t i = 0; i < dst.size(); ++i)
+        {
+            double value = std::clamp(dst[i], 0.0, 1.0);
+            if(sRGB && i % 4 != 3)
+                value = LinearToSRGB(value);
+            dstLevel.m_Pixels[i] = (uint8_t)(value * 255.0 + 0.5);
+        }
+        std::swap(src, dst);
+    }
+}
+
+static double CalculateAverage(const MipmapGenerator::Level& level)
+{
+    double sum = 0.0;
+    const size_t valueCount = (size_t)level.m_Width * level.m_Height * 4;
+    for(size_t i = 0; i < valueCount; ++i)
+        sum += level.m_Pixels[i];
+    return sum / (double)valueCount;
+}
+
+// Returns false if any level differs from the reference too much.
+static bool TestQuality(uint32_t width, uint32_t height, uint32_t flags)
+{
+    MipChain chain(width, height), reference(width, height);
+    FillTestImage(chain.m_Levels[0], width * 7919 + height);
+    memcpy(reference.m_Buffers[0].data(), chain.m_Buffers[0].data(), chain.m_Buffers[0].size());
+    MipmapGenerator(flags).Generate(chain.m_Levels);
+    GenerateReference(flags, reference);
+
+    bool success = true;
+    const double average0 = CalculateAverage(chain.m_Levels[0]);
+    for(size_t levelIndex = 1; levelIndex < chain.m_Levels.size(); ++levelIndex)
+    {
+        const std::vector<uint8_t>& pixels = chain.m_Buffers[levelIndex];
+        const std::vector<uint8_t>& referencePixels = reference.m_Buffers[levelIndex];
+        int maxDifference = 0;
+        for(size_t i = 0; i < pixels.size(); ++i)
+            maxDifference = std::max(maxDifference, std::abs((int)pixels[i] - (int)referencePixels[i]));
+        if(maxDifference > MAX_DIFFERENCE)
+        {
+            fprintf(stderr, "%ux%u flags 0x%X level %zu: differs from reference by %d.\n",
+                width, height, flags, levelIndex, maxDifference);
+            success = false;
+        }
+        // Averages are preserved in linear space only.
+        const double averageDrift = std::fabs(CalculateAverage(chain.m_Levels[levelIndex]) - average0);
+        if(flags == 0 && averageDrift > MAX_AVERAGE_DRIFT)
+        {
+            fprintf(stderr, "%ux%u level %zu: average differs from level 0 by %.2f.\n",
+                width, height, levelIndex, averageDrift);
+            success = false;
+        }
+    }
+    return success;
+}
+
+// Image black except the last column, 5 pixels wide: level 1 must not lose it.
+static bool TestLastColumn()
+{
+    MipChain chain(5, 5);
+    const MipmapGenerator::Level& level0 = chain.m_Levels[0];
+    for(uint32_t y = 0; y < level0.m_Height; ++y)
+        memset(level0.m_Pixels + y * level0.m_RowPitch + 4 * 4, 255, 4);
+    MipmapGenerator(0).Generate(chain.m_Levels);
+    // 2x2: right column covers source columns 2.5..5, so the last one has weight 2/5.
+    const uint8_t right = chain.m_Levels[1].m_Pixels[4];
+    if(right != 102 || chain.m_Levels[1].m_Pixels[0] != 0)
+    {
+        fprintf(stderr, "5x5 with white last column: level 1 is %u, %u, expected 0, 102.\n",
+            chain.m_Levels[1].m_Pixels[0], right);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 2048;
+    uint32_t iterations = 4;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            size = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: MipmapGeneratorBenchmark [-s Size] [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(size < 2 || iterations == 0)
+    {
+        fprintf(stderr, "Size must be at least 2 and iterations at least 1.\n");
+        return 2;
+    }
+
+    MipChain chain(size, size);
+    FillTestImage(chain.m_Levels[0], 42);
+    printf("Image: %ux%u, %zu levels, iterations: %u\n", size, size, chain.m_Levels.size(), iterations);
+    printf("%-24s %10s %10s\n", "Flags", "ms", "MP/s");
+    for(const FlagsInfo& info : FLAGS)
+    {
+        MipmapGenerator generator(info.m_Flags);
+        generator.Generate(chain.m_Levels); // Warm-up
+        const Clock::time_point beginTime = Clock::now();
+        for(uint32_t i = 0; i < iterations; ++i)
+            generator.Generate(chain.m_Levels);
+        const double seconds = std::chrono::duration<double>(Clock::now() - beginTime).count() / iterations;
+        printf("%-24s %10.2f %10.1f\n", info.m_Name, seconds * 1e3, (double)size * size / seconds * 1e-6);
+    }
+
+    static const uint32_t QUALITY_SIZES[][2] = {
+        {2, 2}, {3, 3}, {5, 5}, {7, 3}, {1, 9}, {9, 1}, {6, 10}, {64, 64}, {127, 65}, {255, 129}, {333, 200}};
+    bool success = TestLastColumn();
+    for(const auto& qualitySize : QUALITY_SIZES)
+    {
+        for(const FlagsInfo& info : FLAGS)
+        {
+            if((info.m_Flags & MipmapGenerator::FLAG_PRESERVE_ALPHA_COVERAGE) == 0)
+                success = TestQuality(qualitySize[0], qualitySize[1], info.m_Flags) && success;
+        }
+    }
+    printf("Quality against reference: %s\n", success ? "passed" : "FAILED");
+    return success ? 0 : 1;
+}
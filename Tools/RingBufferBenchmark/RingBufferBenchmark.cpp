@@ -0,0 +1,146 @@
+/*
+Benchmark of scaling of ConcurrentMultiFrameRingBuffer (Source/MultiFrameRingBuffer.hpp) with the number of threads.
+
+Every thread allocates AllocationsPerFrame blocks of 256 units per frame, like temporary constant buffers
+recorded by parallel command lists, then all threads wait for NewFrame. Compares allocations per second of:
+- Mutex: MultiFrameRingBuffer guarded by std::mutex, like a single shared allocator,
+- Atomic: ConcurrentMultiFrameRingBuffer with chunks of one block, so every allocation is a fetch-add
+  on the shared front,
+- Chunked: ConcurrentMultiFrameRingBuffer with chunks of 16 blocks served from the thread cache,
+  like ConstantBufferManager uses it.
+Every allocation is checked to succeed and be aligned. Correctness under contention is tested
+by Tools/RingBufferStressTest.
+
+Usage:
+    RingBufferBenchmark [-t MaxThreadCount] [-f FrameCount] [-a AllocationsPerFrame]
+
+Thread counts are powers of 2 from 1 up to MaxThreadCount, by default 32.
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o RingBufferBenchmark Tools/RingBufferBenchmark/RingBufferBenchmark.cpp -lpthread
+*/
+
+#include "../../Source/MultiFrameRingBuffer.hpp"
+#include <vector>
+#include <thread>
+#include <barrier>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static const uint32_t BLOCK_SIZE = 256;
+static const uint32_t FRAME_COUNT = 3;
+
+class MutexRingBuffer
+{
+public:
+    void Init(uint32_t capacity, uint32_t frameCount, uint32_t)
+    {
+        m_RingBuffer.Init(capacity, frameCount);
+    }
+    void NewFrame() { m_RingBuffer.NewFrame(); }
+    bool Allocate(uint32_t size, uint32_t& outOffset)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_RingBuffer.Allocate(size, outOffset);
+    }
+
+private:
+    std::mutex m_Mutex;
+    MultiFrameRingBuffer<uint32_t> m_RingBuffer;
+};
+
+struct Params
+{
+    uint32_t m_MaxThreadCount = 32;
+    uint32_t m_FrameCount = 200;
+    uint32_t m_AllocationsPerFrame = 2000;
+};
+
+// Returns millions of allocations per second, or 0 if any allocation failed.
+template<typename RingBuffer>
+static double Run(const Params& params, uint32_t threadCount, uint32_t chunkSize)
+{
+    // Fits all allocations of FRAME_COUNT frames, including unused rest of chunks.
+    const uint64_t capacity = (uint64_t)threadCount * (params.m_AllocationsPerFrame * BLOCK_SIZE + chunkSize) *
+        (FRAME_COUNT + 1);
+    if(capacity > UINT32_MAX)
+        return 0.;
+    RingBuffer ringBuffer;
+    ringBuffer.Init((uint32_t)capacity, FRAME_COUNT, chunkSize);
+
+    std::atomic<bool> failed = false;
+    std::barrier frameBarrier((ptrdiff_t)threadCount, [&]() noexcept { ringBuffer.NewFrame(); });
+    auto threadMain = [&]()
+    {
+        for(uint32_t frame = 0; frame < params.m_FrameCount; ++frame)
+        {
+            for(uint32_t i = 0; i < params.m_AllocationsPerFrame; ++i)
+            {
+                uint32_t offset = 0;
+                if(!ringBuffer.Allocate(BLOCK_SIZE, offset) || offset % BLOCK_SIZE != 0)
+                    failed = true;
+            }
+            frameBarrier.arrive_and_wait();
+        }
+    };
+
+    const auto beginTime = Clock::now();
+    std::vector<std::thread> threads;
+    for(uint32_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(threadMain);
+    threadMain();
+    for(std::thread& thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(Clock::now() - beginTime).count();
+    if(failed)
+        return 0.;
+    return (double)threadCount * params.m_FrameCount * params.m_AllocationsPerFrame / seconds * 1e-6;
+}
+
+int main(int argc, char** argv)
+{
+    Params params;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            params.m_MaxThreadCount = (uint32_t)atoi(argv[++i]);
+        else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            params.m_FrameCount = (uint32_t)atoi(argv[++i]);
+        else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            params.m_AllocationsPerFrame = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: RingBufferBenchmark [-t MaxThreadCount] [-f FrameCount] [-a AllocationsPerFrame]\n");
+            return 2;
+        }
+    }
+    if(params.m_MaxThreadCount == 0 || params.m_FrameCount == 0 || params.m_AllocationsPerFrame == 0)
+    {
+        fprintf(stderr, "MaxThreadCount, FrameCount and AllocationsPerFrame must be at least 1.\n");
+        return 2;
+    }
+
+    printf("Frames: %u, allocations per thread per frame: %u, hardware threads: %u\n",
+        params.m_FrameCount, params.m_AllocationsPerFrame, std::thread::hardware_concurrency());
+    printf("%8s %16s %16s %16s\n", "Threads", "Mutex M/s", "Atomic M/s", "Chunked M/s");
+    bool failed = false;
+    for(uint32_t threadCount = 1; threadCount <= params.m_MaxThreadCount; threadCount *= 2)
+    {
+        const double mutexRate = Run<MutexRingBuffer>(params, threadCount, BLOCK_SIZE);
+        const double atomicRate = Run<ConcurrentMultiFrameRingBuffer<uint32_t>>(params, threadCount, BLOCK_SIZE);
+        const double chunkedRate = Run<ConcurrentMultiFrameRingBuffer<uint32_t>>(params, threadCount, 16 * BLOCK_SIZE);
+        printf("%8u %16.1f %16.1f %16.1f\n", threadCount, mutexRate, atomicRate, chunkedRate);
+        failed = failed || mutexRate == 0. || atomicRate == 0. || chunkedRate == 0.;
+    }
+    if(failed)
+    {
+        fprintf(stderr, "Some allocations failed.\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+Stress test of ConcurrentMultiFrameRingBuffer (Source/MultiFrameRingBuffer.hpp), which ConstantBufferManager
+and DescriptorManager use for temporary constant buffers and descriptors allocated by many threads.
+
+Threads allocate blocks of random sizes, small ones served from thread chunks and ones larger than a chunk,
+and fill them with a tag. Between frames, like the engine calls NewFrame after all recording threads finished,
+all blocks of the last FrameCount frames are checked:
+- offsets are aligned and in range, blocks don't cross the end of the buffer,
+- no two live blocks overlap, and each still holds its tag, so nothing was overwritten before it was retired,
+- GetLastFrameSize covers all blocks of the frame.
+Scenarios: frames that fit, frames that run out of space - where Allocate must fail, not corrupt anything,
+and the buffer must recover in the next frames - and Reset to a different capacity in the middle.
+
+Usage:
+    RingBufferStressTest [-t ThreadCount] [-f FrameCount]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o RingBufferStressTest Tools/RingBufferStressTest/RingBufferStressTest.cpp -lpthread
+*/
+
+#include "../../Source/MultiFrameRingBuffer.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <thread>
+#include <barrier>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Like ConstantBufferManager: units are bytes, offsets aligned to 256, chunks of 16 * 256.
+static const uint32_t ALIGNMENT = 256;
+static const uint32_t CHUNK_SIZE = 16 * ALIGNMENT;
+static const uint32_t FRAME_COUNT = 3;
+// Tag is written every this many units, and to the last unit of a block.
+static const uint32_t TAG_STRIDE = 64;
+
+struct Block
+{
+    uint32_t m_Offset;
+    uint32_t m_Size;
+    uint32_t m_Tag;
+};
+
+class StressTest
+{
+public:
+    StressTest(uint32_t threadCount, uint32_t capacity) :
+        m_ThreadCount(threadCount),
+        m_Memory(capacity),
+        m_ThreadBlocks(threadCount),
+        m_ThreadFailureCounts(threadCount)
+    {
+        m_RingBuffer.Init(capacity, FRAME_COUNT, CHUNK_SIZE);
+    }
+
+    /*
+    Runs frameCount frames, in each every thread allocates blocks of total size of about demandPerFrame / threadCount.
+    Returns number of failed allocations.
+    */
+    uint64_t Run(uint32_t frameCount, uint64_t demandPerFrame)
+    {
+        m_DemandPerThread = demandPerFrame / m_ThreadCount;
+        uint64_t failureCount = 0;
+        // Called by one thread when all of them finished the frame, like NewFrame between frames in the engine.
+        auto endFrame = [&]() noexcept
+        {
+            for(uint64_t count : m_ThreadFailureCounts)
+                failureCount += count;
+            EndFrame();
+        };
+        std::barrier frameBarrier((ptrdiff_t)m_ThreadCount, endFrame);
+        auto threadMain = [&](uint32_t threadIndex)
+        {
+            for(uint32_t frame = 0; frame < frameCount; ++frame)
+            {
+                AllocateFrame(threadIndex);
+                frameBarrier.arrive_and_wait();
+            }
+        };
+        std::vector<std::thread> threads;
+        for(uint32_t i = 1; i < m_ThreadCount; ++i)
+            threads.emplace_back(threadMain, i);
+        threadMain(0);
+        for(std::thread& thread : threads)
+            thread.join();
+        return failureCount;
+    }
+
+    // Between runs, when no thread allocates, like NewFrame.
+    void Reset(uint32_t capacity)
+    {
+        m_RingBuffer.Reset(capacity);
+        m_Memory.assign(capacity, 0);
+        for(std::vector<Block>& blocks : m_FrameBlocks)
+            blocks.clear();
+    }
+
+    uint32_t GetCapacity() const { return m_RingBuffer.GetCapacity(); }
+
+private:
+    const uint32_t m_ThreadCount;
+    ConcurrentMultiFrameRingBuffer<uint32_t> m_RingBuffer;
+    // Tag of the block each unit belongs to, written sparsely.
+    std::vector<uint32_t> m_Memory;
+    uint64_t m_DemandPerThread = 0;
+    uint32_t m_FrameNumber = 0;
+    std::vector<std::vector<Block>> m_ThreadBlocks;
+    std::vector<uint64_t> m_ThreadFailureCounts;
+    // Blocks of the last FRAME_COUNT frames, indexed by frame number % FRAME_COUNT.
+    std::vector<Block> m_FrameBlocks[FRAME_COUNT];
+
+    void AllocateFrame(uint32_t threadIndex)
+    {
+        std::vector<Block>& blocks = m_ThreadBlocks[threadIndex];
+        blocks.clear();
+        m_ThreadFailureCounts[threadIndex] = 0;
+        std::mt19937 rand(m_FrameNumber * 1000 + threadIndex);
+        // Unique for every block of the last frames: frame number, thread, block.
+        uint32_t tag = (m_FrameNumber % 1024) << 22 | threadIndex << 16;
+        for(uint64_t demand = 0; ; )
+        {
+            // Mostly small, like constant buffers, some larger than a chunk.
+            const uint32_t units = rand() % 8 == 0 ? rand() % 80 + 1 : rand() % 4 + 1;
+            const uint32_t size = units * ALIGNMENT;
+            demand += size;
+            if(demand > m_DemandPerThread)
+                break;
+            uint32_t offset = 0;
+            if(!m_RingBuffer.Allocate(size, offset))
+            {
+                ++m_ThreadFailureCounts[threadIndex];
+                continue;
+            }
+            // Out-of-range block would write out of m_Memory. It is checked again in EndFrame.
+            if(offset % ALIGNMENT != 0 || (uint64_t)offset + size > m_Memory.size())
+            {
+                blocks.push_back({offset, size, 0});
+                break;
+            }
+            ++tag;
+            for(uint32_t i = 0; i < size; i += TAG_STRIDE)
+                m_Memory[offset + i] = tag;
+            m_Memory[offset + size - 1] = tag;
+            blocks.push_back({offset, size, tag});
+        }
+    }
+
+    void EndFrame()
+    {
+        std::vector<Block>& frameBlocks = m_FrameBlocks[m_FrameNumber % FRAME_COUNT];
+        frameBlocks.clear();
+        for(const std::vector<Block>& blocks : m_ThreadBlocks)
+            frameBlocks.insert(frameBlocks.end(), blocks.begin(), blocks.end());
+        m_RingBuffer.NewFrame();
+        ++m_FrameNumber;
+
+        uint64_t frameSize = 0;
+        for(const Block& block : frameBlocks)
+            frameSize += block.m_Size;
+        TEST(m_RingBuffer.GetLastFrameSize() >= frameSize);
+
+        std::vector<Block> liveBlocks;
+        for(const std::vector<Block>& blocks : m_FrameBlocks)
+            liveBlocks.insert(liveBlocks.end(), blocks.begin(), blocks.end());
+        const uint32_t failureCountBefore = g_FailureCount;
+        for(const Block& block : liveBlocks)
+        {
+            TEST(block.m_Offset % ALIGNMENT == 0);
+            TEST((uint64_t)block.m_Offset + block.m_Size <= m_RingBuffer.GetCapacity());
+            TEST(block.m_Tag != 0);
+            if(block.m_Tag == 0)
+                continue;
+            bool intact = m_Memory[block.m_Offset + block.m_Size - 1] == block.m_Tag;
+            for(uint32_t i = 0; i < block.m_Size; i += TAG_STRIDE)
+                intact = intact && m_Memory[block.m_Offset + i] == block.m_Tag;
+            TEST(intact);
+        }
+        std::sort(liveBlocks.begin(), liveBlocks.end(), [](const Block& lhs, const Block& rhs)
+        {
+            return lhs.m_Offset < rhs.m_Offset;
+        });
+        for(size_t i = 1; i < liveBlocks.size(); ++i)
+            TEST(liveBlocks[i - 1].m_Offset + liveBlocks[i - 1].m_Size <= liveBlocks[i].m_Offset);
+        if(g_FailureCount != failureCountBefore)
+        {
+            fprintf(stderr, "Frame %u failed.\n", m_FrameNumber);
+            exit(1);
+        }
+    }
+};
+
+int main(int argc, char** argv)
+{
+    uint32_t threadCount = 16;
+    uint32_t frameCount = 1000;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threadCount = (uint32_t)atoi(argv[++i]);
+        else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            frameCount = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: RingBufferStressTest [-t ThreadCount] [-f FrameCount]\n");
+            return 2;
+        }
+    }
+    if(threadCount == 0 || threadCount > 64 || frameCount == 0)
+    {
+        fprintf(stderr, "ThreadCount must be 1...64, FrameCount at least 1.\n");
+        return 2;
+    }
+
+    // Not a multiple of CHUNK_SIZE, which Init rounds down.
+    const uint32_t capacity = 4 * 1024 * 1024 + 1000;
+    StressTest test(threadCount, capacity);
+    TEST(test.GetCapacity() % CHUNK_SIZE == 0 && test.GetCapacity() > capacity - CHUNK_SIZE);
+    const uint64_t framePart = test.GetCapacity() / FRAME_COUNT;
+
+    // Half of the space of a frame: leaves enough for unused rest of chunks and wasted space at the end.
+    uint64_t failureCount = test.Run(frameCount, framePart / 2);
+    printf("Fitting frames: %llu failed allocations.\n", (unsigned long long)failureCount);
+    TEST(failureCount == 0);
+
+    // Twice the space of a frame: allocations must fail, without corrupting anything.
+    failureCount = test.Run(frameCount / 4 + 1, framePart * 2);
+    printf("Overflowing frames: %llu failed allocations.\n", (unsigned long long)failureCount);
+    TEST(failureCount > 0);
+
+    // Once the overflowing frames are retired, frames that fit succeed again.
+    test.Run(FRAME_COUNT, framePart / 2);
+    failureCount = test.Run(frameCount / 4 + 1, framePart / 2);
+    TEST(failureCount == 0);
+
+    // Smaller capacity after Reset.
+    test.Reset(capacity / 2);
+    failureCount = test.Run(frameCount / 4 + 1, test.GetCapacity() / FRAME_COUNT / 2);
+    printf("After reset to half: %llu failed allocations.\n", (unsigned long long)failureCount);
+    TEST(failureCount == 0);
+
+    return ReportTestResults();
+}
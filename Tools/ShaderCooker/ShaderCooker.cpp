@@ -0,0 +1,341 @@
+/*
+Offline shader cooker.
+
+Compiles all permutations of all standard shaders (see GetStandardShaderDesc in Source/ShaderCommon.hpp)
+in parallel and writes them into a cooked shader pack, which the engine loads at startup from setting
+"Shaders.CookedPackPath", so it doesn't need to compile them.
+
+Uses the same arguments and keys as the engine, with "Shaders.ExtraParameters" and "Shaders.EmbedDebugInformation"
+taken from LoadSettings.json. Shaders whose sources or settings changed after cooking just don't match any key
+and are compiled by the engine as usual. Keys hash source files with CR LF line endings hashed as LF,
+so a pack cooked from a checkout with different line endings than the one the engine runs from still matches.
+
+Usage, from WorkingDir:
+    ShaderCooker [-s LoadSettings.json] [-o Shaders/Cooked.pack] [-j ThreadCount]
+Exit code is 0 only if all shaders compiled successfully.
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, which links DXC from ThirdParty/dxc_2021_12_08 on Windows
+and finds it on Linux. Or on Linux, with the DXC release package extracted to $DXC:
+    g++ -std=c++20 -O2 -I$DXC/include -o ShaderCooker Tools/ShaderCooker/ShaderCooker.cpp Source/ShaderCommon.cpp \
+        -L$DXC/lib -ldxcompiler -lpthread
+*/
+
+#include "../../Source/ShaderCommon.hpp"
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cassert>
+#include "../../Source/ParallelFor.hpp"
+#include "../../ThirdParty/rapidjson/include/rapidjson/document.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <Windows.h>
+    #include "../../ThirdParty/dxc_2021_12_08/inc/dxcapi.h"
+#else
+    #include <dxc/dxcapi.h>
+#endif
+
+static constexpr uint32_t CODE_PAGE = DXC_CP_UTF8;
+
+struct Options
+{
+    std::filesystem::path m_SettingsPath = "LoadSettings.json";
+    std::filesystem::path m_OutputPath = "Shaders/Cooked.pack";
+    uint32_t m_ThreadCount = 0;
+    // From the settings file.
+    std::vector<std::wstring> m_ExtraParameters;
+    bool m_EmbedDebugInformation = false;
+};
+
+// Minimal owning pointer to a COM object, as ComPtr is not available on Linux.
+template<typename T>
+class DxcPtr
+{
+public:
+    DxcPtr() = default;
+    ~DxcPtr() { if(m_Ptr) m_Ptr->Release(); }
+    DxcPtr(const DxcPtr&) = delete;
+    DxcPtr& operator=(const DxcPtr&) = delete;
+    T* Get() const { return m_Ptr; }
+    T* operator->() const { return m_Ptr; }
+    T** operator&() { assert(!m_Ptr); return &m_Ptr; }
+
+private:
+    T* m_Ptr = nullptr;
+};
+
+static bool LoadFile(const std::filesystem::path& path, std::vector<char>& outContents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+    outContents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+static std::wstring Utf8ToWide(std::string_view str)
+{
+    // Setting values are plain ASCII compiler arguments.
+    return std::wstring(str.begin(), str.end());
+}
+
+static std::string WideToUtf8(std::wstring_view str)
+{
+    std::string result;
+    for(wchar_t ch : str)
+        result += ch < 0x80 ? (char)ch : '?';
+    return result;
+}
+
+static bool LoadSettings(Options& inoutOptions)
+{
+    std::vector<char> contents;
+    if(!LoadFile(inoutOptions.m_SettingsPath, contents))
+    {
+        std::cerr << "Cannot load settings file \"" << inoutOptions.m_SettingsPath.string() << "\".\n";
+        return false;
+    }
+    contents.push_back(0);
+
+    using namespace rapidjson;
+    // Same flags as Settings.cpp in the engine.
+    Document doc;
+    doc.Parse<kParseCommentsFlag | kParseTrailingCommasFlag | kParseNanAndInfFlag | kParseValidateEncodingFlag>(
+        contents.data());
+    if(doc.HasParseError() || !doc.IsObject())
+    {
+        std::cerr << "Cannot parse settings file \"" << inoutOptions.m_SettingsPath.string() << "\".\n";
+        return false;
+    }
+
+    const auto extraParamsIt = doc.FindMember("Shaders.ExtraParameters");
+    if(extraParamsIt != doc.MemberEnd() && extraParamsIt->value.IsArray())
+    {
+        for(const Value& param : extraParamsIt->value.GetArray())
+        {
+            if(param.IsString())
+                inoutOptions.m_ExtraParameters.push_back(Utf8ToWide(param.GetString()));
+        }
+    }
+    const auto embedDebugIt = doc.FindMember("Shaders.EmbedDebugInformation");
+    if(embedDebugIt != doc.MemberEnd() && embedDebugIt->value.IsBool())
+        inoutOptions.m_EmbedDebugInformation = embedDebugIt->value.GetBool();
+    return true;
+}
+
+static bool ParseCommandLine(int argc, char** argv, Options& outOptions)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if(i + 1 < argc && arg == "-s")
+            outOptions.m_SettingsPath = argv[++i];
+        else if(i + 1 < argc && arg == "-o")
+            outOptions.m_OutputPath = argv[++i];
+        else if(i + 1 < argc && arg == "-j")
+            outOptions.m_ThreadCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: ShaderCooker [-s LoadSettings.json] [-o Shaders/Cooked.pack] [-j ThreadCount]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Resolves includes relative to the main file, like IncludeHandler in the engine.
+class IncludeHandler : public IDxcIncludeHandler
+{
+public:
+    IncludeHandler(IDxcUtils* utils, const std::filesystem::path& dir) :
+        m_Utils(utils),
+        m_Directory(dir)
+    {
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override { return E_FAIL; }
+    ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+    ULONG STDMETHODCALLTYPE Release() override { return 0; }
+
+    HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+    {
+        *ppIncludeSource = nullptr;
+        std::vector<char> contents;
+        if(!LoadFile(m_Directory / pFilename, contents))
+            return E_FAIL;
+        DxcPtr<IDxcBlobEncoding> blobEncoding;
+        HRESULT hr = m_Utils->CreateBlob(contents.data(), (uint32_t)contents.size(), CODE_PAGE, &blobEncoding);
+        if(SUCCEEDED(hr))
+            hr = blobEncoding->QueryInterface(__uuidof(IDxcBlob), (void**)ppIncludeSource);
+        return hr;
+    }
+
+private:
+    IDxcUtils* const m_Utils;
+    const std::filesystem::path m_Directory;
+};
+
+struct Job
+{
+    const ShaderDesc* m_Desc;
+    uint32_t m_PermutationIndex;
+    // Filled by CompileJob.
+    uint64_t m_Key = 0;
+    std::vector<char> m_Code;
+    std::string m_Errors;
+};
+
+static bool CompileJob(const Options& options, Job& job)
+{
+    // DXC objects must not be used from multiple threads at once, like in the engine.
+    thread_local DxcPtr<IDxcUtils> utils;
+    thread_local DxcPtr<IDxcCompiler3> compiler;
+    if((!utils.Get() && FAILED(DxcCreateInstance(CLSID_DxcUtils, __uuidof(IDxcUtils), (void**)&utils))) ||
+        (!compiler.Get() && FAILED(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler3), (void**)&compiler))))
+    {
+        job.m_Errors = "Cannot initialize shader compiler.";
+        return false;
+    }
+
+    const ShaderDesc& desc = *job.m_Desc;
+    const std::filesystem::path filePath = desc.m_FilePath;
+    const std::filesystem::path dir = filePath.parent_path();
+    std::vector<char> source;
+    if(!LoadFile(filePath, source) || source.empty())
+    {
+        job.m_Errors = "Cannot load source file.";
+        return false;
+    }
+
+    std::vector<uint32_t> macroValues(desc.m_MacroNames.size());
+    desc.GetMacroValues(job.m_PermutationIndex, macroValues);
+    const std::vector<std::wstring> macroNames(desc.m_MacroNames.begin(), desc.m_MacroNames.end());
+    std::vector<std::wstring> argumentStrings;
+    BuildShaderArguments(desc.m_Type, desc.m_EntryPointName, options.m_ExtraParameters,
+        options.m_EmbedDebugInformation, macroNames, macroValues, argumentStrings);
+    std::vector<LPCWSTR> arguments(argumentStrings.size());
+    for(size_t i = 0; i < argumentStrings.size(); ++i)
+        arguments[i] = argumentStrings[i].c_str();
+
+    std::vector<std::filesystem::path> includes;
+    job.m_Key = CalculateShaderKey(source, dir, argumentStrings, LoadFile, includes);
+
+    const DxcBuffer sourceDxcBuffer = {
+        .Ptr = source.data(),
+        .Size = source.size(),
+        .Encoding = CODE_PAGE};
+    IncludeHandler includeHandler(utils.Get(), dir);
+    DxcPtr<IDxcResult> result;
+    HRESULT compilationResult = E_FAIL;
+    if(FAILED(compiler->Compile(&sourceDxcBuffer, arguments.data(), (uint32_t)arguments.size(), &includeHandler,
+            __uuidof(IDxcResult), (void**)&result)) ||
+        !result.Get() || FAILED(result->GetStatus(&compilationResult)))
+    {
+        job.m_Errors = "Compiler failed.";
+        return false;
+    }
+
+    DxcPtr<IDxcBlobEncoding> errors;
+    // Intentionally ignoring result.
+    result->GetErrorBuffer(&errors);
+    if(errors.Get() && errors->GetBufferSize() > 0)
+    {
+        job.m_Errors.assign((const char*)errors->GetBufferPointer(), errors->GetBufferSize());
+        // Trim null terminator and trailing whitespaces.
+        while(!job.m_Errors.empty() && (job.m_Errors.back() == 0 || isspace((unsigned char)job.m_Errors.back())))
+            job.m_Errors.pop_back();
+    }
+    if(FAILED(compilationResult))
+        return false;
+
+    DxcPtr<IDxcBlob> code;
+    if(FAILED(result->GetResult(&code)) || !code.Get() || code->GetBufferSize() == 0)
+    {
+        job.m_Errors = "No bytecode.";
+        return false;
+    }
+    const char* const codePtr = (const char*)code->GetBufferPointer();
+    job.m_Code.assign(codePtr, codePtr + code->GetBufferSize());
+    return true;
+}
+
+static std::string JobToStr(const Job& job)
+{
+    const ShaderDesc& desc = *job.m_Desc;
+    std::string result = WideToUtf8(desc.m_FilePath) + " " + WideToUtf8(desc.m_EntryPointName);
+    std::vector<uint32_t> macroValues(desc.m_MacroNames.size());
+    desc.GetMacroValues(job.m_PermutationIndex, macroValues);
+    for(size_t i = 0; i < macroValues.size(); ++i)
+        result += " " + WideToUtf8(desc.m_MacroNames[i]) + "=" + std::to_string(macroValues[i]);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!ParseCommandLine(argc, argv, options) || !LoadSettings(options))
+        return 1;
+
+    std::vector<Job> jobs;
+    for(uint32_t shaderIndex = 0; shaderIndex < (uint32_t)StandardShader::Count; ++shaderIndex)
+    {
+        const ShaderDesc& desc = GetStandardShaderDesc((StandardShader)shaderIndex);
+        const uint32_t permutationCount = desc.GetPermutationCount();
+        for(uint32_t permutationIndex = 0; permutationIndex < permutationCount; ++permutationIndex)
+            jobs.push_back(Job{.m_Desc = &desc, .m_PermutationIndex = permutationIndex});
+    }
+
+    const auto beginTime = std::chrono::steady_clock::now();
+    std::vector<char> succeeded(jobs.size());
+    ParallelFor(jobs.size(), options.m_ThreadCount, [&](size_t jobIndex)
+    {
+        succeeded[jobIndex] = CompileJob(options, jobs[jobIndex]) ? 1 : 0;
+    });
+    const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - beginTime).count();
+
+    // Printed after all jobs finished, so messages of different threads don't interleave.
+    std::vector<std::pair<uint64_t, std::vector<char>>> entries;
+    uint32_t failedCount = 0;
+    for(size_t i = 0; i < jobs.size(); ++i)
+    {
+        Job& job = jobs[i];
+        if(!job.m_Errors.empty())
+            std::cerr << JobToStr(job) << ":\n" << job.m_Errors << "\n";
+        if(!succeeded[i])
+        {
+            std::cerr << "FAILED: " << JobToStr(job) << "\n";
+            ++failedCount;
+            continue;
+        }
+        // Keys are unique unless two descs are identical.
+        if(std::find_if(entries.begin(), entries.end(),
+            [&](const auto& entry) { return entry.first == job.m_Key; }) == entries.end())
+        {
+            entries.push_back({job.m_Key, std::move(job.m_Code)});
+        }
+    }
+
+    std::vector<char> pack;
+    BuildShaderPack(entries, pack);
+    {
+        std::ofstream file(options.m_OutputPath, std::ios::binary | std::ios::trunc);
+        file.write(pack.data(), (std::streamsize)pack.size());
+        if(!file)
+        {
+            std::cerr << "Cannot write \"" << options.m_OutputPath.string() << "\".\n";
+            return 1;
+        }
+    }
+
+    printf("Cooked %zu shaders (%u failed) in %.3f s into \"%s\", %zu bytes.\n",
+        entries.size(), failedCount, seconds, options.m_OutputPath.string().c_str(), pack.size());
+    return failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,249 @@
+/*
+Microbenchmark of the per-draw lookup of a shader permutation.
+
+Compares the dense permutation index of MultiShader, calculated by CalculatePermutationIndex
+(Source/ShaderCommon.hpp) and used to index an array of permutations, with the previous lookup:
+hash of macro values combined with CombineHash, used as the key of std::unordered_map.
+MultiShader itself needs Direct3D 12 headers, so DenseShaders and HashedShaders below stand in for it,
+with the same data as MultiShaderPimpl before and after the change. Also measures the path Renderer takes
+for G-buffer pipeline states: material flags used directly as index of a fixed array.
+
+Macro values are taken from random material flags, like the G-buffer pixel shader with 4 binary macros,
+and a shader with macros of more values. Lookups are also checked for correctness: every combination
+of macro values finds its own permutation, and CalculateMacroValues reverses CalculatePermutationIndex.
+
+Usage:
+    ShaderPermutationBenchmark [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o ShaderPermutationBenchmark \
+        Tools/ShaderPermutationBenchmark/ShaderPermutationBenchmark.cpp Source/ShaderCommon.cpp
+*/
+
+#include "../../Source/ShaderCommon.hpp"
+#include "../Common/TestUtils.hpp"
+#include <unordered_map>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Stands in for Shader, so a lookup reads something from the found object.
+struct FakeShader
+{
+    uint32_t m_PermutationIndex;
+};
+
+// Like MultiShaderPimpl now: permutations in an array indexed by the dense permutation index.
+class DenseShaders
+{
+public:
+    explicit DenseShaders(std::span<const uint32_t> macroValueCounts) :
+        m_MacroValueCounts(macroValueCounts.begin(), macroValueCounts.end())
+    {
+        uint32_t count = 1;
+        for(uint32_t valueCount : macroValueCounts)
+            count *= valueCount;
+        m_Permutations.resize(count);
+        for(uint32_t i = 0; i < count; ++i)
+            m_Permutations[i] = {std::make_unique<FakeShader>(FakeShader{i}), true};
+    }
+    const FakeShader* GetShader(std::span<const uint32_t> macroValues) const
+    {
+        const Permutation& permutation = m_Permutations[CalculatePermutationIndex(m_MacroValueCounts, macroValues)];
+        return permutation.m_Compiled ? permutation.m_Shader.get() : nullptr;
+    }
+
+private:
+    struct Permutation
+    {
+        std::unique_ptr<FakeShader> m_Shader;
+        bool m_Compiled = false;
+    };
+    std::vector<uint32_t> m_MacroValueCounts;
+    std::vector<Permutation> m_Permutations;
+};
+
+// Like MultiShaderPimpl before: permutations in std::unordered_map by hash of macro values.
+class HashedShaders
+{
+public:
+    explicit HashedShaders(std::span<const uint32_t> macroValueCounts)
+    {
+        std::vector<uint32_t> macroValues(macroValueCounts.size());
+        uint32_t count = 1;
+        for(uint32_t valueCount : macroValueCounts)
+            count *= valueCount;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            CalculateMacroValues(macroValueCounts, i, macroValues);
+            m_Shaders.insert({HashMacroValues(macroValues), std::make_unique<FakeShader>(FakeShader{i})});
+        }
+    }
+    const FakeShader* GetShader(std::span<const uint32_t> macroValues) const
+    {
+        const auto it = m_Shaders.find(HashMacroValues(macroValues));
+        return it != m_Shaders.end() ? it->second.get() : nullptr;
+    }
+
+private:
+    std::unordered_map<size_t, std::unique_ptr<FakeShader>> m_Shaders;
+
+    // Same as CombineHash in Source/BaseUtils.hpp.
+    static size_t CombineHash(size_t lhs, size_t rhs)
+    {
+        return lhs ^ (rhs + 0x9e3779b9 + (lhs << 6) + (lhs >> 2));
+    }
+    static size_t HashMacroValues(std::span<const uint32_t> macroValues)
+    {
+        size_t h = 0x262521a102765664llu;
+        for(uint32_t val : macroValues)
+            h = CombineHash(h, val);
+        return h;
+    }
+};
+
+static void TestPermutationIndex(std::span<const uint32_t> macroValueCounts)
+{
+    const DenseShaders dense(macroValueCounts);
+    const HashedShaders hashed(macroValueCounts);
+    std::vector<uint32_t> macroValues(macroValueCounts.size());
+    uint32_t count = 1;
+    for(uint32_t valueCount : macroValueCounts)
+        count *= valueCount;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        CalculateMacroValues(macroValueCounts, i, macroValues);
+        for(size_t macroIndex = 0; macroIndex < macroValues.size(); ++macroIndex)
+            TEST(macroValues[macroIndex] < macroValueCounts[macroIndex]);
+        TEST(CalculatePermutationIndex(macroValueCounts, macroValues) == i);
+        const FakeShader* const denseShader = dense.GetShader(macroValues);
+        const FakeShader* const hashedShader = hashed.GetShader(macroValues);
+        TEST(denseShader && denseShader->m_PermutationIndex == i);
+        TEST(hashedShader && hashedShader->m_PermutationIndex == i);
+    }
+}
+
+template<typename LookupFunc>
+static double Measure(uint64_t iterations, const LookupFunc& lookup)
+{
+    uint64_t sum = 0;
+    const auto beginTime = Clock::now();
+    for(uint64_t i = 0; i < iterations; ++i)
+        sum += lookup(i);
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - beginTime).count() / (double)iterations;
+    // Keeps the loop from being optimized away.
+    if(sum == UINT64_MAX)
+        printf(" ");
+    return ns;
+}
+
+// Lookups of one shader, with macro values taken from a random sequence of permutations.
+static void Benchmark(const char* name, std::span<const uint32_t> macroValueCounts, uint64_t iterations)
+{
+    const DenseShaders dense(macroValueCounts);
+    const HashedShaders hashed(macroValueCounts);
+    uint32_t count = 1;
+    for(uint32_t valueCount : macroValueCounts)
+        count *= valueCount;
+
+    // Like draw calls of materials in random order. Power of 2, so the index is a mask.
+    const size_t SEQUENCE_SIZE = 4096;
+    const size_t macroCount = macroValueCounts.size();
+    std::vector<uint32_t> sequence(SEQUENCE_SIZE * macroCount);
+    std::mt19937 rand(1);
+    for(size_t i = 0; i < SEQUENCE_SIZE; ++i)
+        CalculateMacroValues(macroValueCounts, rand() % count, std::span(sequence).subspan(i * macroCount, macroCount));
+    auto getMacroValues = [&](uint64_t i)
+    {
+        return std::span<const uint32_t>(sequence).subspan((i & (SEQUENCE_SIZE - 1)) * macroCount, macroCount);
+    };
+
+    const double indexNs = Measure(iterations, [&](uint64_t i)
+    {
+        return CalculatePermutationIndex(macroValueCounts, getMacroValues(i));
+    });
+    const double denseNs = Measure(iterations, [&](uint64_t i)
+    {
+        return dense.GetShader(getMacroValues(i))->m_PermutationIndex;
+    });
+    const double hashedNs = Measure(iterations, [&](uint64_t i)
+    {
+        return hashed.GetShader(getMacroValues(i))->m_PermutationIndex;
+    });
+    printf("%-24s %12u %12.2f %12.2f %12.2f\n", name, count, indexNs, denseNs, hashedNs);
+}
+
+// Like Renderer::GetOrCreateGBufferPipelineState: material flags index a fixed array of pipeline states.
+static void BenchmarkPipelineStates(uint64_t iterations)
+{
+    struct FakePipelineState
+    {
+        const void* m_PipelineState;
+        bool m_Created;
+    };
+    std::array<FakePipelineState, 32> pipelineStates;
+    std::unordered_map<uint32_t, const void*> pipelineStateMap;
+    for(uint32_t flags = 0; flags < pipelineStates.size(); ++flags)
+    {
+        pipelineStates[flags] = {&pipelineStates[flags], true};
+        pipelineStateMap[flags] = &pipelineStates[flags];
+    }
+    const size_t SEQUENCE_SIZE = 4096;
+    std::vector<uint32_t> flagSequence(SEQUENCE_SIZE);
+    std::mt19937 rand(2);
+    for(uint32_t& flags : flagSequence)
+        flags = rand() % pipelineStates.size();
+
+    const double denseNs = Measure(iterations, [&](uint64_t i)
+    {
+        const FakePipelineState& state = pipelineStates[flagSequence[i & (SEQUENCE_SIZE - 1)]];
+        return state.m_Created ? (uint64_t)(uintptr_t)state.m_PipelineState : 0;
+    });
+    const double hashedNs = Measure(iterations, [&](uint64_t i)
+    {
+        const auto it = pipelineStateMap.find(flagSequence[i & (SEQUENCE_SIZE - 1)]);
+        return it != pipelineStateMap.end() ? (uint64_t)(uintptr_t)it->second : 0;
+    });
+    printf("%-24s %12zu %12s %12.2f %12.2f\n", "G-buffer pipeline state", pipelineStates.size(), "-", denseNs, hashedNs);
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t iterations = 10000000;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: ShaderPermutationBenchmark [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(iterations == 0)
+    {
+        fprintf(stderr, "Iterations must be at least 1.\n");
+        return 2;
+    }
+
+    const ShaderDesc& gbufferDesc = GetStandardShaderDesc(StandardShader::GBufferPS);
+    const uint32_t mixedValueCounts[] = {3, 2, 4, 2, 5};
+    TestPermutationIndex(gbufferDesc.m_MacroValueCounts);
+    TestPermutationIndex(mixedValueCounts);
+    TestPermutationIndex({});
+    if(g_FailureCount)
+        return ReportTestResults();
+
+    printf("Iterations: %llu\n", (unsigned long long)iterations);
+    printf("%-24s %12s %12s %12s %12s\n", "Shader", "Permutations", "Index ns", "Dense ns", "Hashed ns");
+    Benchmark("G-buffer PS", gbufferDesc.m_MacroValueCounts, iterations);
+    Benchmark("Mixed macros", mixedValueCounts, iterations);
+    BenchmarkPipelineStates(iterations);
+    return 0;
+}
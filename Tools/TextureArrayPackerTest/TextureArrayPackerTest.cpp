@@ -0,0 +1,239 @@
+/*
+Test of TextureArrayPacker (Source/TextureArrayPacker.hpp), which Renderer uses to merge textures
+of the same format, size and mip count into texture arrays.
+
+Checks packing of small hand-made scenes, then of random ones against properties every result must have:
+- every array holds only identical items, so no slice needs padding to a larger size or other format,
+- no item is in more than one array, items too large are never packed,
+- every group of at least 2 identical items is packed completely, except one item of an odd group
+  when the limit is 2 slices,
+- arrays respect the slice limit, have at least 2 slices, and split groups differ by at most 1 slice,
+  so no array is padded with a half-empty tail,
+- slices follow the order of items.
+
+Usage:
+    TextureArrayPackerTest [-v]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o TextureArrayPackerTest \
+        Tools/TextureArrayPackerTest/TextureArrayPackerTest.cpp Source/TextureArrayPacker.cpp
+*/
+
+#include "../../Source/TextureArrayPacker.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <random>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static bool g_Verbose = false;
+
+using Item = TextureArrayPacker::Item;
+using Array = TextureArrayPacker::Array;
+
+// Values of DXGI_FORMAT, only compared.
+static const uint32_t FORMAT_BC1 = 71;
+static const uint32_t FORMAT_BC3 = 77;
+static const uint32_t FORMAT_BC5 = 83;
+
+// Like Renderer: default of setting "Textures.Arrays.MaxSize" and D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+static const uint32_t MAX_SIZE = 256;
+static const uint32_t MAX_SLICES = 2048;
+
+static void Print(std::span<const Item> items, const std::vector<Array>& arrays)
+{
+    if(!g_Verbose)
+        return;
+    for(const Array& arr : arrays)
+    {
+        const Item& item = items[arr.m_Items[0]];
+        printf("Format %u %ux%u mips %u:", item.m_Format, item.m_Width, item.m_Height, item.m_MipLevels);
+        for(size_t index : arr.m_Items)
+            printf(" %zu", index);
+        printf("\n");
+    }
+}
+
+static bool ItemEqual(const Item& lhs, const Item& rhs)
+{
+    return lhs.m_Format == rhs.m_Format && lhs.m_Width == rhs.m_Width &&
+        lhs.m_Height == rhs.m_Height && lhs.m_MipLevels == rhs.m_MipLevels;
+}
+
+// Checks the properties listed at the top of the file.
+static void CheckResult(std::span<const Item> items, uint32_t maxSize, uint32_t maxSlices,
+    const std::vector<Array>& arrays)
+{
+    const uint32_t sliceLimit = std::max(maxSlices, 2u);
+    std::vector<uint32_t> arrayCountOfItem(items.size());
+    for(const Array& arr : arrays)
+    {
+        TEST(arr.m_Items.size() >= 2 && arr.m_Items.size() <= sliceLimit);
+        TEST(std::is_sorted(arr.m_Items.begin(), arr.m_Items.end()));
+        for(size_t index : arr.m_Items)
+        {
+            TEST(index < items.size());
+            if(index >= items.size())
+                return;
+            ++arrayCountOfItem[index];
+            TEST(ItemEqual(items[index], items[arr.m_Items[0]]));
+            TEST(items[index].m_Width <= maxSize && items[index].m_Height <= maxSize);
+        }
+    }
+
+    // Group items by key and count how many arrays and slices each group got.
+    using Key = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>;
+    auto getKey = [](const Item& item) -> Key
+    {
+        return {item.m_Format, item.m_Width, item.m_Height, item.m_MipLevels};
+    };
+    std::map<Key, size_t> groupSizes;
+    for(const Item& item : items)
+        ++groupSizes[getKey(item)];
+    std::map<Key, std::vector<size_t>> arraySizes;
+    for(const Array& arr : arrays)
+        arraySizes[getKey(items[arr.m_Items[0]])].push_back(arr.m_Items.size());
+
+    std::map<Key, size_t> unpackedCounts;
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        TEST(arrayCountOfItem[i] <= 1);
+        const bool packable = items[i].m_Width <= maxSize && items[i].m_Height <= maxSize &&
+            groupSizes[getKey(items[i])] >= 2;
+        if(!packable)
+            TEST(arrayCountOfItem[i] == 0);
+        else if(arrayCountOfItem[i] == 0)
+            ++unpackedCounts[getKey(items[i])];
+    }
+    for(const auto& [key, count] : unpackedCounts)
+        TEST(count == 1 && sliceLimit == 2 && groupSizes[key] % 2 == 1);
+    for(const auto& [key, sizes] : arraySizes)
+    {
+        const size_t groupSize = groupSizes[key];
+        TEST(sizes.size() == (sliceLimit == 2 ? groupSize / 2 : (groupSize + sliceLimit - 1) / sliceLimit));
+        const auto [minSize, maxSizeIt] = std::minmax_element(sizes.begin(), sizes.end());
+        TEST(*maxSizeIt - *minSize <= 1);
+    }
+}
+
+static void TestSimple()
+{
+    std::vector<Item> items;
+    for(uint32_t i = 0; i < 7; ++i)
+        items.push_back({FORMAT_BC1, 128, 128, 8});
+    items.push_back({FORMAT_BC1, 512, 512, 10}); // 7: too large
+    items.push_back({FORMAT_BC5, 64, 64, 7}); // 8
+    items.push_back({FORMAT_BC5, 64, 64, 7}); // 9
+    items.push_back({FORMAT_BC1, 128, 64, 8}); // 10: alone
+    items.push_back({FORMAT_BC1, 128, 128, 1}); // 11: alone, different mip count
+    items.push_back({FORMAT_BC3, 128, 128, 8}); // 12: alone, different format
+
+    std::vector<Array> arrays;
+    TextureArrayPacker(MAX_SIZE, 3).Pack(items, arrays);
+    Print(items, arrays);
+    CheckResult(items, MAX_SIZE, 3, arrays);
+    // 7 items split into 3 arrays of 2, 2, 3 - not 3, 3, 1.
+    TEST(arrays.size() == 4);
+    if(arrays.size() == 4)
+    {
+        TEST((arrays[0].m_Items == std::vector<size_t>{0, 1}));
+        TEST((arrays[1].m_Items == std::vector<size_t>{2, 3}));
+        TEST((arrays[2].m_Items == std::vector<size_t>{4, 5, 6}));
+        TEST((arrays[3].m_Items == std::vector<size_t>{8, 9}));
+    }
+}
+
+static void TestEdgeCases()
+{
+    std::vector<Array> arrays = {Array{{1, 2}}};
+    TextureArrayPacker(MAX_SIZE, MAX_SLICES).Pack({}, arrays);
+    TEST(arrays.empty());
+
+    // Single item never makes an array.
+    const Item single[] = {{FORMAT_BC1, 64, 64, 7}};
+    TextureArrayPacker(MAX_SIZE, MAX_SLICES).Pack(single, arrays);
+    TEST(arrays.empty());
+
+    // Size limit is inclusive and applies to both dimensions.
+    const Item limits[] = {{FORMAT_BC1, 256, 256, 9}, {FORMAT_BC1, 256, 256, 9},
+        {FORMAT_BC1, 257, 4, 9}, {FORMAT_BC1, 257, 4, 9}, {FORMAT_BC1, 4, 257, 9}, {FORMAT_BC1, 4, 257, 9}};
+    TextureArrayPacker(MAX_SIZE, MAX_SLICES).Pack(limits, arrays);
+    TEST(arrays.size() == 1 && arrays[0].m_Items == std::vector<size_t>({0, 1}));
+
+    // maxSlices below 2 behaves like 2. Odd item is not packed alone.
+    const Item three[] = {{FORMAT_BC1, 64, 64, 7}, {FORMAT_BC1, 64, 64, 7}, {FORMAT_BC1, 64, 64, 7}};
+    TextureArrayPacker(MAX_SIZE, 1).Pack(three, arrays);
+    CheckResult(three, MAX_SIZE, 1, arrays);
+    TEST(arrays.size() == 1 && arrays[0].m_Items.size() == 2);
+    const Item four[] = {three[0], three[0], three[0], three[0]};
+    TextureArrayPacker(MAX_SIZE, 0).Pack(four, arrays);
+    CheckResult(four, MAX_SIZE, 0, arrays);
+    TEST(arrays.size() == 2);
+
+    // Group exactly at the limit stays one array, one more splits it in halves.
+    std::vector<Item> items(MAX_SLICES, Item{FORMAT_BC1, 32, 32, 6});
+    TextureArrayPacker(MAX_SIZE, MAX_SLICES).Pack(items, arrays);
+    TEST(arrays.size() == 1 && arrays[0].m_Items.size() == MAX_SLICES);
+    items.push_back(items[0]);
+    TextureArrayPacker(MAX_SIZE, MAX_SLICES).Pack(items, arrays);
+    TEST(arrays.size() == 2 && arrays[0].m_Items.size() == MAX_SLICES / 2 &&
+        arrays[1].m_Items.size() == MAX_SLICES / 2 + 1);
+}
+
+static void TestRandom()
+{
+    std::mt19937 rand(1);
+    const uint32_t formats[] = {FORMAT_BC1, FORMAT_BC3, FORMAT_BC5};
+    for(uint32_t iteration = 0; iteration < 2000; ++iteration)
+    {
+        // Few distinct keys, so groups form, including some larger than maxSlices.
+        const uint32_t itemCount = rand() % 200;
+        const uint32_t maxSlices = rand() % 12;
+        const uint32_t maxSize = 32u << (rand() % 5);
+        std::vector<Item> items(itemCount);
+        for(Item& item : items)
+        {
+            const uint32_t width = 16u << (rand() % 5);
+            const uint32_t height = rand() % 4 == 0 ? width / 2 : width;
+            item = {formats[rand() % 3], width, height, rand() % 3 == 0 ? 1u : 5u};
+        }
+        std::vector<Array> arrays;
+        TextureArrayPacker(maxSize, maxSlices).Pack(items, arrays);
+        CheckResult(items, maxSize, maxSlices, arrays);
+
+        // Deterministic: same input gives same result.
+        std::vector<Array> arrays2;
+        TextureArrayPacker(maxSize, maxSlices).Pack(items, arrays2);
+        TEST(arrays.size() == arrays2.size());
+        for(size_t i = 0; i < std::min(arrays.size(), arrays2.size()); ++i)
+            TEST(arrays[i].m_Items == arrays2[i].m_Items);
+        if(g_FailureCount)
+        {
+            fprintf(stderr, "Iteration %u failed.\n", iteration);
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-v") == 0)
+            g_Verbose = true;
+        else
+        {
+            fprintf(stderr, "Usage: TextureArrayPackerTest [-v]\n");
+            return 2;
+        }
+    }
+
+    TestSimple();
+    TestEdgeCases();
+    TestRandom();
+
+    return ReportTestResults();
+}
@@ -0,0 +1,291 @@
+/*
+Test and benchmark of the texture cache format (Source/TextureCacheFormat.hpp), in which Texture stores
+cooked textures in the asset pack.
+
+First checks that textures of many sizes, uncompressed and block-compressed, come back from
+SaveTextureCacheData and LoadTextureCacheData unchanged with levels and rows aligned like a copyable footprint,
+and that truncated or corrupted entries are rejected.
+
+Then writes a file with Count textures of Size x Size RGBA8 with full mip chains, reads it back
+and measures loading them: parsing every entry and copying its levels to a buffer laid out like
+the upload buffer of Texture - with one memcpy per level, as the format allows, and row by row
+for comparison. Exit code is 1 if any check fails.
+
+Usage:
+    TextureCacheBenchmark [-s Size] [-n Count] [-i Iterations]
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o TextureCacheBenchmark \
+        Tools/TextureCacheBenchmark/TextureCacheBenchmark.cpp Source/TextureCacheFormat.cpp
+*/
+
+#include "../../Source/TextureCacheFormat.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <random>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Values of DXGI_FORMAT, stored as numbers only.
+static const uint32_t FORMAT_R8G8B8A8_UNORM = 28;
+static const uint32_t FORMAT_BC1_UNORM = 71;
+
+// Source texture with levels in separate tightly packed buffers, like DirectX::ScratchImage.
+struct SourceTexture
+{
+    TextureCacheDesc m_Desc;
+    std::vector<std::vector<char>> m_Buffers;
+    std::vector<TextureCacheLevel> m_Levels;
+
+    SourceTexture(uint32_t format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t seed)
+    {
+        m_Desc = {format, width, height, mipLevels};
+        std::mt19937 rand(seed);
+        for(uint32_t mip = 0; mip < mipLevels; ++mip)
+        {
+            const uint32_t levelWidth = std::max(width >> mip, 1u), levelHeight = std::max(height >> mip, 1u);
+            size_t rowPitch;
+            uint32_t rowCount;
+            if(format == FORMAT_BC1_UNORM)
+            {
+                rowPitch = (size_t)(levelWidth + 3) / 4 * 8;
+                rowCount = (levelHeight + 3) / 4;
+            }
+            else
+            {
+                rowPitch = (size_t)levelWidth * 4;
+                rowCount = levelHeight;
+            }
+            std::vector<char>& buffer = m_Buffers.emplace_back(rowPitch * rowCount);
+            for(char& c : buffer)
+                c = (char)rand();
+            m_Levels.push_back({buffer.data(), rowPitch, rowCount});
+        }
+    }
+};
+
+static bool IsAligned(const void* ptr, const void* base, size_t alignment)
+{
+    return (size_t)((const char*)ptr - (const char*)base) % alignment == 0;
+}
+
+static void TestRoundTrip(uint32_t format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    const SourceTexture src(format, width, height, mipLevels, width * 31 + height);
+    std::vector<char> data;
+    SaveTextureCacheData(src.m_Desc, src.m_Levels, data);
+    TEST(data.size() % TEXTURE_CACHE_LEVEL_ALIGNMENT == 0);
+
+    TextureCacheDesc desc;
+    std::vector<TextureCacheLevel> levels;
+    TEST(LoadTextureCacheData(data, desc, levels));
+    TEST(desc.m_Format == format && desc.m_Width == width && desc.m_Height == height &&
+        desc.m_MipLevels == mipLevels);
+    TEST(levels.size() == mipLevels);
+    if(levels.size() != mipLevels)
+        return;
+    for(uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        const TextureCacheLevel& level = levels[mip];
+        const TextureCacheLevel& srcLevel = src.m_Levels[mip];
+        TEST(IsAligned(level.m_Data, data.data(), TEXTURE_CACHE_LEVEL_ALIGNMENT));
+        TEST(level.m_RowPitch % TEXTURE_CACHE_ROW_PITCH_ALIGNMENT == 0 && level.m_RowPitch >= srcLevel.m_RowPitch);
+        TEST(level.m_RowCount == srcLevel.m_RowCount);
+        for(uint32_t row = 0; row < level.m_RowCount; ++row)
+        {
+            TEST(memcmp(level.m_Data + row * level.m_RowPitch, srcLevel.m_Data + row * srcLevel.m_RowPitch,
+                srcLevel.m_RowPitch) == 0);
+        }
+    }
+}
+
+static void TestRoundTrips()
+{
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 1, 1, 1);
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 64, 64, 7);
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 100, 37, 7);
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 1, 300, 9);
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 1024, 512, 11);
+    // Only some levels, like textures limited by "Textures.MaxSize".
+    TestRoundTrip(FORMAT_R8G8B8A8_UNORM, 256, 256, 3);
+    TestRoundTrip(FORMAT_BC1_UNORM, 4, 4, 3);
+    TestRoundTrip(FORMAT_BC1_UNORM, 256, 128, 9);
+    TestRoundTrip(FORMAT_BC1_UNORM, 2048, 2048, 12);
+}
+
+static void TestInvalidData()
+{
+    const SourceTexture src(FORMAT_BC1_UNORM, 64, 32, 7, 1);
+    std::vector<char> valid;
+    SaveTextureCacheData(src.m_Desc, src.m_Levels, valid);
+    TextureCacheDesc desc;
+    std::vector<TextureCacheLevel> levels;
+    TEST(LoadTextureCacheData(valid, desc, levels));
+
+    // Truncated anywhere.
+    for(size_t size = 0; size < valid.size(); size += 7)
+        TEST(!LoadTextureCacheData(std::span<const char>(valid.data(), size), desc, levels));
+    // Extra data.
+    std::vector<char> data = valid;
+    data.resize(data.size() + TEXTURE_CACHE_LEVEL_ALIGNMENT);
+    TEST(!LoadTextureCacheData(data, desc, levels));
+
+    // Offsets of fields of the header and the first mip, see TextureCacheFormat.cpp.
+    struct Corruption
+    {
+        size_t m_Offset;
+        uint32_t m_Value;
+    };
+    const uint32_t mip0Offset = 48;
+    const Corruption corruptions[] = {
+        {0, 0x12345678}, // Magic
+        {16, TEXTURE_CACHE_VERSION + 1}, // Version
+        {24, 0}, // Width
+        {28, 0}, // Height
+        {32, 0}, // MipLevels
+        {32, TEXTURE_CACHE_MAX_MIP_LEVELS + 1}, // MipLevels
+        {mip0Offset, 0x10000000}, // Offset beyond the end
+        {mip0Offset + 8, 100}, // RowPitch not aligned
+        {mip0Offset + 12, 0x1000000}, // RowCount beyond the end
+    };
+    for(const Corruption& corruption : corruptions)
+    {
+        data = valid;
+        memcpy(data.data() + corruption.m_Offset, &corruption.m_Value, sizeof(corruption.m_Value));
+        TEST(!LoadTextureCacheData(data, desc, levels));
+    }
+    // Offset not aligned, but data still inside.
+    data = valid;
+    const uint32_t unalignedOffset = mip0Offset + 16 * 7 + 8;
+    memcpy(data.data() + mip0Offset, &unalignedOffset, sizeof(unalignedOffset));
+    TEST(!LoadTextureCacheData(data, desc, levels));
+}
+
+// Copies levels of one entry to upload, laid out like the upload buffer. Returns false if the entry is invalid.
+static bool LoadEntry(std::span<const char> entry, bool singleCopy, std::vector<TextureCacheLevel>& levels,
+    std::vector<char>& upload)
+{
+    TextureCacheDesc desc;
+    if(!LoadTextureCacheData(entry, desc, levels))
+        return false;
+    char* dst = upload.data();
+    for(const TextureCacheLevel& level : levels)
+    {
+        // Footprint of RGBA8 level: rows of width * 4 bytes at the aligned pitch, same as in the cache.
+        const size_t rowSize = (size_t)std::max(desc.m_Width >> (&level - levels.data()), 1u) * 4;
+        if(singleCopy)
+            memcpy(dst, level.m_Data, (level.m_RowCount - 1) * level.m_RowPitch + rowSize);
+        else
+        {
+            for(uint32_t row = 0; row < level.m_RowCount; ++row)
+                memcpy(dst + row * level.m_RowPitch, level.m_Data + row * level.m_RowPitch, rowSize);
+        }
+        dst += level.m_RowPitch * level.m_RowCount;
+    }
+    return true;
+}
+
+static void Benchmark(uint32_t size, uint32_t count, uint32_t iterations)
+{
+    uint32_t mipLevels = 1;
+    while((size >> mipLevels) > 0)
+        ++mipLevels;
+
+    // Like entries in the asset pack: appended one after another, each aligned.
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "TextureCacheBenchmark.bin";
+    std::vector<std::pair<size_t, size_t>> entries;
+    {
+        FILE* file = fopen(path.string().c_str(), "wb");
+        TEST(file != nullptr);
+        if(!file)
+            return;
+        std::vector<char> data;
+        size_t offset = 0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const SourceTexture src(FORMAT_R8G8B8A8_UNORM, size, size, mipLevels, i);
+            SaveTextureCacheData(src.m_Desc, src.m_Levels, data);
+            TEST(fwrite(data.data(), 1, data.size(), file) == data.size());
+            entries.push_back({offset, data.size()});
+            offset += data.size();
+        }
+        fclose(file);
+    }
+
+    const Clock::time_point readBeginTime = Clock::now();
+    std::vector<char> fileData((size_t)std::filesystem::file_size(path));
+    {
+        FILE* file = fopen(path.string().c_str(), "rb");
+        TEST(file != nullptr && fread(fileData.data(), 1, fileData.size(), file) == fileData.size());
+        if(file)
+            fclose(file);
+    }
+    const double readSeconds = std::chrono::duration<double>(Clock::now() - readBeginTime).count();
+    std::filesystem::remove(path);
+
+    std::vector<TextureCacheLevel> levels;
+    std::vector<char> upload(entries.empty() ? 0 : entries[0].second);
+    double seconds[2] = {};
+    for(uint32_t singleCopy = 0; singleCopy < 2; ++singleCopy)
+    {
+        // Warm-up
+        for(const auto& entry : entries)
+            TEST(LoadEntry(std::span<const char>(fileData.data() + entry.first, entry.second), singleCopy, levels, upload));
+        const Clock::time_point beginTime = Clock::now();
+        for(uint32_t i = 0; i < iterations; ++i)
+        {
+            for(const auto& entry : entries)
+                LoadEntry(std::span<const char>(fileData.data() + entry.first, entry.second), singleCopy, levels, upload);
+        }
+        seconds[singleCopy] = std::chrono::duration<double>(Clock::now() - beginTime).count() / iterations;
+    }
+
+    const double megabytes = (double)fileData.size() / (1024.0 * 1024.0);
+    printf("File: %u textures %ux%u RGBA8, %u levels, %.1f MB, read in %.1f ms\n",
+        count, size, size, mipLevels, megabytes, readSeconds * 1e3);
+    printf("%-24s %10s %10s %12s\n", "Load", "ms", "MB/s", "textures/s");
+    const char* const names[2] = {"Row by row", "Single copy per level"};
+    for(uint32_t singleCopy = 0; singleCopy < 2; ++singleCopy)
+    {
+        printf("%-24s %10.2f %10.0f %12.0f\n", names[singleCopy], seconds[singleCopy] * 1e3,
+            megabytes / seconds[singleCopy], count / seconds[singleCopy]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 2048;
+    uint32_t count = 16;
+    uint32_t iterations = 4;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            size = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            count = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "Usage: TextureCacheBenchmark [-s Size] [-n Count] [-i Iterations]\n");
+            return 2;
+        }
+    }
+    if(size == 0 || size > (1u << (TEXTURE_CACHE_MAX_MIP_LEVELS - 1)) || count == 0 || iterations == 0)
+    {
+        fprintf(stderr, "Size must be 1..%u, count and iterations at least 1.\n", 1u << (TEXTURE_CACHE_MAX_MIP_LEVELS - 1));
+        return 2;
+    }
+
+    TestRoundTrips();
+    TestInvalidData();
+    Benchmark(size, count, iterations);
+
+    return ReportTestResults();
+}
@@ -0,0 +1,536 @@
+/*
+Tests of TextureStreamingPolicy (Source/TextureStreamingPolicy.hpp), the part of texture mip streaming
+that decides which levels should be resident.
+
+Besides checks of single functions, simulates a scene: a row of objects with streaming textures,
+a camera flying along it, requests made every frame from distances like Renderer does, and changes
+applied to the simulated textures. Checks that resident levels follow the camera, no more than
+the allowed number of changes is made per frame, and the memory budget is respected. When more
+changes are pending than allowed, the stream-ins kept are those requesting most levels.
+With the automatic budget, simulates GPU memory used by the rest of the application changing over time
+and checks that the budget shrinks immediately, grows back only with headroom, and doesn't oscillate.
+
+Usage:
+    TextureStreamingTest [-v]
+
+-v prints resident levels of all textures at the end of every scenario.
+
+Builds on Windows and Linux with Tools/CMakeLists.txt, or on Linux:
+    g++ -std=c++20 -O2 -o TextureStreamingTest \
+        Tools/TextureStreamingTest/TextureStreamingTest.cpp Source/TextureStreamingPolicy.cpp
+*/
+
+#include "../../Source/TextureStreamingPolicy.hpp"
+#include "../Common/TestUtils.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static bool g_Verbose = false;
+
+static const float PI = 3.14159265f;
+static const uint32_t BC1_BLOCK_SIZE = 8;
+// Like the default of setting "Textures.Streaming.TailSize".
+static const uint32_t TAIL_SIZE = 128;
+static const float PROJECTION_SCALE = 1080.f / (2.f * 0.41421356f); // 45 degrees vertical FOV, 1080 pixels.
+// Texture covers an object 20 units large once.
+static const float UV_DENSITY = 0.05f;
+
+// Like Texture streaming textures, with sizes of levels of a square BC1 texture.
+struct SimulatedTexture
+{
+    uint32_t m_Size = 0;
+    std::vector<uint64_t> m_MipSizes;
+    uint32_t m_MaxFirstMip = 0;
+    uint32_t m_FirstResidentMip = 0;
+
+    explicit SimulatedTexture(uint32_t size) : m_Size(size)
+    {
+        for(uint32_t mipSize = size; ; mipSize /= 2)
+        {
+            const uint64_t blockCount = std::max(mipSize / 4, 1u);
+            m_MipSizes.push_back(blockCount * blockCount * BC1_BLOCK_SIZE);
+            if(mipSize == 1)
+                break;
+        }
+        while(m_MaxFirstMip + 1 < m_MipSizes.size() && size >> m_MaxFirstMip > TAIL_SIZE)
+            ++m_MaxFirstMip;
+        // Only the tail is resident after loading.
+        m_FirstResidentMip = m_MaxFirstMip;
+    }
+    // Size of levels firstMip..last.
+    uint64_t GetSize(uint32_t firstMip) const
+    {
+        uint64_t size = 0;
+        for(size_t mip = firstMip; mip < m_MipSizes.size(); ++mip)
+            size += m_MipSizes[mip];
+        return size;
+    }
+    uint64_t GetResidentSize() const { return GetSize(m_FirstResidentMip); }
+};
+
+struct SimulatedObject
+{
+    float m_Z;
+    size_t m_TextureIndex;
+    float m_UVDensity;
+};
+
+class SimulatedScene
+{
+public:
+    std::vector<SimulatedTexture> m_Textures;
+    std::vector<SimulatedObject> m_Objects;
+    TextureStreamingPolicy m_Policy;
+    TextureStreamingPolicy::Params m_Params;
+    // GPU memory used by everything else than streaming textures.
+    uint64_t m_OtherUsage = 0;
+    uint64_t m_DeviceBudget = 0;
+    float m_CameraZ = 0.f;
+
+    // objectCount objects, spacing apart along +Z, each with its own texture.
+    SimulatedScene(uint32_t objectCount, float spacing, uint32_t textureSize)
+    {
+        for(uint32_t i = 0; i < objectCount; ++i)
+        {
+            m_Textures.emplace_back(textureSize);
+            m_Objects.push_back({(float)(i + 1) * spacing, i, UV_DENSITY});
+        }
+        m_Params.m_AutoBudget = false;
+    }
+
+    // Required mip of the object, as fractional number, or -1 if behind the camera.
+    float GetRequiredMip(const SimulatedObject& obj) const
+    {
+        const float distance = obj.m_Z - m_CameraZ;
+        if(distance <= 0.f)
+            return -1.f;
+        return EstimateRequiredMip((float)m_Textures[obj.m_TextureIndex].m_Size, obj.m_UVDensity,
+            std::max(distance, 0.1f), PROJECTION_SCALE);
+    }
+    uint64_t GetResidentSize() const
+    {
+        uint64_t size = 0;
+        for(const SimulatedTexture& tex : m_Textures)
+            size += tex.GetResidentSize();
+        return size;
+    }
+
+    // Requests, calculates and applies changes of one frame, checking the changes. Returns number of changes.
+    size_t Frame()
+    {
+        for(const SimulatedObject& obj : m_Objects)
+        {
+            const float mip = GetRequiredMip(obj);
+            if(mip >= 0.f)
+                m_Policy.RequestMip(obj.m_TextureIndex, mip, PROJECTION_SCALE / (obj.m_Z - m_CameraZ));
+        }
+
+        std::vector<TextureStreamingPolicy::Texture> textures(m_Textures.size());
+        for(size_t i = 0; i < m_Textures.size(); ++i)
+            textures[i] = {m_Textures[i].m_MipSizes, m_Textures[i].m_MaxFirstMip, m_Textures[i].m_FirstResidentMip};
+        std::pmr::vector<TextureStreamingPolicy::Change> changes;
+        m_Policy.CalculateChanges(textures, m_OtherUsage + GetResidentSize(), m_DeviceBudget, m_Params, changes);
+
+        TEST(changes.size() <= m_Params.m_MaxChangesPerFrame);
+        bool streamingIn = false;
+        for(const TextureStreamingPolicy::Change& change : changes)
+        {
+            TEST(change.m_TextureIndex < m_Textures.size());
+            SimulatedTexture& tex = m_Textures[change.m_TextureIndex];
+            TEST(change.m_FirstResidentMip <= tex.m_MaxFirstMip);
+            TEST(change.m_FirstResidentMip != tex.m_FirstResidentMip);
+            // Ones freeing memory go first.
+            const bool streamIn = change.m_FirstResidentMip < tex.m_FirstResidentMip;
+            TEST(streamIn || !streamingIn);
+            streamingIn = streamIn;
+            tex.m_FirstResidentMip = change.m_FirstResidentMip;
+        }
+        return changes.size();
+    }
+
+    // Runs frames until there are no more changes. Returns number of frames, or UINT32_MAX if it doesn't settle.
+    uint32_t Settle(uint32_t maxFrameCount = 1000)
+    {
+        for(uint32_t frame = 0; frame < maxFrameCount; ++frame)
+        {
+            if(Frame() == 0)
+                return frame;
+        }
+        return UINT32_MAX;
+    }
+
+    void Print(const char* title) const
+    {
+        if(!g_Verbose)
+            return;
+        printf("%s: camera Z = %.1f, resident %.2f MB\n", title, m_CameraZ, (double)GetResidentSize() / (1024. * 1024.));
+        for(const SimulatedObject& obj : m_Objects)
+        {
+            printf("    Z = %6.1f required mip %5.2f, first resident %u\n",
+                obj.m_Z, GetRequiredMip(obj), m_Textures[obj.m_TextureIndex].m_FirstResidentMip);
+        }
+    }
+};
+
+static void TestEstimateRequiredMip()
+{
+    TEST(std::fabs(CalculateProjectionScale(PI * 0.5f, 1000.f) - 500.f) < 0.01f);
+
+    // 1024 texels per world unit, 256 pixels per world unit at distance 2: 4 texels per pixel = mip 2.
+    TEST(std::fabs(EstimateRequiredMip(1024.f, 1.f, 2.f, 512.f) - 2.f) < 1e-4f);
+    // Twice the distance, one level coarser.
+    TEST(std::fabs(EstimateRequiredMip(1024.f, 1.f, 4.f, 512.f) - 3.f) < 1e-4f);
+    // Twice the UV density is like twice the texture size.
+    TEST(std::fabs(EstimateRequiredMip(1024.f, 2.f, 4.f, 512.f) - EstimateRequiredMip(2048.f, 1.f, 4.f, 512.f)) < 1e-4f);
+    // Closer than 1 texel per pixel: mip 0, never negative.
+    TEST(EstimateRequiredMip(1024.f, 1.f, 0.01f, 512.f) == 0.f);
+    TEST(EstimateRequiredMip(1024.f, 1.f, 1.f, 1024.f) == 0.f);
+}
+
+static void TestCalculateStreamingTargets()
+{
+    const SimulatedTexture tex(1024);
+    TEST(tex.m_MaxFirstMip == 3);
+
+    // Requested finer level than resident: target is the request.
+    StreamingTextureState state = {.m_MipSizes = tex.m_MipSizes, .m_MaxFirstMip = 3, .m_FirstResidentMip = 3,
+        .m_RequestedMip = 1, .m_Priority = 1.f};
+    StreamingTextureState states[] = {state};
+    TEST(CalculateStreamingTargets(states, UINT64_MAX) == tex.GetSize(1));
+    TEST(states[0].m_TargetFirstMip == 1);
+
+    // Request of the next coarser level keeps the current one, so it doesn't flip at the boundary.
+    states[0] = state;
+    states[0].m_FirstResidentMip = 1;
+    states[0].m_RequestedMip = 2;
+    CalculateStreamingTargets(states, UINT64_MAX);
+    TEST(states[0].m_TargetFirstMip == 1);
+    states[0].m_RequestedMip = 3;
+    CalculateStreamingTargets(states, UINT64_MAX);
+    TEST(states[0].m_TargetFirstMip == 3);
+
+    // Request beyond the tail is clamped.
+    states[0] = state;
+    states[0].m_RequestedMip = 8;
+    CalculateStreamingTargets(states, UINT64_MAX);
+    TEST(states[0].m_TargetFirstMip == 3);
+
+    // Not requested keeps what it has.
+    states[0] = state;
+    states[0].m_FirstResidentMip = 0;
+    states[0].m_RequestedMip = UINT32_MAX;
+    CalculateStreamingTargets(states, UINT64_MAX);
+    TEST(states[0].m_TargetFirstMip == 0);
+
+    // Budget 0 drops everything down to the tail, which stays.
+    states[0] = state;
+    states[0].m_RequestedMip = 0;
+    const uint64_t size = CalculateStreamingTargets(states, 0);
+    TEST(states[0].m_TargetFirstMip == 3);
+    TEST(size == tex.GetResidentSize());
+}
+
+// Camera approaches a row of objects and flies past them.
+static void TestCameraFlyThrough()
+{
+    SimulatedScene scene(16, 20.f, 2048);
+    scene.m_CameraZ = -2000.f;
+    // Far away, everything needs only the tail.
+    TEST(scene.Settle() == 0);
+    for(const SimulatedTexture& tex : scene.m_Textures)
+        TEST(tex.m_FirstResidentMip == tex.m_MaxFirstMip);
+
+    for(float cameraZ = -2000.f; cameraZ <= 100.f; cameraZ += 5.f)
+    {
+        scene.m_CameraZ = cameraZ;
+        scene.Frame();
+    }
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Inside the row");
+
+    // Visible objects have at least their required level, and not more than one level more than required.
+    for(const SimulatedObject& obj : scene.m_Objects)
+    {
+        const float mip = scene.GetRequiredMip(obj);
+        const SimulatedTexture& tex = scene.m_Textures[obj.m_TextureIndex];
+        if(mip < 0.f)
+        {
+            // Passed by the camera, were close, not requested since then: levels are kept when budget allows.
+            TEST(tex.m_FirstResidentMip < tex.m_MaxFirstMip);
+            continue;
+        }
+        const uint32_t requiredMip = std::min((uint32_t)mip, tex.m_MaxFirstMip);
+        TEST(tex.m_FirstResidentMip <= requiredMip);
+        TEST(tex.m_FirstResidentMip + 1 >= requiredMip);
+    }
+    // Nearest visible object needs more than the farthest.
+    const SimulatedObject* nearest = nullptr;
+    for(const SimulatedObject& obj : scene.m_Objects)
+    {
+        if(scene.GetRequiredMip(obj) >= 0.f)
+        {
+            nearest = &obj;
+            break;
+        }
+    }
+    TEST(nearest != nullptr);
+    if(nearest)
+    {
+        TEST(scene.m_Textures[nearest->m_TextureIndex].m_FirstResidentMip <
+            scene.m_Textures[scene.m_Objects.back().m_TextureIndex].m_FirstResidentMip);
+    }
+
+    // Turn around and fly far away. Levels are dropped as objects get further.
+    scene.m_CameraZ = -3000.f;
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Far away again");
+    for(const SimulatedObject& obj : scene.m_Objects)
+    {
+        const SimulatedTexture& tex = scene.m_Textures[obj.m_TextureIndex];
+        TEST(tex.m_FirstResidentMip + 1 >= tex.m_MaxFirstMip);
+    }
+}
+
+// Many objects close to the camera, budget fits only some of the requested levels.
+static void TestFixedBudget()
+{
+    SimulatedScene scene(32, 4.f, 2048);
+    scene.m_CameraZ = 0.f;
+    uint64_t tailSize = 0;
+    uint64_t fullSize = 0;
+    for(const SimulatedTexture& tex : scene.m_Textures)
+    {
+        tailSize += tex.GetResidentSize();
+        fullSize += tex.GetSize(0);
+    }
+    scene.m_Params.m_MaxBudget = tailSize + (fullSize - tailSize) / 8;
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Fixed budget");
+
+    TEST(scene.GetResidentSize() <= scene.m_Params.m_MaxBudget);
+    TEST(scene.m_Policy.GetBudget() == scene.m_Params.m_MaxBudget);
+    // Higher priority - closer objects - keep finer levels.
+    for(size_t i = 1; i < scene.m_Objects.size(); ++i)
+    {
+        TEST(scene.m_Textures[scene.m_Objects[i - 1].m_TextureIndex].m_FirstResidentMip <=
+            scene.m_Textures[scene.m_Objects[i].m_TextureIndex].m_FirstResidentMip);
+    }
+    TEST(scene.m_Textures[scene.m_Objects.front().m_TextureIndex].m_FirstResidentMip <
+        scene.m_Textures[scene.m_Objects.back().m_TextureIndex].m_FirstResidentMip);
+
+    // Budget lowered below the tails: everything goes to the tail, which can't be dropped.
+    scene.m_Params.m_MaxBudget = tailSize / 2;
+    TEST(scene.Settle() != UINT32_MAX);
+    TEST(scene.GetResidentSize() == tailSize);
+}
+
+// Objects that are no longer visible are the first to lose levels when the budget is needed elsewhere.
+static void TestInvisibleLoseLevelsFirst()
+{
+    SimulatedScene scene(8, 10.f, 2048);
+    scene.m_CameraZ = 0.f;
+    TEST(scene.Settle() != UINT32_MAX);
+    const uint64_t sizeAllVisible = scene.GetResidentSize();
+
+    // Half of the objects behind the camera, the others closer, so they need more.
+    scene.m_CameraZ = 45.f;
+    scene.m_Params.m_MaxBudget = sizeAllVisible;
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Half behind the camera");
+    TEST(scene.GetResidentSize() <= scene.m_Params.m_MaxBudget);
+    uint32_t minBehind = UINT32_MAX;
+    uint32_t maxInFront = 0;
+    for(const SimulatedObject& obj : scene.m_Objects)
+    {
+        const uint32_t firstMip = scene.m_Textures[obj.m_TextureIndex].m_FirstResidentMip;
+        if(scene.GetRequiredMip(obj) < 0.f)
+            minBehind = std::min(minBehind, firstMip);
+        else
+            maxInFront = std::max(maxInFront, firstMip);
+    }
+    TEST(minBehind >= maxInFront);
+}
+
+static void TestCalculateStreamingBudget()
+{
+    const uint64_t MB = 1024 * 1024;
+    const uint64_t deviceBudget = 1000 * MB;
+    const float targetUsage = 0.9f;
+    const float hysteresis = 0.05f;
+    auto calc = [&](uint64_t otherUsage, uint64_t residentSize, uint64_t previousBudget, uint64_t maxBudget = UINT64_MAX)
+    {
+        return CalculateStreamingBudget(otherUsage + residentSize, deviceBudget, residentSize, previousBudget,
+            maxBudget, targetUsage, hysteresis);
+    };
+    // Fractions of the device budget are calculated in float.
+    auto near = [&](uint64_t budget, uint64_t expected) { return std::max(budget, expected) - std::min(budget, expected) < MB; };
+
+    // First call: everything up to the target usage not used by others.
+    uint64_t budget = calc(400 * MB, 300 * MB, UINT64_MAX);
+    TEST(near(budget, 500 * MB));
+    // Limited by maxBudget.
+    TEST(calc(400 * MB, 300 * MB, UINT64_MAX, 200 * MB) == 200 * MB);
+    // Others use more: shrinks immediately, to what fits under the target.
+    budget = calc(600 * MB, 300 * MB, budget);
+    TEST(near(budget, 300 * MB));
+    // Others use a bit less, but not below the target minus hysteresis: doesn't grow.
+    TEST(calc(560 * MB, 300 * MB, budget) == budget);
+    TEST(calc(590 * MB, 300 * MB, budget) == budget);
+    // Others use much less: grows, but only up to the target minus hysteresis, leaving headroom.
+    budget = calc(400 * MB, 300 * MB, budget);
+    TEST(near(budget, 450 * MB));
+    // Budget that is already larger than that, but under the target, is kept.
+    TEST(calc(400 * MB, 300 * MB, 480 * MB) == 480 * MB);
+    // Resident size larger than the reported usage: others use nothing.
+    TEST(near(calc(0, 0, UINT64_MAX), 900 * MB));
+    TEST(near(CalculateStreamingBudget(100 * MB, deviceBudget, 200 * MB, UINT64_MAX, UINT64_MAX,
+        targetUsage, hysteresis), 900 * MB));
+    // Others alone over the target: nothing left.
+    TEST(calc(950 * MB, 300 * MB, budget) == 0);
+}
+
+// Budget follows simulated GPU memory usage of the rest of the application, like reported by the OS.
+static void TestAutoBudget()
+{
+    SimulatedScene scene(32, 4.f, 2048);
+    scene.m_CameraZ = 0.f;
+    const uint64_t tailSize = scene.GetResidentSize();
+    // Size of all requested levels, without a budget.
+    TEST(scene.Settle() != UINT32_MAX);
+    const uint64_t requestedSize = scene.GetResidentSize();
+    for(SimulatedTexture& tex : scene.m_Textures)
+        tex.m_FirstResidentMip = tex.m_MaxFirstMip;
+
+    scene.m_Params.m_AutoBudget = true;
+    const float targetUsage = scene.m_Params.m_TargetUsage;
+    const float lowUsage = targetUsage - scene.m_Params.m_Hysteresis;
+    // Device budget of 1.5 * requestedSize: fits all requested levels only when others use less than 23%.
+    scene.m_DeviceBudget = requestedSize * 3 / 2;
+    auto getUsage = [&]() { return (double)(scene.m_OtherUsage + scene.GetResidentSize()) / (double)scene.m_DeviceBudget; };
+
+    // Others use 40%: streaming gets up to the target, less than requested.
+    scene.m_OtherUsage = scene.m_DeviceBudget * 4 / 10;
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Auto budget, others use 40%");
+    const uint64_t initialSize = scene.GetResidentSize();
+    TEST(initialSize > tailSize);
+    TEST(getUsage() <= targetUsage);
+
+    // Others use 60%: budget shrinks on the first frame, levels are dropped until usage is under the target.
+    scene.m_OtherUsage = scene.m_DeviceBudget * 6 / 10;
+    scene.Frame();
+    TEST(scene.m_Policy.GetBudget() <= (uint64_t)((double)scene.m_DeviceBudget * targetUsage) - scene.m_OtherUsage);
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Auto budget, others use 60%");
+    const uint64_t shrunkSize = scene.GetResidentSize();
+    TEST(shrunkSize < initialSize);
+    TEST(getUsage() <= targetUsage);
+
+    // Others use a bit less, within the hysteresis: nothing changes, also when it goes back and forth.
+    const uint64_t shrunkBudget = scene.m_Policy.GetBudget();
+    for(uint32_t frame = 0; frame < 100; ++frame)
+    {
+        scene.m_OtherUsage = scene.m_DeviceBudget * 6 / 10 - (frame % 2 ? scene.m_DeviceBudget / 50 : 0);
+        TEST(scene.Frame() == 0);
+        TEST(scene.m_Policy.GetBudget() == shrunkBudget);
+    }
+    TEST(scene.GetResidentSize() == shrunkSize);
+
+    // Others back at 40%: budget grows, but leaves headroom under the target.
+    scene.m_OtherUsage = scene.m_DeviceBudget * 4 / 10;
+    TEST(scene.Settle() != UINT32_MAX);
+    scene.Print("Auto budget, others back at 40%");
+    TEST(scene.GetResidentSize() > shrunkSize);
+    TEST(getUsage() <= lowUsage);
+    // Stays there, doesn't oscillate.
+    const uint64_t restoredSize = scene.GetResidentSize();
+    for(uint32_t frame = 0; frame < 100; ++frame)
+        TEST(scene.Frame() == 0);
+    TEST(scene.GetResidentSize() == restoredSize);
+
+    // Others use almost everything: only tails stay.
+    scene.m_OtherUsage = scene.m_DeviceBudget;
+    TEST(scene.Settle() != UINT32_MAX);
+    TEST(scene.GetResidentSize() == tailSize);
+    TEST(scene.m_Policy.GetBudget() == 0);
+}
+
+// Textures that are not streaming are ignored, also requested.
+static void TestNonStreamingTextures()
+{
+    const SimulatedTexture tex(512);
+    std::vector<TextureStreamingPolicy::Texture> textures(3);
+    textures[1] = {tex.m_MipSizes, tex.m_MaxFirstMip, tex.m_MaxFirstMip};
+    TextureStreamingPolicy policy;
+    policy.RequestMip(0, 0.f, 1.f);
+    policy.RequestMip(1, 0.f, 1.f);
+    policy.RequestMip(2, 0.f, 1.f);
+    std::pmr::vector<TextureStreamingPolicy::Change> changes;
+    policy.CalculateChanges(textures, 0, 0, {}, changes);
+    TEST(policy.GetStreamingTextureCount() == 1);
+    TEST(changes.size() == 1);
+    if(changes.size() == 1)
+    {
+        TEST(changes[0].m_TextureIndex == 1);
+        TEST(changes[0].m_FirstResidentMip == 0);
+    }
+    TEST(policy.GetStreamInCount() == 1);
+}
+
+// More stream-ins pending than MaxChangesPerFrame: the ones requesting most levels are made first.
+static void TestChangeLimit()
+{
+    const SimulatedTexture tex(2048);
+    TEST(tex.m_MaxFirstMip == 4);
+    const uint32_t firstResidentMips[] = {0, 1, 2, 3, 4, 4, 3, 1};
+    std::vector<TextureStreamingPolicy::Texture> textures;
+    TextureStreamingPolicy policy;
+    for(uint32_t firstResidentMip : firstResidentMips)
+    {
+        policy.RequestMip(textures.size(), 0.f, 1.f);
+        textures.push_back({tex.m_MipSizes, tex.m_MaxFirstMip, firstResidentMip});
+    }
+    TextureStreamingPolicy::Params params;
+    params.m_AutoBudget = false;
+    params.m_MaxChangesPerFrame = 3;
+    std::pmr::vector<TextureStreamingPolicy::Change> changes;
+    policy.CalculateChanges(textures, 0, 0, params, changes);
+    TEST(changes.size() == 3);
+    if(changes.size() != 3)
+        return;
+    // Textures 4 and 5 request 4 levels, then 3 or 6 request 3.
+    TEST((changes[0].m_TextureIndex == 4 && changes[1].m_TextureIndex == 5) ||
+        (changes[0].m_TextureIndex == 5 && changes[1].m_TextureIndex == 4));
+    TEST(changes[2].m_TextureIndex == 3 || changes[2].m_TextureIndex == 6);
+    for(const TextureStreamingPolicy::Change& change : changes)
+        TEST(change.m_FirstResidentMip == 0);
+}
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-v") == 0)
+            g_Verbose = true;
+        else
+        {
+            fprintf(stderr, "Usage: TextureStreamingTest [-v]\n");
+            return 2;
+        }
+    }
+
+    TestEstimateRequiredMip();
+    TestCalculateStreamingTargets();
+    TestCameraFlyThrough();
+    TestFixedBudget();
+    TestInvisibleLoseLevelsFirst();
+    TestCalculateStreamingBudget();
+    TestAutoBudget();
+    TestNonStreamingTextures();
+    TestChangeLimit();
+
+    return ReportTestResults();
+}
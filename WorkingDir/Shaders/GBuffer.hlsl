@@ -6,25 +6,56 @@ ALPHA_TEST = 0, 1
 HAS_MATERIAL_COLOR = 0, 1
 HAS_ALBEDO_TEXTURE = 0, 1
 HAS_NORMAL_TEXTURE = 0, 1
+BINDLESS = 0, 1 - set by GBufferBindless.hlsl, not a permutation
 */
 
+#ifndef BINDLESS
+	#define BINDLESS 0
+#endif
+
 struct PerObjectConstants
 {
 	float4x4 WorldViewProj;
 	float4x4 WorldView;
 };
-ConstantBuffer<PerObjectConstants> perObjectConstants : register(b1);
+// Of all objects of the pass, tightly packed.
+StructuredBuffer<PerObjectConstants> perObjectConstants : register(t0, space2);
+
+#if BINDLESS
+
+// Fields of PerMaterialConstants of the non-bindless path, plus indices selecting textures and samplers.
+struct MaterialRecord
+{
+	uint Flags; // Use MATERIAL_FLAG_*
+	float AlphaCutoff; // Valid only when (Flags & MATERIAL_FLAG_ALPHA_MASK)
+	uint AlbedoTextureSlice; // Valid only when (Flags & MATERIAL_FLAG_HAS_ALBEDO_TEXTURE)
+	uint NormalTextureSlice; // Valid only when (Flags & MATERIAL_FLAG_HAS_NORMAL_TEXTURE)
+
+	float3 Color; // Valid only when (Flags & MATERIAL_FLAG_HAS_MATERIAL_COLOR)
+	uint AlbedoTextureIndex; // Into bindlessTextures
+
+	uint NormalTextureIndex; // Into bindlessTextures
+	uint AlbedoSamplerIndex; // Into bindlessSamplers
+	uint NormalSamplerIndex; // Into bindlessSamplers
+	uint _padding1;
+};
+
+#else
 
 struct PerMaterialConstants
 {
 	uint Flags; // Use MATERIAL_FLAG_*
 	float AlphaCutoff; // Valid only when (Flags & MATERIAL_FLAG_ALPHA_MASK)
-	uint2 _padding0;
+	uint AlbedoTextureSlice; // Valid only when (Flags & MATERIAL_FLAG_HAS_ALBEDO_TEXTURE)
+	uint NormalTextureSlice; // Valid only when (Flags & MATERIAL_FLAG_HAS_NORMAL_TEXTURE)
 
 	float3 Color; // Valid only when (Flags & MATERIAL_FLAG_HAS_MATERIAL_COLOR)
 	uint _padding1;
 };
-ConstantBuffer<PerMaterialConstants> perMaterialConstants : register(b2);
+// Of all materials, tightly packed.
+StructuredBuffer<PerMaterialConstants> perMaterialConstants : register(t1, space2);
+
+#endif
 
 struct VS_INPUT
 {
@@ -50,9 +81,10 @@ struct VS_OUTPUT
 
 VS_OUTPUT MainVS(VS_INPUT input)
 {
+	const PerObjectConstants objectConstants = perObjectConstants[perDrawConstants.ObjectIndex];
 	VS_OUTPUT output;
-	output.pos_Clip = mul(perObjectConstants.WorldViewProj, float4(input.pos_Local, 1.0));
-	//output.normal_View = mul((float3x3)perObjectConstants.WorldView, input.normal_Local);
+	output.pos_Clip = mul(objectConstants.WorldViewProj, float4(input.pos_Local, 1.0));
+	//output.normal_View = mul((float3x3)objectConstants.WorldView, input.normal_Local);
 	output.normal_Local = input.normal_Local;
 	output.tangent_Local = input.tangent_Local;
 	output.bitangent_Local = input.bitangent_Local;
@@ -63,30 +95,66 @@ VS_OUTPUT MainVS(VS_INPUT input)
 ////////////////////////////////////////////////////////////////////////////////
 #elif PIXEL_SHADER
 
-Texture2D<float4> albedoTexture : register(t0); // Valid only when (Flags & MATERIAL_FLAG_HAS_ALBEDO_TEXTURE)
-Texture2D<float4> normalTexture : register(t1); // Valid only when (Flags & MATERIAL_FLAG_HAS_NORMAL_TEXTURE)
+#if BINDLESS
+
+StructuredBuffer<MaterialRecord> materialRecords : register(t2);
+// Persistent SRV descriptors, indexed by their index in the heap.
+Texture2DArray<float4> bindlessTextures[] : register(t0, space1);
+// All StandardSamplers, in order of StandardSamplers::GetIndex.
+SamplerState bindlessSamplers[8] : register(s0, space1);
+
+// The index is the same for the whole draw, so NonUniformResourceIndex is not needed.
+#define ALBEDO_TEXTURE bindlessTextures[material.AlbedoTextureIndex]
+#define NORMAL_TEXTURE bindlessTextures[material.NormalTextureIndex]
+#define ALBEDO_SAMPLER bindlessSamplers[material.AlbedoSamplerIndex]
+#define NORMAL_SAMPLER bindlessSamplers[material.NormalSamplerIndex]
+
+#else
+
+// Separate textures are also bound as arrays, with a single slice.
+Texture2DArray<float4> albedoTexture : register(t0); // Valid only when (Flags & MATERIAL_FLAG_HAS_ALBEDO_TEXTURE)
+Texture2DArray<float4> normalTexture : register(t1); // Valid only when (Flags & MATERIAL_FLAG_HAS_NORMAL_TEXTURE)
 SamplerState albedoSampler : register(s0); // Valid only when (Flags & MATERIAL_FLAG_HAS_ALBEDO_TEXTURE)
 SamplerState normalSampler : register(s1); // Valid only when (Flags & MATERIAL_FLAG_HAS_NORMAL_TEXTURE)
 
+#define ALBEDO_TEXTURE albedoTexture
+#define NORMAL_TEXTURE normalTexture
+#define ALBEDO_SAMPLER albedoSampler
+#define NORMAL_SAMPLER normalSampler
+
+#endif
+
 void MainPS(
 	VS_OUTPUT input,
 	out float4 outAlbedo : SV_Target0,
 	out float4 outNormal_View : SV_Target1)
 {
+	const PerObjectConstants objectConstants = perObjectConstants[perDrawConstants.ObjectIndex];
+#if BINDLESS
+	const MaterialRecord material = materialRecords[perDrawConstants.MaterialIndex];
+#else
+	const PerMaterialConstants material = perMaterialConstants[perDrawConstants.MaterialIndex];
+#endif
+
 	float4 albedoColor = 1.0.xxxx;
 #if HAS_MATERIAL_COLOR
-	albedoColor.rgb *= perMaterialConstants.Color;
+	albedoColor.rgb *= material.Color;
 #endif
 #if HAS_ALBEDO_TEXTURE
-	albedoColor *= albedoTexture.Sample(albedoSampler, input.texCoord);
+	albedoColor *= ALBEDO_TEXTURE.Sample(ALBEDO_SAMPLER,
+		float3(input.texCoord, material.AlbedoTextureSlice));
 #endif
 #if ALPHA_TEST
-	clip(albedoColor.a - perMaterialConstants.AlphaCutoff);
+	clip(albedoColor.a - material.AlphaCutoff);
 #endif
 	outAlbedo = float4(albedoColor.rgb, 1.0);
 
 #if HAS_NORMAL_TEXTURE
-	float3 normal_Tangent = normalTexture.Sample(normalSampler, input.texCoord).rgb * 2.0 - 1.0;
+	// Only XY is used, Z is reconstructed. Normal maps are compressed as BC5, which stores only 2 channels.
+	float3 normal_Tangent;
+	normal_Tangent.xy = NORMAL_TEXTURE.Sample(NORMAL_SAMPLER,
+		float3(input.texCoord, material.NormalTextureSlice)).rg * 2.0 - 1.0;
+	normal_Tangent.z = sqrt(saturate(1.0 - dot(normal_Tangent.xy, normal_Tangent.xy)));
 	// TODO check which normalize() are required and which are not.
 	normal_Tangent = normalize(normal_Tangent);
 	float3x3 TBN = float3x3(
@@ -97,7 +165,7 @@ void MainPS(
 #else
 	float3 normal_Local = input.normal_Local;
 #endif
-	float3 normal_View = mul((float3x3)perObjectConstants.WorldView, normal_Local);
+	float3 normal_View = mul((float3x3)objectConstants.WorldView, normal_Local);
 
 	outNormal_View = float4(normalize(normal_View), 1.0);
 }
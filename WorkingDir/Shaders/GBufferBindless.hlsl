@@ -0,0 +1,4 @@
+// G-buffer pixel shader of the bindless path: textures and samplers are selected by indices from
+// material records, see Renderer. Same permutation macros as GBuffer.hlsl.
+#define BINDLESS 1
+#include "GBuffer.hlsl"
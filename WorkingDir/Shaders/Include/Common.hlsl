@@ -23,6 +23,14 @@ struct PerFrameConstants
 };
 ConstantBuffer<PerFrameConstants> perFrameConstants : register(b0);
 
+// Root constants, set for every draw.
+struct PerDrawConstants
+{
+	uint ObjectIndex; // Into per-object data of the pass
+	uint MaterialIndex; // Into per-material data
+};
+ConstantBuffer<PerDrawConstants> perDrawConstants : register(b8);
+
 #ifdef VERTEX_SHADER
 
 float4 FullScreenQuadVS(uint vertexID : SV_VertexID) : SV_Position
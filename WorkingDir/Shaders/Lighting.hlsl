@@ -13,7 +13,8 @@ struct Light
 	float3 m_DirectionToLight_Position;
 	uint _padding0;
 };
-ConstantBuffer<Light> g_Light : register(b1);
+// Of all enabled lights, tightly packed. The current one is selected by perDrawConstants.ObjectIndex.
+StructuredBuffer<Light> g_Lights : register(t0, space2);
 
 #if 0
 // a = roughness
@@ -134,6 +135,8 @@ float3 FresnelTerm(float3 specularColor, float vdoth)
 
 float4 MainPS(float4 pos : SV_Position) : SV_Target
 {
+	const Light light = g_Lights[perDrawConstants.ObjectIndex];
+
 	int3 loadPos = int3(pos.xy, 0);
 	float depth = Depth.Load(loadPos).r;
 	float3 albedo = GBufferAlbedo.Load(loadPos).rgb;
@@ -146,14 +149,14 @@ float4 MainPS(float4 pos : SV_Position) : SV_Target
 	float4 pos_ViewHomo = mul(perFrameConstants.ProjInv, float4(pos_Clip, 1.0));
 	float3 pos_View = pos_ViewHomo.xyz / pos_ViewHomo.w;
 	
-	float3 dirToLight = g_Light.m_DirectionToLight_Position;
+	float3 dirToLight = light.m_DirectionToLight_Position;
 	float diffuseTerm = max(0.0, dot(normal_View, dirToLight));
 	float3 reflected_View = reflect(-perFrameConstants.DirToLight_View, normal_View);
 	float3 dirToCam_View = normalize(-pos_View);
 	float specularTerm = pow(max(0.0, dot(dirToCam_View, reflected_View)), 15.0);
 	
-	//float3 color = g_Light.m_Color * diffuseTerm * (albedo + specularTerm);
-	float3 color = g_Light.m_Color * diffuseTerm * (lerp(albedo, float3(1.0,1.0,1.0), specularTerm));
+	//float3 color = light.m_Color * diffuseTerm * (albedo + specularTerm);
+	float3 color = light.m_Color * diffuseTerm * (lerp(albedo, float3(1.0,1.0,1.0), specularTerm));
 
 	// TEMP
 	float3 l = normalize(dirToLight);
@@ -185,7 +188,7 @@ float4 MainPS(float4 pos : SV_Position) : SV_Target
 	//float3 fCookTorrance = 1.0;
 	//color = diffuseTerm * (kD * fLambert + kS * fCookTorrance);
 	//color = F;
-	color = ( kD * fLambert + D*F*G/( 4.0*dot(l,n)*dot(v,n) ) ) * g_Light.m_Color * max(0.0, dot(normal_View, dirToLight));
+	color = ( kD * fLambert + D*F*G/( 4.0*dot(l,n)*dot(v,n) ) ) * light.m_Color * max(0.0, dot(normal_View, dirToLight));
 	//color = kS;
 #endif
 
@@ -215,12 +218,12 @@ float4 MainPS(float4 pos : SV_Position) : SV_Target
 	diffuse += diffuseColor * EnvRemap(SHIrradiance(normal_View));
 	specular += envSpecularColor * env;
 
-	diffuse += diffuseColor * g_Light.m_Color * saturate(dot(normal_View, dirToLight));
+	diffuse += diffuseColor * light.m_Color * saturate(dot(normal_View, dirToLight));
 
 	float3 lightF = FresnelTerm(specularColor, vdoth);
 	float lightD = DistributionTerm(roughnessL, ndoth);
 	float lightV = VisibilityTerm(roughnessL, ndotv, ndotl);
-	specular += g_Light.m_Color * lightF * (lightD * lightV * PI * ndotl);
+	specular += light.m_Color * lightF * (lightD * lightV * PI * ndotl);
 
 	float ao = 1.;//SceneAO(pos, normal_View, localToWorld);
 	diffuse *= ao;